@@ -0,0 +1,75 @@
+#include "plumed/tools/LeptonCall.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace PLMD;
+
+// compare the values computed for many points at once (evaluateBatch), and the values and
+// derivatives computed together by a fused program (CompiledBatchExpression) or by
+// evaluateWithDerivatives, with those computed by evaluate and evaluateDeriv one at a time
+int main() {
+  std::vector<std::string> funcs;
+  funcs.push_back("x*y+sin(x)");
+  funcs.push_back("exp(-x^2/y)+log(y)");
+  funcs.push_back("step(x-0.5)*x^3+abs(y-1)");
+  funcs.push_back("sqrt(x^2+y^2)/(1+x)+cos(x*y)^2");
+  funcs.push_back("1/(1+(x/y)^6)");
+  funcs.push_back("x-y+2");
+
+  std::vector<std::string> var;
+  var.push_back("x");
+  var.push_back("y");
+
+  // more points than a single block, and a number of points that is not a multiple of the block size
+  const unsigned npoints=301;
+  std::vector<double> args(2*npoints);
+  for(unsigned k=0; k<npoints; ++k) {
+    args[k]=0.1+0.01*k;
+    args[npoints+k]=0.7+0.5*std::sin(0.37*k);
+  }
+
+  FILE* fp=std::fopen("output","w");
+  for(const auto & f : funcs) {
+    LeptonCall lc;
+    lc.set(f,var);
+
+    std::vector<double> vals(npoints);
+    lc.evaluateBatch(args.data(),npoints,npoints,vals.data());
+
+    // the function and its derivatives compiled in a single fused program
+    std::vector<lepton::ParsedExpression> pe(1,lepton::Parser::parse(f).optimize(lepton::Constants()));
+    for(const auto & v : var) pe.push_back(lepton::Parser::parse(f).differentiate(v).optimize(lepton::Constants()));
+    lepton::CompiledBatchExpression fused(pe,var);
+    std::vector<double> fvals(3*npoints);
+    fused.evaluate(args.data(),npoints,fvals.data(),npoints,npoints);
+
+    double maxval=0.0, maxdiff_batch=0.0, maxdiff_fused=0.0, maxdiff_deriv=0.0;
+    std::vector<double> a(2), d(2);
+    for(unsigned k=0; k<npoints; ++k) {
+      a[0]=args[k]; a[1]=args[npoints+k];
+      const double v=lc.evaluate(a);
+      const double vf=fvals[k];
+      const double vd=lc.evaluateWithDerivatives(a,d.data());
+      const double scale=std::max(1.0,std::fabs(v));
+      maxval=std::max(maxval,std::fabs(v));
+      maxdiff_batch=std::max(maxdiff_batch,std::fabs(vals[k]-v)/scale);
+      maxdiff_fused=std::max(maxdiff_fused,std::fabs(vf-v)/scale);
+      maxdiff_fused=std::max(maxdiff_fused,std::fabs(vd-v)/scale);
+      for(unsigned i=0; i<2; ++i) {
+        const double dv=lc.evaluateDeriv(i,a);
+        maxdiff_deriv=std::max(maxdiff_deriv,std::fabs(fvals[(i+1)*npoints+k]-dv)/std::max(1.0,std::fabs(dv)));
+        maxdiff_deriv=std::max(maxdiff_deriv,std::fabs(d[i]-dv)/std::max(1.0,std::fabs(dv)));
+      }
+    }
+    std::fprintf(fp,"%s\n",f.c_str());
+    std::fprintf(fp,"  max value %.6f\n",maxval);
+    std::fprintf(fp,"  batch values %s\n",maxdiff_batch<1e-12?"match":"differ");
+    std::fprintf(fp,"  fused values %s\n",maxdiff_fused<1e-12?"match":"differ");
+    std::fprintf(fp,"  fused derivatives %s\n",maxdiff_deriv<1e-12?"match":"differ");
+  }
+  std::fclose(fp);
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include "plumed/tools/NeighborList.h"
+#include "plumed/tools/LinkCells.h"
+#include "plumed/tools/Communicator.h"
+#include "plumed/tools/Pbc.h"
+#include "plumed/tools/Random.h"
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+using namespace PLMD;
+
+// compare the pairs of a single list NeighborList, that are found with the half shell stencil when
+// there are at least three link cells in each direction, with those found searching all the
+// surrounding cells (full stencil) and with those found checking all the pairs
+int main() {
+  Communicator comm;
+  Random rnd;
+  const unsigned natoms=500;
+
+  std::vector<Tensor> boxes;
+  boxes.push_back(Tensor(3.0,0.0,0.0,0.0,3.5,0.0,0.0,0.0,4.0));
+  boxes.push_back(Tensor(3.0,0.0,0.0,0.9,3.2,0.0,-0.6,0.7,3.6));
+  std::vector<double> cutoffs;
+  cutoffs.push_back(0.5);
+  cutoffs.push_back(0.9);
+  // with less than three cells along a direction the full stencil is used
+  cutoffs.push_back(1.3);
+
+  FILE* fp=std::fopen("output","w");
+  for(unsigned b=0; b<boxes.size(); ++b) {
+    Pbc pbc;
+    pbc.setBox(boxes[b]);
+    std::vector<Vector> positions(natoms);
+    std::vector<AtomNumber> atoms(natoms);
+    for(unsigned i=0; i<natoms; ++i) {
+      // atoms are also placed outside the box to check that they are wrapped in the right cell
+      positions[i]=matmul(Vector(3*rnd.RandU01()-1,3*rnd.RandU01()-1,3*rnd.RandU01()-1),boxes[b]);
+      atoms[i].setIndex(i);
+    }
+    for(const auto & cutoff : cutoffs) {
+      const double d2=cutoff*cutoff;
+      NeighborList nl(atoms,true,true,pbc,comm,cutoff);
+      nl.update(positions);
+      std::vector<std::pair<unsigned,unsigned>> halfshell;
+      for(unsigned k=0; k<nl.size(); ++k) {
+        const auto p=nl.getClosePair(k);
+        halfshell.push_back(std::make_pair(std::min(p.first,p.second),std::max(p.first,p.second)));
+      }
+      std::sort(halfshell.begin(),halfshell.end());
+
+      LinkCells lc(comm);
+      lc.setCutoff(cutoff);
+      std::vector<unsigned> indices(natoms);
+      std::iota(indices.begin(),indices.end(),0);
+      lc.buildCellLists(positions,indices,pbc);
+      std::vector<std::pair<unsigned,unsigned>> fullstencil;
+      std::vector<unsigned> cells_required, candidates(natoms+1);
+      for(unsigned i=0; i<natoms; ++i) {
+        unsigned ncandidates=1;
+        candidates[0]=i;
+        lc.retrieveNeighboringAtoms(positions[i],cells_required,ncandidates,candidates);
+        for(unsigned jj=1; jj<ncandidates; ++jj) {
+          const unsigned j=candidates[jj];
+          if(j>i && modulo2(pbc.distance(positions[i],positions[j]))<=d2) fullstencil.push_back(std::make_pair(i,j));
+        }
+      }
+      std::sort(fullstencil.begin(),fullstencil.end());
+
+      std::vector<std::pair<unsigned,unsigned>> allpairs;
+      for(unsigned i=0; i<natoms; ++i) for(unsigned j=i+1; j<natoms; ++j) {
+          if(modulo2(pbc.distance(positions[i],positions[j]))<=d2) allpairs.push_back(std::make_pair(i,j));
+        }
+
+      std::fprintf(fp,"box %u cutoff %.2f\n",b,cutoff);
+      std::fprintf(fp,"  half shell stencil %s\n",lc.canUseHalfShell()?"yes":"no");
+      std::fprintf(fp,"  pairs %zu\n",allpairs.size());
+      std::fprintf(fp,"  neighbor list and full stencil %s\n",halfshell==fullstencil?"match":"differ");
+      std::fprintf(fp,"  neighbor list and all pairs %s\n",halfshell==allpairs?"match":"differ");
+    }
+  }
+  std::fclose(fp);
+  return 0;
+}
@@ -0,0 +1,111 @@
+#include "plumed/dimred/SMACOF.h"
+#include "plumed/core/Value.h"
+#include "plumed/tools/Matrix.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace PLMD;
+
+// the stress of the projection proj with the weights w
+static double stress( const Matrix<double>& dist, const Matrix<double>& w, const std::vector<double>& proj, unsigned nlow ) {
+  const unsigned M=dist.nrows(); double sigma=0, totalWeight=0;
+  for(unsigned i=1; i<M; ++i) {
+    for(unsigned j=0; j<i; ++j) {
+      double dlow=0;
+      for(unsigned k=0; k<nlow; ++k) { double tmp=proj[nlow*i+k]-proj[nlow*j+k]; dlow+=tmp*tmp; }
+      double tmp=dist(i,j)-std::sqrt(dlow); sigma+=w(i,j)*tmp*tmp; totalWeight+=w(i,j);
+    }
+  }
+  return sigma/totalWeight;
+}
+
+// the SMACOF algorithm with dense matrices and the pseudoinverse of V at every iteration,
+// as it was implemented before the matrices were packed
+static void denseSmacof( const Matrix<double>& dist, const Matrix<double>& w, double tol, unsigned maxloops, std::vector<double>& proj, unsigned nlow ) {
+  const unsigned M=dist.nrows();
+  Matrix<double> Z(M,nlow), newZ(M,nlow), V(M,M), mypseudo(M,M), BZ(M,M), temp(M,M), dists(M,M);
+  for(unsigned i=0; i<M; ++i) for(unsigned k=0; k<nlow; ++k) Z(i,k)=proj[nlow*i+k];
+  for(unsigned i=0; i<M; ++i) {
+    for(unsigned j=0; j<M; ++j) { if(i!=j) { V(i,j)=-w(i,j); V(i,i)+=w(i,j); } }
+  }
+  pseudoInvert(V,mypseudo);
+  auto sigma=[&]( const Matrix<double>& X ) {
+    std::vector<double> p(M*nlow);
+    for(unsigned i=0; i<M; ++i) {
+      for(unsigned k=0; k<nlow; ++k) p[nlow*i+k]=X(i,k);
+      for(unsigned j=0; j<M; ++j) {
+        double dlow=0; for(unsigned k=0; k<nlow; ++k) { double tmp=X(i,k)-X(j,k); dlow+=tmp*tmp; }
+        dists(i,j)=std::sqrt(dlow);
+      }
+    }
+    return stress(dist,w,p,nlow);
+  };
+  double myfirstsig=sigma(Z);
+  for(unsigned n=0; n<maxloops; ++n) {
+    for(unsigned i=0; i<M; ++i) {
+      BZ(i,i)=0;
+      for(unsigned j=0; j<M; ++j) {
+        if(i==j) continue;
+        BZ(i,j)=dists(i,j)>0 ? -w(i,j)*dist(i,j)/dists(i,j) : 0.;
+        BZ(i,i)-=BZ(i,j);
+      }
+    }
+    mult(mypseudo,BZ,temp); mult(temp,Z,newZ);
+    double newsig=sigma(newZ);
+    if( std::fabs(newsig-myfirstsig)<tol ) break;
+    myfirstsig=newsig; Z=newZ;
+  }
+  for(unsigned i=0; i<M; ++i) for(unsigned k=0; k<nlow; ++k) proj[nlow*i+k]=Z(i,k);
+}
+
+// compare the stress and the projections obtained with the packed SMACOF, that uses the conjugate gradient
+// for non-negative weights and the pseudoinverse once per call otherwise, with those of the dense algorithm
+int main() {
+  const unsigned M=80, nhigh=5, nlow=2;
+  std::vector<double> points(M*nhigh);
+  for(unsigned i=0; i<M; ++i) for(unsigned l=0; l<nhigh; ++l) points[nhigh*i+l]=std::sin(0.37*i*(l+1)+0.5*l)+0.1*std::cos(1.3*i+l);
+
+  std::vector<unsigned> shape(2,M);
+  Value target(nullptr,"dist",false,shape); target.setConstant();
+  Matrix<double> dist(M,M);
+  for(unsigned i=0; i<M; ++i) {
+    for(unsigned j=0; j<M; ++j) {
+      double d2=0; for(unsigned l=0; l<nhigh; ++l) { double tmp=points[nhigh*i+l]-points[nhigh*j+l]; d2+=tmp*tmp; }
+      target.set(M*i+j,d2); dist(i,j)=std::sqrt(d2);
+    }
+  }
+
+  std::vector<double> start(M*nlow);
+  for(unsigned i=0; i<M; ++i) for(unsigned k=0; k<nlow; ++k) start[nlow*i+k]=points[nhigh*i+k]+0.05*std::sin(2.1*i+k);
+
+  FILE* fp=std::fopen("output","w");
+  const char* names[3]= {"uniform weights","positive weights","negative weights"};
+  for(unsigned t=0; t<3; ++t) {
+    Matrix<double> w(M,M);
+    dimred::SMACOF packed(&target);
+    for(unsigned i=0; i<M; ++i) {
+      for(unsigned j=0; j<M; ++j) {
+        if(i==j) continue;
+        double ww=1.0;
+        if(t==1) ww=0.5+0.4*std::sin(0.11*(i+j)+0.3*i*j);
+        // a few negative weights, as can be obtained with sketch-map
+        if(t==2 && (i+j)%17==0) ww=-0.05;
+        w(i,j)=ww; packed.setWeight(i,j,ww);
+      }
+    }
+    std::vector<double> pnew(start), pold(start);
+    packed.optimize(1e-8,1000,pnew);
+    denseSmacof(dist,w,1e-8,1000,pold,nlow);
+    double maxdiff=0;
+    for(unsigned n=0; n<pnew.size(); ++n) maxdiff=std::max(maxdiff,std::fabs(pnew[n]-pold[n]));
+    const double snew=stress(dist,w,pnew,nlow), sold=stress(dist,w,pold,nlow), sstart=stress(dist,w,start,nlow);
+    std::fprintf(fp,"%s\n",names[t]);
+    std::fprintf(fp,"  initial stress %.4f final stress %.4f\n",sstart,snew);
+    std::fprintf(fp,"  stress %s\n",std::fabs(snew-sold)<1e-6*std::max(1.0,sold)?"matches":"differs");
+    std::fprintf(fp,"  projections %s\n",maxdiff<1e-4?"match":"differ");
+  }
+  std::fclose(fp);
+  return 0;
+}
@@ -184,8 +184,8 @@ void AdjacencyMatrixBase::updateNeighbourList() {
         linkcells.addRequiredCells( linkcells.findMyCell( ActionAtomistic::getPosition(pTaskList[i]) ), ncells_required, cells_required );
         // Now get the indices of the atoms in the link cells positions
         unsigned natoms=1; indices[0]=pTaskList[i];
-        linkcells.retrieveAtomsInCells( ncells_required, cells_required, natoms, indices );
         if( nl_stride==1 ) {
+          linkcells.retrieveAtomsInCells( ncells_required, cells_required, natoms, indices );
           if( nt>1 ) omp_nlist[indices[0]]=0; else nlist[indices[0]] = 0;
           unsigned lstart = getConstPntrToComponent(0)->getShape()[0] + indices[0]*(1+natoms_per_list);
           for(unsigned j=0; j<natoms; ++j) {
@@ -193,8 +193,11 @@ void AdjacencyMatrixBase::updateNeighbourList() {
             else { nlist[ lstart + nlist[indices[0]] ] = indices[j]; nlist[indices[0]]++; }
           }
         } else {
-          // Get the positions of all the atoms in the link cells relative to the central atom
-          for(unsigned j=0; j<natoms; ++j) t_atoms[j] = ActionAtomistic::getPosition(indices[j]) - ActionAtomistic::getPosition(indices[0]);
+          // Get the positions of all the atoms in the link cells relative to the central atom.  The positions are read from
+          // the copy in the link cells, which is ordered by cell, so that they are contiguous in memory
+          linkcells.retrieveAtomsInCells( ncells_required, cells_required, natoms, indices, t_atoms );
+          Vector cpos = ActionAtomistic::getPosition(indices[0]); t_atoms[0].zero();
+          for(unsigned j=1; j<natoms; ++j) t_atoms[j] -= cpos;
           if( !nopbc ) pbcApply( t_atoms, natoms );
           // Now construct the neighbor list
           if( nt>1 ) omp_nlist[indices[0]] = 0; else nlist[indices[0]] = 0;
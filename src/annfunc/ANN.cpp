@@ -23,7 +23,7 @@ SOFTWARE.
 +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 #include "function/Function.h"
 #include "core/ActionRegister.h"
-#include "cassert"
+#include "blas/blas.h"
 
 #include <string>
 #include <cmath>
@@ -90,21 +90,24 @@ To access its components, we use "ann.node-0", "ann.node-1", ..., which represen
 class ANN : public Function
 {
 private:
+  enum activation_type {linear, tanh_activation, circular};
   int num_layers;
   vector<int> num_nodes;
   vector<string> activations;   // activation functions
-  vector<vector<double> > weights;  // flattened weight arrays
+  vector<activation_type> activation_types;
+  vector<vector<double> > weights;  // flattened weight arrays, stored row by row
   vector<vector<double> > biases;
   vector<vector<double> > output_of_each_layer;
   vector<vector<double> > input_of_each_layer;
-  vector<double** > coeff;  // weight matrix arrays, reshaped from "weights"
+  vector<double> jacobian;  // derivatives of all the outputs, one row for each output
+  vector<double> delta;
 
 public:
   static void registerKeywords( Keywords& keys );
   explicit ANN(const ActionOptions&);
   virtual void calculate();
   void calculate_output_of_each_layer(const vector<double>& input);
-  void back_prop(vector<vector<double> >& derivatives_of_each_layer, int index_of_output_component);
+  void back_prop();
 };
 
 PLUMED_REGISTER_ACTION(ANN,"ANN")
@@ -133,9 +136,25 @@ ANN::ANN(const ActionOptions&ao):
   activations = vector<string>(num_layers - 1);
   output_of_each_layer = vector<vector<double> >(num_layers);
   input_of_each_layer = vector<vector<double> >(num_layers);
-  coeff = vector<double** >(num_layers - 1);
   parseVector("NUM_NODES", num_nodes);
   parseVector("ACTIVATIONS", activations);
+  for (int ii = 0; ii < num_layers - 1; ii ++) {
+    if (activations[ii] == string("Linear")) {
+      activation_types.push_back(linear);
+    }
+    else if (activations[ii] == string("Tanh")) {
+      activation_types.push_back(tanh_activation);
+    }
+    else if (activations[ii] == string("Circular")) {
+      if (num_nodes[ii + 1] % 2 != 0) {
+        error("Circular layers should have an even number of nodes");
+      }
+      activation_types.push_back(circular);
+    }
+    else {
+      error("layer type " + activations[ii] + " not found");
+    }
+  }
   log.printf("\nactivations = ");
   for (const auto & ss: activations) {
     log.printf("%s, ", ss.c_str());
@@ -167,27 +186,16 @@ ANN::ANN(const ActionOptions&ao):
     error("Number of arguments is wrong");
   }
 
-  auto temp_coeff = weights;
   for (int ii = 0; ii < num_layers - 1; ii ++) {
-    int num_of_rows, num_of_cols; // num of rows/cols for the coeff matrix of this connection
-    num_of_rows = num_nodes[ii + 1];
-    num_of_cols = num_nodes[ii];
-    assert (num_of_rows * num_of_cols == temp_coeff[ii].size()); // check whether the size matches
-    // create a 2d array to hold coefficients
-    coeff[ii] = new double*[num_of_rows];
-    for (int kk = 0; kk < num_of_rows; kk ++) {
-      coeff[ii][kk] = new double[num_of_cols];
-    }
-    for (int jj = 0; jj < temp_coeff[ii].size(); jj ++) {
-      coeff[ii][jj / num_of_cols][jj % num_of_cols] = temp_coeff[ii][jj];
-    }
+    // the weight matrix of this connection has num_nodes[ii + 1] rows and num_nodes[ii] columns
+    plumed_massert(static_cast<size_t>(num_nodes[ii + 1] * num_nodes[ii]) == weights[ii].size(), "the number of weights does not match the number of nodes");
   }
   // check coeff
   for (int ii = 0; ii < num_layers - 1; ii ++) {
     log.printf("coeff %d = \n", ii);
     for (int jj = 0; jj < num_nodes[ii + 1]; jj ++) {
       for (int kk = 0; kk < num_nodes[ii]; kk ++) {
-        log.printf("%f ", coeff[ii][jj][kk]);
+        log.printf("%f ", weights[ii][jj * num_nodes[ii] + kk]);
       }
       log.printf("\n");
     }
@@ -211,49 +219,41 @@ ANN::ANN(const ActionOptions&ao):
 }
 
 void ANN::calculate_output_of_each_layer(const vector<double>& input) {
+  double one = 1.0;
+  int inc = 1;
   // first layer
   output_of_each_layer[0] = input;
   // following layers
   for(int ii = 1; ii < num_nodes.size(); ii ++) {
-    output_of_each_layer[ii].resize(num_nodes[ii]);
-    input_of_each_layer[ii].resize(num_nodes[ii]);
-    // first calculate input
-    for (int jj = 0; jj < num_nodes[ii]; jj ++) {
-      input_of_each_layer[ii][jj] = biases[ii - 1][jj];  // add bias term
-      for (int kk = 0; kk < num_nodes[ii - 1]; kk ++) {
-        input_of_each_layer[ii][jj] += coeff[ii - 1][jj][kk] * output_of_each_layer[ii - 1][kk];
-      }
-    }
+    int num_of_rows = num_nodes[ii];
+    int num_of_cols = num_nodes[ii - 1];
+    output_of_each_layer[ii].resize(num_of_rows);
+    // first calculate input, the weights are stored row by row, i.e. they are
+    // the transpose of the weight matrix in the column major order used by blas
+    input_of_each_layer[ii].assign(biases[ii - 1].begin(), biases[ii - 1].begin() + num_of_rows);  // add bias term
+    plumed_blas_dgemv("T", &num_of_cols, &num_of_rows, &one, weights[ii - 1].data(), &num_of_cols,
+                      output_of_each_layer[ii - 1].data(), &inc, &one, input_of_each_layer[ii].data(), &inc);
     // then get output
-    if (activations[ii - 1] == string("Linear")) {
-      for(int jj = 0; jj < num_nodes[ii]; jj ++) {
-        output_of_each_layer[ii][jj] = input_of_each_layer[ii][jj];
-      }
+    if (activation_types[ii - 1] == linear) {
+      output_of_each_layer[ii] = input_of_each_layer[ii];
     }
-    else if (activations[ii - 1] == string("Tanh")) {
-      for(int jj = 0; jj < num_nodes[ii]; jj ++) {
+    else if (activation_types[ii - 1] == tanh_activation) {
+      for(int jj = 0; jj < num_of_rows; jj ++) {
         output_of_each_layer[ii][jj] = tanh(input_of_each_layer[ii][jj]);
       }
     }
-    else if (activations[ii - 1] == string("Circular")) {
-      assert (num_nodes[ii] % 2 == 0);
-      for(int jj = 0; jj < num_nodes[ii] / 2; jj ++) {
+    else if (activation_types[ii - 1] == circular) {
+      for(int jj = 0; jj < num_of_rows / 2; jj ++) {
         double radius = sqrt(input_of_each_layer[ii][2 * jj] * input_of_each_layer[ii][2 * jj]
                              +input_of_each_layer[ii][2 * jj + 1] * input_of_each_layer[ii][2 * jj + 1]);
         output_of_each_layer[ii][2 * jj] = input_of_each_layer[ii][2 * jj] / radius;
         output_of_each_layer[ii][2 * jj + 1] = input_of_each_layer[ii][2 * jj + 1] / radius;
-
       }
     }
-    else {
-      printf("layer type not found!\n\n");
-      return;
-    }
   }
 #ifdef DEBUG_2
   // print out the result for debugging
   printf("output_of_each_layer = \n");
-  // for (int ii = num_layers - 1; ii < num_layers; ii ++) {
   for (int ii = 0; ii < num_layers; ii ++) {
     printf("layer[%d]: ", ii);
     if (ii != 0) {
@@ -272,89 +272,54 @@ void ANN::calculate_output_of_each_layer(const vector<double>& input) {
   return;
 }
 
-void ANN::back_prop(vector<vector<double> >& derivatives_of_each_layer, int index_of_output_component) {
-  derivatives_of_each_layer = output_of_each_layer;  // the data structure and size should be the same, so I simply deep copy it
-  // first calculate derivatives for bottleneck layer
-  for (int ii = 0; ii < num_nodes[num_nodes.size() - 1]; ii ++ ) {
-    if (ii == index_of_output_component) {
-      derivatives_of_each_layer[num_nodes.size() - 1][ii] = 1;
-    }
-    else {
-      derivatives_of_each_layer[num_nodes.size() - 1][ii] = 0;
-    }
+void ANN::back_prop() {
+  // the derivatives of all the output components are propagated together, as the rows of a matrix
+  double one = 1.0, zero = 0.0;
+  int num_outputs = num_nodes[num_layers - 1];
+  // first the derivatives with respect to the output layer are the identity
+  jacobian.assign(num_outputs * num_outputs, 0.0);
+  for (int ii = 0; ii < num_outputs; ii ++) {
+    jacobian[ii * num_outputs + ii] = 1;
   }
   // the use back propagation to calculate derivatives for previous layers
-  for (int jj = num_nodes.size() - 2; jj >= 0; jj --) {
-    if (activations[jj] == string("Circular")) {
-      vector<double> temp_derivative_of_input_for_this_layer;
-      temp_derivative_of_input_for_this_layer.resize(num_nodes[jj + 1]);
-#ifdef DEBUG
-      assert (num_nodes[jj + 1] % 2 == 0);
-#endif
-      // first calculate the derivative of input from derivative of output of this circular layer
-      for(int ii = 0; ii < num_nodes[jj + 1] / 2; ii ++) {
-        // printf("size of input_of_each_layer[%d] = %d\n",jj,  input_of_each_layer[jj].size());
-        double x_p = input_of_each_layer[jj + 1][2 * ii];
-        double x_q = input_of_each_layer[jj + 1][2 * ii + 1];
-        double radius = sqrt(x_p * x_p + x_q * x_q);
-        temp_derivative_of_input_for_this_layer[2 * ii] = x_q / (radius * radius * radius)
-            * (x_q * derivatives_of_each_layer[jj + 1][2 * ii]
-               - x_p * derivatives_of_each_layer[jj + 1][2 * ii + 1]);
-        temp_derivative_of_input_for_this_layer[2 * ii + 1] = x_p / (radius * radius * radius)
-            * (x_p * derivatives_of_each_layer[jj + 1][2 * ii + 1]
-               - x_q * derivatives_of_each_layer[jj + 1][2 * ii]);
-      }
-#ifdef DEBUG
-      for (int mm = 0; mm < num_nodes[jj + 1]; mm ++) {
-        printf("temp_derivative_of_input_for_this_layer[%d] = %lf\n", mm, temp_derivative_of_input_for_this_layer[mm]);
-        printf("derivatives_of_each_layer[%d + 1][%d] = %lf\n", jj, mm, derivatives_of_each_layer[jj + 1][mm]);
-      }
-#endif
-      // the calculate the derivative of output of layer jj, from derivative of input of layer (jj + 1)
-      for (int mm = 0; mm < num_nodes[jj]; mm ++) {
-        derivatives_of_each_layer[jj][mm] = 0;
-        for (int kk = 0; kk < num_nodes[jj + 1]; kk ++) {
-          derivatives_of_each_layer[jj][mm] += coeff[jj][kk][mm] \
-                                               * temp_derivative_of_input_for_this_layer[kk];
-#ifdef DEBUG
-          printf("derivatives_of_each_layer[%d][%d] = %lf\n", jj, mm, derivatives_of_each_layer[jj][mm]);
-          printf("coeff[%d][%d][%d] = %lf\n", jj, kk, mm, coeff[jj][kk][mm]);
-#endif
+  for (int jj = num_layers - 2; jj >= 0; jj --) {
+    int num_of_rows = num_nodes[jj + 1];
+    int num_of_cols = num_nodes[jj];
+    // first calculate the derivatives with respect to the input of layer (jj + 1)
+    delta.swap(jacobian);
+    if (activation_types[jj] == tanh_activation) {
+      for (int oo = 0; oo < num_outputs; oo ++) {
+        for (int kk = 0; kk < num_of_rows; kk ++) {
+          delta[oo * num_of_rows + kk] *= 1 - output_of_each_layer[jj + 1][kk] * output_of_each_layer[jj + 1][kk];
         }
       }
-      // TODO: should be fine, pass all tests, although there seems to be some problems here previously
     }
-    else {
-      for (int mm = 0; mm < num_nodes[jj]; mm ++) {
-        derivatives_of_each_layer[jj][mm] = 0;
-        for (int kk = 0; kk < num_nodes[jj + 1]; kk ++) {
-          if (activations[jj] == string("Tanh")) {
-            // printf("tanh\n");
-            derivatives_of_each_layer[jj][mm] += derivatives_of_each_layer[jj + 1][kk] \
-                                                 * coeff[jj][kk][mm] \
-                                                 * (1 - output_of_each_layer[jj + 1][kk] * output_of_each_layer[jj + 1][kk]);
-          }
-          else if (activations[jj] == string("Linear")) {
-            // printf("linear\n");
-            derivatives_of_each_layer[jj][mm] += derivatives_of_each_layer[jj + 1][kk] \
-                                                 * coeff[jj][kk][mm] \
-                                                 * 1;
-          }
-          else {
-            printf("layer type not found!\n\n");
-            return;
-          }
+    else if (activation_types[jj] == circular) {
+      for (int oo = 0; oo < num_outputs; oo ++) {
+        double* row = delta.data() + oo * num_of_rows;
+        for(int ii = 0; ii < num_of_rows / 2; ii ++) {
+          double x_p = input_of_each_layer[jj + 1][2 * ii];
+          double x_q = input_of_each_layer[jj + 1][2 * ii + 1];
+          double radius = sqrt(x_p * x_p + x_q * x_q);
+          double d_p = row[2 * ii], d_q = row[2 * ii + 1];
+          row[2 * ii] = x_q / (radius * radius * radius) * (x_q * d_p - x_p * d_q);
+          row[2 * ii + 1] = x_p / (radius * radius * radius) * (x_p * d_q - x_q * d_p);
         }
       }
     }
+    // then the derivatives with respect to the output of layer jj, jacobian = delta * coeff,
+    // which in the column major order used by blas reads jacobian^T = coeff^T * delta^T
+    jacobian.resize(num_outputs * num_of_cols);
+    plumed_blas_dgemm("N", "N", &num_of_cols, &num_outputs, &num_of_rows, &one, weights[jj].data(), &num_of_cols,
+                      delta.data(), &num_of_rows, &zero, jacobian.data(), &num_of_cols);
   }
 #ifdef DEBUG
   // print out the result for debugging
-  printf("derivatives_of_each_layer = \n");
-  for (int ii = 0; ii < num_layers; ii ++) {
-    printf("layer[%d]: ", ii);
-    for (int jj = 0; jj < num_nodes[ii]; jj ++) {
-      printf("%lf\t", derivatives_of_each_layer[ii][jj]);
+  printf("derivatives of the outputs = \n");
+  for (int ii = 0; ii < num_outputs; ii ++) {
+    printf("output[%d]: ", ii);
+    for (int jj = 0; jj < num_nodes[0]; jj ++) {
+      printf("%lf\t", jacobian[ii * num_nodes[0] + jj]);
     }
     printf("\n");
   }
@@ -371,15 +336,20 @@ void ANN::calculate() {
   }
 
   calculate_output_of_each_layer(input_layer_data);
-  vector<vector<double> > derivatives_of_each_layer;
+  // a single backward pass gives the derivatives of all the components
+  bool derivatives = !doNotCalculateDerivatives();
+  if (derivatives) {
+    back_prop();
+  }
 
   for (int ii = 0; ii < num_nodes[num_layers - 1]; ii ++) {
-    back_prop(derivatives_of_each_layer, ii);
-    string name_of_this_component = "node-" + to_string(ii);
-    Value* value_new=getPntrToComponent(name_of_this_component);
+    Value* value_new=getPntrToComponent(ii);
     value_new -> set(output_of_each_layer[num_layers - 1][ii]);
+    if (!derivatives) {
+      continue;
+    }
     for (int jj = 0; jj < num_nodes[0]; jj ++) {
-      value_new -> setDerivative(jj, derivatives_of_each_layer[0][jj]);  // TODO: setDerivative or addDerivative?
+      value_new -> setDerivative(jj, jacobian[ii * num_nodes[0] + jj]);  // TODO: setDerivative or addDerivative?
     }
 #ifdef DEBUG_3
     printf("derivatives = ");
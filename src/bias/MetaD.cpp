@@ -31,6 +31,7 @@
 #include "tools/Random.h"
 #include "tools/File.h"
 #include "tools/Communicator.h"
+#include "tools/Stopwatch.h"
 #include <ctime>
 #include <numeric>
 
@@ -76,6 +77,9 @@ In case you provide both PLUMED will use the most conservative choice (highest n
 In case you do not provide any information about bin size (neither GRID_BIN nor GRID_SPACING)
 PLUMED will use 1/5 of the Gaussian width (SIGMA) as grid spacing if the width is fixed or 1/5 of the minimum
 Gaussian width (SIGMA_MIN) if the width is variable. This default choice should be reasonable for most applications.
+In three or more dimensions a dense grid may require too much memory. With GRID_BLOCKS the grid is divided
+in small dense tiles that are allocated only when a hill with a non negligible value is added on them, so that memory
+is used only in the region of CV space that has been explored.
 
 Alternatively to the use of grids, it is possible to use a neighbor list to decrease the cost of evaluating the bias,
 this can be enabled using NLIST. NLIST can be beneficial with more than 2 collective variables, where GRID becomes
@@ -85,6 +89,23 @@ is within 6.*DP2CUTOFF*sigma*sigma. While the list is updated if the CVs are far
 standard deviation of the Gaussian center distribution of the list. These parameters (6 and 0.5) can be modified using
 NLIST_PARAMETERS. Note that the use of neighbor list does not provide the exact bias.
 
+A second alternative to the use of grids is HILLS_TREE. In this case the hills are stored in a bounding volume hierarchy
+in CV space. Every hill is enclosed in a box that contains the region where the Gaussian is larger than the cutoff
+(the box takes into account the off diagonal elements of the ADAPTIVE hills) and the hills are split in a binary tree
+of boxes, halving them every time along the CV in which their centers are most spread. The hills that are added
+after the last split are collected in leaves of consecutive hills, and all the hills are split again when
+there are more than \f$\sqrt{256 N}\f$ of them, where \f$N\f$ is the total number of hills, so that the cost of
+the splits is small. At every step only the branches of the tree whose box contains the
+current value of the CVs are visited. Periodic CVs are taken into account when building and visiting the boxes.
+The cost of the bias thus grows with the number of hills that overlap with the current position rather than with
+the total number of hills, also when the CVs come back to regions that were visited long before.
+The number of hills that are summed at the present step is reported in the component treeker.
+When most of the hills overlap with each other, e.g. with large Gaussians or at the beginning of the simulation,
+visiting the tree can be slower than summing all the hills.
+With the default value of HILLS_TREE_CUTOFF the boxes enclose the whole support of the truncated Gaussians so that
+the bias and the forces are the same as those obtained without HILLS_TREE.
+A smaller value of HILLS_TREE_CUTOFF (in units of the Gaussian width) discards the tails of the Gaussians and provides an approximate bias.
+
 Metadynamics can be restarted either from a HILLS file as well as from a GRID, in this second
 case one can first save a GRID using GRID_WFILE (and GRID_WSTRIDE) and at a later stage read
 it using GRID_RFILE.
@@ -231,6 +252,31 @@ where all the walkers are located. WALKERS_RSTRIDE is the number of step between
 one update and the other. Since version 2.2.5, hills files are automatically
 flushed every WALKERS_RSTRIDE steps.
 
+With WALKERS_MPI the hills are instead exchanged between walkers with a single MPI message per deposition,
+and the time spent in the exchange is reported at the end of the log. With many walkers the exchange
+can be overlapped with the following MD step by adding WALKERS_MPI_ASYNC, in which case the hills of
+all walkers are added to the bias one step later. The hills of the last deposition are added when the MD code
+signals the end of the calculation (runFinalJobs).
+
+\par
+When more than two CVs are biased or ADAPTIVE hills are used a grid is often not practical.
+In this case the hills can be stored in a tree with HILLS_TREE, so that the cost of the bias does not grow
+with the total number of hills. The component treeker reports how many hills are summed at every step.
+\plumedfile
+phi: TORSION ATOMS=1,2,3,4
+psi: TORSION ATOMS=5,6,7,8
+d1: DISTANCE ATOMS=1,10
+d2: DISTANCE ATOMS=4,20
+
+METAD ...
+ LABEL=metad
+ ARG=phi,psi,d1,d2 SIGMA=0.30,0.30,0.05,0.05 HEIGHT=1.2 BIASFACTOR=10 TEMP=300.0 PACE=500
+ HILLS_TREE
+... METAD
+
+PRINT ARG=metad.bias,metad.treeker FILE=COLVAR STRIDE=100
+\endplumedfile
+
 \par
 The \f$c(t)\f$ reweighting factor can be calculated on the fly using the equations
 presented in \cite Tiwary_jp504920s as described above.
@@ -433,6 +479,13 @@ private:
   int mw_rstride_;
   bool walkers_mpi_;
   unsigned mpi_nw_;
+  // packed records used to exchange hills between MPI walkers
+  bool mw_async_;
+  bool mw_pending_;
+  std::vector<double> mw_send_;
+  std::vector<double> mw_recv_;
+  Communicator::Request mw_request_;
+  std::unique_ptr<Stopwatch> mw_stopwatch_;
   // flying gaussians
   bool flying_;
   // kinetics from metadynamics
@@ -475,6 +528,37 @@ private:
   std::vector<Gaussian> nlist_hills_;
   std::vector<double> nlist_center_;
   std::vector<double> nlist_dev2_;
+  // hills tree stuff
+  bool tree_;
+  double tree_dp2cutoff_;
+  // a box in CV space, lo and hi are given with respect to ref using difference() so that periodic CVs are unwrapped
+  struct TreeNode {
+    std::vector<double> ref;
+    std::vector<double> lo;
+    std::vector<double> hi;
+    // for the nodes of tree_nodes_: the children (0 for leaves, since the root is not a child of any node)
+    // and the range of tree_order_ that contains the hills of a leaf
+    std::size_t left=0, right=0;
+    std::size_t first=0, last=0;
+  };
+  // the maximum number of hills that are collected in a leaf of the tree
+  static constexpr unsigned tree_leaf_size_=16;
+  // the hills added before the last rebuild are split in space: tree_nodes_[0] is the root and
+  // every node is split in two halves along the CV in which the centers of its hills are most spread
+  std::vector<TreeNode> tree_nodes_;
+  // the hills of the leaves of tree_nodes_
+  std::vector<unsigned> tree_order_;
+  // the number of hills in tree_nodes_
+  std::size_t tree_built_=0;
+  // the hills added after the last rebuild are collected in leaves of consecutive hills:
+  // tree_levels_[0] contains the leaves, the node j at level l contains the nodes 2*j and 2*j+1 of level l-1
+  std::vector<std::vector<TreeNode>> tree_levels_;
+  // the half widths of the box of every hill, flattened
+  std::vector<double> tree_extent_;
+  // the period of every CV, 0 if the CV is not periodic
+  std::vector<double> tree_period_;
+  // the hills that have to be summed at the present step
+  std::vector<unsigned> tree_hills_;
 
   double stretchA=1.0;
   double stretchB=0.0;
@@ -494,6 +578,9 @@ private:
   void   readGaussians(IFile*);
   void   writeGaussian(const Gaussian&,OFile&);
   void   addGaussian(const Gaussian&);
+  void   addWalkersGaussians(unsigned);
+  void   completeWalkersExchange();
+  void   addGaussianOnGridRows(const Gaussian&, const std::vector<unsigned>&);
   double getHeight(const std::vector<double>&);
   void   temperHeight(double &height, const TemperingSpecs &t_specs, const double tempering_bias);
   double getBias(const std::vector<double>&);
@@ -507,11 +594,20 @@ private:
   double getTransitionBarrierBias();
   void   updateFrequencyAdaptiveStride();
   void   updateNlist();
+  std::vector<double> getHillsTreeExtent(const Gaussian&);
+  void   addToHillsTree(const Gaussian&);
+  void   buildHillsTree();
+  std::size_t buildHillsTreeNode(std::size_t first, std::size_t last);
+  void   clearHillsTree();
+  void   mergeHillsTreeBox(TreeNode&, const std::vector<double>& ref, const double* lo, const double* hi);
+  bool   hillsTreeBoxContains(const double* ref, const double* lo, const double* hi, const double* cv);
+  void   updateTreeHills(const std::vector<double>&);
 
 public:
   explicit MetaD(const ActionOptions&);
   void calculate() override;
   void update() override;
+  void runFinalJobs() override;
   static void registerKeywords(Keywords& keys);
   bool checkNeedsGradients()const override;
 };
@@ -530,6 +626,7 @@ void MetaD::registerKeywords(Keywords& keys) {
   keys.addOutputComponent("pace","FREQUENCY_ADAPTIVE","scalar","the hill addition frequency when employing frequency adaptive metadynamics");
   keys.addOutputComponent("nlker","NLIST","scalar","number of hills in the neighbor list");
   keys.addOutputComponent("nlsteps","NLIST","scalar","number of steps from last neighbor list update");
+  keys.addOutputComponent("treeker","HILLS_TREE","scalar","number of hills whose box in the tree contains the current value of the CVs");
   keys.add("compulsory","SIGMA","the widths of the Gaussian hills");
   keys.add("compulsory","PACE","the frequency for hill addition");
   keys.add("compulsory","FILE","HILLS","a file in which the list of added hills is stored");
@@ -554,6 +651,7 @@ void MetaD::registerKeywords(Keywords& keys) {
   keys.add("optional","GRID_BIN","the number of bins for the grid");
   keys.add("optional","GRID_SPACING","the approximate grid spacing (to be used as an alternative or together with GRID_BIN)");
   keys.addFlag("GRID_SPARSE",false,"use a sparse grid to store hills");
+  keys.addFlag("GRID_BLOCKS",false,"use a block sparse grid to store hills: tiles of bins are allocated only where the hills are non zero");
   keys.addFlag("GRID_NOSPLINE",false,"don't use spline interpolation with grids");
   keys.add("optional","GRID_WSTRIDE","write the grid to a file every N steps");
   keys.add("optional","GRID_WFILE","the file on which to write the grid");
@@ -561,6 +659,9 @@ void MetaD::registerKeywords(Keywords& keys) {
   keys.addFlag("STORE_GRIDS",false,"store all the grid files the calculation generates. They will be deleted if this keyword is not present");
   keys.addFlag("NLIST",false,"Use neighbor list for kernels summation, faster but experimental");
   keys.add("optional", "NLIST_PARAMETERS","(default=6.,0.5) the two cutoff parameters for the Gaussians neighbor list");
+  keys.addFlag("HILLS_TREE",false,"store the hills in a tree in CV space and only sum the hills whose support contains the CVs");
+  keys.add("optional","HILLS_TREE_CUTOFF","the number of Gaussian widths beyond which hills are discarded by HILLS_TREE. "
+           "The default is the cutoff of the Gaussian kernels, that gives the same bias that is obtained without HILLS_TREE");
   keys.add("optional","ADAPTIVE","use a geometric (=GEOM) or diffusion (=DIFF) based hills width scheme. Sigma is one number that has distance units or time step dimensions");
   keys.add("optional","SIGMA_MAX","the upper bounds for the sigmas (in CV units) when using adaptive hills. Negative number means no bounds ");
   keys.add("optional","SIGMA_MIN","the lower bounds for the sigmas (in CV units) when using adaptive hills. Negative number means no bounds ");
@@ -570,6 +671,7 @@ void MetaD::registerKeywords(Keywords& keys) {
   keys.add("optional","WALKERS_RSTRIDE","stride for reading hills files");
   keys.addFlag("WALKERS_MPI",false,"Switch on MPI version of multiple walkers - not compatible with WALKERS_* options other than WALKERS_DIR");
   keys.add("optional","INTERVAL","one dimensional lower and upper limits, outside the limits the system will not feel the biasing force.");
+  keys.addFlag("WALKERS_MPI_ASYNC",false,"exchange the hills between MPI walkers while the following MD step runs, hills are added to the bias one step later. Must be used with WALKERS_MPI");
   keys.addFlag("FLYING_GAUSSIAN",false,"Switch on flying Gaussian method, must be used with WALKERS_MPI");
   keys.addFlag("ACCELERATION",false,"Set to TRUE if you want to compute the metadynamics acceleration factor.");
   keys.add("optional","ACCELERATION_RFILE","a data file from which the acceleration should be read at the initial step of the simulation");
@@ -607,6 +709,7 @@ MetaD::MetaD(const ActionOptions& ao):
   wgridstride_(0),
   mw_n_(1), mw_dir_(""), mw_id_(0), mw_rstride_(1),
   walkers_mpi_(false), mpi_nw_(0),
+  mw_async_(false), mw_pending_(false),
   flying_(false),
   acceleration_(false), acc_(0.0), acc_restart_mean_(0.0),
   calc_max_bias_(false), max_bias_(0.0),
@@ -625,7 +728,9 @@ MetaD::MetaD(const ActionOptions& ao):
   work_(0),
   nlist_(false),
   nlist_update_(false),
-  nlist_steps_(0)
+  nlist_steps_(0),
+  tree_(false),
+  tree_dp2cutoff_(dp2cutoff)
 {
   if(!dp2cutoffNoStretch()) {
     stretchA=dp2cutoffA;
@@ -808,6 +913,9 @@ MetaD::MetaD(const ActionOptions& ao):
 
   bool sparsegrid=false;
   parseFlag("GRID_SPARSE",sparsegrid);
+  bool blockgrid=false;
+  parseFlag("GRID_BLOCKS",blockgrid);
+  if(sparsegrid && blockgrid) error("GRID_SPARSE and GRID_BLOCKS cannot be combined");
   bool nospline=false;
   parseFlag("GRID_NOSPLINE",nospline);
   bool spline=!nospline;
@@ -851,6 +959,28 @@ MetaD::MetaD(const ActionOptions& ao):
     nlist_param_[1]=nlist_param[1];
   }
 
+  /*setup hills tree stuff*/
+  parseFlag("HILLS_TREE",tree_);
+  if(tree_&&grid_) error("HILLS_TREE and GRID cannot be combined!");
+  if(tree_&&nlist_) error("HILLS_TREE and NLIST cannot be combined!");
+  double tree_cutoff=-1.0;
+  parse("HILLS_TREE_CUTOFF",tree_cutoff);
+  if(tree_cutoff>0.0) {
+    if(!tree_) error("HILLS_TREE_CUTOFF can only be used with HILLS_TREE");
+    tree_dp2cutoff_=std::min(0.5*tree_cutoff*tree_cutoff,dp2cutoff);
+  }
+  if(tree_) {
+    tree_period_.resize(getNumberOfArguments(),0.0);
+    for(unsigned i=0; i<getNumberOfArguments(); ++i) {
+      if(getPntrToArgument(i)->isPeriodic()) {
+        double min, max;
+        getPntrToArgument(i)->getDomain(min,max);
+        tree_period_[i]=max-min;
+      }
+    }
+    log.printf("  Hills are stored in a tree and are discarded beyond %f widths\n",std::sqrt(2.0*tree_dp2cutoff_));
+  }
+
   // Reweighting factor rct
   parseFlag("CALC_RCT",calc_rct_);
   if (calc_rct_) plumed_massert(grid_,"CALC_RCT is supported only if bias is on a grid");
@@ -876,6 +1006,8 @@ MetaD::MetaD(const ActionOptions& ao):
     plumed_assert(Communicator::initialized()) << "Invalid walkers configuration: WALKERS_MPI needs the communicator correctly initialized.";
   }
 
+  parseFlag("WALKERS_MPI_ASYNC",mw_async_);
+
   // Flying Gaussian
   parseFlag("FLYING_GAUSSIAN", flying_);
 
@@ -1008,6 +1140,7 @@ MetaD::MetaD(const ActionOptions& ao):
     log.printf("\n");
     if(spline) {log.printf("  Grid uses spline interpolation\n");}
     if(sparsegrid) {log.printf("  Grid uses sparse grid\n");}
+    if(blockgrid) {log.printf("  Grid uses block sparse grid\n");}
     if(wgridstride_>0) {log.printf("  Grid is written on file %s with stride %d\n",gridfilename_.c_str(),wgridstride_);}
   }
 
@@ -1028,11 +1161,16 @@ MetaD::MetaD(const ActionOptions& ao):
       // Communicate to the other members of the same group
       // info abount number of walkers and walker index
       comm.Bcast(mpi_nw_,0);
+      if(mw_async_) log.printf("  hills are exchanged while the next step runs and added to the bias one step later\n");
+      log.printf("  time spent exchanging hills is reported at the end of the run\n");
+      mw_stopwatch_=Tools::make_unique<Stopwatch>(log);
     }
   }
+  if(mw_async_ && !walkers_mpi_) error("WALKERS_MPI_ASYNC must be used with WALKERS_MPI");
 
   if(flying_) {
     if(!walkers_mpi_) error("Flying Gaussian method must be used with MPI version of multiple walkers");
+    if(mw_async_) error("Flying Gaussian method cannot be used with WALKERS_MPI_ASYNC");
     log.printf("  Flying Gaussian method with %d walkers active\n",mpi_nw_);
   }
 
@@ -1043,6 +1181,11 @@ MetaD::MetaD(const ActionOptions& ao):
     componentIsNotPeriodic("nlsteps");
   }
 
+  if(tree_) {
+    addComponent("treeker");
+    componentIsNotPeriodic("treeker");
+  }
+
   if(calc_rct_) {
     addComponent("rbias"); componentIsNotPeriodic("rbias");
     addComponent("rct"); componentIsNotPeriodic("rct");
@@ -1174,7 +1317,8 @@ MetaD::MetaD(const ActionOptions& ao):
         }
       }
       std::string funcl=getLabel() + ".bias";
-      if(!sparsegrid) {BiasGrid_=Tools::make_unique<Grid>(funcl,getArguments(),gmin,gmax,gbin,spline,true);}
+      if(blockgrid) {BiasGrid_=Tools::make_unique<BlockGrid>(funcl,getArguments(),gmin,gmax,gbin,spline,true);}
+      else if(!sparsegrid) {BiasGrid_=Tools::make_unique<Grid>(funcl,getArguments(),gmin,gmax,gbin,spline,true);}
       else {BiasGrid_=Tools::make_unique<SparseGrid>(funcl,getArguments(),gmin,gmax,gbin,spline,true);}
       std::vector<std::string> actualmin=BiasGrid_->getMin();
       std::vector<std::string> actualmax=BiasGrid_->getMax();
@@ -1202,7 +1346,7 @@ MetaD::MetaD(const ActionOptions& ao):
         error("The GRID file you want to read: " + gridreadfilename_ + ", cannot be found!");
       }
       std::string funcl=getLabel() + ".bias";
-      BiasGrid_=GridBase::create(funcl, getArguments(), gridfile, gmin, gmax, gbin, sparsegrid, spline, true);
+      BiasGrid_=GridBase::create(funcl, getArguments(), gridfile, gmin, gmax, gbin, sparsegrid, spline, true, blockgrid);
       if(BiasGrid_->getDimension()!=getNumberOfArguments()) error("mismatch between dimensionality of input grid and number of arguments");
       for(unsigned i=0; i<getNumberOfArguments(); ++i) {
         if( getPntrToArgument(i)->isPeriodic()!=BiasGrid_->getIsPeriodic()[i] ) error("periodicity mismatch between arguments and input bias");
@@ -1502,6 +1646,11 @@ void MetaD::addGaussian(const Gaussian& hill)
   if(grid_) {
     size_t ncv=getNumberOfArguments();
     std::vector<unsigned> nneighb=getGaussianSupport(hill);
+    // the interval correction is not separable, it is only applied point by point
+    if(!doInt_) {
+      addGaussianOnGridRows(hill,nneighb);
+      return;
+    }
     std::vector<Grid::index_t> neighbors=BiasGrid_->getNeighbors(hill.center,nneighb);
     std::vector<double> der(ncv);
     std::vector<double> xx(ncv);
@@ -1538,7 +1687,231 @@ void MetaD::addGaussian(const Gaussian& hill)
         BiasGrid_->addValueAndDerivatives(ineigh,allbias[i],der);
       }
     }
-  } else hills_.push_back(hill);
+  } else {
+    hills_.push_back(hill);
+    if(tree_) addToHillsTree(hill);
+  }
+}
+
+void MetaD::addGaussianOnGridRows(const Gaussian& hill, const std::vector<unsigned>& nneighb)
+{
+  // The support of the hill is the outer product of the grid points that are close to its center
+  // along each dimension, so distances are tabulated once per dimension and the hill is then
+  // deposited one row (first dimension, contiguous in memory) at a time.
+  // Diagonal hills are the product of one dimensional Gaussians, so along a row only the
+  // table of the first dimension changes and the row is computed with simple vectorizable loops.
+  // The result can differ in the last bits from evaluateGaussianAndDerivatives.
+  const unsigned ncv=getNumberOfArguments();
+  std::vector<std::vector<unsigned> > axes;
+  BiasGrid_->getNeighborsAlongAxes(hill.center,nneighb,axes);
+  for(unsigned i=0; i<ncv; ++i) if(axes[i].empty()) return;
+
+  const std::vector<double> dx=BiasGrid_->getDx();
+  const std::vector<unsigned> nbin=BiasGrid_->getNbin();
+  const std::vector<double> gmin=BiasGrid_->getPoint(std::vector<unsigned>(ncv,0));
+
+  // per dimension tables: distance from the center, its square in units of sigma and, for diagonal hills,
+  // the one dimensional Gaussian and the factor giving its derivative
+  std::vector<std::vector<double> > dp(ncv), dp2(ncv), ex(ncv), gr(ncv);
+  std::vector<Grid::index_t> stride(ncv);
+  Grid::index_t s=1;
+  unsigned nrows=1;
+  for(unsigned i=0; i<ncv; ++i) {
+    stride[i]=s;
+    s*=nbin[i];
+    if(i>0) nrows*=axes[i].size();
+    const unsigned n=axes[i].size();
+    dp[i].resize(n);
+    dp2[i].resize(n);
+    if(!hill.multivariate) {
+      ex[i].resize(n);
+      gr[i].resize(n);
+    }
+    for(unsigned k=0; k<n; ++k) {
+      const double x=gmin[i]+(double)(axes[i][k])*dx[i];
+      dp[i][k]=difference(i,hill.center[i],x);
+      if(!hill.multivariate) {
+        const double d=dp[i][k]*hill.invsigma[i];
+        dp2[i][k]=d*d;
+        ex[i][k]=std::exp(-0.5*dp2[i][k]);
+        gr[i][k]=d*hill.invsigma[i];
+      }
+    }
+  }
+
+  Matrix<double> mymatrix;
+  if(hill.multivariate) {
+    mymatrix.resize(ncv,ncv);
+    unsigned k=0;
+    for(unsigned i=0; i<ncv; i++) {
+      for(unsigned j=i; j<ncv; j++) {
+        mymatrix(i,j)=mymatrix(j,i)=hill.sigma[k]; // recompose the full inverse matrix
+        k++;
+      }
+    }
+  }
+
+  const unsigned nrow=axes[0].size();
+  std::vector<double> dpp(ncv);
+  const double height=hill.height;
+  const double sA=stretchA;
+  const double sB=stretchB;
+  const double cutoff=dp2cutoff;
+  // compute the row identified by counter
+  auto computeRow=[&](const std::vector<unsigned>& counter, double* bias, double* der) {
+    if(!hill.multivariate) {
+      // contribution of the dimensions that are constant along the row
+      double outerdp2=0.0;
+      double outerex=1.0;
+      for(unsigned i=1; i<ncv; ++i) {
+        outerdp2+=dp2[i][counter[i]];
+        outerex*=ex[i][counter[i]];
+      }
+      const double* dp2row=dp2[0].data();
+      const double* exrow=ex[0].data();
+      #pragma omp simd
+      for(unsigned k=0; k<nrow; ++k) {
+        const double q=0.5*(dp2row[k]+outerdp2);
+        const double bexp=(q<cutoff)?height*exrow[k]*outerex:0.0;
+        bias[k]=(q<cutoff)?sA*bexp+height*sB:0.0;
+      }
+      for(unsigned i=0; i<ncv; ++i) {
+        double* deri=der+i;
+        if(i==0) {
+          const double* grow=gr[0].data();
+          #pragma omp simd
+          for(unsigned k=0; k<nrow; ++k) {
+            const double q=0.5*(dp2row[k]+outerdp2);
+            deri[k*ncv]=(q<cutoff)?-height*exrow[k]*outerex*grow[k]*sA:0.0;
+          }
+        } else {
+          const double g=gr[i][counter[i]];
+          #pragma omp simd
+          for(unsigned k=0; k<nrow; ++k) {
+            const double q=0.5*(dp2row[k]+outerdp2);
+            deri[k*ncv]=(q<cutoff)?-height*exrow[k]*outerex*g*sA:0.0;
+          }
+        }
+      }
+    } else {
+      for(unsigned i=1; i<ncv; ++i) dpp[i]=dp[i][counter[i]];
+      for(unsigned k=0; k<nrow; ++k) {
+        dpp[0]=dp[0][k];
+        double q=0.0;
+        for(unsigned i=0; i<ncv; i++) {
+          q+=dpp[i]*dpp[i]*mymatrix(i,i)*0.5;
+          for(unsigned j=i+1; j<ncv; j++) q+=dpp[i]*dpp[j]*mymatrix(i,j);
+        }
+        double* kder=der+k*ncv;
+        bias[k]=0.0;
+        for(unsigned i=0; i<ncv; i++) kder[i]=0.0;
+        if(q<cutoff) {
+          const double bexp=height*std::exp(-q);
+          for(unsigned i=0; i<ncv; i++) {
+            double tmp=0.0;
+            for(unsigned j=0; j<ncv; j++) tmp += dpp[j]*mymatrix(i,j)*bexp;
+            kder[i]=-tmp*sA;
+          }
+          bias[k]=sA*bexp+height*sB;
+        }
+      }
+    }
+  };
+  // add to the grid the row identified by counter
+  std::vector<Grid::index_t> rowindex(nrow);
+  auto addRow=[&](const std::vector<unsigned>& counter, const double* bias, const double* der) {
+    Grid::index_t base=0;
+    for(unsigned i=1; i<ncv; ++i) base+=axes[i][counter[i]]*stride[i];
+    for(unsigned k=0; k<nrow; ++k) rowindex[k]=base+axes[0][k];
+    BiasGrid_->addValuesAndDerivatives(nrow,rowindex.data(),bias,der);
+  };
+  // move counter to the next row
+  auto nextRow=[&](std::vector<unsigned>& counter) {
+    for(unsigned i=1; i<ncv; ++i) {
+      if(++counter[i]<axes[i].size()) return;
+      counter[i]=0;
+    }
+  };
+
+  const unsigned nproc=comm.Get_size();
+  std::vector<unsigned> counter(ncv,0);
+  if(nproc==1) {
+    std::vector<double> rowbias(nrow), rowder(nrow*ncv);
+    for(unsigned r=0; r<nrows; ++r, nextRow(counter)) {
+      computeRow(counter,rowbias.data(),rowder.data());
+      addRow(counter,rowbias.data(),rowder.data());
+    }
+    return;
+  }
+
+  // With MPI the rows are split between the ranks in chunks of a few rows per rank,
+  // so that only the rows of one chunk are summed and stored at the same time
+  const unsigned rank=comm.Get_rank();
+  const unsigned rowsPerRank=16;
+  const unsigned nchunk=std::min(nrows,nproc*rowsPerRank);
+  std::vector<double> chunkbias(static_cast<std::size_t>(nchunk)*nrow), chunkder(static_cast<std::size_t>(nchunk)*nrow*ncv);
+  std::vector<unsigned> first(ncv,0);
+  for(unsigned r0=0; r0<nrows; r0+=nchunk) {
+    const unsigned n=std::min(nchunk,nrows-r0);
+    std::fill(chunkbias.begin(),chunkbias.end(),0.0);
+    std::fill(chunkder.begin(),chunkder.end(),0.0);
+    counter=first;
+    for(unsigned r=0; r<n; ++r, nextRow(counter)) {
+      if(r%nproc==rank) computeRow(counter,chunkbias.data()+static_cast<std::size_t>(r)*nrow,chunkder.data()+static_cast<std::size_t>(r)*nrow*ncv);
+    }
+    comm.Sum(chunkbias);
+    comm.Sum(chunkder);
+    counter=first;
+    for(unsigned r=0; r<n; ++r, nextRow(counter)) {
+      addRow(counter,chunkbias.data()+static_cast<std::size_t>(r)*nrow,chunkder.data()+static_cast<std::size_t>(r)*nrow*ncv);
+    }
+    first=counter;
+  }
+}
+
+void MetaD::addWalkersGaussians(unsigned ncv)
+{
+  const unsigned nrec=mw_recv_.size()/mpi_nw_;
+  const unsigned nsigma=nrec-2-ncv;
+
+  // Flying Gaussian
+  if (flying_) {
+    hills_.clear();
+    clearHillsTree();
+    comm.Barrier();
+  }
+
+  for(unsigned i=0; i<mpi_nw_; i++) {
+    // actually add hills one by one
+    const double* rec=&mw_recv_[i*nrec];
+    std::vector<double> cv_now(rec+2,rec+2+ncv);
+    std::vector<double> sigma_now(rec+2+ncv,rec+2+ncv+nsigma);
+    // notice that if gamma=1 we store directly -F so this scaling is not necessary:
+    double fact=(biasf_>1.0?(biasf_-1.0)/biasf_:1.0);
+    Gaussian newhill=Gaussian(rec[1]!=0.0,rec[0]*fact,cv_now,sigma_now);
+    addGaussian(newhill);
+    if(!flying_) writeGaussian(newhill,hillsOfile_);
+  }
+}
+
+void MetaD::completeWalkersExchange()
+{
+  {
+    auto sw=mw_stopwatch_->startStop("Walkers exchange wait");
+    if(comm.Get_rank()==0) mw_request_.wait();
+    // Share info with group members
+    comm.Bcast(mw_recv_,0);
+  }
+  mw_pending_=false;
+  addWalkersGaussians(getNumberOfArguments());
+  // this is to update the hills neighbor list
+  if(nlist_) nlist_update_=true;
+}
+
+void MetaD::runFinalJobs()
+{
+  // make sure the hills of the last deposition are added and written
+  if(mw_pending_) completeWalkersExchange();
 }
 
 std::vector<unsigned> MetaD::getGaussianSupport(const Gaussian& hill)
@@ -1604,7 +1977,14 @@ double MetaD::getBias(const std::vector<double>& cv)
     unsigned stride=comm.Get_size();
     unsigned rank=comm.Get_rank();
 
-    if(!nlist_) {
+    if(tree_) {
+      updateTreeHills(cv);
+      #pragma omp parallel num_threads(nt)
+      {
+        #pragma omp for reduction(+:bias) nowait
+        for(unsigned i=rank; i<tree_hills_.size(); i+=stride) bias+=evaluateGaussian(cv,hills_[tree_hills_[i]]);
+      }
+    } else if(!nlist_) {
       #pragma omp parallel num_threads(nt)
       {
         #pragma omp for reduction(+:bias) nowait
@@ -1636,7 +2016,29 @@ double MetaD::getBiasAndDerivatives(const std::vector<double>& cv, std::vector<d
     unsigned stride=comm.Get_size();
     unsigned rank=comm.Get_rank();
 
-    if(!nlist_) {
+    if(tree_) {
+      updateTreeHills(cv);
+      if(tree_hills_.size()<2*nt*stride||nt==1) {
+        // for performance reasons and thread safety
+        std::vector<double> dp(ncv);
+        for(unsigned i=rank; i<tree_hills_.size(); i+=stride) {
+          bias+=evaluateGaussianAndDerivatives(cv,hills_[tree_hills_[i]],der,dp);
+        }
+      } else {
+        #pragma omp parallel num_threads(nt)
+        {
+          std::vector<double> omp_deriv(ncv,0.);
+          // for performance reasons and thread safety
+          std::vector<double> dp(ncv);
+          #pragma omp for reduction(+:bias) nowait
+          for(unsigned i=rank; i<tree_hills_.size(); i+=stride) {
+            bias+=evaluateGaussianAndDerivatives(cv,hills_[tree_hills_[i]],omp_deriv,dp);
+          }
+          #pragma omp critical
+          for(unsigned i=0; i<ncv; i++) der[i]+=omp_deriv[i];
+        }
+      }
+    } else if(!nlist_) {
       if(hills_.size()<2*nt*stride||nt==1) {
         // for performance reasons and thread safety
         std::vector<double> dp(ncv);
@@ -1907,6 +2309,7 @@ void MetaD::calculate()
   std::vector<double> der(ncv,0.);
   if(biasf_!=1.0) ene = getBiasAndDerivatives(cv,der);
   setBias(ene);
+  if(tree_) getPntrToComponent("treeker")->set(tree_hills_.size());
   for(unsigned i=0; i<ncv; i++) setOutputForce(i,-der[i]);
 
   if(calc_work_) getPntrToComponent("work")->set(work_);
@@ -1927,6 +2330,9 @@ void MetaD::calculate()
 
 void MetaD::update()
 {
+  // hills exchanged during the previous step
+  if(mw_pending_) completeWalkersExchange();
+
   // adding hills criteria (could be more complex though)
   bool nowAddAHill;
   if(getStep()%current_stride_==0 && !isFirstStep_) nowAddAHill=true;
@@ -1960,42 +2366,32 @@ void MetaD::update()
 
     // In case we use walkers_mpi, it is now necessary to communicate with other replicas.
     if(walkers_mpi_) {
-      // Allocate arrays to store all walkers hills
-      std::vector<double> all_cv(mpi_nw_*ncv,0.0);
-      std::vector<double> all_sigma(mpi_nw_*thissigma.size(),0.0);
-      std::vector<double> all_height(mpi_nw_,0.0);
-      std::vector<int>    all_multivariate(mpi_nw_,0);
-      if(comm.Get_rank()==0) {
-        // Communicate (only root)
-        multi_sim_comm.Allgather(cv,all_cv);
-        multi_sim_comm.Allgather(thissigma,all_sigma);
-        // notice that if gamma=1 we store directly -F so this scaling is not necessary:
-        multi_sim_comm.Allgather(height*(biasf_>1.0?biasf_/(biasf_-1.0):1.0),all_height);
-        multi_sim_comm.Allgather(int(multivariate),all_multivariate);
-      }
-      // Share info with group members
-      comm.Bcast(all_cv,0);
-      comm.Bcast(all_sigma,0);
-      comm.Bcast(all_height,0);
-      comm.Bcast(all_multivariate,0);
-
-      // Flying Gaussian
-      if (flying_) {
-        hills_.clear();
-        comm.Barrier();
-      }
-
-      for(unsigned i=0; i<mpi_nw_; i++) {
-        // actually add hills one by one
-        std::vector<double> cv_now(ncv);
-        std::vector<double> sigma_now(thissigma.size());
-        for(unsigned j=0; j<ncv; j++) cv_now[j]=all_cv[i*ncv+j];
-        for(unsigned j=0; j<thissigma.size(); j++) sigma_now[j]=all_sigma[i*thissigma.size()+j];
-        // notice that if gamma=1 we store directly -F so this scaling is not necessary:
-        double fact=(biasf_>1.0?(biasf_-1.0)/biasf_:1.0);
-        Gaussian newhill=Gaussian(all_multivariate[i],all_height[i]*fact,cv_now,sigma_now);
-        addGaussian(newhill);
-        if(!flying_) writeGaussian(newhill,hillsOfile_);
+      // Pack the hill in a single record, so that a single message reaches all walkers:
+      // height, multivariate, cv, sigma
+      // notice that if gamma=1 we store directly -F so this scaling is not necessary:
+      const unsigned nrec=2+ncv+thissigma.size();
+      mw_send_.resize(nrec);
+      mw_send_[0]=height*(biasf_>1.0?biasf_/(biasf_-1.0):1.0);
+      mw_send_[1]=(multivariate?1.0:0.0);
+      for(unsigned j=0; j<ncv; j++) mw_send_[2+j]=cv[j];
+      for(unsigned j=0; j<thissigma.size(); j++) mw_send_[2+ncv+j]=thissigma[j];
+      mw_recv_.assign(mpi_nw_*nrec,0.0);
+      if(mw_async_) {
+        // Communicate (only root), the hills are added when the exchange is completed
+        if(comm.Get_rank()==0) {
+          auto sw=mw_stopwatch_->startStop("Walkers exchange");
+          mw_request_=multi_sim_comm.Iallgather(mw_send_,mw_recv_);
+        }
+        mw_pending_=true;
+      } else {
+        {
+          auto sw=mw_stopwatch_->startStop("Walkers exchange");
+          // Communicate (only root)
+          if(comm.Get_rank()==0) multi_sim_comm.Allgather(mw_send_,mw_recv_);
+          // Share info with group members
+          comm.Bcast(mw_recv_,0);
+        }
+        addWalkersGaussians(ncv);
       }
     } else {
       Gaussian newhill=Gaussian(multivariate,height,cv,thissigma);
@@ -2177,10 +2573,25 @@ void MetaD::computeReweightingFactor()
 
   const unsigned rank=comm.Get_rank();
   const unsigned stride=comm.Get_size();
-  for (Grid::index_t t=rank; t<BiasGrid_->getSize(); t+=stride) {
-    const double val=BiasGrid_->getValue(t);
-    Z_0+=std::exp(minusBetaF*(val-max_bias_));
-    Z_V+=std::exp(minusBetaFplusV*(val-max_bias_));
+  if(BlockGrid* bg=dynamic_cast<BlockGrid*>(BiasGrid_.get())) {
+    // only the stored points are visited, the others all have the same value
+    const std::vector<Grid::index_t> points=bg->getStoredPoints();
+    for (std::size_t t=rank; t<points.size(); t+=stride) {
+      const double val=bg->getValue(points[t]);
+      Z_0+=std::exp(minusBetaF*(val-max_bias_));
+      Z_V+=std::exp(minusBetaFplusV*(val-max_bias_));
+    }
+    if(rank==0) {
+      const double nempty=static_cast<double>(bg->getSize()-points.size());
+      Z_0+=nempty*std::exp(minusBetaF*(bg->getOffset()-max_bias_));
+      Z_V+=nempty*std::exp(minusBetaFplusV*(bg->getOffset()-max_bias_));
+    }
+  } else {
+    for (Grid::index_t t=rank; t<BiasGrid_->getSize(); t+=stride) {
+      const double val=BiasGrid_->getValue(t);
+      Z_0+=std::exp(minusBetaF*(val-max_bias_));
+      Z_V+=std::exp(minusBetaFplusV*(val-max_bias_));
+    }
   }
   comm.Sum(Z_0);
   comm.Sum(Z_V);
@@ -2298,6 +2709,226 @@ void MetaD::updateNlist()
   nlist_steps_=0;
   nlist_update_=false;
 }
+std::vector<double> MetaD::getHillsTreeExtent(const Gaussian& hill)
+{
+  // half widths of the box that contains the region where dp2<tree_dp2cutoff_
+  const unsigned ncv=getNumberOfArguments();
+  std::vector<double> extent(ncv);
+  if(hill.multivariate) {
+    // for the ellipsoid 0.5*x^T M x < c the box is given by sqrt(2*c*(M^-1)_ii)
+    unsigned k=0;
+    Matrix<double> mymatrix(ncv,ncv);
+    for(unsigned i=0; i<ncv; i++) {
+      for(unsigned j=i; j<ncv; j++) {
+        mymatrix(i,j)=mymatrix(j,i)=hill.sigma[k]; // recompose the full inverse matrix
+        k++;
+      }
+    }
+    Matrix<double> myinv(ncv,ncv);
+    Invert(mymatrix,myinv);
+    for(unsigned i=0; i<ncv; i++) extent[i]=std::sqrt(2.0*tree_dp2cutoff_*std::abs(myinv(i,i)));
+  } else {
+    for(unsigned i=0; i<ncv; i++) {
+      // a zero width means that the Gaussian does not depend on this CV
+      if(hill.invsigma[i]==0.0) extent[i]=std::numeric_limits<double>::max();
+      else extent[i]=std::sqrt(2.0*tree_dp2cutoff_)*std::abs(hill.sigma[i]);
+    }
+  }
+  // small safety margin for the rounding in difference()
+  for(unsigned i=0; i<ncv; i++) if(extent[i]<std::numeric_limits<double>::max()) extent[i]*=1.0+epsilon;
+  return extent;
+}
+
+void MetaD::mergeHillsTreeBox(TreeNode& node, const std::vector<double>& ref, const double* lo, const double* hi)
+{
+  for(unsigned i=0; i<node.ref.size(); ++i) {
+    // position of ref in the frame of the node
+    const double off=difference(i,node.ref[i],ref[i]);
+    node.lo[i]=std::min(node.lo[i],off+lo[i]);
+    node.hi[i]=std::max(node.hi[i],off+hi[i]);
+    // a box that covers a whole period contains any value of the CV
+    if(tree_period_[i]>0.0 && node.hi[i]-node.lo[i]>=tree_period_[i]) {
+      node.lo[i]=-std::numeric_limits<double>::max();
+      node.hi[i]=std::numeric_limits<double>::max();
+    }
+  }
+}
+
+void MetaD::addToHillsTree(const Gaussian& hill)
+{
+  const unsigned ncv=getNumberOfArguments();
+  const std::vector<double> extent=getHillsTreeExtent(hill);
+  tree_extent_.insert(tree_extent_.end(),extent.begin(),extent.end());
+  std::vector<double> lo(ncv);
+  for(unsigned i=0; i<ncv; ++i) lo[i]=-extent[i];
+
+  // the new hill is added to the boxes of all its ancestors among the recent hills
+  const std::size_t h=hills_.size()-1-tree_built_;
+  if(tree_levels_.empty()) tree_levels_.resize(1);
+  for(unsigned l=0; l<tree_levels_.size(); ++l) {
+    const std::size_t j=h/(static_cast<std::size_t>(tree_leaf_size_)<<l);
+    if(j==tree_levels_[l].size()) tree_levels_[l].push_back(TreeNode{hill.center,lo,extent});
+    else mergeHillsTreeBox(tree_levels_[l][j],hill.center,lo.data(),extent.data());
+  }
+  // when the root gets a sibling a new root is added on top of them
+  if(tree_levels_.back().size()>1) {
+    TreeNode root=tree_levels_.back()[0];
+    const TreeNode& sibling=tree_levels_.back()[1];
+    mergeHillsTreeBox(root,sibling.ref,sibling.lo.data(),sibling.hi.data());
+    tree_levels_.push_back(std::vector<TreeNode>(1,root));
+  }
+  // consecutive hills are close in CV space only for a while, so all the hills are split in space again
+  // when there are more than sqrt(256*N) recent ones: this balances the O(N log N) cost of the split with
+  // the cost of visiting the recent hills, that are checked one leaf at a time
+  const std::size_t nrecent=h+1;
+  if(nrecent>=16*tree_leaf_size_ && nrecent*nrecent>=256*tree_built_) buildHillsTree();
+}
+
+void MetaD::clearHillsTree()
+{
+  tree_nodes_.clear();
+  tree_order_.clear();
+  tree_built_=0;
+  tree_levels_.clear();
+  tree_extent_.clear();
+}
+
+void MetaD::buildHillsTree()
+{
+  tree_built_=hills_.size();
+  tree_order_.resize(tree_built_);
+  for(std::size_t k=0; k<tree_built_; ++k) tree_order_[k]=k;
+  tree_nodes_.clear();
+  buildHillsTreeNode(0,tree_built_);
+  tree_levels_.clear();
+}
+
+std::size_t MetaD::buildHillsTreeNode(std::size_t first, std::size_t last)
+{
+  const unsigned ncv=getNumberOfArguments();
+  const std::size_t n=tree_nodes_.size();
+  // the box of the node encloses the boxes of all its hills
+  const unsigned h0=tree_order_[first];
+  const double* ext0=&tree_extent_[h0*ncv];
+  TreeNode node;
+  node.ref=hills_[h0].center;
+  node.hi.assign(ext0,ext0+ncv);
+  node.lo.resize(ncv);
+  for(unsigned i=0; i<ncv; ++i) node.lo[i]=-ext0[i];
+  std::vector<double> lo(ncv);
+  for(std::size_t k=first+1; k<last; ++k) {
+    const unsigned h=tree_order_[k];
+    const double* ext=&tree_extent_[h*ncv];
+    for(unsigned i=0; i<ncv; ++i) lo[i]=-ext[i];
+    mergeHillsTreeBox(node,hills_[h].center,lo.data(),ext);
+  }
+  node.first=first;
+  node.last=last;
+  tree_nodes_.push_back(node);
+  if(last-first<=tree_leaf_size_) return n;
+
+  // the hills are split at the median of the centers along the CV in which they are most spread
+  // in units of the size of their boxes
+  unsigned split=0;
+  double spread=-1.0;
+  for(unsigned i=0; i<ncv; ++i) {
+    double cmin=0.0, cmax=0.0, width=0.0;
+    for(std::size_t k=first; k<last; ++k) {
+      const unsigned h=tree_order_[k];
+      const double d=difference(i,node.ref[i],hills_[h].center[i]);
+      cmin=std::min(cmin,d);
+      cmax=std::max(cmax,d);
+      width+=tree_extent_[h*ncv+i];
+    }
+    if(width>0.0 && (cmax-cmin)*(last-first)/width>spread) {
+      spread=(cmax-cmin)*(last-first)/width;
+      split=i;
+    }
+  }
+  const std::vector<double> ref=node.ref;
+  const std::size_t mid=first+(last-first)/2;
+  std::nth_element(tree_order_.begin()+first,tree_order_.begin()+mid,tree_order_.begin()+last,[&](unsigned a, unsigned b) {
+    return difference(split,ref[split],hills_[a].center[split])<difference(split,ref[split],hills_[b].center[split]);
+  });
+  const std::size_t left=buildHillsTreeNode(first,mid);
+  const std::size_t right=buildHillsTreeNode(mid,last);
+  tree_nodes_[n].left=left;
+  tree_nodes_[n].right=right;
+  return n;
+}
+
+bool MetaD::hillsTreeBoxContains(const double* ref, const double* lo, const double* hi, const double* cv)
+{
+  for(unsigned i=0; i<tree_period_.size(); ++i) {
+    const double d=difference(i,ref[i],cv[i]);
+    if(d>=lo[i] && d<=hi[i]) continue;
+    // the box may extend beyond half a period from ref, so the other images are checked as well
+    const double p=tree_period_[i];
+    if(p>0.0 && ((d-p>=lo[i] && d-p<=hi[i]) || (d+p>=lo[i] && d+p<=hi[i]))) continue;
+    return false;
+  }
+  return true;
+}
+
+void MetaD::updateTreeHills(const std::vector<double>& cv)
+{
+  tree_hills_.clear();
+  if(hills_.empty()) return;
+
+  const unsigned ncv=getNumberOfArguments();
+  // with INTERVAL the Gaussians are evaluated at the boundary of the interval
+  std::vector<double> qcv(cv);
+  if(doInt_) {
+    if(qcv[0]<lowI_) qcv[0]=lowI_;
+    if(qcv[0]>uppI_) qcv[0]=uppI_;
+  }
+
+  // a hill is summed if its box contains the CVs
+  auto addIfInside=[&](std::size_t k) {
+    const double* ext=&tree_extent_[k*ncv];
+    for(unsigned i=0; i<ncv; ++i) {
+      if(std::abs(difference(i,hills_[k].center[i],qcv[i]))>ext[i]) return;
+    }
+    tree_hills_.push_back(k);
+  };
+
+  // depth first visit of the nodes of the spatial tree whose box contains the CVs
+  if(!tree_nodes_.empty()) {
+    std::vector<std::size_t> stack(1,0);
+    while(!stack.empty()) {
+      const TreeNode& node=tree_nodes_[stack.back()];
+      stack.pop_back();
+      if(!hillsTreeBoxContains(node.ref.data(),node.lo.data(),node.hi.data(),qcv.data())) continue;
+      if(node.left>0) {
+        stack.push_back(node.right);
+        stack.push_back(node.left);
+      } else {
+        for(std::size_t k=node.first; k<node.last; ++k) addIfInside(tree_order_[k]);
+      }
+    }
+  }
+
+  // and of the tree of the recent hills
+  if(!tree_levels_.empty()) {
+    std::vector<std::pair<unsigned,std::size_t>> stack;
+    stack.emplace_back(tree_levels_.size()-1,0);
+    while(!stack.empty()) {
+      const unsigned l=stack.back().first;
+      const std::size_t j=stack.back().second;
+      stack.pop_back();
+      const TreeNode& node=tree_levels_[l][j];
+      if(!hillsTreeBoxContains(node.ref.data(),node.lo.data(),node.hi.data(),qcv.data())) continue;
+      if(l>0) {
+        if(2*j+1<tree_levels_[l-1].size()) stack.emplace_back(l-1,2*j+1);
+        stack.emplace_back(l-1,2*j);
+      } else {
+        const std::size_t kend=std::min(hills_.size(),tree_built_+(j+1)*tree_leaf_size_);
+        for(std::size_t k=tree_built_+j*tree_leaf_size_; k<kend; ++k) addIfInside(k);
+      }
+    }
+  }
+
+}
 
 }
 }
@@ -31,6 +31,7 @@
 #include "tools/Random.h"
 
 #include <cstdio>
+#include <cstdlib>
 #include <string>
 #include <vector>
 #include <fstream>
@@ -135,6 +136,17 @@ Since some of the data transfer could happen asynchronously, you might want to u
 to simulate a lag between the `prepareCalc` and `performCalc` actions. This part of the calculation will not contribute
 to timer, but will obviously slow down your test.
 
+With asynchronous transfers (see the `PLUMED_ASYNC_SHARE` environment variable, used by default with less than 10 processes)
+the atoms sent by the other processes are received in `performCalc` only when the first action needing them is calculated,
+so that actions whose atoms are all local are calculated while the other atoms are still in flight.
+The `--eager-wait` flag restores the previous behavior, where all the atoms are received
+before calculating any action, so that the two strategies can be compared:
+\verbatim
+mpirun -np 4 plumed-runtime benchmark --domain-decomposition --sleep 0.01
+mpirun -np 4 plumed-runtime benchmark --domain-decomposition --sleep 0.01 --eager-wait
+\endverbatim
+The same can be obtained in any simulation by setting `PLUMED_LAZY_WAIT=no`.
+
 \par Output
 
 In the output you will see the usual reports about timing produced by the internal
@@ -459,6 +471,7 @@ void Benchmark::registerKeywords( Keywords& keys ) {
   keys.add("optional","--dump-trajectory","dump the trajectory to this file");
   keys.addFlag("--domain-decomposition",false,"simulate domain decomposition, implies --shuffle");
   keys.addFlag("--shuffled",false,"reshuffle atoms");
+  keys.addFlag("--eager-wait",false,"with domain decomposition, receive all the atoms from the other processes before calculating any action");
 }
 
 Benchmark::Benchmark(const CLToolOptions& co ):
@@ -654,6 +667,14 @@ int Benchmark::main(FILE* in, FILE*out,Communicator& pc) {
   if (domain_decomposition)
     log << "Using --domain-decomposition\n";
 
+  bool eager_wait=false;
+  parseFlag("--eager-wait",eager_wait);
+  if(eager_wait) {
+    log << "Using --eager-wait\n";
+// read by the kernels when the domain decomposition is set up
+    setenv("PLUMED_LAZY_WAIT","no",1);
+  }
+
   double timeToSleep;
   parse("--sleep",timeToSleep);
   log << "Using --sleep=" << timeToSleep << "\n";
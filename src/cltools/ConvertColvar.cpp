@@ -0,0 +1,145 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2012-2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "CLTool.h"
+#include "core/CLToolRegister.h"
+#include "tools/Tools.h"
+#include "tools/IFile.h"
+#include "tools/OFile.h"
+#include <cstdio>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace PLMD {
+namespace cltools {
+
+//+PLUMEDOC TOOLS convert-colvar
+/*
+Convert a fielded file (e.g. a COLVAR file) between the text and the binary format
+
+Files written by \ref PRINT and read by \ref READ can be stored in a binary format
+by giving them the extension `.bin`. Binary files are smaller, are read without converting numbers
+from text and, when possible, are memory mapped. This tool converts a file
+from one format to the other, the format of the output being chosen from the extension
+of its name. Comment lines (other than the ones defining fields) are not copied.
+
+Notice that in binary files all the fields that are not constant are stored as
+double precision numbers, so that they can only contain numeric values.
+
+\par Examples
+
+The following command converts a COLVAR file to the binary format
+\verbatim
+plumed convert-colvar --ifile COLVAR --ofile COLVAR.bin
+\endverbatim
+
+The following command converts it back to text, printing numbers with the chosen format
+\verbatim
+plumed convert-colvar --ifile COLVAR.bin --ofile COLVAR --fmt %12.6f
+\endverbatim
+
+*/
+//+ENDPLUMEDOC
+
+class ConvertColvar:
+  public CLTool
+{
+public:
+  static void registerKeywords( Keywords& keys );
+  explicit ConvertColvar(const CLToolOptions& co );
+  int main(FILE* in, FILE*out,Communicator& pc) override;
+  std::string description()const override {
+    return "convert a fielded file between the text and the binary format";
+  }
+};
+
+PLUMED_REGISTER_CLTOOL(ConvertColvar,"convert-colvar")
+
+void ConvertColvar::registerKeywords( Keywords& keys ) {
+  CLTool::registerKeywords( keys );
+  keys.add("compulsory","--ifile","specify the name of the input file");
+  keys.add("compulsory","--ofile","specify the name of the output file, it is written in binary format if its extension is bin");
+  keys.add("optional","--fmt","specify the format used to write numbers, by default numbers are copied as they are");
+}
+
+ConvertColvar::ConvertColvar(const CLToolOptions& co ):
+  CLTool(co)
+{
+  inputdata=commandline;
+}
+
+int ConvertColvar::main(FILE* in, FILE*out,Communicator& pc) {
+
+  std::string ifilename;
+  parse("--ifile",ifilename);
+  std::string ofilename;
+  parse("--ofile",ofilename);
+  std::string fmt;
+  parse("--fmt",fmt);
+
+  plumed_assert(ifilename.length()>0) << "please specify the input file with --ifile";
+  plumed_assert(ofilename.length()>0) << "please specify the output file with --ofile";
+
+  IFile ifile;
+  ifile.allowIgnoredFields();
+  ifile.open(ifilename);
+
+  OFile ofile;
+  ofile.allowBinary();
+  ofile.open(ofilename);
+  if(fmt.length()>0) ofile.fmtField(" "+fmt);
+
+  std::fprintf(out,"  converting %s (%s) to %s (%s)\n",
+               ifilename.c_str(),(ifile.isBinary()?"binary":"text"),
+               ofilename.c_str(),(Tools::extension(ofile.getPath())=="bin"?"binary":"text"));
+
+  std::vector<std::string> names;
+  std::set<std::string> constants;
+  std::string value;
+  double x;
+  unsigned nrecords=0;
+  while(ifile.scanFieldList(names)) {
+    for(const auto & name : names) {
+      if(ifile.FieldIsConstant(name)) {
+        if(constants.insert(name).second) ofile.addConstantField(name);
+        ifile.scanField(name,value);
+        ofile.printField(name,value);
+      } else if(fmt.length()>0) {
+        ifile.scanField(name,x);
+        ofile.printField(name,x);
+      } else {
+        ifile.scanField(name,value);
+        Tools::trim(value);
+        ofile.printField(name," "+value);
+      }
+    }
+    ifile.scanField();
+    ofile.printField();
+    nrecords++;
+  }
+  std::fprintf(out,"  %u records converted\n",nrecords);
+
+  return 0;
+}
+
+} // End of namespace
+}
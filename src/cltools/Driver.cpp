@@ -35,12 +35,17 @@
 #include <vector>
 #include <map>
 #include <memory>
+#include <limits>
+#include <algorithm>
 #include "tools/Units.h"
 #include "tools/PDB.h"
 #include "tools/FileBase.h"
 #include "tools/IFile.h"
 #include "xdrfile/xdrfile_trr.h"
 #include "xdrfile/xdrfile_xtc.h"
+#include "XdrFrameReader.h"
+#include "XdrFrameIndex.h"
+#include "tools/OFile.h"
 
 
 // when using molfile plugin
@@ -174,6 +179,31 @@ Notice that the xdrfile implementation of xtc and trr
 is more robust than the molfile one, since it provides support for generic cell shapes.
 In addition, it allows \ref DUMPATOMS to write compressed xtc files.
 
+When reading long xtc or trr trajectories with `--ixtc` or `--itrr`, frames can be decoded
+on background threads while PLUMED is analyzing the previous ones, using the `--read-threads` option.
+With more than one thread, xtc and trr frames are also decoded in parallel, each thread skipping the frames decoded by the others:
+\verbatim
+plumed driver --plumed plumed.dat --ixtc traj.xtc --read-threads 4
+\endverbatim
+Frames are still passed to PLUMED in the order in which they are stored in the file, so
+the result is identical to the one obtained reading the trajectory synchronously.
+
+Long trajectories can also be analyzed in parallel splitting their frames among the replicas
+of a `--multi` run with the `--shard` option. Each replica runs an independent instance of PLUMED
+on a contiguous block of frames of the same trajectory, and the number of the step is set as
+if the whole trajectory had been read, so that `STRIDE` keywords select the same frames. For xtc and trr files
+read with `--ixtc` and `--itrr` the replicas jump directly to their first frame using an index of the frames, that is built
+once and stored beside the trajectory (by default in a file with the name of the trajectory followed by `.idx`,
+use `--trajectory-index` to change it). Other formats read with molfile plugins are skipped frame by frame.
+Output files are written by each replica with a suffix (e.g. `colvar.0`, `colvar.1`, ...).
+Once all replicas are done, files listed with `--shard-concat` (e.g. the output of \ref PRINT) are concatenated
+in the order of the frames, and grid files listed with `--shard-sum` (e.g. the output of \ref HISTOGRAM with `NORMALIZATION=false`)
+are summed. Outputs that are not additive, such as normalized averages, should be combined by hand.
+\verbatim
+mpirun -np 8 plumed driver --plumed plumed.dat --ixtc traj.xtc --multi 8 --shard --shard-concat colvar
+\endverbatim
+The `--first-frame` and `--nframes` options can be used to analyze only a part of a trajectory, also without `--shard`.
+
 
 */
 //+ENDPLUMEDOC
@@ -195,6 +225,64 @@ static int register_cb(void *v, vmdplugin_t *p) {
 }
 #endif
 
+/// Concatenate the files written by the replicas of a --shard run in the order of their frames.
+/// Header lines (starting with #!) are only taken from the first replica.
+static void concatenateShards(const std::string & filename,int nshards) {
+  OFile ofile;
+  ofile.open(filename);
+  for(int r=0; r<nshards; r++) {
+    std::string n; Tools::convert(r,n);
+    IFile ifile;
+    ifile.open(FileBase::appendSuffix(filename,"."+n));
+    std::string line;
+    while(ifile.getline(line)) {
+      if(r>0 && line.compare(0,2,"#!")==0) continue;
+      ofile.printf("%s\n",line.c_str());
+    }
+  }
+}
+
+/// Sum the grids written by the replicas of a --shard run.
+/// Coordinates of the grid points are checked and copied, all the other columns are summed.
+static void sumShards(const std::string & filename,int nshards) {
+  std::vector<std::unique_ptr<IFile>> ifiles(nshards);
+  for(int r=0; r<nshards; r++) {
+    std::string n; Tools::convert(r,n);
+    ifiles[r]=Tools::make_unique<IFile>();
+    ifiles[r]->open(FileBase::appendSuffix(filename,"."+n));
+  }
+  OFile ofile;
+  ofile.open(filename);
+  unsigned dimension=0;
+  std::string line;
+  std::vector<std::string> lines(nshards);
+  while(ifiles[0]->getline(lines[0])) {
+    for(int r=1; r<nshards; r++) if(!ifiles[r]->getline(lines[r])) plumed_error()<<"grid files of the replicas have different sizes for "<<filename;
+    std::vector<std::string> words=Tools::getWords(lines[0]);
+// headers and empty lines separating the rows of the grid are copied
+    if(words.size()==0 || words[0]=="#!") {
+      if(words.size()>2 && words[0]=="#!" && words[1]=="SET" && words[2].compare(0,4,"min_")==0) dimension++;
+      ofile.printf("%s\n",lines[0].c_str());
+      continue;
+    }
+    plumed_massert(words.size()>=dimension,"cannot understand line "+lines[0]+" in grid file "+filename);
+    std::vector<double> values(words.size()-dimension,0.0);
+    for(int r=0; r<nshards; r++) {
+      std::vector<std::string> w=Tools::getWords(lines[r]);
+      if(w.size()!=words.size()) plumed_error()<<"grid files of the replicas have different columns for "<<filename;
+      for(unsigned i=0; i<dimension; i++) if(w[i]!=words[i]) plumed_error()<<"grid files of the replicas have different points for "<<filename;
+      for(unsigned i=dimension; i<w.size(); i++) {
+        double v; Tools::convert(w[i],v);
+        values[i-dimension]+=v;
+      }
+    }
+    for(unsigned i=0; i<dimension; i++) ofile.printf("%s ",words[i].c_str());
+// values are written with all their digits as the format of the original files is not known
+    for(const auto v : values) ofile.printf(" %.17g",v);
+    ofile.printf("\n");
+  }
+}
+
 template<typename real>
 class Driver : public CLTool {
 public:
@@ -217,7 +305,17 @@ void Driver<real>::registerKeywords( Keywords& keys ) {
            " (0 means that the number of the step is read from the trajectory file,"
            " currently working only for xtc/trr files read with --ixtc/--trr)"
           );
+  keys.add("compulsory","--read-threads","0","number of threads decoding frames of xtc/trr files read with --ixtc/--itrr in background"
+           " (0 means that frames are read synchronously)");
   keys.add("compulsory","--multi","0","set number of replicas for multi environment (needs MPI)");
+  keys.addFlag("--shard",false,"with --multi, split the frames of the trajectory among the replicas, each one running an independent PLUMED instance "
+               "(only for xtc/trr files and molfile formats)");
+  keys.add("optional","--shard-concat","comma-separated list of output files of the replicas that are concatenated at the end of a --shard run");
+  keys.add("optional","--shard-sum","comma-separated list of grid files of the replicas that are summed at the end of a --shard run");
+  keys.add("optional","--first-frame","index of the first frame that is analyzed, counting from 0 (only for xtc/trr files and molfile formats)");
+  keys.add("optional","--nframes","maximum number of frames that are analyzed");
+  keys.add("optional","--trajectory-index","file where the index of the frames of xtc/trr files is stored, NONE to avoid storing it "
+           "(default is the name of the trajectory followed by .idx)");
   keys.addFlag("--noatoms",false,"don't read in a trajectory.  Just use colvar files as specified in plumed.dat");
   keys.addFlag("--parse-only",false,"read the plumed input file and stop");
   keys.addFlag("--restart",false,"makes driver behave as if restarting");
@@ -343,6 +441,19 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
     intracomm.Set_comm(pc.Get_comm());
   }
 
+// set up for splitting the trajectory among the replicas:
+  bool shard; parseFlag("--shard",shard);
+  std::string shard_concat; parse("--shard-concat",shard_concat);
+  std::string shard_sum; parse("--shard-sum",shard_sum);
+  if(shard) {
+    if(!multi) error("--shard needs --multi");
+    if(noatoms) error("--shard needs a trajectory");
+  } else if(shard_concat.length()>0 || shard_sum.length()>0) error("--shard-concat and --shard-sum need --shard");
+  long long int first_frame=0; parse("--first-frame",first_frame);
+  long long int nframes=-1; parse("--nframes",nframes);
+  if(first_frame<0) error("--first-frame should be positive");
+  std::string trajectory_index; parse("--trajectory-index",trajectory_index);
+
 // set up for debug replica exchange:
   bool debug_grex=parse("--debug-grex",fakein);
   int  grex_stride=0;
@@ -372,6 +483,8 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
   real timestep=real(t);
 // the stride
   unsigned stride; parse("--trajectory-stride",stride);
+// the threads reading xdr files
+  unsigned read_threads; parse("--read-threads",read_threads);
 // are we writing forces
   std::string dumpforces(""), debugforces(""), dumpforcesFmt("%f");;
   bool dumpfullvirial=false;
@@ -516,7 +629,10 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
     if( !Communicator::initialized() ) error("needs mpi for debug-pd");
   }
 
-  PlumedMain p; if( parseOnly ) p.activateParseOnlyMode();
+// PLUMED is destroyed before merging the outputs of the replicas, so that its files are closed
+  auto plumed=Tools::make_unique<PlumedMain>();
+  PlumedMain& p(*plumed);
+  if( parseOnly ) p.activateParseOnlyMode();
   p.cmd("setRealPrecision",(int)sizeof(real));
   int checknatoms=-1;
   long long int step=0;
@@ -561,11 +677,13 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
 
   std::unique_ptr<xdrfile::XDRFILE,decltype(xdr_deleter)> xd_deleter(xd,xdr_deleter);
 
+  std::unique_ptr<XdrFrameReader> xdr_reader;
+
   if(!noatoms&&!parseOnly) {
     if (trajectoryFile=="-")
       fp=in;
     else {
-      if(multi) {
+      if(multi && !shard) {
         std::string n;
         Tools::convert(intercomm.Get_rank(),n);
         std::string testfile=FileBase::appendSuffix(trajectoryFile,"."+n);
@@ -606,6 +724,79 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
         }
       }
     }
+    long long unsigned start_offset=0;
+    if(shard || first_frame>0) {
+      if(!use_molfile && trajectory_fmt!="xdr-xtc" && trajectory_fmt!="xdr-trr")
+        error("--shard and --first-frame can only be used with xtc/trr files and molfile formats");
+      const long long unsigned unknown=std::numeric_limits<long long unsigned>::max();
+      long long unsigned total=unknown;
+      std::vector<long long unsigned> offsets;
+// the index is built by a single process and then shared.
+// With --shard all the replicas read the same file, otherwise each replica reads its own file and builds its own index
+      Communicator & indexcomm(shard ? pc : intracomm);
+      if(indexcomm.Get_rank()==0) {
+        if(use_molfile) {
+#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
+// the number of frames is only needed to split them among the replicas
+          if(shard) {
+            std::unique_ptr<std::lock_guard<std::mutex>> lck;
+            if(api->is_reentrant==VMDPLUGIN_THREADUNSAFE) lck=Tools::molfile_lock();
+            int n=natoms;
+            std::unique_ptr<void,decltype(mf_deleter)> h_count(api->open_file_read(trajectoryFile.c_str(), trajectory_fmt.c_str(), &n),mf_deleter);
+            if(!h_count) error("error opening trajectory file "+trajectoryFile);
+            total=0;
+            while(api->read_next_timestep(h_count.get(),natoms,NULL)==MOLFILE_SUCCESS) total++;
+          }
+#endif
+        } else {
+          XdrFrameIndex index;
+          if(trajectory_index.length()==0) trajectory_index=XdrFrameIndex::getDefaultFileName(trajectoryFile);
+          if(trajectory_index=="NONE") trajectory_index="";
+          if(!index.build(trajectoryFile,trajectory_fmt=="xdr-xtc",natoms,trajectory_index)) error("error indexing trajectory file "+trajectoryFile);
+          offsets=index.getOffsets();
+          total=offsets.size();
+        }
+      }
+      if(Communicator::initialized()) {
+        indexcomm.Bcast(total,0);
+        if(!use_molfile) {
+          offsets.resize(total);
+          indexcomm.Bcast(offsets,0);
+        }
+      }
+// frames from first to last (excluded) are analyzed
+      long long unsigned first=std::min<long long unsigned>(first_frame,total);
+      long long unsigned last=total;
+      if(nframes>=0) last=std::min<long long unsigned>(last,first+nframes);
+      if(shard) {
+        const long long unsigned len=last-first;
+        const long long unsigned r=intercomm.Get_rank();
+        const long long unsigned n=intercomm.Get_size();
+        last=first+len*(r+1)/n;
+        first=first+len*r/n;
+        std::fprintf(out,"DRIVER: replica %llu analyzes frames from %llu to %llu\n",r,first,last);
+      }
+      first_frame=first;
+      if(last!=unknown) nframes=last-first;
+// the step is the one of the frame in the whole trajectory
+      step+=first_frame*stride;
+      if(use_molfile) {
+#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
+        std::unique_ptr<std::lock_guard<std::mutex>> lck;
+        if(api->is_reentrant==VMDPLUGIN_THREADUNSAFE) lck=Tools::molfile_lock();
+        for(long long int i=0; i<first_frame; i++) if(api->read_next_timestep(h_in,natoms,NULL)!=MOLFILE_SUCCESS) break;
+#endif
+      } else if(first<offsets.size()) {
+        start_offset=offsets[first];
+        if(xdrfile::xdrfile_seek(xd,start_offset,SEEK_SET)!=0) error("error seeking trajectory file "+trajectoryFile);
+      }
+    }
+    if(read_threads>0 && (trajectory_fmt=="xdr-xtc" || trajectory_fmt=="xdr-trr")) {
+// the reading threads open the file on their own
+      xd_deleter.reset();
+      xd=NULL;
+      xdr_reader=Tools::make_unique<XdrFrameReader>(trajectoryFile,trajectory_fmt=="xdr-xtc",natoms,read_threads,0,start_offset,nframes);
+    }
     if(dumpforces.length()>0) {
       if(Communicator::initialized() && pc.Get_size()>1) {
         std::string n;
@@ -655,7 +846,9 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
 
   }
   bool lstep=true;
+  long long int nread=0;
   while(true) {
+    if(!noatoms && !parseOnly && nframes>=0 && nread>=nframes) break;
     if(!noatoms&&!parseOnly) {
       if(use_molfile==true) {
 #ifdef __PLUMED_HAS_MOLFILE_PLUGINS
@@ -940,6 +1133,12 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
           //cerr<<"COOR "<<coordinates[i]<<endl;
         }
 #endif
+      } else if(xdr_reader) {
+        const auto* frame=xdr_reader->next();
+        if(!frame) break;
+        if(stride==0) step=frame->step;
+        for(unsigned i=0; i<3; i++) for(unsigned j=0; j<3; j++) cell[3*i+j]=frame->box[i][j];
+        for(int i=0; i<3*natoms; i++) coordinates[i]=real(frame->positions[i]);
       } else if(trajectory_fmt=="xdr-xtc" || trajectory_fmt=="xdr-trr") {
         int localstep;
         float time;
@@ -1182,10 +1381,21 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
 
     if(plumedStopCondition) break;
 
+    nread++;
     step+=stride;
   }
   if(!parseOnly) p.cmd("runFinalJobs");
 
+  if(shard) {
+    plumed.reset();
+    pc.Barrier();
+    const int nshards=intercomm.Get_size();
+    if(pc.Get_rank()==0 && nshards>1) {
+      for(const auto & f : Tools::getWords(shard_concat,",")) concatenateShards(f,nshards);
+      for(const auto & f : Tools::getWords(shard_sum,",")) sumShards(f,nshards);
+    }
+  }
+
   return 0;
 }
 
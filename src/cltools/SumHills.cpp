@@ -143,6 +143,23 @@ plumed sum_hills --histo PATHTOMYCOLVARORHILLSFILE  --sigma 0.2,0.2 --kt 0.6 --n
 just to check the hypothetical free energy calculated in single blocks of time during a simulation
 and not in a cumulative way
 
+With many collective variables a dense grid may not fit in memory. With --blockgrid the hills are
+summed on a grid made of small tiles that are allocated only where hills were deposited, and only these
+tiles are written in the output file
+
+\verbatim
+plumed sum_hills --hills PATHTOMYHILLSFILE --blockgrid
+\endverbatim
+
+On a dense grid the hills are summed in parallel, using the number of threads set with the
+PLUMED_NUM_THREADS environment variable. The result does not depend on the number of threads.
+When using --stride the hills are only summed once, and the partial results are written as
+they are reached.
+
+\verbatim
+PLUMED_NUM_THREADS=8 plumed sum_hills --hills PATHTOMYHILLSFILE --stride 1000
+\endverbatim
+
 Output format can be controlled via the --fmt field
 
 \verbatim
@@ -213,6 +230,7 @@ void CLToolSumHills::registerKeywords( Keywords& keys ) {
   keys.addFlag("--negbias",false," print the negative bias instead of the free energy (only needed with well tempered runs and flexible hills) ");
   keys.addFlag("--nohistory",false," to be used with --stride:  it splits the bias/histogram in pieces without previous history ");
   keys.addFlag("--mintozero",false," it translate all the minimum value in bias/histogram to zero (useful to compare results) ");
+  keys.addFlag("--blockgrid",false," sum the hills on a block sparse grid and only write the regions where hills were deposited (useful with many CVs) ");
   keys.add("optional","--fmt","specify the output format");
 }
 
@@ -480,6 +498,11 @@ int CLToolSumHills::main(FILE* in,FILE*out,Communicator& pc) {
   if(mintozero) {
     actioninput.push_back("MINTOZERO");
   }
+  bool  blockgrid;
+  parseFlag("--blockgrid",blockgrid);
+  if(blockgrid) {
+    actioninput.push_back("GRID_BLOCKS");
+  }
   if(idw.size()!=0) {
     addme="PROJ=";
     for(unsigned i=0; i<idw.size()-1; i++) {addme+=idw[i]+",";}
@@ -24,10 +24,15 @@
 #include "core/CLToolRegister.h"
 #include "tools/Tools.h"
 #include "tools/SwitchingFunction.h"
+#include "tools/Random.h"
 #include <string>
 #include <iostream>
 #include <iomanip>
 #include <limits>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
 
 //+PLUMEDOC TOOLS plotswitch
 /*
@@ -43,6 +48,12 @@ Note that if R_0 happen to be between "from" and "to" the number of steps may no
 
 The various --rational** options use the special set option for the rational, like in COORDINATION.
 
+With --batch the data are tabulated with a single call to calculateSqrBatch, that is the interface used by the colvars
+that evaluate many distances at once.
+
+With --benchmark=N no table is printed: the switching function is evaluated on N random distances between "from" and "to",
+once calling calculateSqr for each distance and once with calculateSqrBatch, and the throughput of the two methods is printed.
+
 \par Examples
 
 Without option will plot the NN=6 MM=12 rational
@@ -55,6 +66,11 @@ plumed plotswitch --switch="RATIONAL NN=5 MM=9 R_0=1.3" --from=1.29999 --to=1.30
 \endverbatim
 If you use this with a older plumed version you will see the discontinuity in dfunc around 1.3
 (i use gnuplot with "p 'plot.dat' u 1:3 w l t 'dfunc', 'plot.dat' u 1:2 w l axis x1y2 t 'res'")
+
+The following compares the scalar and the batched evaluation of a switching function on one million distances
+\verbatim
+plumed plotswitch --switch="RATIONAL NN=6 MM=12 R_0=0.3" --benchmark=1000000
+\endverbatim
 */
 //+ENDPLUMEDOC
 
@@ -66,7 +82,9 @@ public:
   static void registerKeywords( Keywords&  );
 
   int main( FILE*, FILE*, Communicator& ) override;
-
+private:
+/// Time calculateSqr and calculateSqrBatch on n random distances
+  int benchmark( const SwitchingFunction&, double lowerLimit, double upperLimit, unsigned n, unsigned repeats );
 };
 PLUMED_REGISTER_CLTOOL(SwitchingPlotter,"plotswitch")
 
@@ -93,6 +111,11 @@ void SwitchingPlotter::registerKeywords( Keywords& keys ) {
   keys.add("compulsory","--rationalD_0","0.0",
            "The d_0 parameter of the switching function");
   keys.addFlag("--nosquare",false,"use calculate instead of calculateSqr");
+  keys.addFlag("--batch",false,"use calculateSqrBatch instead of calculateSqr");
+  keys.add("compulsory","--benchmark","0",
+           "if greater than zero, time calculateSqr and calculateSqrBatch on this number of random distances instead of tabulating the function");
+  keys.add("compulsory","--benchmarkrepeats","10",
+           "the number of times the timed loops of --benchmark are repeated");
   keys.add("compulsory","--centerrange","-1",
            "centers the visualization in R_0 in a range given epsilons times r_0"
            ", note that specifying this will overide all the other range options");
@@ -108,6 +131,15 @@ int SwitchingPlotter::main( FILE*, FILE*, Communicator& ) {
   parse("--switch",swInput);
   bool dontOptimize;
   parseFlag("--nosquare",dontOptimize);
+  bool useBatch;
+  parseFlag("--batch",useBatch);
+  if(dontOptimize && useBatch) {
+    error("--nosquare and --batch cannot be used together");
+  }
+  unsigned benchmarkSize;
+  parse("--benchmark",benchmarkSize);
+  unsigned benchmarkRepeats;
+  parse("--benchmarkrepeats",benchmarkRepeats);
   int Nsteps;
   parse("--steps",Nsteps);
   double lowerLimit;
@@ -168,9 +200,30 @@ int SwitchingPlotter::main( FILE*, FILE*, Communicator& ) {
     error("I calculated a negative step");
   }
 
+  if(benchmarkSize>0) {
+    return benchmark(switchingFunction,lowerLimit,upperLimit,benchmarkSize,benchmarkRepeats);
+  }
+
   //finally doing the job
   //descriptions starts with the values of "r_0"
   std::cout <<"#r val dfunc ( r_0="<<switchingFunction.description()<<")\n";
+  if(useBatch) {
+    std::vector<double> xs;
+    for(double x=lowerLimit; x < upperLimit; x+=step) {
+      xs.push_back(x);
+    }
+    std::vector<double> d2(xs.size()), res(xs.size()), dfunc(xs.size());
+    for(unsigned i=0; i<xs.size(); ++i) {
+      d2[i]=xs[i]*xs[i];
+    }
+    switchingFunction.calculateSqrBatch(d2.data(),res.data(),dfunc.data(),d2.size());
+    for(unsigned i=0; i<xs.size(); ++i) {
+      std::cout << std::setprecision(plotPrecision) << xs[i] << "\t"
+                << std::setprecision(plotPrecision) << res[i] << "\t"
+                << std::setprecision(plotPrecision) << dfunc[i] << '\n';
+    }
+    return 0;
+  }
   double x=lowerLimit;
   while(x < upperLimit) {
     double dfunc=0.0;
@@ -188,5 +241,45 @@ int SwitchingPlotter::main( FILE*, FILE*, Communicator& ) {
   return 0;
 }
 
+int SwitchingPlotter::benchmark( const SwitchingFunction& switchingFunction, const double lowerLimit,
+                                 const double upperLimit, const unsigned n, const unsigned repeats ) {
+  Random rnd;
+  std::vector<double> d2(n), res(n), dfunc(n), resBatch(n), dfuncBatch(n);
+  for(auto & d : d2) {
+    const double x=lowerLimit+(upperLimit-lowerLimit)*rnd.RandU01();
+    d=x*x;
+  }
+  using clock=std::chrono::steady_clock;
+  // the sums are printed so that the compiler cannot drop the loops
+  double checkScalar=0.0;
+  const auto startScalar=clock::now();
+  for(unsigned r=0; r<repeats; ++r) {
+    for(unsigned i=0; i<n; ++i) {
+      res[i]=switchingFunction.calculateSqr(d2[i],dfunc[i]);
+    }
+    checkScalar+=res[r%n];
+  }
+  const double scalarTime=std::chrono::duration<double,std::nano>(clock::now()-startScalar).count();
+  double checkBatch=0.0;
+  const auto startBatch=clock::now();
+  for(unsigned r=0; r<repeats; ++r) {
+    switchingFunction.calculateSqrBatch(d2.data(),resBatch.data(),dfuncBatch.data(),n);
+    checkBatch+=resBatch[r%n];
+  }
+  const double batchTime=std::chrono::duration<double,std::nano>(clock::now()-startBatch).count();
+  double maxDiff=0.0;
+  for(unsigned i=0; i<n; ++i) {
+    maxDiff=std::max(maxDiff,std::max(std::fabs(res[i]-resBatch[i]),std::fabs(dfunc[i]-dfuncBatch[i])));
+  }
+  const double npairs=double(n)*repeats;
+  std::cout << "# " << switchingFunction.description() << "\n";
+  std::cout << "# " << n << " distances between " << lowerLimit << " and " << upperLimit
+            << ", " << repeats << " repeats (checksums " << checkScalar << " " << checkBatch << ")\n";
+  std::cout << "calculateSqr:      " << npairs/scalarTime << " pairs/ns\n";
+  std::cout << "calculateSqrBatch: " << npairs/batchTime << " pairs/ns\n";
+  std::cout << "speedup: " << scalarTime/batchTime << " max difference: " << maxDiff << "\n";
+  return 0;
+}
+
 } //namespace cltools
 } // namespace PLMD
@@ -0,0 +1,145 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2012-2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "XdrFrameIndex.h"
+#include "xdrfile/xdrfile_trr.h"
+#include "xdrfile/xdrfile_xtc.h"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+namespace PLMD {
+namespace cltools {
+
+namespace {
+/// Header of a stored index, followed by the offsets.
+/// The index is stored in the native byte order, an incompatible file is just rebuilt.
+struct IndexHeader {
+  char magic[8];
+  int version;
+  int xtc;
+  int natoms;
+  int padding;
+  long long unsigned end;
+  long long unsigned nframes;
+};
+
+const char indexMagic[8]= {'P','L','M','D','X','I','D','X'};
+
+int skipFrame(xdrfile::XDRFILE* xd,bool xtc,int natoms) {
+  int step;
+  float time;
+  if(xtc) return xdrfile::read_xtc_skip(xd,natoms,&step,&time);
+  return xdrfile::read_trr_skip(xd,natoms,&step,&time);
+}
+}
+
+std::string XdrFrameIndex::getDefaultFileName(const std::string & filename) {
+  return filename+".idx";
+}
+
+bool XdrFrameIndex::load(const std::string & indexfile) {
+  auto deleter=[](auto f) { if(f) std::fclose(f); };
+  std::unique_ptr<FILE,decltype(deleter)> fp(std::fopen(indexfile.c_str(),"rb"),deleter);
+  if(!fp) return false;
+  IndexHeader header;
+  if(std::fread(&header,sizeof(header),1,fp.get())!=1) return false;
+  if(std::memcmp(header.magic,indexMagic,sizeof(indexMagic))!=0 || header.version!=1) return false;
+  if(header.xtc!=(xtc?1:0) || header.natoms!=natoms) return false;
+  std::vector<long long unsigned> stored(header.nframes);
+  if(header.nframes>0 && std::fread(stored.data(),sizeof(long long unsigned),stored.size(),fp.get())!=stored.size()) return false;
+  offsets.swap(stored);
+  end=header.end;
+  return true;
+}
+
+bool XdrFrameIndex::store(const std::string & indexfile) const {
+  auto deleter=[](auto f) { if(f) std::fclose(f); };
+// write to a temporary file first, so that an interrupted run does not leave a broken index
+  const std::string tmpfile=indexfile+".tmp";
+  {
+    std::unique_ptr<FILE,decltype(deleter)> fp(std::fopen(tmpfile.c_str(),"wb"),deleter);
+    if(!fp) return false;
+    IndexHeader header;
+    std::memset(&header,0,sizeof(header));
+    std::memcpy(header.magic,indexMagic,sizeof(indexMagic));
+    header.version=1;
+    header.xtc=(xtc?1:0);
+    header.natoms=natoms;
+    header.end=end;
+    header.nframes=offsets.size();
+    bool ok=(std::fwrite(&header,sizeof(header),1,fp.get())==1);
+    if(ok && offsets.size()>0) ok=(std::fwrite(offsets.data(),sizeof(long long unsigned),offsets.size(),fp.get())==offsets.size());
+    if(std::fclose(fp.release())!=0) ok=false;
+    if(!ok) {
+      std::remove(tmpfile.c_str());
+      return false;
+    }
+  }
+  return std::rename(tmpfile.c_str(),indexfile.c_str())==0;
+}
+
+bool XdrFrameIndex::build(const std::string & filename,bool xtc,int natoms,const std::string & indexfile) {
+  this->xtc=xtc;
+  this->natoms=natoms;
+  offsets.clear();
+  end=0;
+  auto xd_deleter=[](auto xd) { if(xd) xdrfile::xdrfile_close(xd); };
+  std::unique_ptr<xdrfile::XDRFILE,decltype(xd_deleter)> xd(xdrfile::xdrfile_open(filename.c_str(),"r"),xd_deleter);
+  if(!xd) return false;
+  if(xdrfile::xdrfile_seek(xd.get(),0,SEEK_END)!=0) return false;
+  const long long size=xdrfile::xdrfile_tell(xd.get());
+
+  if(indexfile.length()>0 && load(indexfile)) {
+// the last indexed frame should still end where it used to,
+// otherwise the trajectory was rewritten and the index is rebuilt
+    bool valid=(end<=static_cast<long long unsigned>(size));
+    if(valid && offsets.size()>0) {
+      valid=xdrfile::xdrfile_seek(xd.get(),offsets.back(),SEEK_SET)==0
+            && skipFrame(xd.get(),xtc,natoms)==xdrfile::exdrOK
+            && xdrfile::xdrfile_tell(xd.get())==static_cast<long long>(end);
+    }
+    if(!valid) {
+      offsets.clear();
+      end=0;
+    }
+  }
+
+// scan the frames that are not indexed yet
+  const auto nstored=offsets.size();
+  if(xdrfile::xdrfile_seek(xd.get(),end,SEEK_SET)!=0) return false;
+  while(true) {
+    const long long start=xdrfile::xdrfile_tell(xd.get());
+    if(skipFrame(xd.get(),xtc,natoms)!=xdrfile::exdrOK) break;
+    const long long stop=xdrfile::xdrfile_tell(xd.get());
+// seeking is allowed past the end of the file, so a truncated last frame is detected here
+    if(stop>size) break;
+    offsets.push_back(start);
+    end=stop;
+  }
+
+  if(indexfile.length()>0 && offsets.size()!=nstored) store(indexfile);
+  return true;
+}
+
+}
+}
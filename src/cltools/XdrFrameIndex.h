@@ -0,0 +1,82 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2012-2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#ifndef __PLUMED_cltools_XdrFrameIndex_h
+#define __PLUMED_cltools_XdrFrameIndex_h
+
+#include <string>
+#include <vector>
+
+namespace PLMD {
+namespace cltools {
+
+/**
+Byte offsets of the frames of an xtc or trr trajectory.
+
+The index is built reading only the headers of the frames, and can be stored
+in a file beside the trajectory so that it is built only once.
+When the trajectory has grown since the index was stored, only the new frames are scanned.
+
+\verbatim
+XdrFrameIndex index;
+index.build("traj.xtc",true,natoms,XdrFrameIndex::getDefaultFileName("traj.xtc"));
+// start reading from frame 1000
+xdrfile::xdrfile_seek(xd,index.getOffset(1000),SEEK_SET);
+\endverbatim
+*/
+class XdrFrameIndex {
+  bool xtc=true;
+  int natoms=0;
+/// Offset of each frame
+  std::vector<long long unsigned> offsets;
+/// Offset of the end of the last indexed frame
+  long long unsigned end=0;
+/// Read a stored index, returns false if the file does not exist or is not compatible
+  bool load(const std::string & indexfile);
+/// Store the index, returns false on failure
+  bool store(const std::string & indexfile) const;
+public:
+/// Default name of the file where the index of a trajectory is stored
+  static std::string getDefaultFileName(const std::string & filename);
+/// Build the index of filename. If indexfile is not empty, a stored index is reused and updated there.
+/// Returns false if the trajectory could not be opened.
+  bool build(const std::string & filename,bool xtc,int natoms,const std::string & indexfile="");
+/// Set the offsets (e.g. when they are received from another process)
+  void setOffsets(const std::vector<long long unsigned> & offsets) {
+    this->offsets=offsets;
+  }
+  const std::vector<long long unsigned> & getOffsets() const {
+    return offsets;
+  }
+/// Number of frames
+  std::size_t size() const {
+    return offsets.size();
+  }
+/// Offset of a frame
+  long long unsigned getOffset(std::size_t frame) const {
+    return offsets[frame];
+  }
+};
+
+}
+}
+
+#endif
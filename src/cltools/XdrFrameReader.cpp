@@ -0,0 +1,134 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2012-2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "XdrFrameReader.h"
+#include "tools/Exception.h"
+#include "xdrfile/xdrfile_trr.h"
+#include "xdrfile/xdrfile_xtc.h"
+
+#include <cstdio>
+#include <memory>
+
+namespace PLMD {
+namespace cltools {
+
+XdrFrameReader::XdrFrameReader(const std::string & filename,bool xtc,int natoms,unsigned nthreads,unsigned capacity,
+                               long long unsigned start,long long int nframes):
+  filename(filename),
+  xtc(xtc),
+  natoms(natoms),
+  start(start),
+  nframes(nframes)
+{
+  plumed_massert(nthreads>0,"at least one reading thread is needed");
+// one frame is owned by the caller, and each thread should have a free slot to decode into
+  if(capacity<nthreads+1) capacity=2*nthreads;
+  if(capacity<nthreads+1) capacity=nthreads+1;
+  slots.resize(capacity);
+  for(auto & s : slots) s.frame.positions.resize(3*natoms);
+  threads.reserve(nthreads);
+  try {
+    for(unsigned i=0; i<nthreads; i++) threads.emplace_back(&XdrFrameReader::work,this,i,nthreads);
+  } catch(...) {
+    stop();
+    throw;
+  }
+}
+
+XdrFrameReader::~XdrFrameReader() {
+  stop();
+}
+
+void XdrFrameReader::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping=true;
+  }
+  freeCondition.notify_all();
+  for(auto & t : threads) if(t.joinable()) t.join();
+}
+
+void XdrFrameReader::work(unsigned thread,unsigned nthreads) {
+  auto xd_deleter=[](auto xd) { if(xd) xdrfile::xdrfile_close(xd); };
+  std::unique_ptr<xdrfile::XDRFILE,decltype(xd_deleter)> xd(xdrfile::xdrfile_open(filename.c_str(),"r"),xd_deleter);
+  int status=(xd?xdrfile::exdrOK:xdrfile::exdrFILENOTFOUND);
+  if(status==xdrfile::exdrOK && start>0 && xdrfile::xdrfile_seek(xd.get(),start,SEEK_SET)!=0) status=xdrfile::exdrENDOFFILE;
+  for(long long int index=thread; ; index+=nthreads) {
+    if(nframes>=0 && index>=nframes) status=xdrfile::exdrENDOFFILE;
+// skip the frames decoded by the other threads
+    if(status==xdrfile::exdrOK && index>0) {
+      for(unsigned i=0; i<(index==thread?thread:nthreads-1); i++) {
+        int step; float time;
+        if(xtc) status=xdrfile::read_xtc_skip(xd.get(),natoms,&step,&time);
+        else status=xdrfile::read_trr_skip(xd.get(),natoms,&step,&time);
+        if(status!=xdrfile::exdrOK) break;
+      }
+    }
+    Slot & slot(slots[index%slots.size()]);
+    {
+// wait until the caller is done with the frame that was stored in this slot
+      std::unique_lock<std::mutex> lock(mtx);
+      freeCondition.wait(lock,[&] { return stopping || index<released+static_cast<long long int>(slots.size()); });
+      if(stopping) return;
+    }
+// the slot is not accessed by the caller until its index is published
+    if(status==xdrfile::exdrOK) {
+      auto & f(slot.frame);
+      auto pos=reinterpret_cast<xdrfile::rvec*>(f.positions.data());
+      if(xtc) {
+        float prec;
+        status=xdrfile::read_xtc(xd.get(),natoms,&f.step,&f.time,f.box,pos,&prec);
+      } else {
+        float lambda;
+        status=xdrfile::read_trr(xd.get(),natoms,&f.step,&f.time,&lambda,f.box,pos,NULL,NULL);
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      slot.status=status;
+      slot.index=index;
+    }
+    readyCondition.notify_all();
+// frames after a failed one are never requested
+    if(status!=xdrfile::exdrOK) return;
+  }
+}
+
+const XdrFrameReader::Frame* XdrFrameReader::next() {
+  std::unique_lock<std::mutex> lock(mtx);
+  if(finished) return nullptr;
+// release the frame returned by the previous call
+  if(released<current) {
+    released=current;
+    freeCondition.notify_all();
+  }
+  Slot & slot(slots[current%slots.size()]);
+  readyCondition.wait(lock,[&] { return slot.index==current; });
+  if(slot.status!=xdrfile::exdrOK) {
+    finished=true;
+    return nullptr;
+  }
+  current++;
+  return &slot.frame;
+}
+
+}
+}
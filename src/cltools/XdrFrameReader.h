@@ -0,0 +1,113 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2012-2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#ifndef __PLUMED_cltools_XdrFrameReader_h
+#define __PLUMED_cltools_XdrFrameReader_h
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace PLMD {
+namespace cltools {
+
+/**
+Reads frames of an xtc or trr trajectory on background threads.
+
+Frames are decoded into a bounded ring of buffers while the caller processes
+the previous ones, so that decompression overlaps with the calculation.
+With more than one thread, xtc frames are decompressed in parallel: thread w
+decodes frames w, w+n, w+2n, ... and skips the other ones reading only their headers.
+Frames are always returned in the order in which they are stored in the file.
+
+\verbatim
+XdrFrameReader reader("traj.xtc",true,natoms,2);
+while(const auto* frame=reader.next()) {
+  // use frame->step, frame->box and frame->positions
+}
+\endverbatim
+*/
+class XdrFrameReader {
+public:
+/// A decoded frame
+  struct Frame {
+    int step=0;
+    float time=0.0;
+    float box[3][3]= {};
+/// Positions, natoms x 3
+    std::vector<float> positions;
+  };
+private:
+  struct Slot {
+    Frame frame;
+/// Index of the frame stored in this slot, -1 if none
+    long long int index=-1;
+/// exdrOK if the frame was read correctly
+    int status=0;
+  };
+  std::string filename;
+  bool xtc;
+  int natoms;
+/// Offset of the first frame
+  long long unsigned start;
+/// Maximum number of frames, -1 to read until the end of the file
+  long long int nframes;
+  std::vector<Slot> slots;
+  std::vector<std::thread> threads;
+  std::mutex mtx;
+/// Signals the caller that a frame is ready
+  std::condition_variable readyCondition;
+/// Signals the threads that a slot was released
+  std::condition_variable freeCondition;
+/// Index of the next frame returned by next()
+  long long int current=0;
+/// Frames before this one are not used anymore by the caller
+  long long int released=0;
+  bool stopping=false;
+  bool finished=false;
+/// Body of the reading threads
+  void work(unsigned thread,unsigned nthreads);
+/// Stop and join the reading threads
+  void stop();
+public:
+/// Start reading filename (xtc or trr) with nthreads threads.
+/// capacity is the number of buffered frames, at least one more than the number of threads.
+/// At most nframes frames are read starting from byte offset start (see XdrFrameIndex).
+  XdrFrameReader(const std::string & filename,bool xtc,int natoms,unsigned nthreads,unsigned capacity=0,
+                 long long unsigned start=0,long long int nframes=-1);
+  ~XdrFrameReader();
+  XdrFrameReader(const XdrFrameReader&) = delete;
+  XdrFrameReader& operator=(const XdrFrameReader&) = delete;
+/// Get the next frame, nullptr at the end of the file or after a reading error.
+/// The returned frame stays valid until the following call.
+  const Frame* next();
+/// Number of threads actually used
+  unsigned getNumberOfThreads() const {
+    return threads.size();
+  }
+};
+
+}
+}
+
+#endif
@@ -41,6 +41,7 @@ void ColvarShortcut<T>::registerKeywords(Keywords& keys ) {
   for(unsigned i=0; i<nkeys; ++i) {
     if( keys.style( keys.get(i), "atoms" ) ) keys.reset_style( keys.get(i), "numbered" );
   }
+  keys.addFlag("TASK_BLOCKS",false,"if vectors are calculated compute the values in blocks of tasks using thread local storage that is allocated once");
   keys.addActionNameSuffix("_SCALAR"); keys.addActionNameSuffix("_VECTOR");
 }
 
@@ -49,11 +50,12 @@ ColvarShortcut<T>::ColvarShortcut(const ActionOptions&ao):
   Action(ao),
   ActionShortcut(ao)
 {
-  bool scalar=true; unsigned nkeys = keywords.size();
+  bool scalar=true, blocks=false; unsigned nkeys = keywords.size();
+  parseFlag("TASK_BLOCKS",blocks); std::string blockstr; if( blocks ) blockstr=" TASK_BLOCKS";
   if( getName()=="MASS" || getName()=="CHARGE" || getName()=="POSITION" ) {
     std::string inpt; parse("ATOMS",inpt);
     if( inpt.length()>0 ) {
-      readInputLine( getShortcutLabel() + ": " + getName() + "_VECTOR ATOMS=" + inpt + " " + convertInputLineToString() );
+      readInputLine( getShortcutLabel() + ": " + getName() + "_VECTOR ATOMS=" + inpt + blockstr + " " + convertInputLineToString() );
       scalar=false;
     }
   }
@@ -61,12 +63,15 @@ ColvarShortcut<T>::ColvarShortcut(const ActionOptions&ao):
     if( keywords.style( keywords.get(i), "atoms" ) ) {
       std::string inpt; parseNumbered( keywords.get(i), 1, inpt );
       if( inpt.length()>0 ) {
-        readInputLine( getShortcutLabel() + ": " + getName() + "_VECTOR " + keywords.get(i) + "1=" + inpt + " " + convertInputLineToString() );
+        readInputLine( getShortcutLabel() + ": " + getName() + "_VECTOR " + keywords.get(i) + "1=" + inpt + blockstr + " " + convertInputLineToString() );
         scalar=false; break;
       }
     }
   }
-  if( scalar ) readInputLine( getShortcutLabel() + ": " + getName() + "_SCALAR " + convertInputLineToString() );
+  if( scalar ) {
+    if( blocks ) error("TASK_BLOCKS can only be used when a vector of values is calculated");
+    readInputLine( getShortcutLabel() + ": " + getName() + "_SCALAR " + convertInputLineToString() );
+  }
 }
 
 }
@@ -62,6 +62,13 @@ The following example instructs plumed to calculate the total coordination numbe
 COORDINATION GROUPA=1-10 GROUPB=20-100 R_0=0.3 NLIST NL_CUTOFF=0.5 NL_STRIDE=100
 \endplumedfile
 
+When periodic boundary conditions are used the neighbor list is built using link cells so the cost of building it grows linearly with the number of atoms.
+For large systems it is often better to use a Verlet skin rather than a fixed update frequency.  In the following example the list contains all the pairs
+that are closer than 0.5+0.1 nm and it is rebuilt only when one of the atoms has moved by more than 0.05 nm since the last time the list was built.
+\plumedfile
+COORDINATION GROUPA=1-1000 R_0=0.3 NLIST NL_CUTOFF=0.5 NL_SKIN=0.1
+\endplumedfile
+
 The following is a dummy example which should compute the value 0 because the self interaction
 of atom 1 is skipped. Notice that in plumed 2.0 "self interactions" were not skipped, and the
 same calculation should return 1.
@@ -100,6 +107,7 @@ public:
 // active methods:
   static void registerKeywords( Keywords& keys );
   double pairing(double distance,double&dfunc,unsigned i,unsigned j)const override;
+  void pairingBatch(const double* distance2,double* res,double* dfunc,unsigned n,unsigned i,const unsigned* j)const override;
 };
 
 PLUMED_REGISTER_ACTION(Coordination,"COORDINATION")
@@ -150,6 +158,12 @@ double Coordination::pairing(double distance,double&dfunc,unsigned i,unsigned j)
   return switchingFunction.calculateSqr(distance,dfunc);
 }
 
+void Coordination::pairingBatch(const double* distance2,double* res,double* dfunc,unsigned n,unsigned i,const unsigned* j)const {
+  (void) i; // avoid warnings
+  (void) j; // avoid warnings
+  switchingFunction.calculateSqrBatch(distance2,res,dfunc,n);
+}
+
 }
 
 }
@@ -34,6 +34,7 @@ void CoordinationBase::registerKeywords( Keywords& keys ) {
   keys.addFlag("NLIST",false,"Use a neighbor list to speed up the calculation");
   keys.add("optional","NL_CUTOFF","The cutoff for the neighbor list");
   keys.add("optional","NL_STRIDE","The frequency with which we are updating the atoms in the neighbor list");
+  keys.add("optional","NL_SKIN","The skin for the neighbor list. If this is set the list is built with a cutoff of NL_CUTOFF plus NL_SKIN and is rebuilt only when an atom has moved by more than half the skin. NL_STRIDE is then not required");
   keys.add("atoms","GROUPA","First list of atoms");
   keys.add("atoms","GROUPB","Second list of atoms (if empty, N*(N-1)/2 pairs in GROUPA are counted)");
 }
@@ -63,21 +64,25 @@ CoordinationBase::CoordinationBase(const ActionOptions&ao):
 // neighbor list stuff
   bool doneigh=false;
   double nl_cut=0.0;
+  double nl_skin=0.0;
   int nl_st=0;
   parseFlag("NLIST",doneigh);
   if(doneigh) {
     parse("NL_CUTOFF",nl_cut);
     if(nl_cut<=0.0) error("NL_CUTOFF should be explicitly specified and positive");
+    parse("NL_SKIN",nl_skin);
+    if(nl_skin<0.0) error("NL_SKIN should be positive");
     parse("NL_STRIDE",nl_st);
-    if(nl_st<=0) error("NL_STRIDE should be explicitly specified and positive");
+    if(nl_st<=0 && nl_skin==0.0) error("NL_STRIDE should be explicitly specified and positive");
+    if(nl_st<0) error("NL_STRIDE should be positive");
   }
 
   addValueWithDerivatives(); setNotPeriodic();
   if(gb_lista.size()>0) {
-    if(doneigh)  nl=Tools::make_unique<NeighborList>(ga_lista,gb_lista,serial,dopair,pbc,getPbc(),comm,nl_cut,nl_st);
+    if(doneigh)  nl=Tools::make_unique<NeighborList>(ga_lista,gb_lista,serial,dopair,pbc,getPbc(),comm,nl_cut,nl_st,nl_skin);
     else         nl=Tools::make_unique<NeighborList>(ga_lista,gb_lista,serial,dopair,pbc,getPbc(),comm);
   } else {
-    if(doneigh)  nl=Tools::make_unique<NeighborList>(ga_lista,serial,pbc,getPbc(),comm,nl_cut,nl_st);
+    if(doneigh)  nl=Tools::make_unique<NeighborList>(ga_lista,serial,pbc,getPbc(),comm,nl_cut,nl_st,nl_skin);
     else         nl=Tools::make_unique<NeighborList>(ga_lista,serial,pbc,getPbc(),comm);
   }
 
@@ -100,7 +105,8 @@ CoordinationBase::CoordinationBase(const ActionOptions&ao):
   if(dopair) log.printf("  with PAIR option\n");
   if(doneigh) {
     log.printf("  using neighbor lists with\n");
-    log.printf("  update every %d steps and cutoff %f\n",nl_st,nl_cut);
+    if(nl_skin>0.0) log.printf("  cutoff %f and skin %f, update when an atom moves by more than half the skin\n",nl_cut,nl_skin);
+    else log.printf("  update every %d steps and cutoff %f\n",nl_st,nl_cut);
   }
 }
 
@@ -109,6 +115,8 @@ CoordinationBase::~CoordinationBase() {
 }
 
 void CoordinationBase::prepare() {
+// With a skin the displacements of all the atoms are checked so the full list of atoms is always needed
+  if(nl->getSkin()>0.0) return;
   if(nl->getStride()>0) {
     if(firsttime || (getStep()%nl->getStride()==0)) {
       requestAtoms(nl->getFullAtomList());
@@ -124,6 +132,10 @@ void CoordinationBase::prepare() {
 }
 
 // calculator
+void CoordinationBase::pairingBatch(const double* distance2,double* res,double* dfunc,unsigned n,unsigned i,const unsigned* j)const {
+  for(unsigned k=0; k<n; ++k) res[k]=pairing(distance2[k],dfunc[k],i,j[k]);
+}
+
 void CoordinationBase::calculate()
 {
 
@@ -131,7 +143,12 @@ void CoordinationBase::calculate()
   Tensor virial;
   std::vector<Vector> deriv(getNumberOfAtoms());
 
-  if(nl->getStride()>0 && invalidateList) {
+  if(nl->getSkin()>0.0) {
+    if(firsttime || nl->needsUpdate(getPositions())) {
+      nl->update(getPositions());
+      firsttime=false;
+    }
+  } else if(nl->getStride()>0 && invalidateList) {
     nl->update(getPositions());
   }
 
@@ -149,43 +166,66 @@ void CoordinationBase::calculate()
   const unsigned nn=nl->size();
   if(nt*stride*10>nn) nt=1;
 
-  const unsigned elementsPerRank = std::ceil(double(nn)/stride);
-  const unsigned int start= rank*elementsPerRank;
-  const unsigned int end = ((start + elementsPerRank)< nn)?(start + elementsPerRank): nn;
+// The pairs are stored in rows, one for each atom in the first group, and we loop over the rows
+  const unsigned nrows=nl->getNumberOfRows();
 
   #pragma omp parallel num_threads(nt)
   {
     std::vector<Vector> omp_deriv(getPositions().size());
     Tensor omp_virial;
+// the distances of a row are collected and the switching function is computed for the whole row at once
+    std::vector<Vector> rowDistance;
+    std::vector<double> rowDistance2;
+    std::vector<unsigned> rowAtom;
+    std::vector<double> rowRes;
+    std::vector<double> rowDfunc;
 
     #pragma omp for reduction(+:ncoord) nowait
-    for(unsigned int i=start; i<end; ++i) {
-
-      Vector distance;
-      const unsigned i0=nl->getClosePair(i).first;
-      const unsigned i1=nl->getClosePair(i).second;
-
-      if(getAbsoluteIndex(i0)==getAbsoluteIndex(i1)) continue;
-
-      if(pbc) {
-        distance=pbcDistance(getPosition(i0),getPosition(i1));
-      } else {
-        distance=delta(getPosition(i0),getPosition(i1));
+    for(unsigned int i=rank; i<nrows; i+=stride) {
+
+      const unsigned i0=nl->getRowAtom(i);
+      const unsigned kend=nl->getRowStart(i+1);
+      rowDistance.clear();
+      rowDistance2.clear();
+      rowAtom.clear();
+      for(unsigned int k=nl->getRowStart(i); k<kend; ++k) {
+
+        Vector distance;
+        const unsigned i1=nl->getColumnAtom(k);
+
+        if(getAbsoluteIndex(i0)==getAbsoluteIndex(i1)) continue;
+
+        if(pbc) {
+          distance=pbcDistance(getPosition(i0),getPosition(i1));
+        } else {
+          distance=delta(getPosition(i0),getPosition(i1));
+        }
+        rowDistance.push_back(distance);
+        rowDistance2.push_back(distance.modulo2());
+        rowAtom.push_back(i1);
       }
 
-      double dfunc=0.;
-      ncoord += pairing(distance.modulo2(), dfunc,i0,i1);
-
-      Vector dd(dfunc*distance);
-      Tensor vv(dd,distance);
-      if(nt>1) {
-        omp_deriv[i0]-=dd;
-        omp_deriv[i1]+=dd;
-        omp_virial-=vv;
-      } else {
-        deriv[i0]-=dd;
-        deriv[i1]+=dd;
-        virial-=vv;
+      const unsigned nrow=rowAtom.size();
+      if(nrow==0) continue;
+      rowRes.resize(nrow);
+      rowDfunc.assign(nrow,0.0);
+      pairingBatch(rowDistance2.data(),rowRes.data(),rowDfunc.data(),nrow,i0,rowAtom.data());
+
+      for(unsigned k=0; k<nrow; ++k) {
+        const unsigned i1=rowAtom[k];
+        ncoord += rowRes[k];
+
+        Vector dd(rowDfunc[k]*rowDistance[k]);
+        Tensor vv(dd,rowDistance[k]);
+        if(nt>1) {
+          omp_deriv[i0]-=dd;
+          omp_deriv[i1]+=dd;
+          omp_virial-=vv;
+        } else {
+          deriv[i0]-=dd;
+          deriv[i1]+=dd;
+          virial-=vv;
+        }
       }
 
     }
@@ -44,6 +44,9 @@ public:
   void calculate() override;
   void prepare() override;
   virtual double pairing(double distance,double&dfunc,unsigned i,unsigned j)const=0;
+/// Compute pairing() between atom i and the n atoms in j, distance2 contains the squared distances.
+/// The default calls pairing() for each pair, override it when the n pairs can be computed at once
+  virtual void pairingBatch(const double* distance2,double* res,double* dfunc,unsigned n,unsigned i,const unsigned* j)const;
   static void registerKeywords( Keywords& keys );
 };
 
@@ -118,8 +118,30 @@ Calculate the distance between a pair of atoms
 /*
 Calculate a vector containing the distances between various pairs of atoms
 
+When the TASK_BLOCKS flag is used the positions of the atoms are collected in blocks of tasks
+and the distances for each block are computed without any memory being allocated inside the loop over tasks.
+The derivatives are still computed in the usual way when forces are applied on the vector.
+Since an action that uses TASK_BLOCKS stores its values and is not part of a chain, the actions that use
+the vector are run separately and the forces are applied in a separate loop over the tasks.  For this
+reason using TASK_BLOCKS is slower when forces act on the vector, and it is only useful when the distances
+are only analyzed or printed.
+You can check whether this is faster for your system by comparing two inputs with \ref benchmark
+
+\verbatim
+plumed benchmark --plumed plumed.dat:plumed-blocks.dat
+\endverbatim
+
+where the two files only differ by the presence of the TASK_BLOCKS flag.
+
 \par Examples
 
+The following input calculates three distances using the block task engine
+
+\plumedfile
+d: DISTANCE_VECTOR ATOMS1=1,2 ATOMS2=3,4 ATOMS3=5,6 TASK_BLOCKS
+PRINT ARG=d FILE=colvar
+\endplumedfile
+
 */
 //+ENDPLUMEDOC
 
@@ -38,6 +38,14 @@ private:
   bool wholemolecules;
 /// Blocks of atom numbers
   std::vector< std::vector<unsigned> > ablocks;
+/// The scratch space that each thread uses when tasks are run in blocks
+  struct TaskBlockScratch {
+    std::vector<Vector> fpositions;
+    std::vector<double> mass, charge, values;
+    std::vector<Tensor> virial;
+    std::vector<std::vector<Vector> > derivs;
+  };
+  mutable std::vector<TaskBlockScratch> block_scratch;
 public:
   static void registerKeywords(Keywords&);
   explicit MultiColvarTemplate(const ActionOptions&);
@@ -46,6 +54,10 @@ public:
   void addComponentWithDerivatives( const std::string& name, const std::vector<unsigned>& shape=std::vector<unsigned>() ) override ;
   void setupStreamedComponents( const std::string& headstr, unsigned& nquants, unsigned& nmat, unsigned& maxcol, unsigned& nbookeeping ) override ;
   void performTask( const unsigned&, MultiValue& ) const override ;
+  unsigned getTaskBlockInputSize() const override ;
+  void gatherTaskBlockInputs( const unsigned* tasks, const unsigned& ntasks, double* inputs ) const override ;
+  void prepareTaskBlocks( const unsigned& nt ) override ;
+  void performTaskBlock( const unsigned& tid, const unsigned& ntasks, const double* inputs, double* outputs ) const override ;
   void calculate() override;
 };
 
@@ -56,6 +68,7 @@ void MultiColvarTemplate<T>::registerKeywords(Keywords& keys ) {
   for(unsigned i=0; i<nkeys; ++i) {
     if( keys.style( keys.get(i), "atoms" ) ) keys.reset_style( keys.get(i), "numbered" );
   }
+  keys.addFlag("TASK_BLOCKS",false,"calculate the values in blocks of tasks using thread local storage that is allocated once");
   if( keys.outputComponentExists(".#!value") ) keys.setValueDescription("vector","the " + keys.getDisplayName() + " for each set of specified atoms");
 }
 
@@ -203,6 +216,65 @@ void MultiColvarTemplate<T>::performTask( const unsigned& task_index, MultiValue
   }
 }
 
+template <class T>
+unsigned MultiColvarTemplate<T>::getTaskBlockInputSize() const {
+  // Three coordinates, a mass and a charge for each atom
+  return 5*ablocks.size();
+}
+
+template <class T>
+void MultiColvarTemplate<T>::gatherTaskBlockInputs( const unsigned* tasks, const unsigned& ntasks, double* inputs ) const {
+  unsigned natoms=ablocks.size();
+  double* x=inputs; double* y=x+natoms*taskBlockSize; double* z=y+natoms*taskBlockSize;
+  double* m=z+natoms*taskBlockSize; double* q=m+natoms*taskBlockSize;
+  for(unsigned k=0; k<ntasks; ++k) {
+    unsigned task_index=tasks[k];
+    // Retrieve the positions and make them whole in the same way as is done in performTask
+    Vector prev;
+    for(unsigned i=0; i<natoms; ++i) {
+      Vector pos = getPosition( ablocks[i][task_index] );
+      if( natoms==1 ) pos = usepbc ? pbcDistance(Vector(0.0,0.0,0.0),pos) : delta(Vector(0.0,0.0,0.0),pos);
+      else if( usepbc && i>0 ) pos = prev + pbcDistance(prev,pos);
+      prev=pos; unsigned ind=i*taskBlockSize+k;
+      x[ind]=pos[0]; y[ind]=pos[1]; z[ind]=pos[2];
+      m[ind]=getMass( ablocks[i][task_index] ); q[ind]=getCharge( ablocks[i][task_index] );
+    }
+  }
+}
+
+template <class T>
+void MultiColvarTemplate<T>::prepareTaskBlocks( const unsigned& nt ) {
+  unsigned natoms=ablocks.size(), ncomp=getNumberOfComponents();
+  if( block_scratch.size()<nt ) block_scratch.resize( nt );
+  for(unsigned i=0; i<nt; ++i) {
+    TaskBlockScratch & sc( block_scratch[i] );
+    if( sc.fpositions.size()!=natoms ) { sc.fpositions.resize( natoms ); sc.mass.resize( natoms ); sc.charge.resize( natoms ); }
+    if( sc.values.size()!=ncomp ) { sc.values.resize( ncomp ); sc.virial.resize( ncomp ); sc.derivs.resize( ncomp ); }
+    for(unsigned j=0; j<ncomp; ++j) {
+      if( sc.derivs[j].size()!=natoms ) sc.derivs[j].resize( natoms );
+    }
+  }
+}
+
+template <class T>
+void MultiColvarTemplate<T>::performTaskBlock( const unsigned& tid, const unsigned& ntasks, const double* inputs, double* outputs ) const {
+  unsigned natoms=ablocks.size();
+  const double* x=inputs; const double* y=x+natoms*taskBlockSize; const double* z=y+natoms*taskBlockSize;
+  const double* m=z+natoms*taskBlockSize; const double* q=m+natoms*taskBlockSize;
+  // This scratch space is allocated once for each thread in prepareTaskBlocks so there is no allocation here
+  TaskBlockScratch & sc( block_scratch[tid] );
+  std::vector<Vector> & fpositions( sc.fpositions ); std::vector<double> & mass( sc.mass ); std::vector<double> & charge( sc.charge );
+  std::vector<double> & values( sc.values ); std::vector<Tensor> & virial( sc.virial ); std::vector<std::vector<Vector> > & derivs( sc.derivs );
+  for(unsigned k=0; k<ntasks; ++k) {
+    for(unsigned i=0; i<natoms; ++i) {
+      unsigned ind=i*taskBlockSize+k;
+      fpositions[i]=Vector( x[ind], y[ind], z[ind] ); mass[i]=m[ind]; charge[i]=q[ind];
+    }
+    T::calculateCV( mode, mass, charge, fpositions, values, derivs, virial, this );
+    for(unsigned j=0; j<values.size(); ++j) outputs[j*taskBlockSize+k]=values[j];
+  }
+}
+
 }
 }
 #endif
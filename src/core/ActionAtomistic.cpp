@@ -47,6 +47,7 @@ ActionAtomistic::ActionAtomistic(const ActionOptions&ao):
   lockRequestAtoms(false),
   donotretrieve(false),
   donotforce(false),
+  atomGatherCache(plumed.getAtomGatherCache()),
   massesWereSet(false),
   chargesWereSet(false)
 {
@@ -133,6 +134,13 @@ void ActionAtomistic::requestAtoms(const std::vector<AtomNumber> & a, const bool
     }
   }
 
+  // Atoms from the MD code can be gathered once per step for all the actions requesting them
+  bool mdatoms=(indexes.size()>0);
+  for(const auto & a : atom_value_ind) if( a.first!=0 ) { mdatoms=false; break; }
+  if( mdatoms ) sharedAtoms=atomGatherCache.get(indexes);
+  else sharedAtoms.reset();
+  retrievedPositions=&positions; retrievedMasses=&masses; retrievedCharges=&charges;
+
   // Add the dependencies to the actions that we require
   Tools::removeDuplicates(unique); value_depends.resize(0);
   for(unsigned i=0; i<requirements.size(); ++i ) {
@@ -171,6 +179,7 @@ void ActionAtomistic::calculateAtomicNumericalDerivatives( ActionWithValue* a, c
   std::vector<Tensor> valuebox(nval);
   std::vector<Vector> savedPositions(natoms);
   const double delta=std::sqrt(epsilon);
+  copySharedAtoms();
 
   for(int i=0; i<natoms; i++) for(int k=0; k<3; k++) {
       savedPositions[i][k]=positions[i][k];
@@ -351,6 +360,8 @@ void ActionAtomistic::retrieveAtoms( const bool& force ) {
     plumed_assert( pbca ); pbc=pbca->pbc;
   }
   if( donotretrieve || indexes.size()==0 ) return;
+  // with domain decomposition the atoms from the other domains might still be in flight
+  plumed.waitForAtoms(unique);
   auto * mtr=masv[0]->getPntrToAction();
   plumed_assert(mtr); // needed for following calls, see #1046
   ActionToPutData* mv = mtr->castToActionToPutData();
@@ -361,6 +372,21 @@ void ActionAtomistic::retrieveAtoms( const bool& force ) {
   ActionToPutData* cv = ptr->castToActionToPutData();
   if(cv) chargesWereSet=cv->hasBeenSet();
   else if( (chargev[0]->getPntrToAction())->getName()=="CONSTANT" ) chargesWereSet=true; // Read masses from PDB file
+  const std::size_t bytes=indexes.size()*(sizeof(Vector)+2*sizeof(double));
+  // If another action requesting the same atoms already gathered them in this step they are just used.
+  // Otherwise they are gathered in the shared entry, or in the local arrays if nobody else uses it
+  AtomGatherCache::Entry* entry=nullptr;
+  if( sharedAtoms && sharedAtoms.use_count()>1 ) {
+    if( atomGatherCache.isCurrent(*sharedAtoms) ) {
+      retrievedPositions=&sharedAtoms->positions; retrievedMasses=&sharedAtoms->masses; retrievedCharges=&sharedAtoms->charges;
+      atomGatherCache.countShared(bytes);
+      return;
+    }
+    if( atomGatherCache.canRefresh(*sharedAtoms) ) entry=sharedAtoms.get();
+  }
+  std::vector<Vector> & pos( entry ? entry->positions : positions );
+  std::vector<double> & mas( entry ? entry->masses : masses );
+  std::vector<double> & chg( entry ? entry->charges : charges );
   unsigned j = 0;
 
 // for(const auto & a : atom_value_ind) {
@@ -381,15 +407,24 @@ void ActionAtomistic::retrieveAtoms( const bool& force ) {
     auto & ch=chargev[nn]->data;
     auto & ma=masv[nn]->data;
     for(const auto & kk : a.second) {
-      positions[j][0] = xp[kk];
-      positions[j][1] = yp[kk];
-      positions[j][2] = zp[kk];
-      charges[j] = ch[kk];
-      masses[j] = ma[kk];
+      pos[j][0] = xp[kk];
+      pos[j][1] = yp[kk];
+      pos[j][2] = zp[kk];
+      chg[j] = ch[kk];
+      mas[j] = ma[kk];
       j++;
     }
   }
+  retrievedPositions=&pos; retrievedMasses=&mas; retrievedCharges=&chg;
+  if( entry ) atomGatherCache.setCurrent(*entry);
+  atomGatherCache.countGathered(bytes);
+}
 
+void ActionAtomistic::copySharedAtoms() {
+  if( retrievedPositions==&positions ) return;
+  positions=*retrievedPositions; masses=*retrievedMasses; charges=*retrievedCharges;
+  retrievedPositions=&positions; retrievedMasses=&masses; retrievedCharges=&charges;
+  atomGatherCache.countCopied(positions.size()*(sizeof(Vector)+2*sizeof(double)));
 }
 
 void ActionAtomistic::setForcesOnAtoms(const std::vector<double>& forcesToApply, unsigned& ind) {
@@ -441,6 +476,7 @@ Tensor ActionAtomistic::getVirial() const {
 }
 
 void ActionAtomistic::readAtomsFromPDB(const PDB& pdb) {
+  copySharedAtoms();
 
   for(unsigned j=0; j<indexes.size(); j++) {
     if( indexes[j].index()>pdb.size() ) error("there are not enough atoms in the input pdb file");
@@ -458,6 +494,7 @@ unsigned ActionAtomistic::getTotAtoms()const {
 }
 
 void ActionAtomistic::makeWhole() {
+  copySharedAtoms();
   for(unsigned j=0; j<positions.size()-1; ++j) {
     const Vector & first (positions[j]);
     Vector & second (positions[j+1]);
@@ -27,8 +27,10 @@
 #include "tools/Pbc.h"
 #include "tools/ForwardDecl.h"
 #include "Value.h"
+#include "AtomGatherCache.h"
 #include <vector>
 #include <map>
+#include <memory>
 
 namespace PLMD {
 
@@ -76,6 +78,16 @@ class ActionAtomistic :
   bool                  donotretrieve;
   bool                  donotforce;
 
+/// Atoms gathered once per step for all the actions requesting the same atoms, null if some of them are virtual atoms
+  std::shared_ptr<AtomGatherCache::Entry> sharedAtoms;
+  AtomGatherCache&      atomGatherCache;
+/// Retrieved positions, masses and charges, either the local arrays or the ones in sharedAtoms
+  const std::vector<Vector>* retrievedPositions=&positions;
+  const std::vector<double>* retrievedMasses=&masses;
+  const std::vector<double>* retrievedCharges=&charges;
+/// Copy the shared atoms to the local arrays before modifying them
+  void copySharedAtoms();
+
 /// Values that hold information about atom positions and charges
   std::vector<Value*>   xpos, ypos, zpos, masv, chargev;
   void updateUniqueLocal( const bool& useunique, const std::vector<int>& g2l );
@@ -198,19 +210,19 @@ public:
 
 inline
 const Vector & ActionAtomistic::getPosition(int i)const {
-  return positions[i];
+  return (*retrievedPositions)[i];
 }
 
 inline
 double ActionAtomistic::getMass(int i)const {
   if( !massesWereSet ) log.printf("WARNING: masses were not passed to plumed\n");
-  return masses[i];
+  return (*retrievedMasses)[i];
 }
 
 inline
 double ActionAtomistic::getCharge(int i) const {
   if( !chargesWereSet ) error("charges were not passed to plumed");
-  return charges[i];
+  return (*retrievedCharges)[i];
 }
 
 inline
@@ -225,7 +237,7 @@ AtomNumber ActionAtomistic::getAbsoluteIndex(int i)const {
 
 inline
 const std::vector<Vector> & ActionAtomistic::getPositions()const {
-  return positions;
+  return *retrievedPositions;
 }
 
 inline
@@ -282,6 +294,7 @@ void ActionAtomistic::setGlobalPosition(const std::pair<std::size_t, std::size_t
   xpos[a.first]->data[a.second]=pos[0];
   ypos[a.first]->data[a.second]=pos[1];
   zpos[a.first]->data[a.second]=pos[2];
+  atomGatherCache.invalidate();
 }
 
 inline
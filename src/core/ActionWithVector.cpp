@@ -46,9 +46,14 @@ ActionWithVector::ActionWithVector(const ActionOptions&ao):
   never_reduce_tasks(false),
   reduce_tasks(false),
   atomsWereRetrieved(false),
+  use_task_blocks(false),
   done_in_chain(false)
 {
   if( keywords.exists("SERIAL") ) parseFlag("SERIAL",serial);
+  if( keywords.exists("TASK_BLOCKS") ) {
+    parseFlag("TASK_BLOCKS",use_task_blocks);
+    if( use_task_blocks ) log.printf("  running tasks in blocks of %d with preallocated thread local storage\n", taskBlockSize );
+  }
 }
 
 ActionWithVector::~ActionWithVector() {
@@ -122,6 +127,8 @@ unsigned ActionWithVector::buildArgumentStore( const unsigned& argstart ) {
     if( getPntrToArgument(i)->isConstant() ) continue;
     ActionWithVector* av=dynamic_cast<ActionWithVector*>(getPntrToArgument(i)->getPntrToAction());
     if( !av || getPntrToArgument(i)->getRank()>0 && getPntrToArgument(i)->hasDerivatives() ) { done_in_chain=false; break; }
+    // Actions that run their tasks in blocks store their output so they cannot be the start of a chain
+    if( av->use_task_blocks ) { done_in_chain=false; break; }
   }
   if( done_in_chain ) {
     std::vector<std::string> alabels; std::vector<ActionWithVector*> f_actions;
@@ -459,6 +466,13 @@ void ActionWithVector::runAllTasks() {
   // Clear buffer
   buffer.assign( buffer.size(), 0.0 );
 
+  // Use the block engine if possible as we do not need any of the scratch space in the MultiValue
+  if( canRunTaskBlocks() ) {
+    runAllTasksInBlocks( partialTaskList, nt, stride, rank );
+    if( !serial && buffer.size()>0 ) gatherProcesses( buffer );
+    finishComputations( buffer ); return;
+  }
+
   // Recover the number of derivatives we require
   unsigned nderivatives = 0; bool gridsInStream=checkForGrids(nderivatives);
   if( !doNotCalculateDerivatives() && !gridsInStream ) getNumberOfStreamedDerivatives( nderivatives, NULL );
@@ -491,6 +505,61 @@ void ActionWithVector::runAllTasks() {
   finishComputations( buffer );
 }
 
+bool ActionWithVector::canRunTaskBlocks() const {
+  if( !use_task_blocks || action_to_do_after || getTaskBlockInputSize()==0 ) return false;
+  // Blocks only compute values so they can only be used to calculate vectors.  Derivatives are computed in apply
+  for(int i=0; i<getNumberOfComponents(); ++i) {
+    if( getConstPntrToComponent(i)->getRank()!=1 || getConstPntrToComponent(i)->hasDerivatives() ) return false;
+  }
+  return true;
+}
+
+void ActionWithVector::runAllTasksInBlocks( const std::vector<unsigned>& partialTaskList, const unsigned& nt, const unsigned& stride, const unsigned& rank ) {
+  if( !isActive() ) return;
+  // Work out the number of tasks done on this rank and the number of blocks
+  unsigned nmine=0; if( rank<partialTaskList.size() ) nmine = ( partialTaskList.size() - rank + stride - 1 ) / stride;
+  unsigned nblocks = ( nmine + taskBlockSize - 1 ) / taskBlockSize;
+
+  // Setup the arenas here so there is no memory allocation inside the loop
+  unsigned nin=getTaskBlockInputSize(), nout=getNumberOfComponents();
+  if( task_block_arenas.size()<nt ) { task_block_arenas.resize(nt); task_block_indices.resize(nt); }
+  for(unsigned i=0; i<nt; ++i) {
+    if( task_block_arenas[i].size()!=taskBlockSize*(nin+nout) ) task_block_arenas[i].resize( taskBlockSize*(nin+nout) );
+    if( task_block_indices[i].size()!=taskBlockSize ) task_block_indices[i].resize( taskBlockSize );
+  }
+  prepareTaskBlocks( nt );
+
+  #pragma omp parallel num_threads(nt)
+  {
+    unsigned tid=OpenMP::getThreadNum();
+    double* inputs=task_block_arenas[tid].data(); double* outputs=inputs + taskBlockSize*nin;
+    unsigned* tasks=task_block_indices[tid].data();
+
+    #pragma omp for nowait
+    for(unsigned b=0; b<nblocks; ++b) {
+      unsigned nb=0;
+      for(unsigned m=b*taskBlockSize; m<nmine && nb<taskBlockSize; ++m) { tasks[nb]=partialTaskList[rank+m*stride]; nb++; }
+      gatherTaskBlockInputs( tasks, nb, inputs );
+      performTaskBlock( tid, nb, inputs, outputs );
+      // Each task is done by only one thread so the outputs can be written straight into the buffer
+      for(unsigned j=0; j<nout; ++j) {
+        const Value* myval=getConstPntrToComponent(j);
+        if( !myval->storedata ) continue;
+        const double* jout=outputs + j*taskBlockSize; unsigned bufstart=myval->bufstart;
+        for(unsigned k=0; k<nb; ++k) buffer[bufstart+tasks[k]] += jout[k];
+      }
+    }
+  }
+}
+
+void ActionWithVector::gatherTaskBlockInputs( const unsigned* tasks, const unsigned& ntasks, double* inputs ) const {
+  plumed_merror("action " + getName() + " with label " + getLabel() + " cannot run tasks in blocks");
+}
+
+void ActionWithVector::performTaskBlock( const unsigned& tid, const unsigned& ntasks, const double* inputs, double* outputs ) const {
+  plumed_merror("action " + getName() + " with label " + getLabel() + " cannot run tasks in blocks");
+}
+
 void ActionWithVector::gatherThreads( const unsigned& nt, const unsigned& bufsize, const std::vector<double>& omp_buffer, std::vector<double>& buffer, MultiValue& myvals ) {
   if( nt>1 ) for(unsigned i=0; i<bufsize; ++i) buffer[i]+=omp_buffer[i];
 }
@@ -91,11 +91,25 @@ private:
   bool atomsWereRetrieved;
 /// This is used to build the argument store when we cannot use the chain
   unsigned reallyBuildArgumentStore( const unsigned& argstart );
+/// Has the user asked to run the tasks in blocks
+  bool use_task_blocks;
+/// The thread local arenas that hold the inputs and outputs for each block of tasks
+  std::vector<std::vector<double> > task_block_arenas;
+/// The thread local lists of the tasks in each block
+  std::vector<std::vector<unsigned> > task_block_indices;
+/// Check if the tasks for this action can be run in blocks at this time
+  bool canRunTaskBlocks() const ;
+/// Run all the tasks in blocks using the preallocated arenas
+  void runAllTasksInBlocks( const std::vector<unsigned>& partialTaskList, const unsigned& nt, const unsigned& stride, const unsigned& rank );
 protected:
+/// The number of tasks that are processed together when tasks are run in blocks
+  static constexpr unsigned taskBlockSize=128;
 /// A vector that contains the start point for the argument derivatives
   std::vector<unsigned> arg_deriv_starts;
 /// Assert if this action is part of a chain
   bool done_in_chain;
+/// Check if the user has asked to run the tasks in blocks
+  bool usesTaskBlocks() const { return use_task_blocks; }
 /// This updates whether or not we are using all the task reduction stuff
   void updateTaskListReductionStatus();
 /// Run all calculations in serial
@@ -154,6 +168,14 @@ public:
   virtual void setupStreamedComponents( const std::string& headstr, unsigned& nquants, unsigned& nmat, unsigned& maxcol, unsigned& nbookeeping );
 /// This we override to perform each individual task
   virtual void performTask( const unsigned& current, MultiValue& myvals ) const = 0;
+/// Get the number of inputs for each task when tasks are run in blocks (zero if blocks are not supported)
+  virtual unsigned getTaskBlockInputSize() const { return 0; }
+/// Collect the inputs for a block of tasks. Input j for task k is stored in inputs[j*taskBlockSize+k]
+  virtual void gatherTaskBlockInputs( const unsigned* tasks, const unsigned& ntasks, double* inputs ) const ;
+/// Allocate any scratch space that is needed by each of the nt threads when running tasks in blocks
+  virtual void prepareTaskBlocks( const unsigned& nt ) {}
+/// Calculate the value of each component for a block of tasks on thread tid.  Component j for task k is stored in outputs[j*taskBlockSize+k]
+  virtual void performTaskBlock( const unsigned& tid, const unsigned& ntasks, const double* inputs, double* outputs ) const ;
 /// This is used to ensure that all indices are updated when you do local average
   virtual void updateAdditionalIndices( const unsigned& ostrn, MultiValue& myvals ) const {}
 /// Gather the data from all the OpenMP threads
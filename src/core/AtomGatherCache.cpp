@@ -0,0 +1,51 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2012-2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "AtomGatherCache.h"
+#include "tools/Log.h"
+
+namespace PLMD {
+
+std::shared_ptr<AtomGatherCache::Entry> AtomGatherCache::get(const std::vector<AtomNumber>& atoms) {
+  auto & w(entries[atoms]);
+  auto entry=w.lock();
+  if(entry) return entry;
+// entries of lists that are not used anymore (e.g. after a neighbor list update) are removed here
+  for(auto it=entries.begin(); it!=entries.end();) {
+    if(it->second.expired() && &it->second!=&w) it=entries.erase(it);
+    else ++it;
+  }
+  entry=std::make_shared<Entry>();
+  entry->positions.resize(atoms.size());
+  entry->masses.resize(atoms.size());
+  entry->charges.resize(atoms.size());
+  w=entry;
+  return entry;
+}
+
+void AtomGatherCache::report(Log& log) const {
+  if(nsteps==0 || bytesShared==0) return;
+  log.printf("Atoms gathered by the actions, bytes per step: %llu copied, %llu without sharing the gathered atoms\n",
+             bytesGathered/nsteps,(bytesGathered+bytesShared)/nsteps);
+  log.printf("  of the shared atoms %llu bytes per step were copied by actions that modify them\n",bytesCopied/nsteps);
+}
+
+}
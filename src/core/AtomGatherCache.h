@@ -0,0 +1,113 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2012-2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#ifndef __PLUMED_core_AtomGatherCache_h
+#define __PLUMED_core_AtomGatherCache_h
+
+#include "tools/AtomNumber.h"
+#include "tools/Vector.h"
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace PLMD {
+
+class Log;
+
+/**
+Positions, masses and charges of atoms gathered once per step and shared between actions.
+
+Actions that request exactly the same list of atoms from the MD code get the same Entry.
+When at least two actions use an entry, the first one that retrieves its atoms in a step
+gathers them from the global arrays and the following ones just point to the gathered data.
+An entry is refreshed at most once per step, so that the data seen by an action cannot change
+between its calculate() and its update(). If the positions are modified
+during the step (see ActionAtomistic::setGlobalPosition()) after an entry was gathered,
+the actions that retrieve their atoms later gather them in their own arrays.
+
+The number of bytes copied from the global arrays, of bytes that were served from the
+entries without copying and of bytes copied from the entries by actions that modify their
+atoms are accumulated, and reported in the log at the end of the run.
+*/
+class AtomGatherCache {
+public:
+/// Data gathered for a list of atoms
+  struct Entry {
+    std::vector<Vector> positions;
+    std::vector<double> masses;
+    std::vector<double> charges;
+/// Value of AtomGatherCache::generation when the data was gathered, 0 if never
+    unsigned long long generation=0;
+/// Step when the data was gathered
+    unsigned long long step=0;
+  };
+private:
+  std::map<std::vector<AtomNumber>,std::weak_ptr<Entry>> entries;
+/// Increased every time the global positions might change
+  unsigned long long generation=1;
+  unsigned long long nsteps=0;
+  unsigned long long bytesGathered=0;
+  unsigned long long bytesShared=0;
+  unsigned long long bytesCopied=0;
+public:
+/// Get the entry for a list of atoms, it is shared by all the actions holding it
+  std::shared_ptr<Entry> get(const std::vector<AtomNumber>& atoms);
+/// Mark all the entries as outdated at the beginning of a step
+  void newStep() {
+    generation++;
+    nsteps++;
+  }
+/// Mark all the entries as outdated after the global positions were modified
+  void invalidate() {
+    generation++;
+  }
+/// True if the entry contains the current positions
+  bool isCurrent(const Entry& e) const {
+    return e.generation==generation;
+  }
+/// True if the entry can be refreshed, i.e. it was not used yet in this step
+  bool canRefresh(const Entry& e) const {
+    return e.step!=nsteps;
+  }
+/// Mark the entry as containing the current positions
+  void setCurrent(Entry& e) const {
+    e.generation=generation;
+    e.step=nsteps;
+  }
+/// Count bytes copied from the global arrays
+  void countGathered(std::size_t bytes) {
+    bytesGathered+=bytes;
+  }
+/// Count bytes that were used from an entry without copying them
+  void countShared(std::size_t bytes) {
+    bytesShared+=bytes;
+  }
+/// Count bytes copied from an entry by an action that modifies its atoms
+  void countCopied(std::size_t bytes) {
+    bytesCopied+=bytes;
+  }
+/// Write the number of bytes gathered per step, with and without sharing, on the log
+  void report(Log&) const;
+};
+
+}
+
+#endif
@@ -81,6 +81,14 @@ void DomainDecomposition::DomainComms::enable(Communicator& c) {
     else if(s=="no") async=false;
     else plumed_merror("PLUMED_ASYNC_SHARE variable is set to " + s + "; should be yes or no");
   }
+// with asynchronous sharing, atoms from the other domains are received when the first action needing them is calculated
+  lazy=async;
+  if(std::getenv("PLUMED_LAZY_WAIT")) {
+    std::string s(std::getenv("PLUMED_LAZY_WAIT"));
+    if(s=="yes") lazy=async;
+    else if(s=="no") lazy=false;
+    else plumed_merror("PLUMED_LAZY_WAIT variable is set to " + s + "; should be yes or no");
+  }
 }
 
 void DomainDecomposition::registerKeywords(Keywords& keys) {
@@ -103,6 +111,8 @@ DomainDecomposition::DomainDecomposition(const ActionOptions&ao):
   ddStep(0),
   shuffledAtoms(0),
   asyncSent(false),
+  receivedCount(0),
+  receiveStamp(0),
   unique_serial(false)
 {
   // Read in the number of atoms
@@ -188,6 +198,7 @@ void DomainDecomposition::setAtomsNlocal(int n) {
     dd.positionsToBeReceived.resize(natoms*nvals,0.0);
     dd.indexToBeSent.resize(n,0);
     dd.indexToBeReceived.resize(natoms,0);
+    receivedStamp.resize(natoms,0);
   }
 }
 
@@ -379,33 +390,66 @@ void DomainDecomposition::wait() {
   for(const auto & ip : inputs) ip->dataCanBeSet=false;
 
   if(dd && shuffledAtoms>0) {
-    int ndata=0; std::vector<Value*> values_to_set;
+// data left from a step that was interrupted
+    waitForAllAtoms();
+    values_to_set.clear();
     for(const auto & ip : inputs) {
-      if( (!ip->fixed || firststep) && ip->wasset ) { values_to_set.push_back(ip->copyOutput(0)); ndata++; }
+      if( (!ip->fixed || firststep) && ip->wasset ) values_to_set.push_back(ip->copyOutput(0));
     }
 
 // receive toBeReceived
     if(asyncSent) {
-      Communicator::Status status;
-      std::size_t count=0;
-      for(int i=0; i<dd.Get_size(); i++) {
-        dd.Recv(&dd.indexToBeReceived[count],dd.indexToBeReceived.size()-count,i,666,status);
-        int c=status.Get_count<int>();
-        dd.Recv(&dd.positionsToBeReceived[ndata*count],dd.positionsToBeReceived.size()-ndata*count,i,667);
-        count+=c;
-      }
-      for(int i=0; i<count; i++) {
-        int dpoint=0;
-        for(unsigned j=0; j<values_to_set.size(); ++j) {
-          values_to_set[j]->set(dd.indexToBeReceived[i], dd.positionsToBeReceived[ndata*i+dpoint] );
-          dpoint++;
-        }
-      }
+      pendingDomains.resize(dd.Get_size());
+      for(int i=0; i<dd.Get_size(); i++) pendingDomains[i]=i;
+      receivedCount=0;
+      receiveStamp++;
       asyncSent=false;
+// otherwise the atoms are received in waitForAtoms(), called by the actions when they retrieve their atoms
+      if(!dd.lazy) waitForAllAtoms();
     }
   }
 }
 
+void DomainDecomposition::waitForAtoms(const std::vector<AtomNumber>& atoms) {
+  std::size_t first=0;
+  while(!pendingDomains.empty()) {
+// atoms before first are either local or already received
+    while(first<atoms.size()) {
+      auto i=atoms[first].index();
+      if(i<g2l.size() && g2l[i]<0 && receivedStamp[i]!=receiveStamp) break;
+      first++;
+    }
+    if(first==atoms.size()) return;
+    receiveFromDomain(nextPendingDomain());
+  }
+}
+
+void DomainDecomposition::waitForAllAtoms() {
+  while(!pendingDomains.empty()) receiveFromDomain(nextPendingDomain());
+}
+
+std::size_t DomainDecomposition::nextPendingDomain() {
+  for(std::size_t i=0; i<pendingDomains.size(); i++) if(dd.Iprobe(pendingDomains[i],666)) return i;
+  return 0;
+}
+
+void DomainDecomposition::receiveFromDomain(std::size_t ipending) {
+  const int domain=pendingDomains[ipending];
+  pendingDomains[ipending]=pendingDomains.back();
+  pendingDomains.pop_back();
+  const std::size_t ndata=values_to_set.size();
+  Communicator::Status status;
+  dd.Recv(&dd.indexToBeReceived[receivedCount],dd.indexToBeReceived.size()-receivedCount,domain,666,status);
+  const std::size_t c=status.Get_count<int>();
+  dd.Recv(&dd.positionsToBeReceived[ndata*receivedCount],dd.positionsToBeReceived.size()-ndata*receivedCount,domain,667);
+  for(std::size_t i=receivedCount; i<receivedCount+c; i++) {
+    const int index=dd.indexToBeReceived[i];
+    for(unsigned j=0; j<ndata; ++j) values_to_set[j]->set(index, dd.positionsToBeReceived[ndata*i+j] );
+    receivedStamp[index]=receiveStamp;
+  }
+  receivedCount+=c;
+}
+
 unsigned DomainDecomposition::getNumberOfForcesToRescale() const {
   return gatindex.size();
 }
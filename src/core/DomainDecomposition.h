@@ -36,6 +36,8 @@ private:
   public:
     bool on;
     bool async;
+/// Receive the atoms from the other domains only when they are needed
+    bool lazy;
 
     std::vector<Communicator::Request> mpi_request_positions;
     std::vector<Communicator::Request> mpi_request_index;
@@ -45,7 +47,7 @@ private:
     std::vector<int>    indexToBeSent;
     std::vector<int>    indexToBeReceived;
     operator bool() const {return on;}
-    DomainComms(): on(false), async(false) {}
+    DomainComms(): on(false), async(false), lazy(false) {}
     void enable(Communicator& c);
   };
   DomainComms dd;
@@ -62,6 +64,19 @@ private:
   unsigned shuffledAtoms;
 
   bool asyncSent;
+/// Domains whose atoms were sent asynchronously but were not received yet
+  std::vector<int> pendingDomains;
+/// Values that are set with the received data
+  std::vector<Value*> values_to_set;
+/// Number of atoms received in the present step
+  std::size_t receivedCount;
+/// receivedStamp[i]==receiveStamp if atom i was received in the present step
+  std::vector<unsigned> receivedStamp;
+  unsigned receiveStamp;
+/// Receive the atoms sent from one of the pending domains
+  void receiveFromDomain(std::size_t ipending);
+/// Position in pendingDomains of a domain whose data has arrived, or of the first one if none has
+  std::size_t nextPendingDomain();
   bool unique_serial; // use unique in serial mode
 /// This holds the list of unique atoms
   std::vector<AtomNumber> unique;
@@ -90,6 +105,12 @@ public:
   void share() override ;
   void shareAll() override ;
   void wait() override ;
+/// Receive from the other domains until all these atoms are available
+  void waitForAtoms(const std::vector<AtomNumber>& atoms);
+/// Receive the atoms from all the pending domains
+  void waitForAllAtoms();
+/// True if some atoms have not been received yet
+  bool hasPendingAtoms() const { return !pendingDomains.empty(); }
   void reset() override ;
   void writeBinary(std::ostream&o) override ;
   void readBinary(std::istream&i) override ;
@@ -21,11 +21,13 @@
 +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 #include "PlumedMain.h"
 #include "ActionAtomistic.h"
+#include "AtomGatherCache.h"
 #include "ActionPilot.h"
 #include "ActionForInterface.h"
 #include "ActionRegister.h"
 #include "ActionSet.h"
 #include "ActionWithValue.h"
+#include "ActionWithArguments.h"
 #include "ActionWithVirtualAtom.h"
 #include "ActionToGetData.h"
 #include "ActionToPutData.h"
@@ -43,6 +45,7 @@
 #include "tools/OpenMP.h"
 #include "tools/Tools.h"
 #include "tools/Stopwatch.h"
+#include "tools/Profiler.h"
 #include "tools/TypesafePtr.h"
 #include "lepton/Exception.h"
 #include "DataPassingTools.h"
@@ -268,9 +271,46 @@ PlumedMain::PlumedMain():
 
 // destructor needed to delete forward declarated objects
 PlumedMain::~PlumedMain() {
+// the profile refers to the labels of the actions, so it must be written before they are destroyed
+  if(profiler) {
+    try {
+      writeProfile();
+    } catch(...) {
+      // exceptions cannot escape from a destructor
+    }
+  }
+  try {
+    atomGatherCache.report(log);
+  } catch(...) {
+    // exceptions cannot escape from a destructor
+  }
   CountInstances::decrease();
 }
 
+void PlumedMain::startProfiling(const std::string& prefix,std::size_t capacity) {
+  plumed_massert(prefix.length()>0,"a file prefix is needed for the profile");
+  profilePrefix=prefix;
+  profiler=Tools::make_unique<Profiler>(capacity);
+  log<<"Profiling each step, the last "<<capacity<<" events will be written on "<<prefix<<".json and "<<prefix<<".folded\n";
+  if(!profiler->hasCounters()) log<<"Hardware counters are not available, only times will be recorded\n";
+  else log<<"Hardware counters only count the thread that calls PLUMED, OpenMP threads are not included\n";
+}
+
+void PlumedMain::writeProfile() {
+  if(!profiler || comm.Get_rank()!=0) return;
+  if(profiler->dropped()>0) log<<"Profiler: the first "<<profiler->dropped()<<" events have been dropped\n";
+  OFile trace;
+  trace.link(*this);
+  trace.open(profilePrefix+".json");
+  profiler->writeChromeTrace(trace,multi_sim_comm.Get_rank());
+  trace.close();
+  OFile folded;
+  folded.link(*this);
+  folded.open(profilePrefix+".folded");
+  profiler->writeFoldedStacks(folded);
+  folded.close();
+}
+
 /////////////////////////////////////////////////////////////
 //  MAIN INTERPRETER
 
@@ -610,6 +650,10 @@ void PlumedMain::cmd(std::string_view word,const TypesafePtr & val) {
         CHECK_NOTINIT(initialized,word);
         passtools->usingNaturalUnits=true;
         break;
+      case cmd_setProfile:
+        CHECK_NOTNULL(val,word);
+        startProfiling(val.getCString());
+        break;
       case cmd_setNoVirial:
       {
         CHECK_NOTINIT(initialized,word);
@@ -1039,6 +1083,8 @@ void PlumedMain::prepareDependencies() {
 
 // Stopwatch is stopped when sw goes out of scope
   auto sw=stopwatch.startStop("1 Prepare dependencies");
+  Profiler::Scope ps;
+  if(profiler) ps=profiler->scope(step,Profiler::Phase::prepare);
 
 // activate all the actions which are on step
 // activation is recursive and enables also the dependencies
@@ -1088,6 +1134,8 @@ void PlumedMain::shareData() {
   if(!active)return;
 // Stopwatch is stopped when sw goes out of scope
   auto sw=stopwatch.startStop("2 Sharing data");
+  Profiler::Scope ps;
+  if(profiler) ps=profiler->scope(step,Profiler::Phase::share);
   for(const auto & ip : inputs) ip->share();
 }
 
@@ -1115,18 +1163,36 @@ void PlumedMain::waitData() {
   if(!active)return;
 // Stopwatch is stopped when sw goes out of scope
   auto sw=stopwatch.startStop("3 Waiting for data");
+  Profiler::Scope ps;
+  if(profiler) ps=profiler->scope(step,Profiler::Phase::wait);
   for(const auto & ip : inputs) {
     if( ip->isActive() && ip->hasBeenSet() ) ip->wait();
     else if( ip->isActive() ) ip->warning("input requested but this quantity has not been set");
   }
 }
 
+void PlumedMain::waitForAtoms(const std::vector<AtomNumber>& atoms) {
+  for(const auto & ip : inputs) {
+    DomainDecomposition* dd=ip->castToDomainDecomposition();
+    if( dd && dd->hasPendingAtoms() ) dd->waitForAtoms(atoms);
+  }
+}
+
+void PlumedMain::waitForAllAtoms() {
+  for(const auto & ip : inputs) {
+    DomainDecomposition* dd=ip->castToDomainDecomposition();
+    if( dd && dd->hasPendingAtoms() ) dd->waitForAllAtoms();
+  }
+}
+
 void PlumedMain::justCalculate() {
   if(!active)return;
 // Stopwatch is stopped when sw goes out of scope
   auto sw=stopwatch.startStop("4 Calculating (forward loop)");
   bias=0.0;
   work=0.0;
+// positions have been shared, the atoms gathered in the previous step are outdated
+  atomGatherCache.newStep();
 
   // Check the input actions to determine if we need to calculate constants that
   // depend on masses and charges
@@ -1136,6 +1202,13 @@ void PlumedMain::justCalculate() {
   }
   if( firststep ) { for(const auto & ip : inputs) ip->firststep=false; }
 
+  // Atoms from the other domains might still be in flight, they are received when they are needed
+  bool atomsPending=false;
+  for(const auto & ip : inputs) {
+    DomainDecomposition* dd=ip->castToDomainDecomposition();
+    if( dd && dd->hasPendingAtoms() ) atomsPending=true;
+  }
+
   int iaction=0;
 // calculate the active actions in order (assuming *backward* dependence)
   for(const auto & pp : actionSet) {
@@ -1161,10 +1234,23 @@ void PlumedMain::justCalculate() {
           if( av && av->calculateOnUpdate() ) continue ;
         }
         {
+          Profiler::Scope ps;
+          if(profiler) ps=profiler->scope(step,Profiler::Phase::retrieveAtoms,&p->getLabel());
+          // actions reading the values passed from the MD code as arguments need all the atoms
+          ActionWithArguments*aw=p->castToActionWithArguments();
+          if(aw && atomsPending) {
+            for(unsigned i=0; i<aw->getNumberOfArguments(); ++i) {
+              if( aw->getPntrToArgument(i)->getPntrToAction()->castToActionToPutData() ) { waitForAllAtoms(); atomsPending=false; break; }
+            }
+          }
           if(aa) if(aa->isActive()) aa->retrieveAtoms();
         }
-        if(p->checkNumericalDerivatives()) p->calculateNumericalDerivatives();
-        else p->calculate();
+        {
+          Profiler::Scope ps;
+          if(profiler) ps=profiler->scope(step,Profiler::Phase::calculate,&p->getLabel());
+          if(p->checkNumericalDerivatives()) p->calculateNumericalDerivatives();
+          else p->calculate();
+        }
         // This retrieves components called bias
         if(av) {
           bias+=av->getOutputQuantity("bias");
@@ -1181,6 +1267,8 @@ void PlumedMain::justCalculate() {
     }
     iaction++;
   }
+  // backward propagation and update might use any atom
+  if( atomsPending ) waitForAllAtoms();
 }
 
 void PlumedMain::justApply() {
@@ -1209,6 +1297,8 @@ void PlumedMain::backwardPropagate() {
         auto spaces=std::string(k-actionNumberLabel.length(),' ');
         sw=stopwatch.startStop("5A " + spaces + actionNumberLabel+" "+p->getLabel());
       }
+      Profiler::Scope ps;
+      if(profiler) ps=profiler->scope(step,Profiler::Phase::apply,&p->getLabel());
 
       p->apply();
     }
@@ -1232,6 +1322,8 @@ void PlumedMain::update() {
   for(const auto & p : actionSet) {
     p->beforeUpdate();
     if(p->isActive() && p->checkUpdate() && updateFlagsTop()) {
+      Profiler::Scope ps;
+      if(profiler) ps=profiler->scope(step,Profiler::Phase::update,&p->getLabel());
       ActionWithValue* av=dynamic_cast<ActionWithValue*>(p.get());
       if( av && av->calculateOnUpdate() ) { p->prepare(); p->calculate(); }
       else p->update();
@@ -62,6 +62,9 @@ class ActionSet;
 class DLLoader;
 class Communicator;
 class Stopwatch;
+class Profiler;
+class AtomGatherCache;
+class AtomNumber;
 class Citations;
 class ExchangePatterns;
 class FileBase;
@@ -160,6 +163,12 @@ private:
   ForwardDecl<Stopwatch> stopwatch_fwd;
   Stopwatch& stopwatch=*stopwatch_fwd;
 
+/// Forward declaration.
+/// Should be placed before actionSet since the actions refer to it.
+  ForwardDecl<AtomGatherCache> atomGatherCache_fwd;
+/// Atoms gathered for the actions in the current step
+  AtomGatherCache& atomGatherCache=*atomGatherCache_fwd;
+
 /// Forward declaration.
   ForwardDecl<Citations> citations_fwd;
 /// tools/Citations.holder
@@ -263,6 +272,17 @@ public:
 /// Flag to switch on detailed timers
   bool detailedTimers=false;
 
+/// Per step profiler, only allocated when profiling is on
+  std::unique_ptr<Profiler> profiler;
+/// Prefix of the files where the profile is written
+  std::string profilePrefix;
+/// Switch on the per step profiler.
+/// The last capacity events are written on prefix.json (Chrome trace) and prefix.folded (folded stacks)
+/// when PlumedMain is destroyed
+  void startProfiling(const std::string& prefix,std::size_t capacity=1000000);
+/// Write the profile on files
+  void writeProfile();
+
 /// GpuDevice Identifier
   int gpuDeviceId=-1;
 
@@ -394,10 +414,22 @@ public:
     Scatters the needed atoms.
     In asynchronous implementations, this method waits for the communications started in shareData()
     to be completed. Otherwise, just send around needed atoms.
+    With domain decomposition and asynchronous sharing, the atoms from the other domains
+    are only received when an action needs them (see waitForAtoms()).
   */
   void waitData();
+  /**
+    Make sure that the atoms received from the other domains include these ones.
+    Called by the actions before using the positions of their atoms.
+  */
+  void waitForAtoms(const std::vector<AtomNumber>& atoms);
+  /**
+    Make sure that all the atoms from the other domains have been received.
+  */
+  void waitForAllAtoms();
   /**
     Perform the forward loop on active actions.
+    Actions whose atoms are all local are calculated while the atoms of the other domains are still being received.
   */
   void justCalculate();
   /**
@@ -477,6 +509,9 @@ public:
 /// Access to exchange patterns
   ExchangePatterns& getExchangePatterns() {return exchangePatterns;}
 
+/// Access to the atoms gathered for the actions
+  AtomGatherCache& getAtomGatherCache() {return atomGatherCache;}
+
 /// Push a state to update flags
   void updateFlagsPush(bool);
 /// Pop a state from update flags
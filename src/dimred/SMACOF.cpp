@@ -20,90 +20,171 @@
    along with plumed.  If not, see <http://www.gnu.org/licenses/>.
 +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 #include "SMACOF.h"
+#include "tools/OpenMP.h"
+
+#include <algorithm>
 
 namespace PLMD {
 namespace dimred {
 
 SMACOF::SMACOF( const Value* target)
 {
-  std::vector<unsigned> shape( target->getShape() );
-  Distances.resize( shape[0], shape[1] ); Weights.resize( shape[0], shape[1] );
-  for(unsigned i=0; i<shape[0]; ++i) {
-    for(unsigned j=0; j<shape[1]; ++j) Distances(i,j) = sqrt( target->get(shape[0]*i+j) );
+  std::vector<unsigned> shape( target->getShape() ); M = shape[0];
+  std::size_t npairs = static_cast<std::size_t>(M)*(M-1)/2;
+  Distances.resize( npairs ); Weights.assign( npairs, 0.0 );
+  for(unsigned i=1; i<M; ++i) {
+    for(unsigned j=0; j<i; ++j) Distances[ index(i,j) ] = sqrt( target->get(shape[0]*i+j) );
   }
 }
 
 void SMACOF::optimize( const double& tol, const unsigned& maxloops, std::vector<double>& proj ) {
-  unsigned M = Distances.nrows(); unsigned nlow=proj.size() / M; Matrix<double> Z( M, nlow );
-  // Transfer initial projection to matrix
-  unsigned k = 0;
-  for(unsigned i=0; i<M; ++i) {
-    for(unsigned j=0; j<nlow; ++j) { Z(i,j)=proj[k]; k++; }
+  unsigned nlow=proj.size() / M;
+  // Sum of the weights and check if the conjugate gradient can be used
+  double totalWeight=0; bool negative=false;
+  for(std::size_t ij=0; ij<Weights.size(); ++ij) {
+    totalWeight+=Weights[ij]; if( Weights[ij]<0 ) negative=true;
   }
 
-  // Calculate V
-  Matrix<double> V(M,M);
-  for(unsigned i=0; i<M; ++i) {
-    for(unsigned j=0; j<M; ++j) {
-      if(i==j) continue;
-      V(i,j)=-Weights(i,j);
-    }
-    for(unsigned j=0; j<M; ++j) {
-      if(i==j)continue;
-      V(i,i)-=V(i,j);
+  // With negative weights V is not positive semidefinite, so we pseudo invert it
+  Matrix<double> mypseudo;
+  if( negative ) {
+    Matrix<double> V(M,M);
+    for(unsigned i=0; i<M; ++i) {
+      for(unsigned j=0; j<M; ++j) {
+        if(i==j) continue;
+        V(i,j)=-Weights[ index(i,j) ]; V(i,i)-=V(i,j);
+      }
     }
+    mypseudo.resize(M,M); pseudoInvert(V, mypseudo);
   }
-  // And pseudo invert V
-  Matrix<double> mypseudo(M, M); pseudoInvert(V, mypseudo);
-  Matrix<double> dists( M, M ); double myfirstsig = calculateSigma( Z, dists );
 
   // initial sigma is made up of the original distances minus the distances between the projections all squared.
-  Matrix<double> temp( M, M ), BZ( M, M ), newZ( M, nlow );
+  std::vector<double> Z( proj ), newZ( proj.size() ), BZ( proj.size() ), newBZ( proj.size() );
+  double myfirstsig = calculateSigma( Z, nlow, totalWeight, BZ );
+  unsigned nt=OpenMP::getNumThreads();
   for(unsigned n=0; n<maxloops; ++n) {
     if(n==maxloops-1) plumed_merror("ran out of steps in SMACOF algorithm");
 
-    // Recompute BZ matrix
-    for(unsigned i=0; i<M; ++i) {
-      for(unsigned j=0; j<M; ++j) {
-        if(i==j) continue;  //skips over the diagonal elements
-
-        if( dists(i,j)>0 ) BZ(i,j) = -Weights(i,j)*Distances(i,j) / dists(i,j);
-        else BZ(i,j)=0.;
-      }
-      //the diagonal elements are -off diagonal elements BZ(i,i)-=BZ(i,j)   (Equation 8.25)
-      BZ(i,i)=0; //create the space memory for the diagonal elements which are scalars
-      for(unsigned j=0; j<M; ++j) {
-        if(i==j) continue;
-        BZ(i,i)-=BZ(i,j);
+    // Guttman transform, the new projection solves V newZ = BZ Z
+    if( negative ) {
+      #pragma omp parallel for num_threads(nt)
+      for(unsigned i=0; i<M; ++i) {
+        for(unsigned k=0; k<nlow; ++k) newZ[nlow*i+k]=0;
+        for(unsigned j=0; j<M; ++j) {
+          for(unsigned k=0; k<nlow; ++k) newZ[nlow*i+k]+=mypseudo(i,j)*BZ[nlow*j+k];
+        }
       }
+    } else {
+      newZ=Z; solveConjugateGradient( BZ, nlow, newZ );
     }
-
-    mult( mypseudo, BZ, temp); mult(temp, Z, newZ);
     //Compute new sigma
-    double newsig = calculateSigma( newZ, dists );
+    double newsig = calculateSigma( newZ, nlow, totalWeight, newBZ );
     //Computing whether the algorithm has converged (has the mass of the potato changed
     //when we put it back in the oven!)
     if( fabs( newsig - myfirstsig )<tol ) break;
-    myfirstsig=newsig; Z = newZ;
+    myfirstsig=newsig; Z.swap( newZ ); BZ.swap( newBZ );
   }
 
-  // Transfer final projection matrix to output proj
-  k = 0;
+  // Transfer final projection to output proj
+  proj = Z;
+}
+
+double SMACOF::calculateSigma( const std::vector<double>& Z, const unsigned& nlow, const double& totalWeight, std::vector<double>& BZ ) const {
+  double sigma=0; unsigned nt=OpenMP::getNumThreads();
+  #pragma omp parallel num_threads(nt)
+  {
+    std::vector<double> diff( nlow );
+    #pragma omp for reduction(+:sigma)
+    for(unsigned i=0; i<M; ++i) {
+      for(unsigned k=0; k<nlow; ++k) BZ[nlow*i+k]=0;
+      for(unsigned j=0; j<M; ++j) {
+        if(i==j) continue;
+        std::size_t ij=index(i,j); double dlow=0;
+        for(unsigned k=0; k<nlow; ++k) { diff[k]=Z[nlow*i+k] - Z[nlow*j+k]; dlow+=diff[k]*diff[k]; }
+        dlow=sqrt(dlow);
+        // Each pair enters the stress once
+        if( j<i ) { double tmp3 = Distances[ij] - dlow; sigma += Weights[ij]*tmp3*tmp3; }
+        // Row i of the BZ matrix (Equation 8.25) multiplied by Z
+        if( dlow>0 ) {
+          double bz = Weights[ij]*Distances[ij] / dlow;
+          for(unsigned k=0; k<nlow; ++k) BZ[nlow*i+k]+=bz*diff[k];
+        }
+      }
+    }
+  }
+  return sigma / totalWeight;
+}
+
+void SMACOF::multiplyV( const std::vector<double>& X, const unsigned& nlow, std::vector<double>& VX ) const {
+  unsigned nt=OpenMP::getNumThreads();
+  #pragma omp parallel for num_threads(nt)
   for(unsigned i=0; i<M; ++i) {
-    for(unsigned j=0; j<nlow; ++j) { proj[k]=Z(i,j); k++; }
+    for(unsigned k=0; k<nlow; ++k) VX[nlow*i+k]=0;
+    for(unsigned j=0; j<M; ++j) {
+      if(i==j) continue;
+      double ww=Weights[ index(i,j) ];
+      for(unsigned k=0; k<nlow; ++k) VX[nlow*i+k]+=ww*( X[nlow*i+k] - X[nlow*j+k] );
+    }
   }
 }
 
-double SMACOF::calculateSigma( const Matrix<double>& Z, Matrix<double>& dists ) {
-  unsigned M = Distances.nrows(); double sigma=0; double totalWeight=0;
+void SMACOF::solveConjugateGradient( const std::vector<double>& BZ, const unsigned& nlow, std::vector<double>& X ) const {
+  // Jacobi preconditioner from the diagonal of V
+  std::vector<double> diag( M, 0.0 );
   for(unsigned i=1; i<M; ++i) {
-    for(unsigned j=0; j<i; ++j) {
-      double dlow=0; for(unsigned k=0; k<Z.ncols(); ++k) { double tmp=Z(i,k) - Z(j,k); dlow+=tmp*tmp; }
-      dists(i,j)=dists(j,i)=sqrt(dlow); double tmp3 = Distances(i,j) - dists(i,j);
-      sigma += Weights(i,j)*tmp3*tmp3; totalWeight+=Weights(i,j);
+    for(unsigned j=0; j<i; ++j) { double ww=Weights[ index(i,j) ]; diag[i]+=ww; diag[j]+=ww; }
+  }
+  for(unsigned i=0; i<M; ++i) if( diag[i]<=0 ) diag[i]=1;
+
+  // Each column of X is solved for independently, but V is applied to all of them at once
+  std::vector<double> R( X.size() ), P( X.size() ), VP( X.size() );
+  std::vector<double> rz( nlow, 0.0 ), bnorm( nlow, 0.0 ), rr( nlow ), pvp( nlow );
+  multiplyV( X, nlow, VP );
+  for(unsigned i=0; i<M; ++i) {
+    for(unsigned k=0; k<nlow; ++k) {
+      unsigned ik=nlow*i+k; R[ik]=BZ[ik]-VP[ik]; P[ik]=R[ik]/diag[i];
+      rz[k]+=R[ik]*P[ik]; bnorm[k]+=BZ[ik]*BZ[ik];
     }
   }
-  return sigma / totalWeight;
+
+  const double eps=1.e-10; std::vector<bool> done( nlow, false );
+  for(unsigned n=0; n<M; ++n) {
+    std::fill( rr.begin(), rr.end(), 0.0 );
+    for(unsigned ik=0; ik<R.size(); ++ik) rr[ik%nlow]+=R[ik]*R[ik];
+    bool converged=true;
+    for(unsigned k=0; k<nlow; ++k) {
+      if( rr[k]<=eps*eps*bnorm[k] ) done[k]=true;
+      if( !done[k] ) converged=false;
+    }
+    if( converged ) break;
+
+    multiplyV( P, nlow, VP );
+    std::fill( pvp.begin(), pvp.end(), 0.0 );
+    for(unsigned ik=0; ik<P.size(); ++ik) pvp[ik%nlow]+=P[ik]*VP[ik];
+    std::vector<double> rznew( nlow, 0.0 );
+    for(unsigned i=0; i<M; ++i) {
+      for(unsigned k=0; k<nlow; ++k) {
+        // A vanishing curvature means that the column cannot be improved any further
+        if( pvp[k]<=0 ) { done[k]=true; continue; }
+        if( done[k] ) continue;
+        unsigned ik=nlow*i+k; double alpha=rz[k]/pvp[k];
+        X[ik]+=alpha*P[ik]; R[ik]-=alpha*VP[ik]; rznew[k]+=R[ik]*R[ik]/diag[i];
+      }
+    }
+    for(unsigned i=0; i<M; ++i) {
+      for(unsigned k=0; k<nlow; ++k) {
+        if( done[k] ) continue;
+        unsigned ik=nlow*i+k; P[ik]=R[ik]/diag[i] + ( rznew[k]/rz[k] )*P[ik];
+      }
+    }
+    for(unsigned k=0; k<nlow; ++k) if( !done[k] ) rz[k]=rznew[k];
+  }
+
+  // V is singular, remove the translation so as to get the same solution as with the pseudoinverse
+  for(unsigned k=0; k<nlow; ++k) {
+    double mean=0; for(unsigned i=0; i<M; ++i) mean+=X[nlow*i+k];
+    mean/=M; for(unsigned i=0; i<M; ++i) X[nlow*i+k]-=mean;
+  }
 }
 
 }
@@ -22,6 +22,7 @@
 #ifndef __PLUMED_dimred_SMACOF_h
 #define __PLUMED_dimred_SMACOF_h
 
+#include <cstddef>
 #include <vector>
 #include "core/Value.h"
 #include "tools/Matrix.h"
@@ -29,10 +30,30 @@
 namespace PLMD {
 namespace dimred {
 
+/**
+Stress majorization (SMACOF) of a set of projections.
+
+The target distances and the weights are stored in packed lower triangular arrays,
+so that only M(M-1)/2 elements of each are kept for M points.
+When all the weights are non-negative the linear system of each Guttman transform is solved with a
+preconditioned conjugate gradient that never builds the M x M matrices, otherwise the pseudoinverse of the
+weights matrix is computed once for each call to optimize.
+The matrix of squared distances that is passed to the constructor is still a dense M x M Value,
+so that the memory used for M points is dominated by the 8 M^2 bytes of the input matrix
+(20 GB for 50000 points) and every iteration costs O(M^2) operations.
+*/
 class SMACOF {
 private:
-  Matrix<double> Distances, Weights;
-  double calculateSigma( const Matrix<double>& InitialZ, Matrix<double>& dists );
+  unsigned M;
+  std::vector<double> Distances, Weights;
+/// Index of element i,j (with i!=j) in the packed lower triangular arrays
+  static std::size_t index( const unsigned& i, const unsigned& j );
+/// Calculate the stress of Z and the right hand side BZ Z of the Guttman transform
+  double calculateSigma( const std::vector<double>& Z, const unsigned& nlow, const double& totalWeight, std::vector<double>& BZ ) const ;
+/// Multiply X by the matrix V built from the weights
+  void multiplyV( const std::vector<double>& X, const unsigned& nlow, std::vector<double>& VX ) const ;
+/// Solve V X = BZ with the conjugate gradient, X contains the initial guess
+  void solveConjugateGradient( const std::vector<double>& BZ, const unsigned& nlow, std::vector<double>& X ) const ;
 public:
   explicit SMACOF( const Value* mysquaredists );
   void optimize( const double& tol, const unsigned& maxloops, std::vector<double>& proj);
@@ -40,14 +61,21 @@ public:
   void setWeight( const unsigned& i, const unsigned& j, const double& ww );
 };
 
+inline
+std::size_t SMACOF::index( const unsigned& i, const unsigned& j ) {
+  if( i<j ) return static_cast<std::size_t>(j)*(j-1)/2 + i;
+  return static_cast<std::size_t>(i)*(i-1)/2 + j;
+}
+
 inline
 double SMACOF::getDistance( const unsigned& i, const unsigned& j ) const {
-  return Distances( i, j );
+  if( i==j ) return 0.0;
+  return Distances[ index(i,j) ];
 }
 
 inline
 void SMACOF::setWeight( const unsigned& i, const unsigned& j, const double& ww ) {
-  Weights(i,j) = Weights(j,i ) = ww;
+  if( i!=j ) Weights[ index(i,j) ] = ww;
 }
 
 }
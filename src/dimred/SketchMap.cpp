@@ -29,6 +29,11 @@
 /*
 Construct a sketch map projection of the input data
 
+When USE_SMACOF is used the projections are optimized with the SMACOF algorithm, which stores the distances and
+the weights for the M points in packed triangular arrays. The matrix of the dissimilarities between the points is
+however a dense M x M matrix, so that the memory needed grows with the square of the number of points
+(about 20 GB for 50000 points) and only a few tens of thousands of points can be projected.
+
 \par Examples
 
 */
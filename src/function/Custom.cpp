@@ -159,6 +159,13 @@ Notice that these equations have been used to combine \ref RMSD
 from different snapshots of a protein so as to define
 progression (S) and distance (Z) variables \cite perez2015atp.
 
+When the arguments are vectors the TASK_BLOCKS flag can be used to evaluate the function for
+128 elements of the vectors with a single call.  This is only faster when the function is
+evaluated for many elements.  The flag is not used by default because the values are then
+stored and the function cannot be part of a chain of actions.  The derivatives are still computed
+one element at a time, and functions of matrices do not use blocks, so the flag is ignored when
+the arguments are matrices.
+
 
 */
 //+ENDPLUMEDOC
@@ -339,27 +346,37 @@ std::vector<Value*> Custom::getArgumentsToCheck( const std::vector<Value*>& args
   return fargs;
 }
 
-void Custom::calc( const ActionWithArguments* action, const std::vector<double>& args, std::vector<double>& vals, Matrix<double>& derivatives ) const {
-  if( args.size()>1 ) {
-    bool allzero=false;
-    if( check_multiplication_vars.size()>0 ) {
-      for(unsigned i=0; i<check_multiplication_vars.size(); ++i) {
-        if( fabs(args[check_multiplication_vars[i]])<epsilon ) { allzero=true; break; }
-      }
-    } else if( zerowhenallzero ) {
-      allzero=(fabs(args[0])<epsilon);
-      for(unsigned i=1; i<args.size(); ++i) {
-        if( fabs(args[i])>epsilon ) { allzero=false; break; }
-      }
+bool Custom::isZero( const double* args, const unsigned& stride ) const {
+  unsigned nargs=function.getNumberOfArguments();
+  if( nargs<2 ) return false;
+  bool allzero=false;
+  if( check_multiplication_vars.size()>0 ) {
+    for(unsigned i=0; i<check_multiplication_vars.size(); ++i) {
+      if( fabs(args[check_multiplication_vars[i]*stride])<epsilon ) { allzero=true; break; }
     }
-    if( allzero ) {
-      vals[0]=0; for(unsigned i=0; i<args.size(); i++) derivatives(0,i) = 0.0;
-      return;
+  } else if( zerowhenallzero ) {
+    allzero=(fabs(args[0])<epsilon);
+    for(unsigned i=1; i<nargs; ++i) {
+      if( fabs(args[i*stride])>epsilon ) { allzero=false; break; }
     }
   }
-  vals[0] = function.evaluate( args );
-  if( !noderiv ) {
-    for(unsigned i=0; i<args.size(); i++) derivatives(0,i) = function.evaluateDeriv( i, args );
+  return allzero;
+}
+
+void Custom::calc( const ActionWithArguments* action, const std::vector<double>& args, std::vector<double>& vals, Matrix<double>& derivatives ) const {
+  if( args.size()>1 && isZero( args.data(), 1 ) ) {
+    vals[0]=0; for(unsigned i=0; i<args.size(); i++) derivatives(0,i) = 0.0;
+    return;
+  }
+  if( noderiv ) vals[0] = function.evaluate( args );
+  else vals[0] = function.evaluateWithDerivatives( args, &derivatives(0,0) );
+}
+
+void Custom::calcTaskBlock( const unsigned& ntasks, const unsigned& stride, const double* args, double* vals ) const {
+  // All the tasks in the block are evaluated with a single call and the values that are known to be zero are then reset
+  function.evaluateBatch( args, stride, ntasks, vals );
+  for(unsigned k=0; k<ntasks; ++k) {
+    if( isZero( args+k, stride ) ) vals[k]=0;
   }
 }
 
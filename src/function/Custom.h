@@ -35,6 +35,8 @@ class Custom : public FunctionTemplateBase {
 /// Check if only multiplication is done in function.  If only multiplication is done we can do some tricks
 /// to speed things up
   std::vector<unsigned> check_multiplication_vars;
+/// Check if the function is zero without evaluating it.  Argument j is in args[j*stride]
+  bool isZero( const double* args, const unsigned& stride ) const ;
 public:
   void registerKeywords( Keywords& keys ) override;
   std::string getGraphInfo( const std::string& lab ) const override;
@@ -42,6 +44,8 @@ public:
   bool getDerivativeZeroIfValueIsZero() const override;
   std::vector<Value*> getArgumentsToCheck( const std::vector<Value*>& args ) override;
   void calc( const ActionWithArguments* action, const std::vector<double>& args, std::vector<double>& vals, Matrix<double>& derivatives ) const override;
+  bool supportsTaskBlocks() const override { return true; }
+  void calcTaskBlock( const unsigned& ntasks, const unsigned& stride, const double* args, double* vals ) const override;
 };
 
 }
@@ -68,6 +68,8 @@ FilesHandler::FilesHandler(const std::vector<std::string> &filenames, const bool
   for(unsigned i=0; i<filenames.size(); i++) {
     auto ifile=Tools::make_unique<IFile>();
     ifile->link(action);
+    // hills files can be large and are read sequentially
+    ifile->allowMappedText();
     plumed_massert((ifile->FileExist(filenames[i])), "the file "+filenames[i]+" does not exist " );
     ifiles.emplace_back(std::move(ifile));
   }
@@ -182,6 +184,7 @@ class FuncSumHills :
   bool negativebias;
   bool nohistory;
   bool minTOzero;
+  bool blockgrid;
   bool doInt;
   double lowI_;
   double uppI_;
@@ -194,10 +197,23 @@ public:
   void calculate() override; // this probably is not needed
   bool checkFilesAreExisting(const std::vector<std::string> & hills );
   static void registerKeywords(Keywords& keys);
+/// Change the sign of a copy of the bias grid and write it on file
+  template <class T>
+  void writeNegativeBias( T& biasGrid, const std::string& myout );
 };
 
 PLUMED_REGISTER_ACTION(FuncSumHills,"FUNCSUMHILLS")
 
+template <class T>
+void FuncSumHills::writeNegativeBias( T& biasGrid, const std::string& myout ) {
+  biasGrid.scaleAllValuesAndDerivatives(-1.);
+  OFile gridfile; gridfile.link(*this);
+  gridfile.open(myout);
+  if(minTOzero) biasGrid.setMinToZero();
+  biasGrid.setOutputFmt(fmt);
+  biasGrid.writeToFile(gridfile);
+}
+
 void FuncSumHills::registerKeywords(Keywords& keys) {
   Function::registerKeywords(keys);
   keys.add("optional","HILLSFILES"," source file for hills creation(may be the same as HILLS)"); // this can be a vector!
@@ -219,6 +235,7 @@ void FuncSumHills::registerKeywords(Keywords& keys) {
   keys.addFlag("NEGBIAS",false,"dump  negative bias ( -bias )   instead of the free energy: needed in well tempered with flexible hills ");
   keys.addFlag("NOHISTORY",false,"to be used with INITSTRIDE:  it splits the bias/histogram in pieces without previous history  ");
   keys.addFlag("MINTOZERO",false,"translate the resulting bias/histogram to have the minimum to zero  ");
+  keys.addFlag("GRID_BLOCKS",false,"sum the hills on a block sparse grid, only the tiles of bins where the hills are non zero are allocated and written");
   keys.add("optional","FMT","the format that should be used to output real numbers");
   keys.setValueDescription("scalar","a scalar");
 }
@@ -234,6 +251,7 @@ FuncSumHills::FuncSumHills(const ActionOptions&ao):
   negativebias(false),
   nohistory(false),
   minTOzero(false),
+  blockgrid(false),
   doInt(false),
   lowI_(-1.),
   uppI_(-1.),
@@ -426,6 +444,11 @@ FuncSumHills::FuncSumHills(const ActionOptions&ao):
   }
   parseFlag("MINTOZERO",minTOzero);
   if(minTOzero)log<<"  mintozero: bias/histogram will be translated to have the minimum value equal to zero\n";
+  parseFlag("GRID_BLOCKS",blockgrid);
+  if(blockgrid) {
+    if(proj.size()!=0) error("GRID_BLOCKS cannot be used together with PROJ");
+    log<<"  hills are summed on a block sparse grid\n";
+  }
   //what might it be this?
   // here start
   // want something right now?? do it and return
@@ -454,7 +477,7 @@ FuncSumHills::FuncSumHills(const ActionOptions&ao):
     // check if the files exists
     if(integratehills) {
       checkFilesAreExisting(hillsFiles);
-      biasrep=Tools::make_unique<BiasRepresentation>(tmphillsvalues,comm, gmin, gmax, gbin, doInt, lowI_, uppI_);
+      biasrep=Tools::make_unique<BiasRepresentation>(tmphillsvalues,comm, gmin, gmax, gbin, doInt, lowI_, uppI_, blockgrid);
       if(negativebias) {
         biasrep->setRescaledToBias(true);
         log<<"  required the -bias instead of the free energy \n";
@@ -561,21 +584,18 @@ FuncSumHills::FuncSumHills(const ActionOptions&ao):
       } else {
 
         if(integratehills) {
-
-          Grid biasGrid=*(biasrep->getGridPtr());
-          biasGrid.scaleAllValuesAndDerivatives(-1.);
-
-          OFile gridfile; gridfile.link(*this);
           std::ostringstream ostr; ostr<<nfiles;
           std::string myout;
           if(initstride>0) { myout=outhills+ostr.str()+".dat" ;} else {myout=outhills;}
-          log<<"  Writing full grid on file "<<myout<<" \n";
-          gridfile.open(myout);
-
-          if(minTOzero) biasGrid.setMinToZero();
-          biasGrid.setOutputFmt(fmt);
-          biasGrid.writeToFile(gridfile);
-          // rescale back prior to accumulate
+          if(blockgrid) {
+            BlockGrid biasGrid=*dynamic_cast<BlockGrid*>(biasrep->getGridBasePtr());
+            log<<"  Writing block sparse grid ("<<biasGrid.getNumberOfTiles()<<" tiles) on file "<<myout<<" \n";
+            writeNegativeBias(biasGrid,myout);
+          } else {
+            Grid biasGrid=*(biasrep->getGridPtr());
+            log<<"  Writing full grid on file "<<myout<<" \n";
+            writeNegativeBias(biasGrid,myout);
+          }
           if(!ibias)integratehills=false;// once you get to the final bunch just give up
         }
         if(integratehisto) {
@@ -70,6 +70,10 @@ public:
   void setupStreamedComponents( const std::string& headstr, unsigned& nquants, unsigned& nmat, unsigned& maxcol, unsigned& nbookeeping ) override ;
 /// Calculate the function
   void performTask( const unsigned& current, MultiValue& myvals ) const override ;
+/// These are used to calculate the function for blocks of tasks
+  unsigned getTaskBlockInputSize() const override ;
+  void gatherTaskBlockInputs( const unsigned* tasks, const unsigned& ntasks, double* inputs ) const override ;
+  void performTaskBlock( const unsigned& tid, const unsigned& ntasks, const double* inputs, double* outputs ) const override ;
 };
 
 template <class T>
@@ -80,6 +84,7 @@ void FunctionOfVector<T>::registerKeywords(Keywords& keys ) {
   keys.reserve("compulsory","PERIODIC","if the output of your function is periodic then you should specify the periodicity of the function.  If the output is not periodic you must state this using PERIODIC=NO");
   keys.add("hidden","NO_ACTION_LOG","suppresses printing from action on the log");
   T tfunc; tfunc.registerKeywords( keys );
+  if( tfunc.supportsTaskBlocks() ) keys.addFlag("TASK_BLOCKS",false,"calculate the values in blocks of tasks with a single call to the function.  The values are then stored and the function is not part of a chain of actions");
   if( keys.getDisplayName()=="SUM" ) {
     keys.setValueDescription("scalar","the sum of all the elements in the input vector");
   } else if( keys.getDisplayName()=="MEAN" ) {
@@ -170,6 +175,8 @@ FunctionOfVector<T>::FunctionOfVector(const ActionOptions&ao):
     if( !getPntrToArgument(i)->isConstant() ) { allconstant=false; break; }
   }
   if( allconstant ) done_in_chain=false;
+  // The tasks can only be run in blocks if this action runs its own loop
+  if( usesTaskBlocks() ) done_in_chain=false;
   nderivatives = buildArgumentStore(myfunc.getArgStart());
 }
 
@@ -305,6 +312,30 @@ void FunctionOfVector<T>::performTask( const unsigned& current, MultiValue& myva
   }
 }
 
+template <class T>
+unsigned FunctionOfVector<T>::getTaskBlockInputSize() const {
+  if( !myfunc.supportsTaskBlocks() || actionInChain() ) return 0;
+  return getNumberOfArguments() - myfunc.getArgStart();
+}
+
+template <class T>
+void FunctionOfVector<T>::gatherTaskBlockInputs( const unsigned* tasks, const unsigned& ntasks, double* inputs ) const {
+  unsigned argstart=myfunc.getArgStart();
+  for(unsigned i=argstart; i<getNumberOfArguments(); ++i) {
+    const Value* myarg=getPntrToArgument(i); double* in=inputs + (i-argstart)*taskBlockSize;
+    if( myarg->getRank()==1 ) {
+      for(unsigned k=0; k<ntasks; ++k) in[k]=myarg->get( tasks[k] );
+    } else {
+      double val=myarg->get(); for(unsigned k=0; k<ntasks; ++k) in[k]=val;
+    }
+  }
+}
+
+template <class T>
+void FunctionOfVector<T>::performTaskBlock( const unsigned& tid, const unsigned& ntasks, const double* inputs, double* outputs ) const {
+  myfunc.calcTaskBlock( ntasks, taskBlockSize, inputs, outputs );
+}
+
 template <class T>
 unsigned FunctionOfVector<T>::getNumberOfFinalTasks() {
   unsigned nelements=0, argstart=myfunc.getArgStart();
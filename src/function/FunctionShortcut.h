@@ -49,6 +49,7 @@ void FunctionShortcut<T>::registerKeywords(Keywords& keys ) {
   keys.reserve("compulsory","PERIODIC","if the output of your function is periodic then you should specify the periodicity of the function.  If the output is not periodic you must state this using PERIODIC=NO");
   keys.addActionNameSuffix("_SCALAR"); keys.addActionNameSuffix("_VECTOR"); keys.addActionNameSuffix("_MATRIX"); keys.addActionNameSuffix("_GRID");
   T tfunc; tfunc.registerKeywords( keys );
+  if( tfunc.supportsTaskBlocks() ) keys.addFlag("TASK_BLOCKS",false,"if the function is calculated for vectors calculate the values in blocks of tasks with a single call to the function.  This flag is ignored for scalars, matrices and grids");
   if( keys.getDisplayName()=="SUM" || keys.getDisplayName()=="CUSTOM" || keys.getDisplayName()=="MATHEVAL" ) {
     keys.addInputKeyword("compulsory","ARG","scalar/vector/matrix/grid","the values input to this function");
   } else keys.addInputKeyword("compulsory","ARG","scalar/vector/matrix","the values input to this function");
@@ -69,10 +70,14 @@ FunctionShortcut<T>::FunctionShortcut(const ActionOptions&ao):
 template <class T>
 void FunctionShortcut<T>::createAction( ActionShortcut* action, const std::vector<Value*>& vals, const std::string& allargs ) {
   unsigned maxrank=vals[0]->getRank(); bool isgrid=false;
+  // Blocks of tasks are only used for vectors
+  bool blocks=false; if( action->keywords.exists("TASK_BLOCKS") ) action->parseFlag("TASK_BLOCKS",blocks);
+  std::string blockstr; if( blocks ) blockstr=" TASK_BLOCKS";
   for(unsigned i=0; i<vals.size(); ++i) {
     if( vals[i]->getRank()>0 && vals[i]->hasDerivatives() ) isgrid=true;
     if( vals[i]->getRank()>maxrank ) maxrank=vals[i]->getRank();
   }
+  if( blocks && (isgrid || maxrank!=1) ) action->warning("TASK_BLOCKS is only used when the function is calculated for vectors so it is ignored here");
   if( isgrid ) {
     if( actionRegister().check( action->getName() + "_GRID") ) action->readInputLine( action->getShortcutLabel() + ": " + action->getName() + "_GRID ARG=" + allargs + " " + action->convertInputLineToString() );
     else plumed_merror("there is no action registered that allows you to do " + action->getName() + " with functions on a grid");
@@ -80,7 +85,7 @@ void FunctionShortcut<T>::createAction( ActionShortcut* action, const std::vecto
     if( actionRegister().check( action->getName() + "_SCALAR") ) action->readInputLine( action->getShortcutLabel() + ": " + action->getName() + "_SCALAR ARG=" + allargs + " " + action->convertInputLineToString() );
     else plumed_merror("there is no action registered that allows you to do " + action->getName() + " with scalars");
   } else if( maxrank==1 ) {
-    if( actionRegister().check( action->getName() + "_VECTOR") ) action->readInputLine( action->getShortcutLabel() + ": " + action->getName() + "_VECTOR ARG=" + allargs + " " + action->convertInputLineToString() );
+    if( actionRegister().check( action->getName() + "_VECTOR") ) action->readInputLine( action->getShortcutLabel() + ": " + action->getName() + "_VECTOR ARG=" + allargs + blockstr + " " + action->convertInputLineToString() );
     else plumed_merror("there is no action registered that allows you to do " + action->getName() + " with vectors");
   } else if( maxrank==2  ) {
     if( actionRegister().check( action->getName() + "_MATRIX") ) action->readInputLine( action->getShortcutLabel() + ": " + action->getName() + "_MATRIX ARG=" + allargs + " " + action->convertInputLineToString() );
@@ -60,6 +60,10 @@ public:
   virtual unsigned getArgStart() const { return 0; }
   virtual void setup( ActionWithValue* action );
   virtual void calc( const ActionWithArguments* action, const std::vector<double>& args, std::vector<double>& vals, Matrix<double>& derivatives ) const = 0;
+/// Override this function if the values can be calculated for a block of tasks with a single call
+  virtual bool supportsTaskBlocks() const { return false; }
+/// Calculate the values for a block of ntasks tasks.  Argument j of task k is in args[j*stride+k] and value i of task k is stored in vals[i*stride+k]
+  virtual void calcTaskBlock( const unsigned& ntasks, const unsigned& stride, const double* args, double* vals ) const { plumed_error(); }
 };
 
 template<class T>
@@ -42,6 +42,17 @@ DEBUG DETAILED_TIMERS
 DEBUG logRequestedAtoms STRIDE=2
 \endplumedfile
 
+The time spent by each action in each phase of each step can be recorded with PROFILE.
+At the end of the simulation the recorded events are written on a file that can be opened with chrome://tracing or
+https://ui.perfetto.dev (prof.json in the example below) and on a file that can be converted to a flame graph with
+flamegraph.pl (prof.folded). When Linux perf events are available, cycles and instructions spent in each event are also recorded.
+These counters only count the thread that calls PLUMED, so the cycles and instructions spent in OpenMP threads are not included.
+Only the last PROFILE_EVENTS events are kept. The same can be obtained from an MD code with `cmd("setProfile","prof")`.
+
+\plumedfile
+DEBUG PROFILE=prof PROFILE_EVENTS=100000
+\endplumedfile
+
 */
 //+ENDPLUMEDOC
 class Debug:
@@ -70,6 +81,8 @@ void Debug::registerKeywords( Keywords& keys ) {
   keys.addFlag("logRequestedAtoms",false,"write in the log which atoms have been requested at a given time");
   keys.addFlag("NOVIRIAL",false,"switch off the virial contribution for the entirety of the simulation");
   keys.addFlag("DETAILED_TIMERS",false,"switch on detailed timers");
+  keys.add("optional","PROFILE","record the time spent in each phase of each step by each action and write it on files with this prefix");
+  keys.add("compulsory","PROFILE_EVENTS","1000000","the number of events kept by PROFILE, older events are dropped");
   keys.add("optional","FILE","the name of the file on which to output these quantities");
 }
 
@@ -91,6 +104,13 @@ Debug::Debug(const ActionOptions&ao):
     log.printf("  Detailed timing on\n");
     plumed.detailedTimers=true;
   }
+  std::string profile;
+  parse("PROFILE",profile);
+  unsigned profileEvents=1000000;
+  parse("PROFILE_EVENTS",profileEvents);
+  if(profile.length()>0) {
+    plumed.startProfiling(profile,profileEvents);
+  }
   ofile.link(*this);
   std::string file;
   parse("FILE",file);
@@ -308,6 +308,8 @@ void FitToTemplate::calculate() {
 
     shift=center-cc;
     setValue(shift.modulo());
+    // all the atoms are modified, so they should all be received from the other domains
+    plumed.waitForAllAtoms();
     unsigned nat = getTotAtoms();
     for(unsigned i=0; i<nat; i++) {
       std::pair<std::size_t,std::size_t> a = getValueIndices( AtomNumber::index(i));
@@ -318,6 +320,8 @@ void FitToTemplate::calculate() {
   else if( type=="OPTIMAL" or type=="OPTIMAL-FAST") {
     // specific stuff that provides all that is needed
     double r=rmsd->calc_FitElements( getPositions(), rotation,  drotdpos, centeredpositions, center_positions);
+    // all the atoms are modified, so they should all be received from the other domains
+    plumed.waitForAllAtoms();
     setValue(r); unsigned nat = getTotAtoms();
     for(unsigned i=0; i<nat; i++) {
       std::pair<std::size_t,std::size_t> a = getValueIndices( AtomNumber::index(i));
@@ -43,6 +43,11 @@ Keep into account that even on steps when the action is not updated (and thus th
 the argument will be activated. In other words, if you use `UPDATE_FROM` to start printing at a given time,
 the collective variables this PRINT statement depends on will be computed also before that time.
 
+When the name of the file has extension `.bin` (e.g. `FILE=COLVAR.bin`) the file is written in a compact
+binary format, that can be read back with \ref READ and converted to text with \ref convert-colvar.
+In this case `FMT` is ignored and numbers are stored with full double precision.  Other actions that write files
+(e.g. \ref DUMPDERIVATIVES) always write text, even when the name of the file has extension `.bin`.
+
 \par Examples
 
 The following input instructs plumed to print the distance between atoms 3 and 5 on a file
@@ -119,6 +124,7 @@ Print::Print(const ActionOptions&ao):
   ofile.link(*this);
   parse("FILE",file);
   if(file.length()>0) {
+    ofile.allowBinary();
     ofile.open(file);
     log.printf("  on file %s\n",file.c_str());
   } else {
@@ -46,6 +46,9 @@ this value can be referenced using the label of the Action.  Alternatively, if m
 are read in, they can be referenced elsewhere in the input by using the label for the Action
 followed by a dot and the character string that appeared after the dot in the title of the field.
 
+Binary files written by \ref PRINT (i.e. with extension `.bin`) are recognized automatically. They
+are memory mapped when possible and their values are read without any conversion from text.
+
 \par Examples
 
 This input reads in data from a file called input_colvar.data that was generated
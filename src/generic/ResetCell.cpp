@@ -158,7 +158,8 @@ void ResetCell::calculate() {
 // rotation matrix from old to new coordinates
   rotation=transpose(matmul(inverse(box),newbox));
 
-// rotate all coordinates
+// rotate all coordinates, after receiving them from the other domains
+  plumed.waitForAllAtoms();
   unsigned nat = getTotAtoms();
   for(unsigned i=0; i<nat; i++) {
     std::pair<std::size_t,std::size_t> a = getValueIndices( AtomNumber::index(i));
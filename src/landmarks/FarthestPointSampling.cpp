@@ -22,11 +22,28 @@
 #include "matrixtools/MatrixOperationBase.h"
 #include "core/ActionRegister.h"
 #include "tools/Random.h"
+#include "tools/OpenMP.h"
+
+#include <algorithm>
+#include <limits>
 
 //+PLUMEDOC LANDMARKS FARTHEST_POINT_SAMPLING
 /*
 Select a set of landmarks using farthest point sampling.
 
+The input to this action is usually the square matrix of the dissimilarities between the points.
+If the COORDINATES flag is used the input matrix instead contains the coordinates of the points,
+one point per row (e.g. the data output by \ref COLLECT_FRAMES). The squared Euclidean distances
+between the points are then computed when they are needed, so that the matrix of
+dissimilarities, which grows with the square of the number of points, is never stored.
+For each point only the minimum distance from the landmarks selected so far is kept, so selecting
+k landmarks from N points costs a time proportional to N k and memory proportional to N.
+
+When the COORDINATES flag is used the selection is also incremental. If the landmarks are recalculated after
+new points were added to the end of the input matrix, only the distances between the new points and the landmarks
+are computed as long as none of the new points would have been selected. The first landmark, which is picked
+at random, is retained until the stored points are cleared.
+
 \par Examples
 
 */
@@ -39,6 +56,24 @@ class FarthestPointSampling : public matrixtools::MatrixOperationBase {
 private:
   unsigned seed;
   unsigned nlandmarks;
+/// Is the input matrix containing the coordinates of the points rather than the dissimilarities
+  bool coordinates;
+/// The number of points when the landmarks were last selected
+  unsigned nprevious;
+/// The landmarks selected last time
+  std::vector<unsigned> landmarks;
+/// The minimum distance from the previous landmarks that each landmark had when it was selected
+  std::vector<double> maxmindist;
+/// The coordinates of the landmarks, used to check that points were only added to the input
+  std::vector<double> landmarkpos;
+/// Get the (squared) distance between two points
+  double getDistance( const unsigned& i, const unsigned& j ) const ;
+/// Check that the points in the input are those used last time, possibly with some new points at the end
+  bool landmarksAreValid( const unsigned& npoints ) const ;
+/// Check if one of the points added since the last time would have been selected as a landmark
+  bool newPointsChangeLandmarks( const unsigned& npoints ) const ;
+/// Select all the landmarks starting from the point first (passed by value as it can be an element of landmarks)
+  void selectLandmarks( const unsigned& npoints, const unsigned first );
 public:
   static void registerKeywords( Keywords& keys );
   explicit FarthestPointSampling( const ActionOptions& ao );
@@ -55,14 +90,18 @@ void FarthestPointSampling::registerKeywords( Keywords& keys ) {
   matrixtools::MatrixOperationBase::registerKeywords( keys );
   keys.add("compulsory","NZEROS","the number of landmark points that you want to select");
   keys.add("compulsory","SEED","1234","a random number seed");
+  keys.addFlag("COORDINATES",false,"the input matrix contains the coordinates of the points, one per row, and the squared distances between them are calculated on the fly");
   keys.setValueDescription("vector","a vector which has as many elements as there are rows in the input matrix of dissimilarities. NZEROS of the elements in this vector are equal to one, the rest of the elements are equal to zero.  The nodes that have elements equal to one are the NZEROS points that are farthest appart according to the input dissimilarities");
 }
 
 FarthestPointSampling::FarthestPointSampling( const ActionOptions& ao ):
   Action(ao),
-  MatrixOperationBase(ao)
+  MatrixOperationBase(ao),
+  nprevious(0)
 {
-  if( getPntrToArgument(0)->getShape()[0]!=getPntrToArgument(0)->getShape()[1] ) error("input to this argument should be a square matrix of dissimilarities");
+  parseFlag("COORDINATES",coordinates);
+  if( coordinates ) log.printf("  input matrix contains coordinates of points, squared distances are calculated on the fly \n");
+  else if( getPntrToArgument(0)->getShape()[0]!=getPntrToArgument(0)->getShape()[1] ) error("input to this argument should be a square matrix of dissimilarities");
   parse("NZEROS",nlandmarks); parse("SEED",seed);
   log.printf("  selecting %d landmark points \n", nlandmarks );
 
@@ -75,37 +114,109 @@ void FarthestPointSampling::prepare() {
   if( myval->getShape()[0]!=getPntrToArgument(0)->getShape()[0] ) {
     std::vector<unsigned> shape(1); shape[0] = getPntrToArgument(0)->getShape()[0]; myval->setShape(shape);
   }
-  for(unsigned i=0; i<nlandmarks; ++i) myval->set( i, 0.0 );
-  for(unsigned i=nlandmarks; i<myval->getShape()[0]; ++i) myval->set( i, 1.0 );
+  unsigned nzeros=std::min( nlandmarks, myval->getShape()[0] );
+  for(unsigned i=0; i<nzeros; ++i) myval->set( i, 0.0 );
+  for(unsigned i=nzeros; i<myval->getShape()[0]; ++i) myval->set( i, 1.0 );
 }
 
-void FarthestPointSampling::calculate() {
-  Value* myval=getPntrToComponent(0); unsigned npoints = getPntrToArgument(0)->getShape()[0];
-  for(unsigned i=0; i<npoints; ++i) myval->set( i, 1.0 );
-  std::vector<unsigned> landmarks( nlandmarks );
-
-  // Select first point at random
-  Random random; random.setSeed(-seed); double rand=random.RandU01();
-  landmarks[0] = std::floor( npoints*rand ); myval->set( landmarks[0], 0 );
+double FarthestPointSampling::getDistance( const unsigned& i, const unsigned& j ) const {
+  Value* myarg = getPntrToArgument(0); unsigned ncols = myarg->getShape()[1];
+  if( !coordinates ) return myarg->get( static_cast<std::size_t>(i)*ncols + j );
+  std::size_t ibase=static_cast<std::size_t>(i)*ncols, jbase=static_cast<std::size_t>(j)*ncols; double dist=0;
+  if( myarg->isPeriodic() ) {
+    for(unsigned k=0; k<ncols; ++k) { double tmp = myarg->difference( myarg->get( ibase+k ), myarg->get( jbase+k ) ); dist += tmp*tmp; }
+  } else {
+    for(unsigned k=0; k<ncols; ++k) { double tmp = myarg->get( jbase+k ) - myarg->get( ibase+k ); dist += tmp*tmp; }
+  }
+  return dist;
+}
 
-  // Now find distance to all other points (N.B. We can use squared distances here for speed)
-  Matrix<double> distances( nlandmarks, npoints ); Value* myarg = getPntrToArgument(0);
-  for(unsigned i=0; i<npoints; ++i) distances(0,i) = myarg->get( landmarks[0]*npoints + i );
+bool FarthestPointSampling::landmarksAreValid( const unsigned& npoints ) const {
+  if( nprevious==0 || npoints<nprevious || landmarks.size()!=nlandmarks ) return false;
+  Value* myarg = getPntrToArgument(0); unsigned ncols = myarg->getShape()[1];
+  if( landmarkpos.size()!=nlandmarks*ncols ) return false;
+  for(unsigned i=0; i<nlandmarks; ++i) {
+    for(unsigned k=0; k<ncols; ++k) {
+      if( myarg->get( landmarks[i]*ncols + k )!=landmarkpos[i*ncols+k] ) return false;
+    }
+  }
+  return true;
+}
 
-  // Now find all other landmarks
+bool FarthestPointSampling::newPointsChangeLandmarks( const unsigned& npoints ) const {
+  // The old points come first, so a new point is only selected if it is strictly farther from the landmarks
+  std::vector<double> mindist( npoints-nprevious, std::numeric_limits<double>::max() );
+  unsigned nt=OpenMP::getNumThreads();
   for(unsigned i=1; i<nlandmarks; ++i) {
-    // Find point that has the largest minimum distance from the landmarks selected thus far
     double maxd=0;
-    for(unsigned j=0; j<npoints; ++j) {
-      double mind=distances(0,j);
-      for(unsigned k=1; k<i; ++k) {
-        if( distances(k,j)<mind ) { mind=distances(k,j); }
+    #pragma omp parallel num_threads(nt)
+    {
+      #pragma omp for reduction(max:maxd)
+      for(unsigned j=nprevious; j<npoints; ++j) {
+        double d = getDistance( landmarks[i-1], j ); double& mind = mindist[j-nprevious];
+        if( d<mind ) mind=d;
+        if( mind>maxd ) maxd=mind;
+      }
+    }
+    if( maxd>maxmindist[i] ) return true;
+  }
+  return false;
+}
+
+void FarthestPointSampling::selectLandmarks( const unsigned& npoints, const unsigned first ) {
+  landmarks.assign( nlandmarks, 0 ); maxmindist.assign( nlandmarks, 0.0 ); landmarks[0] = first;
+
+  // Minimum distance of each point from the landmarks selected thus far (N.B. We can use squared distances here for speed)
+  std::vector<double> mindist( npoints, std::numeric_limits<double>::max() );
+  unsigned nt=OpenMP::getNumThreads(); std::vector<double> tmaxd( nt ); std::vector<unsigned> tland( nt );
+  for(unsigned i=1; i<nlandmarks; ++i) {
+    // Update the minimum distances with the last landmark and find the point for which it is largest
+    std::fill( tmaxd.begin(), tmaxd.end(), 0.0 ); std::fill( tland.begin(), tland.end(), 0 );
+    #pragma omp parallel num_threads(nt)
+    {
+      double maxd=0; unsigned jmax=0;
+      #pragma omp for schedule(static)
+      for(unsigned j=0; j<npoints; ++j) {
+        double d = getDistance( landmarks[i-1], j );
+        if( d<mindist[j] ) mindist[j]=d;
+        if( mindist[j]>maxd ) { maxd=mindist[j]; jmax=j; }
       }
-      if( mind>maxd ) { maxd=mind; landmarks[i]=j; }
+      tmaxd[OpenMP::getThreadNum()]=maxd; tland[OpenMP::getThreadNum()]=jmax;
+    }
+    // Ties are resolved in favour of the first point, as in a serial loop
+    for(unsigned t=0; t<nt; ++t) {
+      if( tmaxd[t]>maxmindist[i] || (tmaxd[t]>0 && tmaxd[t]==maxmindist[i] && tland[t]<landmarks[i]) ) { maxmindist[i]=tmaxd[t]; landmarks[i]=tland[t]; }
+    }
+  }
+}
+
+void FarthestPointSampling::calculate() {
+  Value* myval=getPntrToComponent(0); unsigned npoints = getPntrToArgument(0)->getShape()[0];
+  // While fewer points than landmarks have been stored all the points are landmarks
+  if( npoints<=nlandmarks ) {
+    for(unsigned i=0; i<npoints; ++i) myval->set( i, 0 );
+    nprevious = 0; return;
+  }
+
+  if( coordinates && landmarksAreValid( npoints ) ) {
+    // Only new points have to be checked if the landmarks were selected from the same points before
+    if( npoints>nprevious && newPointsChangeLandmarks( npoints ) ) selectLandmarks( npoints, landmarks[0] );
+  } else {
+    // Select first point at random
+    Random random; random.setSeed(-seed); double rand=random.RandU01();
+    selectLandmarks( npoints, std::floor( npoints*rand ) );
+  }
+
+  if( coordinates ) {
+    Value* myarg = getPntrToArgument(0); unsigned ncols = myarg->getShape()[1]; landmarkpos.resize( nlandmarks*ncols );
+    for(unsigned i=0; i<nlandmarks; ++i) {
+      for(unsigned k=0; k<ncols; ++k) landmarkpos[i*ncols+k] = myarg->get( landmarks[i]*ncols + k );
     }
-    myval->set( landmarks[i], 0 );
-    for(unsigned k=0; k<npoints; ++k) distances(i,k) = myarg->get( landmarks[i]*npoints + k );
   }
+  nprevious = npoints;
+
+  for(unsigned i=0; i<npoints; ++i) myval->set( i, 1.0 );
+  for(unsigned i=0; i<nlandmarks; ++i) myval->set( landmarks[i], 0 );
 }
 
 }
@@ -48,6 +48,11 @@ Select a random set of landmarks from a large set of configurations.
 /*
 Select a of landmarks from a large set of configurations using farthest point sampling.
 
+If the NODISSIMILARITIES flag is used the matrix of dissimilarities between all the configurations is not calculated.
+The squared distances between the collected data points are instead calculated when they are needed by \ref FARTHEST_POINT_SAMPLING,
+which makes it possible to select landmarks from a very large number of configurations.
+Notice that the weights of the landmarks cannot then be calculated with the Voronoi procedure.
+
 \par Examples
 
 */
@@ -121,9 +126,11 @@ LandmarkSelection::LandmarkSelection( const ActionOptions& ao ):
     std::string seed; parse("SEED",seed); if( seed.length()>0 ) seed = " SEED=" + seed;
     readInputLine( getShortcutLabel() + "_mask: CREATE_MASK ARG=" + getShortcutLabel() + "_allweights TYPE=random NZEROS=" + nlandmarks + seed );
   } else if( getName()=="LANDMARK_SELECT_FPS" ) {
-    if( dissims.length()==0 ) error("dissimiarities must be defined to use FPS sampling");
     std::string seed; parse("SEED",seed); if( seed.length()>0 ) seed = " SEED=" + seed;
-    readInputLine( getShortcutLabel() + "_mask: FARTHEST_POINT_SAMPLING ARG=" + dissims + " NZEROS=" + nlandmarks + seed );
+    if( dissims.length()>0 ) readInputLine( getShortcutLabel() + "_mask: FARTHEST_POINT_SAMPLING ARG=" + dissims + " NZEROS=" + nlandmarks + seed );
+    // Without the dissimilarities the distances are calculated from the collected data when they are needed
+    else if( argn.length()>0 ) readInputLine( getShortcutLabel() + "_mask: FARTHEST_POINT_SAMPLING ARG=" + argn + "_data COORDINATES NZEROS=" + nlandmarks + seed );
+    else error("dissimiarities or collected data must be defined to use FPS sampling");
   }
 
   if( argn.length()>0 ) readInputLine( getShortcutLabel() + "_data: SELECT_WITH_MASK ARG=" + argn + "_data ROW_MASK=" + getShortcutLabel() + "_mask");
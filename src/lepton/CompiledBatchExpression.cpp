@@ -0,0 +1,296 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ * -------------------------------------------------------------------------- *
+ *                                   Lepton                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the Lepton expression parser originating from              *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2013-2016 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- *
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/* -------------------------------------------------------------------------- *
+ *                                   lepton                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the lepton expression parser originating from              *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2013-2019 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "CompiledBatchExpression.h"
+#include "Exception.h"
+#include "Operation.h"
+#include "ParsedExpression.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace PLMD {
+using namespace lepton;
+using namespace std;
+
+// Number of points evaluated together by each operation.
+static const int blockSize = 64;
+
+CompiledBatchExpression::CompiledBatchExpression() : numTemps(0) {
+}
+
+CompiledBatchExpression::CompiledBatchExpression(const vector<ParsedExpression>& expressions, const vector<string>& variables) :
+        variables(variables), variableIndex(variables.size(), -1), numTemps(0) {
+    vector<pair<ExpressionTreeNode, int> > temps;
+    for (int i = 0; i < (int) expressions.size(); i++) {
+        ParsedExpression expr = expressions[i].optimize(); // Just in case it wasn't already optimized.
+        compileExpression(expr.getRootNode(), temps);
+        outputIndex.push_back(findTempIndex(expr.getRootNode(), temps));
+    }
+    int maxArguments = 1;
+    for (int i = 0; i < (int) operation.size(); i++)
+        if (operation[i]->getNumArguments() > maxArguments)
+            maxArguments = operation[i]->getNumArguments();
+    argValues.resize(maxArguments);
+    workspace.resize(numTemps*blockSize);
+}
+
+CompiledBatchExpression::~CompiledBatchExpression() {
+    for (int i = 0; i < (int) operation.size(); i++)
+        if (operation[i] != NULL)
+            delete operation[i];
+}
+
+CompiledBatchExpression::CompiledBatchExpression(const CompiledBatchExpression& expression) : numTemps(0) {
+    *this = expression;
+}
+
+CompiledBatchExpression& CompiledBatchExpression::operator=(const CompiledBatchExpression& expression) {
+    if (this == &expression)
+        return *this;
+    for (int i = 0; i < (int) operation.size(); i++)
+        if (operation[i] != NULL)
+            delete operation[i];
+    variables = expression.variables;
+    variableIndex = expression.variableIndex;
+    outputIndex = expression.outputIndex;
+    arguments = expression.arguments;
+    target = expression.target;
+    numTemps = expression.numTemps;
+    workspace.resize(expression.workspace.size());
+    argValues.resize(expression.argValues.size());
+    operation.resize(expression.operation.size());
+    for (int i = 0; i < (int) operation.size(); i++)
+        operation[i] = expression.operation[i]->clone();
+    return *this;
+}
+
+void CompiledBatchExpression::compileExpression(const ExpressionTreeNode& node, vector<pair<ExpressionTreeNode, int> >& temps) {
+    if (findTempIndex(node, temps) != -1)
+        return; // We have already processed a node identical to this one.
+
+    // Process the child nodes.
+
+    vector<int> args;
+    for (int i = 0; i < (int) node.getChildren().size(); i++) {
+        compileExpression(node.getChildren()[i], temps);
+        args.push_back(findTempIndex(node.getChildren()[i], temps));
+    }
+
+    // Process this node.
+
+    if (node.getOperation().getId() == Operation::VARIABLE) {
+        vector<string>::const_iterator var = find(variables.begin(), variables.end(), node.getOperation().getName());
+        if (var == variables.end())
+            throw Exception("CompiledBatchExpression: Unknown variable '"+node.getOperation().getName()+"'");
+        variableIndex[var-variables.begin()] = numTemps;
+    }
+    else {
+        arguments.push_back(args);
+        target.push_back(numTemps);
+        operation.push_back(node.getOperation().clone());
+    }
+    temps.push_back(make_pair(node, numTemps));
+    numTemps++;
+}
+
+int CompiledBatchExpression::findTempIndex(const ExpressionTreeNode& node, vector<pair<ExpressionTreeNode, int> >& temps) {
+    for (int i = 0; i < (int) temps.size(); i++)
+        if (temps[i].first == node)
+            return temps[i].second;
+    return -1;
+}
+
+int CompiledBatchExpression::getNumVariables() const {
+    return variables.size();
+}
+
+int CompiledBatchExpression::getNumOutputs() const {
+    return outputIndex.size();
+}
+
+void CompiledBatchExpression::evaluate(const double* input, int inputStride, double* output, int outputStride, int npoints) const {
+    const int numVariables = variables.size();
+    const int numOutputs = outputIndex.size();
+    for (int start = 0; start < npoints; start += blockSize) {
+        const int n = (std::min)(blockSize, npoints-start);
+
+        // Copy the variables of this block of points.
+
+        for (int v = 0; v < numVariables; v++) {
+            if (variableIndex[v] < 0)
+                continue;
+            double* w = &workspace[variableIndex[v]*blockSize];
+            const double* in = &input[v*inputStride+start];
+            for (int p = 0; p < n; p++)
+                w[p] = in[p];
+        }
+
+        // Evaluate each operation for all the points of the block.
+
+        for (int step = 0; step < (int) operation.size(); step++) {
+            const Operation& op = *operation[step];
+            const vector<int>& args = arguments[step];
+            double* t = &workspace[target[step]*blockSize];
+            const double* a = (args.size() > 0 ? &workspace[args[0]*blockSize] : NULL);
+            const double* b = (args.size() > 1 ? &workspace[args[1]*blockSize] : NULL);
+            switch (op.getId()) {
+            case Operation::CONSTANT: {
+                const double value = dynamic_cast<const Operation::Constant&>(op).getValue();
+                for (int p = 0; p < n; p++)
+                    t[p] = value;
+                break;
+            }
+            case Operation::ADD:
+                for (int p = 0; p < n; p++)
+                    t[p] = a[p]+b[p];
+                break;
+            case Operation::SUBTRACT:
+                for (int p = 0; p < n; p++)
+                    t[p] = a[p]-b[p];
+                break;
+            case Operation::MULTIPLY:
+                for (int p = 0; p < n; p++)
+                    t[p] = a[p]*b[p];
+                break;
+            case Operation::DIVIDE:
+                for (int p = 0; p < n; p++)
+                    t[p] = a[p]/b[p];
+                break;
+            case Operation::NEGATE:
+                for (int p = 0; p < n; p++)
+                    t[p] = -a[p];
+                break;
+            case Operation::SQRT:
+                for (int p = 0; p < n; p++)
+                    t[p] = std::sqrt(a[p]);
+                break;
+            case Operation::EXP:
+                for (int p = 0; p < n; p++)
+                    t[p] = std::exp(a[p]);
+                break;
+            case Operation::LOG:
+                for (int p = 0; p < n; p++)
+                    t[p] = std::log(a[p]);
+                break;
+            case Operation::SIN:
+                for (int p = 0; p < n; p++)
+                    t[p] = std::sin(a[p]);
+                break;
+            case Operation::COS:
+                for (int p = 0; p < n; p++)
+                    t[p] = std::cos(a[p]);
+                break;
+            case Operation::TANH:
+                for (int p = 0; p < n; p++)
+                    t[p] = std::tanh(a[p]);
+                break;
+            case Operation::ABS:
+                for (int p = 0; p < n; p++)
+                    t[p] = std::abs(a[p]);
+                break;
+            case Operation::SQUARE:
+                for (int p = 0; p < n; p++)
+                    t[p] = a[p]*a[p];
+                break;
+            case Operation::CUBE:
+                for (int p = 0; p < n; p++)
+                    t[p] = a[p]*a[p]*a[p];
+                break;
+            case Operation::RECIPROCAL:
+                for (int p = 0; p < n; p++)
+                    t[p] = 1.0/a[p];
+                break;
+            case Operation::ADD_CONSTANT: {
+                const double value = dynamic_cast<const Operation::AddConstant&>(op).getValue();
+                for (int p = 0; p < n; p++)
+                    t[p] = a[p]+value;
+                break;
+            }
+            case Operation::MULTIPLY_CONSTANT: {
+                const double value = dynamic_cast<const Operation::MultiplyConstant&>(op).getValue();
+                for (int p = 0; p < n; p++)
+                    t[p] = a[p]*value;
+                break;
+            }
+            default:
+                // Any other operation is evaluated one point at a time.
+                for (int p = 0; p < n; p++) {
+                    for (int i = 0; i < (int) args.size(); i++)
+                        argValues[i] = workspace[args[i]*blockSize+p];
+                    t[p] = op.evaluate(&argValues[0], dummyVariables);
+                }
+            }
+        }
+
+        // Copy the results.
+
+        for (int o = 0; o < numOutputs; o++) {
+            const double* w = &workspace[outputIndex[o]*blockSize];
+            double* out = &output[o*outputStride+start];
+            for (int p = 0; p < n; p++)
+                out[p] = w[p];
+        }
+    }
+}
+}
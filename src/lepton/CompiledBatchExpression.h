@@ -0,0 +1,136 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ * -------------------------------------------------------------------------- *
+ *                                   Lepton                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the Lepton expression parser originating from              *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2013-2016 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- *
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#ifndef __PLUMED_lepton_CompiledBatchExpression_h
+#define __PLUMED_lepton_CompiledBatchExpression_h
+
+/* -------------------------------------------------------------------------- *
+ *                                   lepton                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the lepton expression parser originating from              *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2013-2019 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "ExpressionTreeNode.h"
+#include "windowsIncludes.h"
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace PLMD {
+namespace lepton {
+
+class Operation;
+class ParsedExpression;
+
+/**
+ * A CompiledBatchExpression evaluates several expressions of the same variables (typically a function and its
+ * derivatives) for many sets of values of the variables with a single call.
+ *
+ * All the expressions are compiled into a single program, in which subexpressions that appear more than once,
+ * also in different expressions, are evaluated only once. The program is run over blocks of points, so that
+ * the cost of dispatching each operation is shared by all the points of a block and the most common operations
+ * are evaluated in simple loops that the compiler can vectorize.
+ *
+ * WARNING: CompiledBatchExpression is NOT thread safe.  You should never access a CompiledBatchExpression from two
+ * threads at the same time.
+ */
+
+class LEPTON_EXPORT CompiledBatchExpression {
+public:
+    CompiledBatchExpression();
+    /**
+     * Compile a list of expressions.  The values of the variables are passed to evaluate() in the order
+     * in which they are listed in variables.
+     */
+    CompiledBatchExpression(const std::vector<ParsedExpression>& expressions, const std::vector<std::string>& variables);
+    CompiledBatchExpression(const CompiledBatchExpression& expression);
+    ~CompiledBatchExpression();
+    CompiledBatchExpression& operator=(const CompiledBatchExpression& expression);
+    /**
+     * Get the number of variables read for each point.
+     */
+    int getNumVariables() const;
+    /**
+     * Get the number of expressions computed for each point.
+     */
+    int getNumOutputs() const;
+    /**
+     * Evaluate all the expressions for npoints points.  The value of variable v for point p is read from
+     * input[v*inputStride+p], and the value of expression e for point p is stored in output[e*outputStride+p].
+     * The strides should be at least npoints.
+     */
+    void evaluate(const double* input, int inputStride, double* output, int outputStride, int npoints) const;
+private:
+    void compileExpression(const ExpressionTreeNode& node, std::vector<std::pair<ExpressionTreeNode, int> >& temps);
+    int findTempIndex(const ExpressionTreeNode& node, std::vector<std::pair<ExpressionTreeNode, int> >& temps);
+    std::vector<std::string> variables;
+    std::vector<int> variableIndex;
+    std::vector<int> outputIndex;
+    std::vector<std::vector<int> > arguments;
+    std::vector<int> target;
+    std::vector<Operation*> operation;
+    int numTemps;
+    mutable std::vector<double> workspace;
+    mutable std::vector<double> argValues;
+    std::map<std::string, double> dummyVariables;
+};
+
+} // namespace lepton
+} // namespace PLMD
+
+#endif /*LEPTON_COMPILED_BATCH_EXPRESSION_H_*/
@@ -74,6 +74,7 @@ const std::map<std::string, double> & Constants();
 }
 }
 
+#include "CompiledBatchExpression.h"
 #include "CompiledExpression.h"
 #include "CustomFunction.h"
 #include "ExpressionProgram.h"
@@ -128,7 +128,7 @@ void OuterProduct::performTask( const std::string& controller, const unsigned& i
   if( index2>=getPntrToArgument(0)->getShape()[0] ) ind2 = index2 - getPntrToArgument(0)->getShape()[0];
   if( diagzero && index1==ind2 ) return;
 
-  double fval; unsigned jarg = 0, kelem = index1; bool jstore=stored_vector1;
+  double fval, der[2]; unsigned jarg = 0, kelem = index1; bool jstore=stored_vector1;
   std::vector<double> args(2);
   args[0] = getArgumentElement( 0, index1, myvals );
   args[1] = getArgumentElement( 1, ind2, myvals );
@@ -136,7 +136,9 @@ void OuterProduct::performTask( const std::string& controller, const unsigned& i
     fval=args[0]; if( args[1]<args[0] ) { fval=args[1]; jarg=1; kelem=ind2; jstore=stored_vector2; }
   } else if( domax ) {
     fval=args[0]; if( args[1]>args[0] ) { fval=args[1]; jarg=1; kelem=ind2; jstore=stored_vector2; }
-  } else { fval=function.evaluate( args ); }
+  } else if( doNotCalculateDerivatives() ) {
+    fval=function.evaluate( args );
+  } else { fval=function.evaluateWithDerivatives( args, der ); }
 
   myvals.addValue( ostrn, fval );
   if( doNotCalculateDerivatives() ) return ;
@@ -144,8 +146,8 @@ void OuterProduct::performTask( const std::string& controller, const unsigned& i
   if( domin || domax ) {
     addDerivativeOnVectorArgument( jstore, 0, jarg, kelem, 1.0, myvals );
   } else {
-    addDerivativeOnVectorArgument( stored_vector1, 0, 0, index1, function.evaluateDeriv( 0, args ), myvals );
-    addDerivativeOnVectorArgument( stored_vector2, 0, 1, ind2, function.evaluateDeriv( 1, args ), myvals );
+    addDerivativeOnVectorArgument( stored_vector1, 0, 0, index1, der[0], myvals );
+    addDerivativeOnVectorArgument( stored_vector2, 0, 1, ind2, der[1], myvals );
   }
   if( doNotCalculateDerivatives() || !matrixChainContinues() ) return ;
   unsigned nmat = getConstPntrToComponent(0)->getPositionInMatrixStash(), nmat_ind = myvals.getNumberOfMatrixRowDerivatives( nmat );
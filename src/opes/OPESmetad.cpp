@@ -22,6 +22,10 @@
 #include "tools/Communicator.h"
 #include "tools/File.h"
 #include "tools/OpenMP.h"
+#include "tools/Stopwatch.h"
+
+#include <set>
+#include <unordered_map>
 
 namespace PLMD {
 namespace opes {
@@ -65,6 +69,10 @@ If the system has a basin that is clearly more stable than the others, it is bet
 By default, the kernels SIGMA is adaptive, estimated from the fluctuations over ADAPTIVE_SIGMA_STRIDE simulation steps (similar to \ref METAD ADAPTIVE=DIFF, but contrary to that, no artifacts are introduced and the bias will converge to the correct one).
 However, notice that depending on the system this might not be the optimal choice for SIGMA.
 
+The compressed kernels are stored in a uniform grid of cells whose width is set by the current SIGMA, so that the search for a kernel to merge with, and the update of the neighbor list when NLIST is active, only look at the kernels in the nearby cells.
+The grid is rebuilt when SIGMA changes by more than a factor of two.
+This keeps the cost of each deposition low also in long runs with many kernels, and can be switched off with KERNELS_INDEX_OFF.
+
 You can target a uniform flat distribution by explicitly setting BIASFACTOR=inf.
 However, this should be useful only in very specific cases.
 
@@ -173,6 +181,7 @@ private:
   unsigned rank_;
   unsigned NumWalkers_;
   unsigned walker_rank_;
+  std::unique_ptr<Stopwatch> walkers_stopwatch_; //time spent exchanging kernels
   unsigned long long counter_;
   std::size_t ncv_;
 
@@ -223,6 +232,33 @@ private:
   unsigned nlist_steps_;
   bool nlist_update_;
   bool nlist_pace_reset_;
+//spatial index of the kernel centers, a uniform hash grid in units of sigma
+  struct cellHash
+  {
+    std::size_t operator()(const std::vector<long>& c) const
+    {
+      std::size_t h=0;
+      for(unsigned i=0; i<c.size(); i++)
+        h^=std::hash<long>()(c[i])+0x9e3779b9+(h<<6)+(h>>2);
+      return h;
+    }
+  };
+  bool kindex_;
+  std::vector<double> kindex_sigma_; //the sigma used to build the index
+  std::vector<std::multiset<double>> kindex_sigmas_; //sigmas of the indexed kernels, the last one is the largest
+  std::vector<double> kindex_width_;
+  std::vector<double> kindex_min_;
+  std::vector<long> kindex_ncells_; //number of cells in the period, zero if the CV is not periodic
+  std::unordered_map<std::vector<long>,std::vector<unsigned>,cellHash> kindex_cells_;
+  std::vector<std::vector<long>> kindex_key_; //the cell of each kernel
+  std::vector<unsigned> kindex_pos_; //the position of each kernel in the list of its cell
+  std::vector<std::vector<std::multiset<double>::iterator>> kindex_sigma_it_; //the sigmas of each kernel in kindex_sigmas_
+  void kindexBuild(const std::vector<double>&);
+  void kindexGetCell(const std::vector<double>&,std::vector<long>&) const;
+  void kindexInsert(const unsigned);
+  void kindexRemove(const unsigned);
+  void kindexErase(const unsigned);
+  void kindexGetKernels(const std::vector<double>&,const double,std::vector<unsigned>&) const;
 
   bool calc_work_;
   double work_;
@@ -327,6 +363,7 @@ void OPESmetad<mode>::registerKeywords(Keywords& keys)
   keys.addFlag("NLIST_PACE_RESET",false,"force the reset of the neighbor list at each PACE. Can be useful with WALKERS_MPI");
   keys.addFlag("FIXED_SIGMA",false,"do not decrease sigma as the simulation proceeds. Can be added in a RESTART, to keep in check the number of compressed kernels");
   keys.addFlag("RECURSIVE_MERGE_OFF",false,"do not recursively attempt kernel merging when a new one is added");
+  keys.addFlag("KERNELS_INDEX_OFF",false,"do not use a spatial index of the kernel centers to find merging candidates and to build the neighbor list, scan all the kernels instead");
   keys.addFlag("NO_ZED",false,"do not normalize over the explored CV space, Z_n=1");
 //kernels and state files
   keys.add("compulsory","FILE","KERNELS","a file in which the list of all deposited kernels is stored");
@@ -502,6 +539,9 @@ OPESmetad<mode>::OPESmetad(const ActionOptions& ao)
   bool recursive_merge_off=false;
   parseFlag("RECURSIVE_MERGE_OFF",recursive_merge_off);
   recursive_merge_=!recursive_merge_off;
+  bool kindex_off=false;
+  parseFlag("KERNELS_INDEX_OFF",kindex_off);
+  kindex_=!kindex_off;
   parseFlag("CALC_WORK",calc_work_);
 
 //options involving extra arguments
@@ -900,6 +940,8 @@ OPESmetad<mode>::OPESmetad(const ActionOptions& ao)
     log.printf(" +++ WARNING +++ kernels will never merge, expect slowdowns\n");
   if(!recursive_merge_)
     log.printf(" -- RECURSIVE_MERGE_OFF: only one merge for each new kernel will be attempted. This is faster only if total number of kernels does not grow too much\n");
+  if(!kindex_)
+    log.printf(" -- KERNELS_INDEX_OFF: all kernels will be scanned when looking for merging candidates and neighbors\n");
   if(nlist_)
     log.printf(" -- NLIST: using neighbor list for kernels, with parameters: %g,%g\n",nlist_param_[0],nlist_param_[1]);
   if(nlist_pace_reset_)
@@ -917,6 +959,8 @@ OPESmetad<mode>::OPESmetad(const ActionOptions& ao)
     log.printf("  using multiple walkers\n");
     log.printf("    number of walkers: %u\n",NumWalkers_);
     log.printf("    walker rank: %u\n",walker_rank_);
+    log.printf("    time spent exchanging kernels is reported at the end of the run\n");
+    walkers_stopwatch_=Tools::make_unique<Stopwatch>(log);
   }
   int mw_warning=0;
   if(!walkers_mpi && comm.Get_rank()==0 && multi_sim_comm.Get_size()>(int)NumWalkers_)
@@ -1020,14 +1064,14 @@ void OPESmetad<mode>::update()
     double sum_heights=height;
     double sum_heights2=height*height;
     if(NumWalkers_>1)
-    {
+    { //both sums in a single message
+      auto sw=walkers_stopwatch_->startStop("Walkers exchange");
+      std::vector<double> sums={sum_heights,sum_heights2};
       if(comm.Get_rank()==0)
-      {
-        multi_sim_comm.Sum(sum_heights);
-        multi_sim_comm.Sum(sum_heights2);
-      }
-      comm.Bcast(sum_heights,0);
-      comm.Bcast(sum_heights2,0);
+        multi_sim_comm.Sum(sums);
+      comm.Bcast(sums,0);
+      sum_heights=sums[0];
+      sum_heights2=sums[1];
     }
     counter_+=NumWalkers_;
     sum_weights_+=sum_heights;
@@ -1113,51 +1157,51 @@ void OPESmetad<mode>::update()
       addKernel(height,center,sigma,log_weight);
     else
     {
-      std::vector<double> all_height(NumWalkers_,0.0);
-      std::vector<double> all_center(NumWalkers_*ncv_,0.0);
-      std::vector<double> all_sigma(NumWalkers_*ncv_,0.0);
-      std::vector<double> all_logweight(NumWalkers_,0.0);
-      if(comm.Get_rank()==0)
+      //each walker sends a single record: height, logweight, nlist size, center, sigma
+      const unsigned nrec=3+2*ncv_;
+      std::vector<double> record(nrec);
+      record[0]=height;
+      record[1]=log_weight;
+      record[2]=(nlist_?nlist_index_.size():0);
+      for(unsigned i=0; i<ncv_; i++)
       {
-        multi_sim_comm.Allgather(height,all_height);
-        multi_sim_comm.Allgather(center,all_center);
-        multi_sim_comm.Allgather(sigma,all_sigma);
-        multi_sim_comm.Allgather(log_weight,all_logweight);
+        record[3+i]=center[i];
+        record[3+ncv_+i]=sigma[i];
       }
-      comm.Bcast(all_height,0);
-      comm.Bcast(all_center,0);
-      comm.Bcast(all_sigma,0);
-      comm.Bcast(all_logweight,0);
-      if(nlist_)
-      { //gather all the nlist_index_, so merging can be done using it
-        std::vector<int> all_nlist_size(NumWalkers_);
+      std::vector<double> all_records(NumWalkers_*nrec,0.0);
+      {
+        auto sw=walkers_stopwatch_->startStop("Walkers exchange");
         if(comm.Get_rank()==0)
-        {
-          all_nlist_size[walker_rank_]=nlist_index_.size();
-          multi_sim_comm.Sum(all_nlist_size);
-        }
-        comm.Bcast(all_nlist_size,0);
-        unsigned tot_size=0;
-        for(unsigned w=0; w<NumWalkers_; w++)
-          tot_size+=all_nlist_size[w];
-        if(tot_size>0)
-        {
-          std::vector<int> disp(NumWalkers_);
-          for(unsigned w=0; w<NumWalkers_-1; w++)
-            disp[w+1]=disp[w]+all_nlist_size[w];
-          std::vector<unsigned> all_nlist_index(tot_size);
-          if(comm.Get_rank()==0)
-            multi_sim_comm.Allgatherv(nlist_index_,all_nlist_index,&all_nlist_size[0],&disp[0]);
-          comm.Bcast(all_nlist_index,0);
-          std::set<unsigned> nlist_index_set(all_nlist_index.begin(),all_nlist_index.end()); //remove duplicates and sort
-          nlist_index_.assign(nlist_index_set.begin(),nlist_index_set.end());
+          multi_sim_comm.Allgather(record,all_records);
+        comm.Bcast(all_records,0);
+        if(nlist_)
+        { //gather all the nlist_index_, so merging can be done using it
+          std::vector<int> all_nlist_size(NumWalkers_);
+          for(unsigned w=0; w<NumWalkers_; w++)
+            all_nlist_size[w]=static_cast<int>(all_records[w*nrec+2]);
+          unsigned tot_size=0;
+          for(unsigned w=0; w<NumWalkers_; w++)
+            tot_size+=all_nlist_size[w];
+          if(tot_size>0)
+          {
+            std::vector<int> disp(NumWalkers_);
+            for(unsigned w=0; w<NumWalkers_-1; w++)
+              disp[w+1]=disp[w]+all_nlist_size[w];
+            std::vector<unsigned> all_nlist_index(tot_size);
+            if(comm.Get_rank()==0)
+              multi_sim_comm.Allgatherv(nlist_index_,all_nlist_index,&all_nlist_size[0],&disp[0]);
+            comm.Bcast(all_nlist_index,0);
+            std::set<unsigned> nlist_index_set(all_nlist_index.begin(),all_nlist_index.end()); //remove duplicates and sort
+            nlist_index_.assign(nlist_index_set.begin(),nlist_index_set.end());
+          }
         }
       }
       for(unsigned w=0; w<NumWalkers_; w++)
       {
-        std::vector<double> center_w(all_center.begin()+ncv_*w,all_center.begin()+ncv_*(w+1));
-        std::vector<double> sigma_w(all_sigma.begin()+ncv_*w,all_sigma.begin()+ncv_*(w+1));
-        addKernel(all_height[w],center_w,sigma_w,all_logweight[w]);
+        const double* record_w=&all_records[w*nrec];
+        std::vector<double> center_w(record_w+3,record_w+3+ncv_);
+        std::vector<double> sigma_w(record_w+3+ncv_,record_w+3+2*ncv_);
+        addKernel(record_w[0],center_w,sigma_w,record_w[1]);
       }
     }
     getPntrToComponent("nker")->set(kernels_.size());
@@ -1330,6 +1374,14 @@ double OPESmetad<mode>::getProbAndDerivatives(const std::vector<double>& cv,std:
 template <class mode>
 void OPESmetad<mode>::addKernel(const double height,const std::vector<double>& center,const std::vector<double>& sigma)
 {
+  if(kindex_)
+  { //rebuild the index if the kernels were changed elsewhere or if sigma changed considerably
+    bool rebuild=(kindex_sigma_.size()==0 || kindex_key_.size()!=kernels_.size());
+    for(unsigned i=0; i<ncv_ && !rebuild; i++)
+      rebuild=(sigma[i]<0.5*kindex_sigma_[i] || sigma[i]>2*kindex_sigma_[i]);
+    if(rebuild)
+      kindexBuild(sigma);
+  }
   bool no_match=true;
   if(threshold2_!=0)
   {
@@ -1340,6 +1392,11 @@ void OPESmetad<mode>::addKernel(const double height,const std::vector<double>& c
       delta_kernels_.emplace_back(-1*kernels_[taker_k].height,kernels_[taker_k].center,kernels_[taker_k].sigma);
       mergeKernels(kernels_[taker_k],kernel(height,center,sigma));
       delta_kernels_.push_back(kernels_[taker_k]);
+      if(kindex_)
+      {
+        kindexRemove(taker_k);
+        kindexInsert(taker_k);
+      }
       if(recursive_merge_) //the overhead is worth it if it keeps low the total number of kernels
       {
         unsigned giver_k=taker_k;
@@ -1353,6 +1410,12 @@ void OPESmetad<mode>::addKernel(const double height,const std::vector<double>& c
           mergeKernels(kernels_[taker_k],kernels_[giver_k]);
           delta_kernels_.push_back(kernels_[taker_k]);
           kernels_.erase(kernels_.begin()+giver_k);
+          if(kindex_)
+          {
+            kindexErase(giver_k);
+            kindexRemove(taker_k);
+            kindexInsert(taker_k);
+          }
           if(nlist_)
           {
             unsigned giver_nk=0;
@@ -1380,6 +1443,8 @@ void OPESmetad<mode>::addKernel(const double height,const std::vector<double>& c
   {
     kernels_.emplace_back(height,center,sigma);
     delta_kernels_.emplace_back(height,center,sigma);
+    if(kindex_)
+      kindexInsert(kernels_.size()-1);
     if(nlist_)
       nlist_index_.push_back(kernels_.size()-1);
   }
@@ -1405,6 +1470,31 @@ unsigned OPESmetad<mode>::getMergeableKernel(const std::vector<double>& giver_ce
 { //returns kernels_.size() if no match is found
   unsigned min_k=kernels_.size();
   double min_norm2=threshold2_;
+  if(!nlist_ && kindex_)
+  { //only the kernels in the nearby cells can be merged, every rank checks all of them
+    std::vector<unsigned> candidates;
+    kindexGetKernels(giver_center,std::sqrt(threshold2_),candidates);
+    std::sort(candidates.begin(),candidates.end()); //same order as a full scan
+    for(unsigned k : candidates)
+    {
+      if(k==giver_k) //a kernel should not be merged with itself
+        continue;
+      double norm2=0;
+      for(unsigned i=0; i<ncv_; i++)
+      {
+        const double dist_i=difference(i,giver_center[i],kernels_[k].center[i])/kernels_[k].sigma[i];
+        norm2+=dist_i*dist_i;
+        if(norm2>=min_norm2)
+          break;
+      }
+      if(norm2<min_norm2)
+      {
+        min_norm2=norm2;
+        min_k=k;
+      }
+    }
+    return min_k;
+  }
   if(!nlist_)
   {
     #pragma omp parallel num_threads(NumOMP_)
@@ -1497,7 +1587,26 @@ void OPESmetad<mode>::updateNlist(const std::vector<double>& new_center)
   nlist_center_=new_center;
   nlist_index_.clear();
   //first we gather all the nlist_index
-  if(NumOMP_==1 || (unsigned)kernels_.size()<2*NumOMP_*NumParallel_)
+  if(kindex_)
+  { //every rank looks only at the kernels in the nearby cells
+    if(kindex_key_.size()!=kernels_.size())
+      kindexBuild(kernels_.back().sigma);
+    std::vector<unsigned> candidates;
+    kindexGetKernels(nlist_center_,std::sqrt(nlist_param_[0]*cutoff2_),candidates);
+    for(unsigned k : candidates)
+    {
+      double norm2_k=0;
+      for(unsigned i=0; i<ncv_; i++)
+      {
+        const double dist_ik=difference(i,nlist_center_[i],kernels_[k].center[i])/kernels_[k].sigma[i];
+        norm2_k+=dist_ik*dist_ik;
+      }
+      if(norm2_k<=nlist_param_[0]*cutoff2_)
+        nlist_index_.push_back(k);
+    }
+    std::sort(nlist_index_.begin(),nlist_index_.end());
+  }
+  else if(NumOMP_==1 || (unsigned)kernels_.size()<2*NumOMP_*NumParallel_)
   {
     for(unsigned k=rank_; k<kernels_.size(); k+=NumParallel_)
     {
@@ -1534,7 +1643,7 @@ void OPESmetad<mode>::updateNlist(const std::vector<double>& new_center)
     if(recursive_merge_)
       std::sort(nlist_index_.begin(),nlist_index_.end());
   }
-  if(NumParallel_>1)
+  if(NumParallel_>1 && !kindex_)
   {
     std::vector<int> all_nlist_size(NumParallel_);
     all_nlist_size[rank_]=nlist_index_.size();
@@ -1579,6 +1688,166 @@ void OPESmetad<mode>::updateNlist(const std::vector<double>& new_center)
   nlist_update_=false;
 }
 
+template <class mode>
+void OPESmetad<mode>::kindexBuild(const std::vector<double>& sigma)
+{
+  const double width_factor=(threshold2_>0?std::sqrt(threshold2_):std::sqrt(cutoff2_));
+  kindex_sigma_=sigma;
+  kindex_width_.resize(ncv_);
+  kindex_min_.assign(ncv_,0.);
+  kindex_ncells_.assign(ncv_,0);
+  for(unsigned i=0; i<ncv_; i++)
+  {
+    kindex_width_[i]=width_factor*sigma[i];
+    if(getPntrToArgument(i)->isPeriodic())
+    { //an integer number of cells must fit in the period
+      double max;
+      getPntrToArgument(i)->getDomain(kindex_min_[i],max);
+      const double period=max-kindex_min_[i];
+      kindex_ncells_[i]=std::max(1L,static_cast<long>(std::floor(period/kindex_width_[i])));
+      kindex_width_[i]=period/kindex_ncells_[i];
+    }
+  }
+  kindex_sigmas_.assign(ncv_,std::multiset<double>());
+  kindex_cells_.clear();
+  kindex_key_.clear();
+  kindex_pos_.clear();
+  kindex_sigma_it_.clear();
+  for(unsigned k=0; k<kernels_.size(); k++)
+    kindexInsert(k);
+}
+
+template <class mode>
+void OPESmetad<mode>::kindexGetCell(const std::vector<double>& x,std::vector<long>& cell) const
+{
+  cell.resize(ncv_);
+  for(unsigned i=0; i<ncv_; i++)
+  {
+    cell[i]=static_cast<long>(std::floor((x[i]-kindex_min_[i])/kindex_width_[i]));
+    if(kindex_ncells_[i]>0)
+    {
+      cell[i]%=kindex_ncells_[i];
+      if(cell[i]<0)
+        cell[i]+=kindex_ncells_[i];
+    }
+  }
+}
+
+template <class mode>
+void OPESmetad<mode>::kindexInsert(const unsigned k)
+{
+  if(kindex_key_.size()<=k)
+  {
+    kindex_key_.resize(k+1);
+    kindex_pos_.resize(k+1);
+    kindex_sigma_it_.resize(k+1);
+  }
+  kindexGetCell(kernels_[k].center,kindex_key_[k]);
+  std::vector<unsigned>& list=kindex_cells_[kindex_key_[k]];
+  kindex_pos_[k]=list.size();
+  list.push_back(k);
+  kindex_sigma_it_[k].resize(ncv_);
+  for(unsigned i=0; i<ncv_; i++)
+    kindex_sigma_it_[k][i]=kindex_sigmas_[i].insert(kernels_[k].sigma[i]);
+}
+
+template <class mode>
+void OPESmetad<mode>::kindexRemove(const unsigned k)
+{ //the kernel keeps its slot in kindex_key_, the last kernel of the cell takes its place in the list
+  auto cell=kindex_cells_.find(kindex_key_[k]);
+  plumed_dbg_massert(cell!=kindex_cells_.end(),"kernel not found in the kernels index");
+  std::vector<unsigned>& list=cell->second;
+  plumed_dbg_massert(list[kindex_pos_[k]]==k,"kernel not found in its cell of the kernels index");
+  const unsigned last=list.back();
+  list[kindex_pos_[k]]=last;
+  kindex_pos_[last]=kindex_pos_[k];
+  list.pop_back();
+  if(list.empty())
+    kindex_cells_.erase(cell);
+  //the sigmas stored at insertion are removed, so the search radius shrinks when the widest kernels are merged away
+  for(unsigned i=0; i<ncv_; i++)
+    kindex_sigmas_[i].erase(kindex_sigma_it_[k][i]);
+}
+
+template <class mode>
+void OPESmetad<mode>::kindexErase(const unsigned k)
+{ //to be called after kernels_.erase(), all the following kernels are shifted by one
+  kindexRemove(k);
+  kindex_key_.erase(kindex_key_.begin()+k);
+  kindex_pos_.erase(kindex_pos_.begin()+k);
+  kindex_sigma_it_.erase(kindex_sigma_it_.begin()+k);
+  for(auto& cell : kindex_cells_)
+    for(auto& kk : cell.second)
+      if(kk>k)
+        kk--;
+}
+
+template <class mode>
+void OPESmetad<mode>::kindexGetKernels(const std::vector<double>& center,const double radius,std::vector<unsigned>& candidates) const
+{ //returns all the kernels that might be within radius, in units of their own sigma
+  candidates.clear();
+  if(kindex_cells_.empty())
+    return;
+  std::vector<long> cell;
+  kindexGetCell(center,cell);
+  std::vector<std::vector<long>> ranges(ncv_);
+  double ncells=1;
+  for(unsigned i=0; i<ncv_; i++)
+  {
+    const double max_sigma=(kindex_sigmas_[i].empty()?0.:*kindex_sigmas_[i].rbegin());
+    const long r=static_cast<long>(std::floor(radius*max_sigma/kindex_width_[i]))+1;
+    if(kindex_ncells_[i]>0 && 2*r+1>=kindex_ncells_[i])
+    {
+      for(long c=0; c<kindex_ncells_[i]; c++)
+        ranges[i].push_back(c);
+    }
+    else
+    {
+      for(long c=cell[i]-r; c<=cell[i]+r; c++)
+        ranges[i].push_back(kindex_ncells_[i]>0?(c+kindex_ncells_[i])%kindex_ncells_[i]:c);
+    }
+    ncells*=ranges[i].size();
+  }
+  if(ncells>=kindex_cells_.size())
+  { //visiting the occupied cells is cheaper
+    for(const auto& c : kindex_cells_)
+    {
+      bool inside=true;
+      for(unsigned i=0; i<ncv_ && inside; i++)
+      {
+        if(kindex_ncells_[i]>0 && (long)ranges[i].size()==kindex_ncells_[i])
+          continue;
+        const long first=ranges[i].front();
+        long dc=c.first[i]-first;
+        if(kindex_ncells_[i]>0)
+          dc=(dc%kindex_ncells_[i]+kindex_ncells_[i])%kindex_ncells_[i];
+        inside=(dc>=0 && dc<(long)ranges[i].size());
+      }
+      if(inside)
+        candidates.insert(candidates.end(),c.second.begin(),c.second.end());
+    }
+    return;
+  }
+  std::vector<unsigned> counter(ncv_,0);
+  while(true)
+  {
+    for(unsigned i=0; i<ncv_; i++)
+      cell[i]=ranges[i][counter[i]];
+    auto c=kindex_cells_.find(cell);
+    if(c!=kindex_cells_.end())
+      candidates.insert(candidates.end(),c->second.begin(),c->second.end());
+    unsigned i=0;
+    for(; i<ncv_; i++)
+    {
+      if(++counter[i]<ranges[i].size())
+        break;
+      counter[i]=0;
+    }
+    if(i==ncv_)
+      break;
+  }
+}
+
 template <class mode>
 void OPESmetad<mode>::dumpStateToFile()
 {
@@ -28,6 +28,7 @@ along with plumed.  If not, see <http://www.gnu.org/licenses/>.
 #include <torch/torch.h>
 #include <torch/script.h>
 
+#include <algorithm>
 #include <fstream>
 #include <cmath>
 
@@ -57,6 +58,10 @@ This can be a function defined in Python or a more complex model, such as a neur
 
 By default it is assumed that the model is saved as: `model.ptc`, unless otherwise indicated by the `FILE` keyword. The function automatically checks for the number of output dimensions and creates a component for each of them. The outputs are called node-i with i between 0 and N-1 for N outputs.
 
+The arguments can also be vectors with the same number of elements. In this case the model is evaluated on all the elements in a single call, each element being a separate row of the batch of inputs, and the outputs are vectors with the same number of elements as the arguments. This makes it possible to evaluate a model for many atoms or for many stored frames at once.
+
+With vector arguments the derivatives of all the outputs are obtained with a single backward pass, in which the batch of inputs is replicated once for each output. The buffers used for the inputs are kept from one step to the next. When derivatives are not needed (e.g. when running \ref driver without forces) the model is evaluated without recording the operations for autograd. With scalar arguments the model is evaluated on a single row of inputs, with a backward pass for each output, as replicating a single row gives no gain.
+
 Note that this function requires \ref installation-libtorch LibTorch C++ library. Check the instructions in the \ref PYTORCH page to enable the module.
 
 \par Examples
@@ -70,6 +75,16 @@ model: PYTORCH_MODEL FILE=torch_model.ptc ARG=phi,psi
 PRINT FILE=COLVAR ARG=model.node-0,model.node-1
 \endplumedfile
 
+The same model can be evaluated on the dihedral angles of many residues at once by passing vectors as arguments.
+In this case each output component is a vector with one element for each pair of dihedrals.
+
+\plumedfile
+#SETTINGS AUXFILE=regtest/pytorch/rt-pytorch_model_2d/torch_model.ptc
+phi: TORSION ATOMS1=5,7,9,15 ATOMS2=15,17,19,25
+psi: TORSION ATOMS1=7,9,15,17 ATOMS2=17,19,25,27
+model: PYTORCH_MODEL FILE=torch_model.ptc ARG=phi,psi
+\endplumedfile
+
 */
 //+ENDPLUMEDOC
 
@@ -81,10 +96,26 @@ class PytorchModel :
   unsigned _n_out;
   torch::jit::script::Module _model;
   torch::Device device = torch::kCPU;
+// are the arguments vectors whose elements are evaluated as a batch
+  bool _batched;
+// number of elements in the batch
+  unsigned _n_batch;
+// inputs, replicated once for each output: row j*_n_batch+i contains the input of element i
+  torch::Tensor _input;
+// identity batch used to get the derivatives of all the outputs in one backward pass
+  torch::Tensor _grad_outputs;
+// derivatives of output j of element i with respect to the inputs are in row j*_n_batch+i
+  torch::Tensor _jacobian;
+// resize the persistent buffers for a batch of nbatch elements
+  void resizeBuffers(unsigned nbatch);
+// evaluate the model on a single row of scalar arguments, with one backward pass for each output
+  void calculateSingle();
 
 public:
   explicit PytorchModel(const ActionOptions&);
-  void calculate();
+  void prepare() override;
+  void calculate() override;
+  void apply() override;
   static void registerKeywords(Keywords& keys);
 
   std::vector<float> tensor_to_vector(const torch::Tensor& x);
@@ -94,6 +125,7 @@ PLUMED_REGISTER_ACTION(PytorchModel,"PYTORCH_MODEL")
 
 void PytorchModel::registerKeywords(Keywords& keys) {
   Function::registerKeywords(keys);
+  keys.addInputKeyword("compulsory","ARG","scalar/vector","the labels of the values from which the function is calculated");
   keys.add("optional","FILE","Filename of the PyTorch compiled model");
   keys.addOutputComponent("node", "default", "Model outputs");
 }
@@ -105,7 +137,9 @@ std::vector<float> PytorchModel::tensor_to_vector(const torch::Tensor& x) {
 
 PytorchModel::PytorchModel(const ActionOptions&ao):
   Action(ao),
-  Function(ao)
+  Function(ao),
+  _batched(false),
+  _n_batch(0)
 {
   // print libtorch version
   std::stringstream ss;
@@ -117,6 +151,18 @@ PytorchModel::PytorchModel(const ActionOptions&ao):
   //number of inputs of the model
   _n_in=getNumberOfArguments();
 
+  //check if the model is evaluated on a batch of vector elements
+  _batched=(getPntrToArgument(0)->getRank()==1);
+  for(unsigned i=0; i<_n_in; i++) {
+    Value* arg=getPntrToArgument(i);
+    if( arg->getRank()>1 || arg->hasDerivatives() ) error("arguments should be scalars or vectors");
+    if( (arg->getRank()==1)!=_batched ) error("arguments should be either all scalars or all vectors");
+    if( _batched ) {
+      if( arg->getShape()[0]!=getPntrToArgument(0)->getShape()[0] ) error("all the vectors in input should have the same number of elements");
+      arg->buildDataStore();
+    }
+  }
+
   //parse model name
   std::string fname="model.ptc";
   parse("FILE",fname);
@@ -178,15 +224,21 @@ PytorchModel::PytorchModel(const ActionOptions&ao):
   _n_out=cvs.size();
 
   //create components
+  std::vector<unsigned> shape;
+  if( _batched ) shape.push_back( getPntrToArgument(0)->getShape()[0] );
   for(unsigned j=0; j<_n_out; j++) {
     string name_comp = "node-"+std::to_string(j);
-    addComponentWithDerivatives( name_comp );
+    if( _batched ) {
+      addComponent( name_comp, shape );
+      getPntrToComponent(j)->buildDataStore();
+    } else addComponentWithDerivatives( name_comp );
     componentIsNotPeriodic( name_comp );
   }
 
   //print log
   log.printf("  Number of input: %d \n",_n_in);
   log.printf("  Number of outputs: %d \n",_n_out);
+  if( _batched ) log.printf("  Evaluating the model on the %d elements of the input vectors as a batch\n",getPntrToArgument(0)->getShape()[0]);
   log.printf("  Bibliography: ");
   log<<plumed.cite("Bonati, Trizio, Rizzi and Parrinello, J. Chem. Phys. 159, 014801 (2023)");
   log<<plumed.cite("Bonati, Rizzi and Parrinello, J. Phys. Chem. Lett. 11, 2998-3004 (2020)");
@@ -195,7 +247,71 @@ PytorchModel::PytorchModel(const ActionOptions&ao):
 }
 
 
+void PytorchModel::resizeBuffers(unsigned nbatch) {
+  if( _input.defined() && nbatch==_n_batch ) return;
+  _n_batch=nbatch;
+  _input = torch::zeros({_n_out*_n_batch,_n_in},torch::kFloat32);
+  _grad_outputs = torch::eye(_n_out,torch::kFloat32).repeat_interleave(_n_batch,0).to(device);
+}
+
+void PytorchModel::prepare() {
+  if( !_batched ) return;
+  std::vector<unsigned> shape(1,getPntrToArgument(0)->getShape()[0]);
+  for(unsigned j=0; j<_n_out; j++) {
+    if( getPntrToComponent(j)->getShape()[0]!=shape[0] ) getPntrToComponent(j)->setShape(shape);
+  }
+}
+
 void PytorchModel::calculate() {
+  if( !_batched ) { calculateSingle(); return; }
+  unsigned nbatch = getPntrToArgument(0)->getShape()[0];
+  if( nbatch==0 ) return;
+  resizeBuffers(nbatch);
+
+  // retrieve arguments, element i of argument k is in row i and column k
+  float* in = _input.data_ptr<float>();
+  for(unsigned k=0; k<_n_in; k++) {
+    Value* arg=getPntrToArgument(k);
+    for(unsigned i=0; i<_n_batch; i++) in[i*_n_in+k] = arg->get(i);
+  }
+
+  torch::Tensor output;
+  if( doNotCalculateDerivatives() ) {
+    // without derivatives only the first copy of the inputs is needed
+#if (TORCH_VERSION_MAJOR == 2 || TORCH_VERSION_MAJOR == 1 && TORCH_VERSION_MINOR >= 9)
+    c10::InferenceMode guard;
+#else
+    torch::NoGradGuard guard;
+#endif
+    std::vector<torch::jit::IValue> inputs;
+    inputs.push_back( _input.narrow(0,0,_n_batch).to(device) );
+    output = _model.forward( inputs ).toTensor().to(torch::kCPU).contiguous();
+  } else {
+    // replicate the inputs for the other outputs
+    for(unsigned j=1; j<_n_out; j++) std::copy( in, in+_n_batch*_n_in, in+j*_n_batch*_n_in );
+    torch::Tensor input_S = _input.to(device).detach().requires_grad_(true);
+    std::vector<torch::jit::IValue> inputs;
+    inputs.push_back( input_S );
+    torch::Tensor replicated_output = _model.forward( inputs ).toTensor();
+    // copy j of the outputs is multiplied by the j-th row of the identity, so that
+    // its gradient contains the derivatives of output j
+    _jacobian = torch::autograd::grad({replicated_output},
+    {input_S},
+    /*grad_outputs=*/ {_grad_outputs},
+    /*retain_graph=*/false,
+    /*create_graph=*/false)[0].to(torch::kCPU).contiguous();
+    output = replicated_output.narrow(0,0,_n_batch).detach().to(torch::kCPU).contiguous();
+  }
+
+  //set CV values, the derivatives are used in apply
+  const float* cvs = output.data_ptr<float>();
+  for(unsigned j=0; j<_n_out; j++) {
+    Value* comp=getPntrToComponent(j);
+    for(unsigned i=0; i<_n_batch; i++) comp->set(i,cvs[i*_n_out+j]);
+  }
+}
+
+void PytorchModel::calculateSingle() {
 
   // retrieve arguments
   vector<float> current_S(_n_in);
@@ -220,19 +336,38 @@ void PytorchModel::calculate() {
     /*create_graph=*/false)[0]; // the [0] is to get a tensor and not a vector<at::tensor>
 
     vector<float> der = this->tensor_to_vector ( gradient );
-    string name_comp = "node-"+std::to_string(j);
     //set derivatives of component j
     for(unsigned i=0; i<_n_in; i++)
-      setDerivative( getPntrToComponent(name_comp),i, der[i] );
+      setDerivative( getPntrToComponent(j),i, der[i] );
   }
 
   //set CV values
   vector<float> cvs = this->tensor_to_vector (output);
+  for(unsigned j=0; j<_n_out; j++)
+    getPntrToComponent(j)->set(cvs[j]);
+
+}
+
+void PytorchModel::apply() {
+  if( !_batched ) { Function::apply(); return; }
+  if( doNotCalculateDerivatives() || !_jacobian.defined() ) return;
+
+  bool forces=false;
   for(unsigned j=0; j<_n_out; j++) {
-    string name_comp = "node-"+std::to_string(j);
-    getPntrToComponent(name_comp)->set(cvs[j]);
+    if( getPntrToComponent(j)->forcesWereAdded() ) { forces=true; break; }
+  }
+  if( !forces ) return;
+
+  // chain rule for each element of the batch
+  const float* der = _jacobian.data_ptr<float>();
+  for(unsigned k=0; k<_n_in; k++) {
+    Value* arg=getPntrToArgument(k);
+    for(unsigned i=0; i<_n_batch; i++) {
+      double f=0;
+      for(unsigned j=0; j<_n_out; j++) f += getPntrToComponent(j)->getForce(i)*der[(j*_n_batch+i)*_n_in+k];
+      arg->addForce( i, f );
+    }
   }
-
 }
 
 
@@ -123,7 +123,7 @@ void ThreeBodyGFunctions::performTask( const unsigned& task_index, MultiValue& m
   const Value* yval = getPntrToArgument(1);
   const Value* zval = getPntrToArgument(2);
   Angle angle; Vector disti, distj; unsigned matsize = wval->getNumberOfValues();
-  std::vector<double> values(4); std::vector<Vector> der_i(4), der_j(4);
+  std::vector<double> values(4), fder(4); std::vector<Vector> der_i(4), der_j(4);
   unsigned nbonds = wval->getRowLength( task_index ), ncols = wval->getShape()[1];
   for(unsigned i=0; i<nbonds; ++i) {
     unsigned ipos = ncols*task_index + wval->getRowIndex( task_index, i );
@@ -150,11 +150,13 @@ void ThreeBodyGFunctions::performTask( const unsigned& task_index, MultiValue& m
       // Now compute all symmetry functions
       for(unsigned n=0; n<functions.size(); ++n) {
         unsigned ostrn = getConstPntrToComponent(n)->getPositionInStream();
-        double nonweight = functions[n].evaluate( values ); myvals.addValue( ostrn, nonweight*weightij );
-        if( doNotCalculateDerivatives() ) continue;
+        if( doNotCalculateDerivatives() ) {
+          myvals.addValue( ostrn, functions[n].evaluate( values )*weightij ); continue;
+        }
+        double nonweight = functions[n].evaluateWithDerivatives( values, fder.data() ); myvals.addValue( ostrn, nonweight*weightij );
 
         for(unsigned m=0; m<functions[n].getNumberOfArguments(); ++m) {
-          double der = weightij*functions[n].evaluateDeriv( m, values );
+          double der = weightij*fder[m];
           myvals.addDerivative( ostrn, ipos, der*der_i[m][0] );
           myvals.addDerivative( ostrn, matsize+ipos, der*der_i[m][1] );
           myvals.addDerivative( ostrn, 2*matsize+ipos, der*der_i[m][2] );
@@ -26,11 +26,16 @@
 #include "KernelFunctions.h"
 #include "File.h"
 #include "Grid.h"
+#include "OpenMP.h"
+#include <algorithm>
 
 namespace PLMD {
 
+/// kernels are added to a dense grid in parallel in batches of this size
+static const std::size_t depositBatchSize=1024;
+
 /// the constructor here
-BiasRepresentation::BiasRepresentation(const std::vector<Value*> & tmpvalues, Communicator &cc ):hasgrid(false),rescaledToBias(false),mycomm(cc) {
+BiasRepresentation::BiasRepresentation(const std::vector<Value*> & tmpvalues, Communicator &cc ):hasgrid(false),rescaledToBias(false),mycomm(cc),ndeposited(0) {
   lowI_=0.0;
   uppI_=0.0;
   doInt_=false;
@@ -43,7 +48,7 @@ BiasRepresentation::BiasRepresentation(const std::vector<Value*> & tmpvalues, Co
 
 /// overload the constructor: add the sigma  at constructor time
 BiasRepresentation::BiasRepresentation(const std::vector<Value*> & tmpvalues, Communicator &cc, const std::vector<double> & sigma ):
-  hasgrid(false), rescaledToBias(false), histosigma(sigma),mycomm(cc)
+  hasgrid(false), rescaledToBias(false), histosigma(sigma),mycomm(cc),ndeposited(0)
 {
   lowI_=0.0;
   uppI_=0.0;
@@ -57,8 +62,8 @@ BiasRepresentation::BiasRepresentation(const std::vector<Value*> & tmpvalues, Co
 
 /// overload the constructor: add the grid at constructor time
 BiasRepresentation::BiasRepresentation(const std::vector<Value*> & tmpvalues, Communicator &cc, const std::vector<std::string> & gmin, const std::vector<std::string> & gmax,
-                                       const std::vector<unsigned> & nbin, bool doInt, double lowI, double uppI):
-  hasgrid(false), rescaledToBias(false), mycomm(cc)
+                                       const std::vector<unsigned> & nbin, bool doInt, double lowI, double uppI, bool blockgrid):
+  hasgrid(false), rescaledToBias(false), mycomm(cc), ndeposited(0)
 {
   ndim=tmpvalues.size();
   for(int i=0; i<ndim; i++) {
@@ -69,13 +74,13 @@ BiasRepresentation::BiasRepresentation(const std::vector<Value*> & tmpvalues, Co
   lowI_=lowI;
   uppI_=uppI;
   // initialize the grid
-  addGrid(gmin,gmax,nbin);
+  addGrid(gmin,gmax,nbin,blockgrid);
 }
 
 /// overload the constructor with some external sigmas: needed for histogram
 BiasRepresentation::BiasRepresentation(const std::vector<Value*> & tmpvalues, Communicator &cc, const std::vector<std::string> & gmin, const std::vector<std::string> & gmax,
                                        const std::vector<unsigned> & nbin, const std::vector<double> & sigma):
-  hasgrid(false), rescaledToBias(false),histosigma(sigma),mycomm(cc)
+  hasgrid(false), rescaledToBias(false),histosigma(sigma),mycomm(cc),ndeposited(0)
 {
   lowI_=0.0;
   uppI_=0.0;
@@ -89,12 +94,13 @@ BiasRepresentation::BiasRepresentation(const std::vector<Value*> & tmpvalues, Co
   addGrid(gmin,gmax,nbin);
 }
 
-void BiasRepresentation::addGrid(const std::vector<std::string> & gmin, const std::vector<std::string> & gmax, const std::vector<unsigned> & nbin ) {
+void BiasRepresentation::addGrid(const std::vector<std::string> & gmin, const std::vector<std::string> & gmax, const std::vector<unsigned> & nbin, bool blockgrid ) {
   plumed_massert(hills.size()==0,"you can set the grid before loading the hills");
   plumed_massert(hasgrid==false,"to build the grid you should not having the grid in this bias representation");
   std::string ss; ss="file.free";
   std::vector<Value*> vv; for(unsigned i=0; i<values.size(); i++) vv.push_back(values[i]);
-  BiasGrid_=Tools::make_unique<Grid>(ss,vv,gmin,gmax,nbin,false,true);
+  if(blockgrid) BiasGrid_=Tools::make_unique<BlockGrid>(ss,vv,gmin,gmax,nbin,false,true);
+  else BiasGrid_=Tools::make_unique<Grid>(ss,vv,gmin,gmax,nbin,false,true);
   hasgrid=true;
 }
 
@@ -171,64 +177,150 @@ void BiasRepresentation::pushKernel( IFile *ifile ) {
       plumed_massert(maxi==maxv,"the input periodicity in hills and in value definition does not match"  );
     }
   }
+  hills.emplace_back(std::move(kk));
   // if grid is defined then it should be added on the grid
-  //cerr<<"now with "<<hills.size()<<endl;
   if(hasgrid) {
+    // on a dense grid with a single process the kernels are added in batches,
+    // which are split among the threads
+    if(mycomm.Get_size()==1 && dynamic_cast<Grid*>(BiasGrid_.get())) {
+      if(hills.size()-ndeposited>=depositBatchSize) depositKernels();
+    } else {
+      depositKernel(hills.size()-1);
+      ndeposited=hills.size();
+    }
+  }
+}
+
+void BiasRepresentation::depositKernel(std::size_t k) {
+  const auto & kk=hills[k];
+  std::vector<unsigned> nneighb;
+  if(doInt_&&(kk->getCenter()[0]+kk->getContinuousSupport()[0] > uppI_ || kk->getCenter()[0]-kk->getContinuousSupport()[0] < lowI_ )) {
+    nneighb=BiasGrid_->getNbin();
+  } else nneighb=kk->getSupport(BiasGrid_->getDx());
+  std::vector<Grid::index_t> neighbors=BiasGrid_->getNeighbors(kk->getCenter(),nneighb);
+  std::vector<double> der(ndim);
+  std::vector<double> xx(ndim);
+  const double f=(biasf[k]-1.)/(biasf[k]);
+  if(mycomm.Get_size()==1) {
+    for(unsigned i=0; i<neighbors.size(); ++i) {
+      Grid::index_t ineigh=neighbors[i];
+      for(int j=0; j<ndim; ++j) {der[j]=0.0;}
+      BiasGrid_->getPoint(ineigh,xx);
+      // assign xx to a new vector of values
+      for(int j=0; j<ndim; ++j) {values[j]->set(xx[j]);}
+      double bias;
+      if(doInt_) bias=kk->evaluate(values,der,true,doInt_,lowI_,uppI_);
+      else bias=kk->evaluate(values,der,true);
+      if(rescaledToBias) {
+        bias*=f;
+        for(int j=0; j<ndim; ++j) {der[j]*=f;}
+      }
+      BiasGrid_->addValueAndDerivatives(ineigh,bias,der);
+    }
+  } else {
+    unsigned stride=mycomm.Get_size();
+    unsigned rank=mycomm.Get_rank();
+    std::vector<double> allder(ndim*neighbors.size(),0.0);
+    std::vector<double> allbias(neighbors.size(),0.0);
+    for(unsigned i=rank; i<neighbors.size(); i+=stride) {
+      Grid::index_t ineigh=neighbors[i];
+      BiasGrid_->getPoint(ineigh,xx);
+      for(int j=0; j<ndim; ++j) {values[j]->set(xx[j]);}
+      if(doInt_) allbias[i]=kk->evaluate(values,der,true,doInt_,lowI_,uppI_);
+      else allbias[i]=kk->evaluate(values,der,true);
+      if(rescaledToBias) {
+        allbias[i]*=f;
+        for(int j=0; j<ndim; ++j) {der[j]*=f;}
+      }
+      for(int j=0; j<ndim; ++j) allder[ndim*i+j]=der[j];
+    }
+    mycomm.Sum(allbias);
+    mycomm.Sum(allder);
+    for(unsigned i=0; i<neighbors.size(); ++i) {
+      Grid::index_t ineigh=neighbors[i];
+      for(int j=0; j<ndim; ++j) {der[j]=allder[ndim*i+j];}
+      BiasGrid_->addValueAndDerivatives(ineigh,allbias[i],der);
+    }
+  }
+}
+
+void BiasRepresentation::depositKernels() {
+  if(!hasgrid || ndeposited==hills.size()) return;
+  if(mycomm.Get_size()==1 && dynamic_cast<Grid*>(BiasGrid_.get())) depositKernelsInParallel();
+  else for(std::size_t k=ndeposited; k<hills.size(); k++) depositKernel(k);
+  ndeposited=hills.size();
+}
+
+void BiasRepresentation::depositKernelsInParallel() {
+  // The grid is split in contiguous tiles of points, and each tile is updated by a single thread.
+  // Within a tile the kernels are added in the order in which they were read,
+  // so that the result is identical to the one obtained adding them one at a time.
+  Grid* grid=dynamic_cast<Grid*>(BiasGrid_.get());
+  const std::size_t nkernels=hills.size()-ndeposited;
+  unsigned nt=OpenMP::getNumThreads();
+  const Grid::index_t gridsize=grid->getSize();
+  const Grid::index_t ntiles=std::max<Grid::index_t>(1,std::min<Grid::index_t>(gridsize,8*nt));
+  const Grid::index_t tilesize=(gridsize+ntiles-1)/ntiles;
+  // grid points close to a kernel, these are computed again where needed rather than stored for all the kernels
+  auto getKernelNeighbors=[&](std::size_t k) {
+    const auto & kk=hills[ndeposited+k];
     std::vector<unsigned> nneighb;
     if(doInt_&&(kk->getCenter()[0]+kk->getContinuousSupport()[0] > uppI_ || kk->getCenter()[0]-kk->getContinuousSupport()[0] < lowI_ )) {
-      nneighb=BiasGrid_->getNbin();
-    } else nneighb=kk->getSupport(BiasGrid_->getDx());
-    std::vector<Grid::index_t> neighbors=BiasGrid_->getNeighbors(kk->getCenter(),nneighb);
+      nneighb=grid->getNbin();
+    } else nneighb=kk->getSupport(grid->getDx());
+    return grid->getNeighbors(kk->getCenter(),nneighb);
+  };
+  // tiles that contain the grid points close to each kernel
+  std::vector<std::vector<Grid::index_t>> tiles(nkernels);
+  #pragma omp parallel for num_threads(nt)
+  for(std::size_t k=0; k<nkernels; k++) {
+    for(const auto & ineigh : getKernelNeighbors(k)) tiles[k].push_back(ineigh/tilesize);
+    std::sort(tiles[k].begin(),tiles[k].end());
+    tiles[k].erase(std::unique(tiles[k].begin(),tiles[k].end()),tiles[k].end());
+  }
+  // kernels touching each tile, in the order in which they were read
+  std::vector<std::vector<std::size_t>> tileKernels(ntiles);
+  for(std::size_t k=0; k<nkernels; k++) for(const auto & t : tiles[k]) tileKernels[t].push_back(k);
+
+  #pragma omp parallel num_threads(nt)
+  {
+    // the kernels are evaluated on private copies of the values
+    std::vector<std::unique_ptr<Value>> myvalues(ndim);
+    std::vector<Value*> vv(ndim);
+    for(int j=0; j<ndim; ++j) {
+      myvalues[j]=Tools::make_unique<Value>(values[j]->getName());
+      if(values[j]->isPeriodic()) {
+        std::string min,max; values[j]->getDomain(min,max);
+        myvalues[j]->setDomain(min,max);
+      } else myvalues[j]->setNotPeriodic();
+      vv[j]=myvalues[j].get();
+    }
     std::vector<double> der(ndim);
     std::vector<double> xx(ndim);
-    if(mycomm.Get_size()==1) {
-      for(unsigned i=0; i<neighbors.size(); ++i) {
-        Grid::index_t ineigh=neighbors[i];
-        for(int j=0; j<ndim; ++j) {der[j]=0.0;}
-        BiasGrid_->getPoint(ineigh,xx);
-        // assign xx to a new vector of values
-        for(int j=0; j<ndim; ++j) {values[j]->set(xx[j]);}
-        double bias;
-        if(doInt_) bias=kk->evaluate(values,der,true,doInt_,lowI_,uppI_);
-        else bias=kk->evaluate(values,der,true);
-        if(rescaledToBias) {
-          double f=(biasf.back()-1.)/(biasf.back());
-          bias*=f;
-          for(int j=0; j<ndim; ++j) {der[j]*=f;}
+    #pragma omp for schedule(dynamic,1)
+    for(Grid::index_t t=0; t<ntiles; t++) {
+      const Grid::index_t tmin=t*tilesize;
+      const Grid::index_t tmax=tmin+tilesize;
+      for(const auto & k : tileKernels[t]) {
+        const auto & kk=hills[ndeposited+k];
+        const double f=(biasf[ndeposited+k]-1.)/(biasf[ndeposited+k]);
+        for(const auto & ineigh : getKernelNeighbors(k)) {
+          if(ineigh<tmin || ineigh>=tmax) continue;
+          for(int j=0; j<ndim; ++j) {der[j]=0.0;}
+          grid->getPoint(ineigh,xx);
+          for(int j=0; j<ndim; ++j) {vv[j]->set(xx[j]);}
+          double bias;
+          if(doInt_) bias=kk->evaluate(vv,der,true,doInt_,lowI_,uppI_);
+          else bias=kk->evaluate(vv,der,true);
+          if(rescaledToBias) {
+            bias*=f;
+            for(int j=0; j<ndim; ++j) {der[j]*=f;}
+          }
+          grid->addValueAndDerivatives(ineigh,bias,der);
         }
-        BiasGrid_->addValueAndDerivatives(ineigh,bias,der);
-      }
-    } else {
-      unsigned stride=mycomm.Get_size();
-      unsigned rank=mycomm.Get_rank();
-      std::vector<double> allder(ndim*neighbors.size(),0.0);
-      std::vector<double> allbias(neighbors.size(),0.0);
-      std::vector<double> tmpder(ndim);
-      for(unsigned i=rank; i<neighbors.size(); i+=stride) {
-        Grid::index_t ineigh=neighbors[i];
-        BiasGrid_->getPoint(ineigh,xx);
-        for(int j=0; j<ndim; ++j) {values[j]->set(xx[j]);}
-        if(doInt_) allbias[i]=kk->evaluate(values,der,true,doInt_,lowI_,uppI_);
-        else allbias[i]=kk->evaluate(values,der,true);
-        if(rescaledToBias) {
-          double f=(biasf.back()-1.)/(biasf.back());
-          allbias[i]*=f;
-          for(int j=0; j<ndim; ++j) {tmpder[j]*=f;}
-        }
-        // this solution with the temporary vector is rather bad, probably better to take
-        // a pointer of double as it was in old gaussian
-        for(int j=0; j<ndim; ++j) { allder[ndim*i+j]=tmpder[j]; tmpder[j]=0.;}
-      }
-      mycomm.Sum(allbias);
-      mycomm.Sum(allder);
-      for(unsigned i=0; i<neighbors.size(); ++i) {
-        Grid::index_t ineigh=neighbors[i];
-        for(int j=0; j<ndim; ++j) {der[j]=allder[ndim*i+j];}
-        BiasGrid_->addValueAndDerivatives(ineigh,allbias[i],der);
       }
     }
   }
-  hills.emplace_back(std::move(kk));
 }
 
 int BiasRepresentation::getNumberOfKernels() {
@@ -237,6 +329,15 @@ int BiasRepresentation::getNumberOfKernels() {
 
 Grid* BiasRepresentation::getGridPtr() {
   plumed_massert(hasgrid,"if you want the grid pointer then you should have defined a grid before");
+  depositKernels();
+  Grid* grid=dynamic_cast<Grid*>(BiasGrid_.get());
+  plumed_massert(grid,"this bias representation does not use a dense grid");
+  return grid;
+}
+
+GridBase* BiasRepresentation::getGridBasePtr() {
+  plumed_massert(hasgrid,"if you want the grid pointer then you should have defined a grid before");
+  depositKernels();
   return BiasGrid_.get();
 }
 
@@ -277,6 +378,8 @@ void BiasRepresentation::getMinMaxBin(std::vector<double> &vmin, std::vector<dou
 
 void BiasRepresentation::clear() {
   hills.clear();
+  biasf.clear();
+  ndeposited=0;
   // clear the grid
   if(hasgrid) {
     BiasGrid_->clear();
@@ -29,6 +29,7 @@
 namespace PLMD {
 
 class Value;
+class GridBase;
 class Grid;
 class IFile;
 class KernelFunctions;
@@ -52,13 +53,13 @@ public:
   BiasRepresentation(const std::vector<Value*> & tmpvalues, Communicator &cc,  const std::vector<double> & sigma);
   /// create a bias containing a grid representation
   BiasRepresentation(const std::vector<Value*> & tmpvalues, Communicator &cc, const std::vector<std::string> &  gmin, const std::vector<std::string> & gmax,
-                     const std::vector<unsigned> & nbin, bool doInt, double lowI_, double uppI_);
+                     const std::vector<unsigned> & nbin, bool doInt, double lowI_, double uppI_, bool blockgrid=false);
   /// create a histogram with grid representation and sigmas in input
   BiasRepresentation(const std::vector<Value*> & tmpvalues, Communicator &cc, const std::vector<std::string> & gmin, const std::vector<std::string> & gmax, const std::vector<unsigned> & nbin, const std::vector<double> & sigma);
   /// retrieve the number of dimension of the representation
   unsigned 	getNumberOfDimensions();
   /// add the grid to the representation
-  void 		addGrid(const std::vector<std::string> & gmin, const std::vector<std::string> & gmax, const std::vector<unsigned> & nbin );
+  void 		addGrid(const std::vector<std::string> & gmin, const std::vector<std::string> & gmax, const std::vector<unsigned> & nbin, bool blockgrid=false );
   /// push a kernel on the representation (includes widths and height)
   void 		pushKernel( IFile * ff);
   /// set the flag that rescales the free energy to the bias
@@ -77,8 +78,12 @@ public:
   const std::string & getName(unsigned i);
   /// get a pointer to a specific value
   Value* 	getPtrToValue(unsigned i);
-  /// get the pointer to the grid
+  /// add to the grid the kernels that have been pushed but not deposited yet
+  void 		depositKernels();
+  /// get the pointer to the grid, this can be used only if the grid is dense
   Grid* 	getGridPtr();
+  /// get the pointer to the grid, whatever its kind
+  GridBase* 	getGridBasePtr();
   /// get a new histogram point from a file
   std::unique_ptr<KernelFunctions> readFromPoint(IFile *ifile);
   /// get an automatic min/max from the set so to know how to configure the grid
@@ -98,7 +103,13 @@ private:
   std::vector<double> biasf;
   std::vector<double> histosigma;
   Communicator& mycomm;
-  std::unique_ptr<Grid> BiasGrid_;
+  std::unique_ptr<GridBase> BiasGrid_;
+  /// number of kernels already added to the grid
+  std::size_t ndeposited;
+  /// add the i-th kernel to the grid, one kernel at a time
+  void depositKernel(std::size_t i);
+  /// add all the pending kernels to a dense grid in parallel
+  void depositKernelsInParallel();
 };
 
 }
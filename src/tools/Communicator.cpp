@@ -224,6 +224,22 @@ void Communicator::Allgather(ConstData in,Data out) {
 #endif
 }
 
+Communicator::Request Communicator::Iallgather(ConstData in,Data out) {
+  Request req;
+#ifdef __PLUMED_HAS_MPI
+  plumed_massert(initialized(),"you are trying to use an MPI function, but MPI is not initialized");
+  void*s=const_cast<void*>((const void*)in.pointer);
+  void*r=const_cast<void*>((const void*)out.pointer);
+  if(s==NULL)s=MPI_IN_PLACE;
+  MPI_Iallgather(s,in.size,in.type,r,out.size/Get_size(),out.type,communicator,&req.r);
+#else
+  (void) in;
+  (void) out;
+  plumed_merror("you are trying to use an MPI function, but PLUMED has been compiled without MPI support");
+#endif
+  return req;
+}
+
 void Communicator::Recv(Data data,int source,int tag,Status&status) {
 #ifdef __PLUMED_HAS_MPI
   plumed_massert(initialized(),"you are trying to use an MPI function, but MPI is not initialized");
@@ -238,6 +254,19 @@ void Communicator::Recv(Data data,int source,int tag,Status&status) {
 #endif
 }
 
+bool Communicator::Iprobe(int source,int tag) {
+  int flag=0;
+#ifdef __PLUMED_HAS_MPI
+  plumed_massert(initialized(),"you are trying to use an MPI function, but MPI is not initialized");
+  MPI_Iprobe(source,tag,communicator,&flag,MPI_STATUS_IGNORE);
+#else
+  (void) source;
+  (void) tag;
+  plumed_merror("you are trying to use an MPI function, but PLUMED has been compiled without MPI support");
+#endif
+  return flag!=0;
+}
+
 void Communicator::Barrier()const {
 #ifdef __PLUMED_HAS_MPI
   if(initialized()) MPI_Barrier(communicator);
@@ -236,12 +236,23 @@ public:
     Allgather(ConstData(sendbuf),Data(recvbuf));
   }
 
+/// Wrapper for MPI_Iallgather (data struct)
+  Request Iallgather(ConstData in,Data out);
+/// Wrapper for MPI_Iallgather (reference).
+/// Buffers should not be touched until the request has been waited for
+  template <class T,class S> Request Iallgather(const T&sendbuf,S&recvbuf) {
+    return Iallgather(ConstData(sendbuf),Data(recvbuf));
+  }
+
 /// Wrapper for MPI_Recv (data struct)
   void Recv(Data,int,int,Status&s=StatusIgnore);
 /// Wrapper for MPI_Recv (pointer)
   template <class T> void Recv(T*buf,int count,int source,int tag,Status&s=StatusIgnore) {Recv(Data(buf,count),source,tag,s);}
 /// Wrapper for MPI_Recv (reference)
   template <class T> void Recv(T&buf,int source,int tag,Status&s=StatusIgnore) {Recv(Data(buf),source,tag,s);}
+/// Wrapper to MPI_Iprobe.
+/// Returns true if a message with the given tag from source can be received
+  bool Iprobe(int source,int tag);
 
 /// Wrapper to MPI_Comm_split
   void Split(int,int,Communicator&)const;
@@ -32,6 +32,7 @@
 
 #include <iostream>
 #include <string>
+#include <utility>
 
 #ifdef __PLUMED_HAS_ZLIB
 #include <zlib.h>
@@ -39,6 +40,14 @@
 
 namespace PLMD {
 
+const char FileBase::binaryMagic[8]= {'P','L','M','D','B','I','N','1'};
+
+void FileBase::toLittleEndian(char*p,std::size_t n) {
+  const unsigned one=1;
+  if(*reinterpret_cast<const char*>(&one)) return;
+  for(std::size_t i=0; i<n/2; i++) std::swap(p[i],p[n-1-i]);
+}
+
 FileBase& FileBase::link(FILE*fp) {
   plumed_massert(!this->fp,"cannot link an already open file");
   this->fp=fp;
@@ -22,6 +22,7 @@
 #ifndef __PLUMED_tools_FileBase_h
 #define __PLUMED_tools_FileBase_h
 
+#include <cstddef>
 #include <string>
 
 namespace PLMD {
@@ -79,7 +80,11 @@ protected:
   std::string mode;
 /// Set to true if you want flush to be heavy (close/reopen)
   bool heavyFlush;
+/// Magic number at the beginning of binary fielded files
+  static const char binaryMagic[8];
 public:
+/// Convert between the host byte order and the little-endian order used in binary files (in place)
+  static void toLittleEndian(char*,std::size_t);
 /// Append suffix.
 /// It appends the desired suffix to the string. Notice that
 /// it conserves some suffix (e.g. gz/xtc/trr).
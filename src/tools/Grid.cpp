@@ -36,7 +36,9 @@
 #include <sstream>
 #include <cstdio>
 #include <cfloat>
+#include <limits>
 #include <array>
+#include <algorithm>
 
 namespace PLMD {
 
@@ -294,6 +296,25 @@ unsigned GridBase::getSplineNeighbors(const unsigned* indices, std::size_t indic
   return nneighbors;
 }
 
+void GridBase::getNeighborsAlongAxes(const std::vector<double> & x,const std::vector<unsigned> & nneigh, std::vector<std::vector<unsigned> >& neigh) const {
+  plumed_dbg_assert(nneigh.size()==dimension_);
+  std::array<unsigned,maxdim> indices;
+  getIndices(x,indices.data(),dimension_);
+  neigh.resize(dimension_);
+  // same rules used by getNeighbors()
+  for(unsigned i=0; i<dimension_; ++i) {
+    neigh[i].clear();
+    for(unsigned k=0; k<2*nneigh[i]+1; ++k) {
+      int i0=k-nneigh[i]+indices[i];
+      if(!pbc_[i] && i0<0)         continue;
+      if(!pbc_[i] && i0>=static_cast<int>(nbin_[i])) continue;
+      if( pbc_[i] && i0<0)         i0=nbin_[i]-(-i0)%nbin_[i];
+      if( pbc_[i] && i0>=static_cast<int>(nbin_[i])) i0%=nbin_[i];
+      neigh[i].push_back(static_cast<unsigned>(i0));
+    }
+  }
+}
+
 std::vector<GridBase::index_t> GridBase::getNearestNeighbors(const index_t index) const {
   std::vector<index_t> nearest_neighs = std::vector<index_t>();
   for (unsigned i = 0; i < dimension_; i++) {
@@ -373,54 +394,102 @@ double GridBase::getValueAndDerivatives(const std::vector<unsigned> & indices, s
   return getValueAndDerivatives(getIndex(indices),der);
 }
 
-double GridBase::getValueAndDerivatives(const std::vector<double> & x, std::vector<double>& der) const {
-  plumed_dbg_assert(der.size()==dimension_ && usederiv_);
-
-  if(dospline_) {
-    double X,X2,X3,value;
-    std::array<double,maxdim> fd, C, D;
-    std::array<double,maxdim> dder;
+template<typename F>
+double GridBase::interpolateSpline(const std::vector<double> & x, std::vector<double>& der, F fetch) const {
+  double X,X2,X3,value;
+  std::array<double,maxdim> fd, C, D;
+  std::array<double,maxdim> dder;
 // reset
-    value=0.0;
-    for(unsigned int i=0; i<dimension_; ++i) der[i]=0.0;
+  value=0.0;
+  for(unsigned int i=0; i<dimension_; ++i) der[i]=0.0;
 
-    std::array<unsigned,maxdim> indices;
-    getIndices(x, indices.data(),dimension_);
-    std::array<double,maxdim> xfloor;
-    getPoint(indices.data(), dimension_, xfloor.data(),dimension_);
-    gch::small_vector<index_t,16> neigh(1<<dimension_); // pow(2,dimension_); up to dimension 4 will stay on stack
-    auto nneigh = getSplineNeighbors(indices.data(),dimension_, neigh.data(), neigh.size());
+  std::array<unsigned,maxdim> indices;
+  getIndices(x, indices.data(),dimension_);
+  std::array<double,maxdim> xfloor;
+  getPoint(indices.data(), dimension_, xfloor.data(),dimension_);
+  const index_t base=getIndex(indices.data(),dimension_);
+
+// the parts of the Hermite polynomials that do not depend on the grid values are computed once per dimension,
+// for the lower (0) and upper (1) corner of the cell
+  std::array<std::array<double,2>,maxdim> h, g, dh, dg;
+// offset of the upper corner along each dimension, the neighbors are the same of getSplineNeighbors()
+  std::array<index_t,maxdim> offset;
+  std::array<bool,maxdim> hasUpper;
+  index_t stride=1;
+  for(unsigned j=0; j<dimension_; ++j) {
+    const double dx=getDx(j);
+    for(unsigned x0=0; x0<2; ++x0) {
+      X=std::abs((x[j]-xfloor[j])/dx-(double)x0);
+      X2=X*X;
+      X3=X2*X;
+      h[j][x0]=1.0-3.0*X2+2.0*X3;
+      g[j][x0]=X-2.0*X2+X3;
+      dh[j][x0]=-6.0*X +6.0*X2;
+      dg[j][x0]=1.0-4.0*X +3.0*X2;
+    }
+    hasUpper[j]=true;
+    if(indices[j]+1<nbin_[j]) offset[j]=stride;
+    // with pbc the upper corner is the first point, unsigned arithmetic wraps back to it
+    else if(pbc_[j]) offset[j]=-static_cast<index_t>(indices[j])*stride;
+    else hasUpper[j]=false;
+    stride*=nbin_[j];
+  }
 
 // loop over neighbors
-    std::array<unsigned,maxdim> nindices;
-    for(unsigned int ipoint=0; ipoint<nneigh; ++ipoint) {
-      double grid=getValueAndDerivatives(neigh[ipoint],dder.data(),dimension_);
-      getIndices(neigh[ipoint], nindices.data(), dimension_);
-      double ff=1.0;
-
-      for(unsigned j=0; j<dimension_; ++j) {
-        int x0=1;
-        if(nindices[j]==indices[j]) x0=0;
-        double dx=getDx(j);
-        X=std::abs((x[j]-xfloor[j])/dx-(double)x0);
-        X2=X*X;
-        X3=X2*X;
-        double yy;
-        if(std::abs(grid)<0.0000001) yy=0.0;
-        else yy=-dder[j]/grid;
-        C[j]=(1.0-3.0*X2+2.0*X3) - (x0?-1.0:1.0)*yy*(X-2.0*X2+X3)*dx;
-        D[j]=( -6.0*X +6.0*X2) - (x0?-1.0:1.0)*yy*(1.0-4.0*X +3.0*X2)*dx;
-        D[j]*=(x0?-1.0:1.0)/dx;
-        ff*=C[j];
-      }
-      for(unsigned j=0; j<dimension_; ++j) {
-        fd[j]=D[j];
-        for(unsigned i=0; i<dimension_; ++i) if(i!=j) fd[j]*=C[i];
+  const unsigned nneigh=1<<dimension_;
+  for(unsigned int ipoint=0; ipoint<nneigh; ++ipoint) {
+    index_t index=base;
+    bool valid=true;
+    for(unsigned j=0; j<dimension_; ++j) if((ipoint>>j)&1) {
+        if(!hasUpper[j]) {valid=false; break;}
+        index+=offset[j];
       }
-      value+=grid*ff;
-      for(unsigned j=0; j<dimension_; ++j) der[j]+=grid*fd[j];
+    if(!valid) continue;
+    double grid=fetch(index,dder.data());
+    double ff=1.0;
+
+    for(unsigned j=0; j<dimension_; ++j) {
+      // a periodic dimension with a single point has the two corners on the same point
+      const unsigned x0=((ipoint>>j)&1) && offset[j]!=0;
+      double dx=getDx(j);
+      double yy;
+      if(std::abs(grid)<0.0000001) yy=0.0;
+      else yy=-dder[j]/grid;
+      C[j]=h[j][x0] - (x0?-1.0:1.0)*yy*g[j][x0]*dx;
+      D[j]=dh[j][x0] - (x0?-1.0:1.0)*yy*dg[j][x0]*dx;
+      D[j]*=(x0?-1.0:1.0)/dx;
+      ff*=C[j];
+    }
+    for(unsigned j=0; j<dimension_; ++j) {
+      fd[j]=D[j];
+      for(unsigned i=0; i<dimension_; ++i) if(i!=j) fd[j]*=C[i];
     }
-    return value;
+    value+=grid*ff;
+    for(unsigned j=0; j<dimension_; ++j) der[j]+=grid*fd[j];
+  }
+  return value;
+}
+
+double GridBase::getSplineValueAndDerivatives(const std::vector<double> & x, std::vector<double>& der) const {
+  return interpolateSpline(x,der,[this](index_t index,double* dder) {
+    return getValueAndDerivatives(index,dder,dimension_);
+  });
+}
+
+double Grid::getSplineValueAndDerivatives(const std::vector<double> & x, std::vector<double>& der) const {
+  plumed_dbg_assert(usederiv_);
+  return interpolateSpline(x,der,[this](index_t index,double* dder) {
+    const double* d=&der_[index*dimension_];
+    for(unsigned j=0; j<dimension_; ++j) dder[j]=d[j];
+    return grid_[index];
+  });
+}
+
+double GridBase::getValueAndDerivatives(const std::vector<double> & x, std::vector<double>& der) const {
+  plumed_dbg_assert(der.size()==dimension_ && usederiv_);
+
+  if(dospline_) {
+    return getSplineValueAndDerivatives(x,der);
   } else {
     return getValueAndDerivatives(getIndex(x),der);
   }
@@ -442,6 +511,14 @@ void GridBase::addValueAndDerivatives(const std::vector<unsigned> & indices, dou
   addValueAndDerivatives(getIndex(indices),value,der);
 }
 
+void GridBase::addValuesAndDerivatives(std::size_t n, const index_t* index, const double* value, const double* der) {
+  std::vector<double> dd(dimension_);
+  for(std::size_t k=0; k<n; ++k) {
+    for(unsigned j=0; j<dimension_; ++j) dd[j]=der[k*dimension_+j];
+    addValueAndDerivatives(index[k],value[k],dd);
+  }
+}
+
 void GridBase::writeHeader(OFile& ofile) {
   for(unsigned i=0; i<dimension_; ++i) {
     ofile.addConstantField("min_" + argnames[i]);
@@ -504,8 +581,8 @@ void GridBase::writeCubeFile(OFile& ofile, const double& lunit) {
 
 std::unique_ptr<GridBase> GridBase::create(const std::string& funcl, const std::vector<Value*> & args, IFile& ifile,
     const std::vector<std::string> & gmin,const std::vector<std::string> & gmax,
-    const std::vector<unsigned> & nbin,bool dosparse, bool dospline, bool doder) {
-  std::unique_ptr<GridBase> grid=GridBase::create(funcl,args,ifile,dosparse,dospline,doder);
+    const std::vector<unsigned> & nbin,bool dosparse, bool dospline, bool doder, bool doblocks) {
+  std::unique_ptr<GridBase> grid=GridBase::create(funcl,args,ifile,dosparse,dospline,doder,doblocks);
   std::vector<unsigned> cbin( grid->getNbin() );
   std::vector<std::string> cmin( grid->getMin() ), cmax( grid->getMax() );
   for(unsigned i=0; i<args.size(); ++i) {
@@ -520,7 +597,7 @@ std::unique_ptr<GridBase> GridBase::create(const std::string& funcl, const std::
   return grid;
 }
 
-std::unique_ptr<GridBase> GridBase::create(const std::string& funcl, const std::vector<Value*> & args, IFile& ifile, bool dosparse, bool dospline, bool doder)
+std::unique_ptr<GridBase> GridBase::create(const std::string& funcl, const std::vector<Value*> & args, IFile& ifile, bool dosparse, bool dospline, bool doder, bool doblocks)
 {
   std::unique_ptr<GridBase> grid;
   unsigned nvar=args.size(); bool hasder=false; std::string pstring;
@@ -570,7 +647,8 @@ std::unique_ptr<GridBase> GridBase::create(const std::string& funcl, const std::
     }
   }
 
-  if(!dosparse) {grid=Tools::make_unique<Grid>(funcl,args,gmin,gmax,gbin,dospline,doder);}
+  if(doblocks) {grid=Tools::make_unique<BlockGrid>(funcl,args,gmin,gmax,gbin,dospline,doder);}
+  else if(!dosparse) {grid=Tools::make_unique<Grid>(funcl,args,gmin,gmax,gbin,dospline,doder);}
   else {grid=Tools::make_unique<SparseGrid>(funcl,args,gmin,gmax,gbin,dospline,doder);}
 
   std::vector<double> xx(nvar),dder(nvar);
@@ -736,6 +814,16 @@ void Grid::addValueAndDerivatives(index_t index, double value, std::vector<doubl
   for(unsigned int i=0; i<dimension_; ++i) der_[index*dimension_+i]+=der[i];
 }
 
+void Grid::addValuesAndDerivatives(std::size_t n, const index_t* index, const double* value, const double* der) {
+  plumed_dbg_assert(usederiv_);
+  for(std::size_t k=0; k<n; ++k) {
+    plumed_dbg_assert(index[k]<maxsize_);
+    grid_[index[k]]+=value[k];
+    double* d=&der_[index[k]*dimension_];
+    for(unsigned j=0; j<dimension_; ++j) d[j]+=der[k*dimension_+j];
+  }
+}
+
 Grid::index_t SparseGrid::getSize() const {
   return map_.size();
 }
@@ -833,6 +921,221 @@ double SparseGrid::getMaxValue() const {
   return maxval;
 }
 
+void SparseGrid::clear() {
+  map_.clear();
+  der_.clear();
+}
+
+void BlockGrid::setupTiles() {
+  // the edge is chosen so that tiles have about targetTileSize points
+  const unsigned edge=std::max(2u,static_cast<unsigned>(std::lround(std::pow(static_cast<double>(targetTileSize),1.0/dimension_))));
+  tileEdge_.resize(dimension_);
+  tileStride_.resize(dimension_);
+  localStride_.resize(dimension_);
+  index_t tstride=1;
+  unsigned lstride=1;
+  for(unsigned i=0; i<dimension_; ++i) {
+    tileEdge_[i]=std::min(edge,nbin_[i]);
+    tileStride_[i]=tstride;
+    localStride_[i]=lstride;
+    tstride*=(nbin_[i]+tileEdge_[i]-1)/tileEdge_[i];
+    lstride*=tileEdge_[i];
+  }
+  nTiles_=tstride;
+  tileSize_=lstride;
+  tileStorage_=(usederiv_ ? tileSize_*(1+dimension_) : tileSize_);
+}
+
+void BlockGrid::locate(index_t index, index_t& tile, unsigned& local) const {
+  plumed_dbg_assert(index<maxsize_);
+  tile=0;
+  local=0;
+  // same ordering as GridBase::getIndices
+  for(unsigned i=0; i<dimension_; ++i) {
+    const unsigned k=index%nbin_[i];
+    index/=nbin_[i];
+    tile+=(k/tileEdge_[i])*tileStride_[i];
+    local+=(k%tileEdge_[i])*localStride_[i];
+  }
+}
+
+std::size_t BlockGrid::getTile(index_t tile) {
+  const auto it=tiles_.find(tile);
+  if(it!=tiles_.end()) return static_cast<std::size_t>(it->second)*tileStorage_;
+  const unsigned slot=tileIndex_.size();
+  tiles_.emplace(tile,slot);
+  tileIndex_.push_back(tile);
+  data_.resize(data_.size()+tileStorage_,0.0);
+  return static_cast<std::size_t>(slot)*tileStorage_;
+}
+
+bool BlockGrid::getGlobalIndex(unsigned slot, unsigned local, index_t& index) const {
+  index_t tile=tileIndex_[slot];
+  index=0;
+  index_t gstride=1;
+  for(unsigned i=0; i<dimension_; ++i) {
+    const index_t ntiles=(nbin_[i]+tileEdge_[i]-1)/tileEdge_[i];
+    const unsigned k=(tile%ntiles)*tileEdge_[i]+local%tileEdge_[i];
+    tile/=ntiles;
+    local/=tileEdge_[i];
+    // the last tile along a dimension can be partially outside the grid
+    if(k>=nbin_[i]) return false;
+    index+=k*gstride;
+    gstride*=nbin_[i];
+  }
+  return true;
+}
+
+GridBase::index_t BlockGrid::getSize() const {
+  return maxsize_;
+}
+
+double BlockGrid::getValue(index_t index) const {
+  plumed_assert(index<maxsize_);
+  index_t tile;
+  unsigned local;
+  locate(index,tile,local);
+  const auto it=tiles_.find(tile);
+  if(it==tiles_.end()) return offset_;
+  return offset_+data_[static_cast<std::size_t>(it->second)*tileStorage_+local];
+}
+
+double BlockGrid::getValueAndDerivatives(index_t index, double* der, std::size_t der_size) const {
+  plumed_assert(index<maxsize_ && usederiv_ && der_size==dimension_);
+  index_t tile;
+  unsigned local;
+  locate(index,tile,local);
+  const auto it=tiles_.find(tile);
+  if(it==tiles_.end()) {
+    for(unsigned i=0; i<dimension_; ++i) der[i]=0.0;
+    return offset_;
+  }
+  const double* t=&data_[static_cast<std::size_t>(it->second)*tileStorage_];
+  const double* d=t+tileSize_+static_cast<std::size_t>(local)*dimension_;
+  for(unsigned i=0; i<dimension_; ++i) der[i]=d[i];
+  return offset_+t[local];
+}
+
+void BlockGrid::setValue(index_t index, double value) {
+  plumed_assert(index<maxsize_ && !usederiv_);
+  index_t tile;
+  unsigned local;
+  locate(index,tile,local);
+  data_[getTile(tile)+local]=value-offset_;
+}
+
+void BlockGrid::setValueAndDerivatives(index_t index, double value, std::vector<double>& der) {
+  plumed_assert(index<maxsize_ && usederiv_ && der.size()==dimension_);
+  index_t tile;
+  unsigned local;
+  locate(index,tile,local);
+  const std::size_t t=getTile(tile);
+  data_[t+local]=value-offset_;
+  double* d=&data_[t+tileSize_+static_cast<std::size_t>(local)*dimension_];
+  for(unsigned i=0; i<dimension_; ++i) d[i]=der[i];
+}
+
+void BlockGrid::addValue(index_t index, double value) {
+  plumed_assert(index<maxsize_ && !usederiv_);
+  // zero contributions (e.g. beyond the cutoff of a kernel) should not allocate tiles
+  if(value==0.0) return;
+  index_t tile;
+  unsigned local;
+  locate(index,tile,local);
+  data_[getTile(tile)+local]+=value;
+}
+
+void BlockGrid::addValueAndDerivatives(index_t index, double value, std::vector<double>& der) {
+  plumed_assert(index<maxsize_ && usederiv_ && der.size()==dimension_);
+  // zero contributions (e.g. beyond the cutoff of a kernel) should not allocate tiles
+  if(value==0.0 && std::all_of(der.begin(),der.end(),[](double x) {return x==0.0;})) return;
+  index_t tile;
+  unsigned local;
+  locate(index,tile,local);
+  const std::size_t t=getTile(tile);
+  data_[t+local]+=value;
+  double* d=&data_[t+tileSize_+static_cast<std::size_t>(local)*dimension_];
+  for(unsigned i=0; i<dimension_; ++i) d[i]+=der[i];
+}
+
+double BlockGrid::getMinValue() const {
+  // the points that are not allocated have value offset_
+  double minval=(tileIndex_.size()<nTiles_ ? 0.0 : std::numeric_limits<double>::max());
+  for(unsigned slot=0; slot<tileIndex_.size(); ++slot) {
+    const double* t=&data_[static_cast<std::size_t>(slot)*tileStorage_];
+    index_t index;
+    for(unsigned k=0; k<tileSize_; ++k) if(t[k]<minval && getGlobalIndex(slot,k,index)) minval=t[k];
+  }
+  return offset_+minval;
+}
+
+double BlockGrid::getMaxValue() const {
+  double maxval=(tileIndex_.size()<nTiles_ ? 0.0 : std::numeric_limits<double>::lowest());
+  for(unsigned slot=0; slot<tileIndex_.size(); ++slot) {
+    const double* t=&data_[static_cast<std::size_t>(slot)*tileStorage_];
+    index_t index;
+    for(unsigned k=0; k<tileSize_; ++k) if(t[k]>maxval && getGlobalIndex(slot,k,index)) maxval=t[k];
+  }
+  return offset_+maxval;
+}
+
+void BlockGrid::scaleAllValuesAndDerivatives( const double& scalef ) {
+  offset_*=scalef;
+  for(auto & x : data_) x*=scalef;
+}
+
+void BlockGrid::setMinToZero() {
+  // the shift is stored once so the points that are not allocated are shifted too
+  offset_-=getMinValue();
+}
+
+std::vector<GridBase::index_t> BlockGrid::getStoredPoints() const {
+  std::vector<index_t> points;
+  points.reserve(static_cast<std::size_t>(tileIndex_.size())*tileSize_);
+  for(unsigned slot=0; slot<tileIndex_.size(); ++slot) {
+    for(unsigned k=0; k<tileSize_; ++k) {
+      index_t index;
+      if(getGlobalIndex(slot,k,index)) points.push_back(index);
+    }
+  }
+  std::sort(points.begin(),points.end());
+  return points;
+}
+
+void BlockGrid::writeToFile(OFile& ofile) {
+  // points are written in the same order used by Grid
+  const std::vector<index_t> points=getStoredPoints();
+  std::vector<double> xx(dimension_);
+  std::vector<double> der(dimension_);
+  double f;
+  writeHeader(ofile);
+  ofile.fmtField(" "+fmt_);
+  for(const auto i : points) {
+    getPoint(i,xx);
+    if(usederiv_) {f=getValueAndDerivatives(i,der);}
+    else {f=getValue(i);}
+    if(i>0 && dimension_>1 && getIndices(i)[dimension_-2]==0) ofile.printf("\n");
+    for(unsigned j=0; j<dimension_; ++j) {
+      ofile.printField("min_" + argnames[j], str_min_[j] );
+      ofile.printField("max_" + argnames[j], str_max_[j] );
+      ofile.printField("nbins_" + argnames[j], static_cast<int>(nbin_[j]) );
+      if( pbc_[j] ) ofile.printField("periodic_" + argnames[j], "true" );
+      else          ofile.printField("periodic_" + argnames[j], "false" );
+    }
+    for(unsigned j=0; j<dimension_; ++j) ofile.printField(argnames[j],xx[j]);
+    ofile.printField(funcname, f);
+    if(usederiv_) { for(unsigned j=0; j<dimension_; ++j) ofile.printField("der_" + argnames[j],der[j]); }
+    ofile.printField();
+  }
+}
+
+void BlockGrid::clear() {
+  offset_=0.0;
+  tiles_.clear();
+  tileIndex_.clear();
+  data_.clear();
+}
+
 void Grid::projectOnLowDimension(double &val, std::vector<int> &vHigh, WeightBase * ptr2obj ) {
   unsigned i=0;
   for(i=0; i<vHigh.size(); i++) {
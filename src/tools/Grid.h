@@ -26,6 +26,7 @@
 #include <array>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <cmath>
 #include <memory>
 #include <cstddef>
@@ -217,6 +218,11 @@ protected:
 /// get "neighbors" for spline
   unsigned getSplineNeighbors(const unsigned* indices, std::size_t indices_size, index_t* neighbors, std::size_t neighbors_size)const;
 // std::vector<index_t> getSplineNeighbors(const std::vector<unsigned> & indices)const;
+/// spline interpolation in x, fetch(index,der) should return the value and set the derivatives of a grid point
+  template<typename F>
+  double interpolateSpline(const std::vector<double> & x, std::vector<double>& der, F fetch) const;
+/// spline interpolation in x, grids that can access their points without virtual calls can override it
+  virtual double getSplineValueAndDerivatives(const std::vector<double> & x, std::vector<double>& der) const;
 
 
 public:
@@ -277,6 +283,9 @@ public:
   std::vector<index_t> getNeighbors(index_t index,const std::vector<unsigned> & neigh) const;
   std::vector<index_t> getNeighbors(const std::vector<unsigned> & indices,const std::vector<unsigned> & neigh) const;
   std::vector<index_t> getNeighbors(const std::vector<double> & x,const std::vector<unsigned> & neigh) const;
+/// get, for each dimension i, the indices of the points that are within nneigh[i] bins from x along that dimension.
+/// The points returned by getNeighbors() are all the combinations of these indices
+  void getNeighborsAlongAxes(const std::vector<double> & x,const std::vector<unsigned> & nneigh, std::vector<std::vector<unsigned> >& neigh) const;
 /// get nearest neighbors (those separated by exactly one lattice unit)
   std::vector<index_t> getNearestNeighbors(const index_t index) const;
   std::vector<index_t> getNearestNeighbors(const std::vector<unsigned> &indices) const;
@@ -284,12 +293,12 @@ public:
 /// write header for grid file
   void writeHeader(OFile& file);
 
-/// read grid from file
-  static std::unique_ptr<GridBase> create(const std::string&,const std::vector<Value*>&,IFile&,bool,bool,bool);
+/// read grid from file, the last flag stores it in a BlockGrid
+  static std::unique_ptr<GridBase> create(const std::string&,const std::vector<Value*>&,IFile&,bool,bool,bool,bool doblocks=false);
 /// read grid from file and check boundaries are what is expected from input
   static std::unique_ptr<GridBase> create(const std::string&,const std::vector<Value*>&, IFile&,
                                           const std::vector<std::string>&,const std::vector<std::string>&,
-                                          const std::vector<unsigned>&,bool,bool,bool);
+                                          const std::vector<unsigned>&,bool,bool,bool,bool doblocks=false);
 /// get grid size
   virtual index_t getSize() const=0;
 /// get grid value
@@ -314,6 +323,8 @@ public:
 /// add to grid value and derivatives
   virtual void addValueAndDerivatives(index_t index, double value, std::vector<double>& der)=0;
   void addValueAndDerivatives(const std::vector<unsigned> & indices, double value, std::vector<double>& der);
+/// add to the values and derivatives of n points, der contains the derivatives of the first point, then those of the second and so on
+  virtual void addValuesAndDerivatives(std::size_t n, const index_t* index, const double* value, const double* der);
 /// add a kernel function to the grid
   void addKernel( const KernelFunctions& kernel );
 
@@ -324,6 +335,8 @@ public:
 
 /// dump grid on file
   virtual void writeToFile(OFile&)=0;
+/// set all values and derivatives to zero
+  virtual void clear()=0;
 /// dump grid to gaussian cube file
   void writeCubeFile(OFile&, const double& lunit);
 
@@ -344,6 +357,8 @@ class Grid : public GridBase
   std::vector<double> grid_;
   std::vector<double> der_;
   double contour_location=0.0;
+protected:
+  double getSplineValueAndDerivatives(const std::vector<double> & x, std::vector<double>& der) const override;
 public:
   Grid(const std::string& funcl, const std::vector<Value*> & args, const std::vector<std::string> & gmin,
        const std::vector<std::string> & gmax,
@@ -383,6 +398,8 @@ public:
   void addValue(index_t index, double value) override;
 /// add to grid value and derivatives
   void addValueAndDerivatives(index_t index, double value, std::vector<double>& der) override;
+/// add to the values and derivatives of n points
+  void addValuesAndDerivatives(std::size_t n, const index_t* index, const double* value, const double* der) override;
 
 /// get minimum value
   double getMinValue() const override;
@@ -411,7 +428,7 @@ public:
   void mpiSumValuesAndDerivatives( Communicator& comm );
 /// Integrate the function calculated on the grid
   double integrate( std::vector<unsigned>& npoints );
-  void clear();
+  void clear() override;
 };
 
 
@@ -458,10 +475,107 @@ public:
   double getMaxValue() const override;
 /// dump grid on file
   void writeToFile(OFile&) override;
+  void clear() override;
 
   virtual ~SparseGrid() = default;
 };
 
+/// A sparse grid made of dense tiles.
+/// The grid is divided in tiles of tileEdge bins per dimension, a tile is allocated the first
+/// time a non zero value is added to one of its points. Values and derivatives of a tile are
+/// stored contiguously and tiles are found through a hash table, so that accessing a point
+/// costs a division per dimension and a hash lookup instead of the tree walk of SparseGrid.
+/// Points that belong to tiles that have not been allocated have zero value and derivatives.
+class BlockGrid : public GridBase
+{
+/// the number of points per tile that is targeted when choosing the edge of the tiles
+  static constexpr unsigned targetTileSize=256;
+  std::vector<unsigned> tileEdge_;
+/// strides of the tile index and of the point index inside a tile
+  std::vector<index_t> tileStride_;
+  std::vector<unsigned> localStride_;
+  unsigned tileSize_;
+/// number of doubles used by a tile: tileSize_ values followed by tileSize_*dimension_ derivatives
+  unsigned tileStorage_;
+/// from tile index to position of the tile in data_
+  std::unordered_map<index_t,unsigned> tiles_;
+/// tile index of each allocated tile
+  std::vector<index_t> tileIndex_;
+  std::vector<double> data_;
+/// total number of tiles needed to cover the grid
+  index_t nTiles_;
+/// value that is added to all the points, including those that are not allocated
+  double offset_=0.0;
+  void setupTiles();
+/// find the tile containing a point and the position of the point in the tile
+  void locate(index_t index, index_t& tile, unsigned& local) const;
+/// returns the offset of the tile in data_, allocating it if needed
+  std::size_t getTile(index_t tile);
+/// global index of the point in position local of the allocated tile number slot, returns false if outside the grid
+  bool getGlobalIndex(unsigned slot, unsigned local, index_t& index) const;
+public:
+  BlockGrid(const std::string& funcl, const std::vector<Value*> & args, const std::vector<std::string> & gmin,
+            const std::vector<std::string> & gmax,
+            const std::vector<unsigned> & nbin, bool dospline, bool usederiv):
+    GridBase(funcl,args,gmin,gmax,nbin,dospline,usederiv) {setupTiles();}
+/// this constructor here is not Value-aware
+  BlockGrid(const std::string& funcl, const std::vector<std::string> &names, const std::vector<std::string> & gmin,
+            const std::vector<std::string> & gmax, const std::vector<unsigned> & nbin, bool dospline,
+            bool usederiv, const std::vector<bool> &isperiodic, const std::vector<std::string> &pmin,
+            const std::vector<std::string> &pmax ):
+    GridBase(funcl,names,gmin,gmax,nbin,dospline,usederiv,isperiodic,pmin,pmax) {setupTiles();}
+
+/// this returns the number of points of the dense grid, as for Grid, so that loops over indexes are valid.
+/// It is not the number of points that are stored: loops up to getSize() also visit the points of the tiles
+/// that are not allocated, and buffers sized with it are as large as those of a Grid. Use getStoredPoints()
+/// to visit only the allocated points.
+  index_t getSize() const override;
+/// get the sorted indexes of the points of the allocated tiles that are inside the grid
+  std::vector<index_t> getStoredPoints() const;
+/// get the value of the points that are not stored
+  double getOffset() const {return offset_;}
+/// get the number of tiles that have been allocated
+  unsigned getNumberOfTiles() const {return tileIndex_.size();}
+/// get the number of points in a tile
+  unsigned getTileSize() const {return tileSize_;}
+
+/// this is to access to Grid:: version of these methods (allowing overloading of virtual methods)
+  using GridBase::getValue;
+  using GridBase::getValueAndDerivatives;
+  using GridBase::setValue;
+  using GridBase::setValueAndDerivatives;
+  using GridBase::addValue;
+  using GridBase::addValueAndDerivatives;
+
+/// get grid value
+  double getValue(index_t index) const override;
+/// get grid value and derivatives
+  double getValueAndDerivatives(index_t index, double* der, std::size_t der_size) const override;
+
+/// set grid value
+  void setValue(index_t index, double value) override;
+/// set grid value and derivatives
+  void setValueAndDerivatives(index_t index, double value, std::vector<double>& der) override;
+/// add to grid value, adding zero does not allocate a tile
+  void addValue(index_t index, double value) override;
+/// add to grid value and derivatives, adding zero does not allocate a tile
+  void addValueAndDerivatives(index_t index, double value, std::vector<double>& der) override;
+
+/// get minimum value, the points that are not allocated are also considered
+  double getMinValue() const override;
+/// get maximum value, the points that are not allocated are also considered
+  double getMaxValue() const override;
+/// Scale all grid values and derivatives by a constant factor
+  void scaleAllValuesAndDerivatives( const double& scalef );
+/// Set the minimum value of the grid to zero and translates accordingly
+  void setMinToZero();
+/// dump grid on file, only the points of the allocated tiles are written
+  void writeToFile(OFile&) override;
+  void clear() override;
+
+  virtual ~BlockGrid() = default;
+};
+
 
 inline
 GridBase::index_t GridBase::getIndex(const unsigned* indices,std::size_t indices_size) const {
@@ -32,10 +32,19 @@
 
 #include <iostream>
 #include <string>
+#include <cstdint>
 #ifdef __PLUMED_HAS_ZLIB
 #include <zlib.h>
 #endif
 
+#if defined(__unix__) || defined(__APPLE__)
+#if __has_include(<sys/mman.h>)
+#define __PLUMED_IFILE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#endif
+
 namespace PLMD {
 
 size_t IFile::llread(char*ptr,size_t s) {
@@ -58,8 +67,91 @@ size_t IFile::llread(char*ptr,size_t s) {
   return r;
 }
 
+std::size_t IFile::binaryRead(char*ptr,std::size_t s) {
+  if(mapped && binaryOffset+s<=mappedSize) {
+    std::memcpy(ptr,mapped+binaryOffset,s);
+    binaryOffset+=s;
+    return s;
+  }
+// beyond the mapped region (e.g. the file has grown), read from the file
+  if(std::fseek(fp,binaryOffset,SEEK_SET)!=0) {
+    eof=true;
+    return 0;
+  }
+  std::size_t r=llread(ptr,s);
+  binaryOffset+=r;
+  return r;
+}
+
+IFile& IFile::advanceBinaryField() {
+  const auto readUnsigned=[this](std::uint32_t & n) {
+    char c[4];
+    if(binaryRead(c,4)!=4) return false;
+    toLittleEndian(c,4);
+    std::memcpy(&n,c,4);
+    return true;
+  };
+  const auto readString=[&](std::string & str) {
+    std::uint32_t n;
+    if(!readUnsigned(n)) return false;
+    str.resize(n);
+    return n==0 || binaryRead(&str[0],n)==n;
+  };
+  while(true) {
+// a block that is not complete (e.g. a file being written) is read again after reset()
+    const std::size_t start=binaryOffset;
+    bool complete=false;
+    char tag=0;
+    if(binaryRead(&tag,1)==1) {
+      if(tag=='H') {
+        fields.clear();
+        std::uint32_t n;
+        complete=readUnsigned(n);
+        for(std::uint32_t i=0; complete && i<n; i++) {
+          Field field;
+          complete=readString(field.name) && binaryRead(&field.type,1)==1;
+          plumed_massert(!complete || field.type=='d' || field.type=='i',"file " + getPath() + ": corrupted binary file");
+          fields.push_back(field);
+        }
+        if(complete) complete=readUnsigned(n);
+        for(std::uint32_t i=0; complete && i<n; i++) {
+          Field field;
+          field.constant=true;
+          complete=readString(field.name) && readString(field.value);
+          fields.push_back(field);
+        }
+      } else if(tag=='R') {
+        unsigned nf=0;
+        for(const auto & f : fields) if(!f.constant) nf++;
+        binaryRecord.resize(8*nf);
+        complete=(nf==0 || binaryRead(binaryRecord.data(),8*nf)==8*nf);
+        if(complete) {
+          char* p=binaryRecord.data();
+          for(auto & f : fields) {
+            if(f.constant) continue;
+            toLittleEndian(p,8);
+            if(f.type=='i') std::memcpy(&f.integer,p,8);
+            else std::memcpy(&f.number,p,8);
+            f.read=false;
+            p+=8;
+          }
+          break;
+        }
+      } else plumed_merror("file " + getPath() + ": corrupted binary file");
+    }
+    if(!complete) {
+      binaryOffset=start;
+      eof=true;
+      return *this;
+    }
+  }
+  inMiddleOfField=true;
+  return *this;
+}
+
 IFile& IFile::advanceField() {
   plumed_assert(!inMiddleOfField);
+  if(binary) return advanceBinaryField();
   std::string line;
   bool done=false;
   while(!done) {
@@ -119,10 +211,41 @@ IFile& IFile::open(const std::string&path) {
     plumed_merror("file " + getPath() + ": trying to use a gz file without zlib being linked");
 #endif
   }
+  unmap();
+  binary=false;
+  if(fp && !gzfp) {
+// binary files are recognized from their magic number
+    char magic[sizeof(binaryMagic)];
+    if(std::fread(magic,1,sizeof(magic),fp)==sizeof(magic) && std::memcmp(magic,binaryMagic,sizeof(magic))==0) {
+      binary=true;
+      binaryOffset=sizeof(magic);
+    }
+    textOffset=0;
+#ifdef __PLUMED_IFILE_MMAP
+    struct stat st;
+    if((binary || mapText) && fstat(fileno(fp),&st)==0 && st.st_size>0) {
+      void* m=mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fileno(fp),0);
+      if(m!=MAP_FAILED) {
+        mapped=static_cast<char*>(m);
+        mappedSize=st.st_size;
+        madvise(m,mappedSize,MADV_SEQUENTIAL);
+      }
+    }
+#endif
+    std::rewind(fp);
+  }
   if(plumed) plumed->insertFile(*this);
   return *this;
 }
 
+void IFile::unmap() {
+#ifdef __PLUMED_IFILE_MMAP
+  if(mapped) munmap(mapped,mappedSize);
+#endif
+  mapped=NULL;
+  mappedSize=0;
+}
+
 IFile& IFile::scanFieldList(std::vector<std::string>&s) {
   if(!inMiddleOfField) advanceField();
 // using explicit conversion not to confuse cppcheck 1.86
@@ -134,11 +257,19 @@ IFile& IFile::scanFieldList(std::vector<std::string>&s) {
 }
 
 bool IFile::FieldExist(const std::string& s) {
-  std::vector<std::string> slist;
-  scanFieldList(slist);
-  int mycount = (int) std::count(slist.begin(), slist.end(), s);
-  if(mycount>0) return true;
-  else return false;
+  if(!inMiddleOfField) advanceField();
+// using explicit conversion not to confuse cppcheck 1.86
+  if(!bool(*this)) return false;
+  for(const auto & f : fields) if(f.name==s) return true;
+  return false;
+}
+
+bool IFile::FieldIsConstant(const std::string& s) {
+  if(!inMiddleOfField) advanceField();
+// using explicit conversion not to confuse cppcheck 1.86
+  if(!bool(*this)) return false;
+  for(const auto & f : fields) if(f.name==s) return f.constant;
+  return false;
 }
 
 IFile& IFile::scanField(const std::string&name,std::string&str) {
@@ -146,58 +277,58 @@ IFile& IFile::scanField(const std::string&name,std::string&str) {
 // using explicit conversion not to confuse cppcheck 1.86
   if(!bool(*this)) return *this;
   unsigned i=findField(name);
-  str=fields[i].value;
+  if(fields[i].type=='i') {
+    str=std::to_string(fields[i].integer);
+  } else if(fields[i].type=='d') {
+    char buffer[32];
+    std::snprintf(buffer,sizeof(buffer),"%.17g",fields[i].number);
+    str=buffer;
+  } else {
+    str=fields[i].value;
+  }
   fields[i].read=true;
   return *this;
 }
 
-IFile& IFile::scanField(const std::string&name,double &x) {
-  std::string str;
-  scanField(name,str);
-  if(*this) Tools::convert(str,x);
+template<typename T>
+IFile& IFile::scanNumericField(const std::string&name,T&x) {
+  if(!inMiddleOfField) advanceField();
+// using explicit conversion not to confuse cppcheck 1.86
+  if(!bool(*this)) return *this;
+  unsigned i=findField(name);
+  if(fields[i].type=='d') x=static_cast<T>(fields[i].number);
+  else if(fields[i].type=='i') x=static_cast<T>(fields[i].integer);
+  else Tools::convert(fields[i].value,x);
+  fields[i].read=true;
   return *this;
 }
 
+IFile& IFile::scanField(const std::string&name,double &x) {
+  return scanNumericField(name,x);
+}
+
 IFile& IFile::scanField(const std::string&name,int &x) {
-  std::string str;
-  scanField(name,str);
-  if(*this) Tools::convert(str,x);
-  return *this;
+  return scanNumericField(name,x);
 }
 
 IFile& IFile::scanField(const std::string&name,long int &x) {
-  std::string str;
-  scanField(name,str);
-  if(*this) Tools::convert(str,x);
-  return *this;
+  return scanNumericField(name,x);
 }
 
 IFile& IFile::scanField(const std::string&name,long long int &x) {
-  std::string str;
-  scanField(name,str);
-  if(*this) Tools::convert(str,x);
-  return *this;
+  return scanNumericField(name,x);
 }
 
 IFile& IFile::scanField(const std::string&name,unsigned &x) {
-  std::string str;
-  scanField(name,str);
-  if(*this) Tools::convert(str,x);
-  return *this;
+  return scanNumericField(name,x);
 }
 
 IFile& IFile::scanField(const std::string&name,long unsigned &x) {
-  std::string str;
-  scanField(name,str);
-  if(*this) Tools::convert(str,x);
-  return *this;
+  return scanNumericField(name,x);
 }
 
 IFile& IFile::scanField(const std::string&name,long long unsigned &x) {
-  std::string str;
-  scanField(name,str);
-  if(*this) Tools::convert(str,x);
-  return *this;
+  return scanNumericField(name,x);
 }
 
 IFile& IFile::scanField(Value* val) {
@@ -228,15 +359,57 @@ IFile& IFile::scanField() {
 IFile::IFile():
   inMiddleOfField(false),
   ignoreFields(false),
-  noEOL(false)
+  noEOL(false),
+  mapText(false),
+  binary(false),
+  mapped(NULL),
+  mappedSize(0),
+  textOffset(0),
+  binaryOffset(0)
 {
 }
 
 IFile::~IFile() {
   if(inMiddleOfField) std::cerr<<"WARNING: IFile closed in the middle of reading. seems strange!\n";
+  unmap();
+}
+
+bool IFile::mappedGetline(std::string &str) {
+  if(eof || err) {
+    eof=true;
+    str="";
+    return true;
+  }
+  const char* line=mapped+textOffset;
+  const char* end=mapped+mappedSize;
+  const char* p=line;
+  while(p<end && *p && *p!='\n' && *p!='\r') p++;
+  if(p<end && *p=='\n') {
+    str.assign(line,p);
+    textOffset=p+1-mapped;
+    return true;
+  }
+  if(p+1<end && *p=='\r') {
+    plumed_massert(p[1]=='\n',"plumed only accepts \\n (unix) or \\r\\n (dos) new lines");
+    str.assign(line,p);
+    textOffset=p+2-mapped;
+    return true;
+  }
+  if(p<end && !*p) {
+// same as in getline, the position is not advanced
+    eof=true;
+    str="";
+    return true;
+  }
+// the line continues beyond the mapped region (e.g. the file has grown or has no end-of-line),
+// so the rest of the file is read with the usual functions
+  if(std::fseek(fp,textOffset,SEEK_SET)!=0) err=true;
+  unmap();
+  return false;
 }
 
 IFile& IFile::getline(std::string &str) {
+  if(mapped && !binary && mappedGetline(str)) return *this;
   char tmp=0;
   str="";
   fpos_t pos;
@@ -292,4 +465,8 @@ void IFile::allowNoEOL() {
   noEOL=true;
 }
 
+void IFile::allowMappedText() {
+  mapText=true;
+}
+
 }
@@ -37,6 +37,12 @@ Class for input files
 This class provides features similar to those in the standard C "FILE*" type,
 but only for sequential input. See OFile for sequential output.
 
+Binary files written by OFile (see \ref binary-ofile) are recognized from their first bytes
+and read transparently with the same interface. When possible, they are memory mapped and
+numeric fields are returned without any conversion from text. Plain text files
+are memory mapped only if allowMappedText() is called before opening them, so that lines
+are not read one character at a time.
+
 */
 class IFile:
 /// Class identifying a single field for fielded output
@@ -45,7 +51,11 @@ class IFile:
     public FieldBase {
   public:
     bool read;
-    Field(): read(false) {}
+/// Type in binary files, 'd' for double, 'i' for integer, 0 for text
+    char type;
+    double number;
+    long long int integer;
+    Field(): read(false), type(0), number(0.0), integer(0) {}
   };
 /// Low-level read.
 /// Note: in parallel, all processes read
@@ -58,8 +68,32 @@ class IFile:
   bool ignoreFields;
 /// Set to true to allow files without end-of-line at the end
   bool noEOL;
+/// Set to true to memory map plain text files
+  bool mapText;
 /// Advance to next field (= read one line)
   IFile& advanceField();
+/// True if the file is in binary format
+  bool binary;
+/// Memory mapped content of the file, NULL if not mapped
+  char* mapped;
+  std::size_t mappedSize;
+/// Current position in a mapped text file
+  std::size_t textOffset;
+/// Read a line from the mapped memory, false if it is not entirely contained in it
+  bool mappedGetline(std::string&);
+/// Current position in a binary file
+  std::size_t binaryOffset;
+/// Buffer for records of binary files
+  std::vector<char> binaryRecord;
+/// Read from a binary file, from the mapped memory when possible
+  std::size_t binaryRead(char*,std::size_t);
+/// Advance to next record of a binary file
+  IFile& advanceBinaryField();
+/// Release the mapped memory
+  void unmap();
+/// Read a numeric field, without conversions from text in binary files
+  template<typename T>
+  IFile& scanNumericField(const std::string&,T&);
 /// Find field index by name
   unsigned findField(const std::string&name)const;
 public:
@@ -102,6 +136,12 @@ public:
   void reset(bool);
 /// Check if a field exist
   bool FieldExist(const std::string& s);
+/// Check if a field is constant (i.e. set with "#! SET")
+  bool FieldIsConstant(const std::string& s);
+/// True if the file is in binary format
+  bool isBinary() const {
+    return binary;
+  }
 /// Read in a value
   IFile& scanField(Value* val);
 /// Allow some of the fields in the input to be ignored
@@ -110,6 +150,10 @@ public:
 /// This in practice should be only used when opening
 /// plumed input files
   void allowNoEOL();
+/// Allow a plain text file to be memory mapped.
+/// This should be only used for large files that are read
+/// sequentially and are not modified while they are read
+  void allowMappedText();
 };
 
 }
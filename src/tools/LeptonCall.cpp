@@ -68,6 +68,8 @@ void LeptonCall::set(const std::string & func, const std::vector<std::string>& v
       nt++;
     }
   }
+  // the function is also compiled so that it can be computed for many sets of arguments with a single call
+  expression_batch.assign(nth,lepton::CompiledBatchExpression(std::vector<lepton::ParsedExpression>(1,pe),var));
 }
 
 double LeptonCall::evaluate( const std::vector<double>& args ) const {
@@ -88,4 +90,14 @@ double LeptonCall::evaluateDeriv( const unsigned& ider, const std::vector<double
   return expression_deriv[ider][t].evaluate();
 }
 
+double LeptonCall::evaluateWithDerivatives( const std::vector<double>& args, double* derivs ) const {
+  plumed_dbg_assert( allow_extra_args || args.size()==nargs );
+  for(unsigned i=0; i<nargs; ++i) derivs[i]=evaluateDeriv( i, args );
+  return evaluate( args );
+}
+
+void LeptonCall::evaluateBatch( const double* args, unsigned stride, unsigned npoints, double* vals ) const {
+  expression_batch[OpenMP::getThreadNum()].evaluate( args, stride, vals, npoints, npoints );
+}
+
 }
@@ -40,11 +40,18 @@ private:
   std::vector<std::vector<lepton::CompiledExpression> > expression_deriv;
   std::vector<double*> lepton_ref;
   std::vector<double*> lepton_ref_deriv;
+/// Lepton expression for many sets of arguments at once
+/// \warning Since lepton::CompiledBatchExpression is mutable, a vector is necessary for multithreading!
+  std::vector<lepton::CompiledBatchExpression> expression_batch;
 public:
   void set(const std::string & func, const std::vector<std::string>& var, Action* action=NULL, const bool& a=false );
   unsigned getNumberOfArguments() const ;
   double evaluate( const std::vector<double>& args ) const ;
   double evaluateDeriv( const unsigned& ider, const std::vector<double>& args ) const ;
+/// Evaluate the function and store its derivatives with respect to all the arguments in derivs
+  double evaluateWithDerivatives( const std::vector<double>& args, double* derivs ) const ;
+/// Evaluate the function for npoints sets of arguments. Argument j of point k is in args[j*stride+k]
+  void evaluateBatch( const double* args, unsigned stride, unsigned npoints, double* vals ) const ;
 };
 
 inline
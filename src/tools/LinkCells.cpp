@@ -22,6 +22,8 @@
 #include "LinkCells.h"
 #include "Communicator.h"
 #include "Tools.h"
+#include "OpenMP.h"
+#include <algorithm>
 
 namespace PLMD {
 
@@ -52,7 +54,7 @@ void LinkCells::buildCellLists( const std::vector<Vector>& pos, const std::vecto
 
   // Setup the lists
   if( pos.size()!=allcells.size() ) {
-    allcells.resize( pos.size() ); lcell_lists.resize( pos.size() );
+    allcells.resize( pos.size() ); lcell_lists.resize( pos.size() ); lcell_positions.resize( pos.size() );
   }
 
   {
@@ -72,34 +74,47 @@ void LinkCells::buildCellLists( const std::vector<Vector>& pos, const std::vecto
 
   // Setup the storage for link cells
   unsigned ncellstot=ncells[0]*ncells[1]*ncells[2];
-  if( lcell_tots.size()!=ncellstot ) {
-    lcell_tots.resize( ncellstot ); lcell_starts.resize( ncellstot );
-  }
-  // Clear nlcells
-  for(unsigned i=0; i<ncellstot; ++i) lcell_tots[i]=0;
-  // Clear allcells
-  allcells.assign( allcells.size(), 0 );
-
-  // Find out what cell everyone is in
-  unsigned rank=comm.Get_rank(), size=comm.Get_size();
-  for(unsigned i=rank; i<pos.size(); i+=size) {
-    allcells[i]=findCell( pos[i] );
-    lcell_tots[allcells[i]]++;
-  }
-  // And gather all this information on every node
-  comm.Sum( allcells ); comm.Sum( lcell_tots );
-
-  // Now prepare the link cell lists
-  unsigned tot=0;
-  for(unsigned i=0; i<lcell_tots.size(); ++i) { lcell_starts[i]=tot; tot+=lcell_tots[i]; lcell_tots[i]=0; }
-  plumed_assert( tot==pos.size() );
-
-  // And setup the link cells properly
-  for(unsigned j=0; j<pos.size(); ++j) {
-    unsigned myind = lcell_starts[ allcells[j] ] + lcell_tots[ allcells[j] ];
-    lcell_lists[ myind ] = indices[j];
-    lcell_tots[allcells[j]]++;
+  if( lcell_starts.size()!=ncellstot+1 ) lcell_starts.resize( ncellstot+1 );
+
+  // The atoms are sorted into cells with a counting sort.  Each thread deals with a contiguous chunk of atoms
+  // so the order of the atoms in each cell is the same as in the input whatever the number of threads.
+  unsigned natoms=pos.size(), nt=OpenMP::getNumThreads();
+  if( nt*10>natoms ) nt=1;
+  unsigned chunk = ( natoms + nt - 1 ) / nt;
+  if( thread_counts.size()!=nt*ncellstot ) thread_counts.resize( nt*ncellstot );
+  thread_counts.assign( thread_counts.size(), 0 );
+
+  #pragma omp parallel num_threads(nt)
+  {
+    // Find out what cell everyone is in and count the atoms in each cell
+    #pragma omp for schedule(static,1)
+    for(unsigned t=0; t<nt; ++t) {
+      unsigned* mycounts=thread_counts.data() + t*ncellstot;
+      unsigned end=std::min( natoms, (t+1)*chunk );
+      for(unsigned i=t*chunk; i<end; ++i) { allcells[i]=findCell( pos[i] ); mycounts[allcells[i]]++; }
+    }
+    // Now prepare the link cell lists
+    #pragma omp single
+    {
+      unsigned tot=0;
+      for(unsigned i=0; i<ncellstot; ++i) {
+        lcell_starts[i]=tot;
+        for(unsigned t=0; t<nt; ++t) { unsigned n=thread_counts[t*ncellstot+i]; thread_counts[t*ncellstot+i]=tot; tot+=n; }
+      }
+      lcell_starts[ncellstot]=tot;
+    }
+    // And setup the link cells properly with a cell ordered copy of the positions
+    #pragma omp for schedule(static,1)
+    for(unsigned t=0; t<nt; ++t) {
+      unsigned* myoffsets=thread_counts.data() + t*ncellstot;
+      unsigned end=std::min( natoms, (t+1)*chunk );
+      for(unsigned j=t*chunk; j<end; ++j) {
+        unsigned myind = myoffsets[ allcells[j] ]; myoffsets[ allcells[j] ]++;
+        lcell_lists[ myind ] = indices[j]; lcell_positions[ myind ] = pos[j];
+      }
+    }
   }
+  plumed_assert( lcell_starts[ncellstot]==natoms );
 }
 
 #define LINKC_MIN(n) ((n<2)? 0 : -1)
@@ -142,8 +157,8 @@ void LinkCells::retrieveAtomsInCells( const unsigned& ncells_required,
                                       unsigned& natomsper, std::vector<unsigned>& atoms ) const {
   for(unsigned i=0; i<ncells_required; ++i) {
     unsigned mybox=cells_required[i];
-    for(unsigned k=0; k<lcell_tots[mybox]; ++k) {
-      unsigned myatom = lcell_lists[lcell_starts[mybox]+k];
+    for(unsigned k=lcell_starts[mybox]; k<lcell_starts[mybox+1]; ++k) {
+      unsigned myatom = lcell_lists[k];
       if( myatom!=atoms[0] ) { // Ideally would provide an option to not do this
         atoms[natomsper]=myatom;
         natomsper++;
@@ -152,6 +167,48 @@ void LinkCells::retrieveAtomsInCells( const unsigned& ncells_required,
   }
 }
 
+void LinkCells::retrieveAtomsInCells( const unsigned& ncells_required,
+                                      const std::vector<unsigned>& cells_required,
+                                      unsigned& natomsper, std::vector<unsigned>& atoms, std::vector<Vector>& positions ) const {
+  for(unsigned i=0; i<ncells_required; ++i) {
+    unsigned mybox=cells_required[i];
+    for(unsigned k=lcell_starts[mybox]; k<lcell_starts[mybox+1]; ++k) {
+      unsigned myatom = lcell_lists[k];
+      if( myatom!=atoms[0] ) {
+        atoms[natomsper]=myatom; positions[natomsper]=lcell_positions[k];
+        natomsper++;
+      }
+    }
+  }
+}
+
+void LinkCells::retrieveHalfShellAtoms( const unsigned& k, std::vector<unsigned>& cells_required, unsigned& natomsper, std::vector<unsigned>& atoms ) const {
+  plumed_dbg_assert( canUseHalfShell() );
+  // Find the cell that contains the k-th atom
+  unsigned mybox=std::upper_bound( lcell_starts.begin(), lcell_starts.end(), k ) - lcell_starts.begin() - 1;
+  // The atoms after this one in its own cell
+  for(unsigned j=k+1; j<lcell_starts[mybox+1]; ++j) { atoms[natomsper]=lcell_lists[j]; natomsper++; }
+  // And all the atoms in the cells in front of this one
+  std::array<unsigned,3> celn;
+  celn[2] = mybox / nstride[2]; celn[1] = ( mybox % nstride[2] ) / nstride[1]; celn[0] = mybox % nstride[1];
+  if( cells_required.size()<13 ) cells_required.resize( 13 );
+  unsigned ncells_required=0;
+  for(int nz=0; nz<2; ++nz) {
+    for(int ny=(nz==0 ? 0 : -1); ny<2; ++ny) {
+      for(int nx=((nz==0 && ny==0) ? 1 : -1); nx<2; ++nx) {
+        int xval = celn[0] + nx, yval = celn[1] + ny, zval = celn[2] + nz;
+        cells_required[ncells_required] = LINKC_PBC(xval,ncells[0])*nstride[0] + LINKC_PBC(yval,ncells[1])*nstride[1] + LINKC_PBC(zval,ncells[2])*nstride[2];
+        ncells_required++;
+      }
+    }
+  }
+  plumed_dbg_assert( ncells_required==13 );
+  for(unsigned i=0; i<ncells_required; ++i) {
+    unsigned obox=cells_required[i];
+    for(unsigned j=lcell_starts[obox]; j<lcell_starts[obox+1]; ++j) { atoms[natomsper]=lcell_lists[j]; natomsper++; }
+  }
+}
+
 std::array<unsigned,3> LinkCells::findMyCell( const Vector& pos ) const {
   Vector fpos=mypbc.realToScaled( pos );
   std::array<unsigned,3> celn;
@@ -172,9 +229,9 @@ unsigned LinkCells::findCell( const Vector& pos ) const {
 }
 
 unsigned LinkCells::getMaxInCell() const {
-  unsigned maxn = lcell_tots[0];
-  for(unsigned i=1; i<lcell_tots.size(); ++i) {
-    if( lcell_tots[i]>maxn ) { maxn=lcell_tots[i]; }
+  unsigned maxn = 0;
+  for(unsigned i=0; i+1<lcell_starts.size(); ++i) {
+    if( lcell_starts[i+1]-lcell_starts[i]>maxn ) { maxn=lcell_starts[i+1]-lcell_starts[i]; }
   }
   return maxn;
 }
@@ -48,12 +48,14 @@ private:
   std::vector<unsigned> nstride;
 /// The list of cells each atom is inside
   std::vector<unsigned> allcells;
-/// The start of each block corresponding to each link cell
+/// The start of each block corresponding to each link cell (the last element is the number of atoms)
   std::vector<unsigned> lcell_starts;
-/// The number of atoms in each link cell
-  std::vector<unsigned> lcell_tots;
 /// The atoms ordered by link cells
   std::vector<unsigned> lcell_lists;
+/// The positions of the atoms ordered by link cells
+  std::vector<Vector> lcell_positions;
+/// The number of atoms in each cell for each of the threads that build the lists
+  std::vector<unsigned> thread_counts;
 public:
 ///
   explicit LinkCells( Communicator& comm );
@@ -82,8 +84,23 @@ public:
   void retrieveAtomsInCells( const unsigned& ncells_required,
                              const std::vector<unsigned>& cells_required,
                              unsigned& natomsper, std::vector<unsigned>& atoms ) const ;
+/// Retrieve the atoms in a list of cells together with their positions, which are read from the cell ordered copy
+  void retrieveAtomsInCells( const unsigned& ncells_required,
+                             const std::vector<unsigned>& cells_required,
+                             unsigned& natomsper, std::vector<unsigned>& atoms, std::vector<Vector>& positions ) const ;
 /// Retrieve the atoms we need to consider
   void retrieveNeighboringAtoms( const Vector& pos, std::vector<unsigned>& cell_list, unsigned& natomsper, std::vector<unsigned>& atoms ) const ;
+/// Can the half shell stencil be used with the current cells (there must be at least three cells in each direction)
+  bool canUseHalfShell() const ;
+/// Get the number of atoms in the cell lists
+  unsigned getNumberOfAtoms() const ;
+/// Get the index of the atom in the k-th position of the cell ordered list
+  unsigned getSortedAtom( const unsigned& k ) const ;
+/// Get the position of the atom in the k-th position of the cell ordered list
+  const Vector& getSortedPosition( const unsigned& k ) const ;
+/// Retrieve the atoms in the half shell around the k-th atom of the cell ordered list.  These are the atoms that come after
+/// it in its own cell and the atoms in the 13 cells in front of its cell, so every pair is only found once.
+  void retrieveHalfShellAtoms( const unsigned& k, std::vector<unsigned>& cells_required, unsigned& natomsper, std::vector<unsigned>& atoms ) const ;
 };
 
 inline
@@ -96,6 +113,26 @@ unsigned LinkCells::getNumberOfCells() const {
   return ncells[0]*ncells[1]*ncells[2];
 }
 
+inline
+bool LinkCells::canUseHalfShell() const {
+  return ncells[0]>2 && ncells[1]>2 && ncells[2]>2;
+}
+
+inline
+unsigned LinkCells::getNumberOfAtoms() const {
+  return lcell_lists.size();
+}
+
+inline
+unsigned LinkCells::getSortedAtom( const unsigned& k ) const {
+  return lcell_lists[k];
+}
+
+inline
+const Vector& LinkCells::getSortedPosition( const unsigned& k ) const {
+  return lcell_positions[k];
+}
+
 }
 
 #endif
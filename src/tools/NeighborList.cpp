@@ -24,6 +24,7 @@
 #include "Pbc.h"
 #include "AtomNumber.h"
 #include "Communicator.h"
+#include "LinkCells.h"
 #include "OpenMP.h"
 #include "Tools.h"
 #include <vector>
@@ -45,7 +46,8 @@ NeighborList::NeighborList(const std::vector<AtomNumber>& list0,
                            const Pbc& pbc,
                            Communicator& cm,
                            const double& distance,
-                           const unsigned& stride)
+                           const unsigned& stride,
+                           const double& skin)
   : reduced(false),
     serial_(serial),
     do_pair_(do_pair),
@@ -56,6 +58,7 @@ NeighborList::NeighborList(const std::vector<AtomNumber>& list0,
     //copy-initialize fullatomlist_
     fullatomlist_(list0),
     distance_(distance),
+    skin_(skin),
     nlist0_(list0.size()),
     nlist1_(list1.size()),
     stride_(stride) {
@@ -78,7 +81,8 @@ NeighborList::NeighborList(const std::vector<AtomNumber>& list0,
                            const Pbc& pbc,
                            Communicator& cm,
                            const double& distance,
-                           const unsigned& stride)
+                           const unsigned& stride,
+                           const double& skin)
   : reduced(false),
     serial_(serial),
     do_pbc_(do_pbc),
@@ -88,6 +92,7 @@ NeighborList::NeighborList(const std::vector<AtomNumber>& list0,
     //copy-initialize fullatomlist_
     fullatomlist_(list0),
     distance_(distance),
+    skin_(skin),
     nlist0_(list0.size()),
     nallpairs_(nlist0_*(nlist0_-1)/2),
     stride_(stride) {
@@ -97,6 +102,12 @@ NeighborList::NeighborList(const std::vector<AtomNumber>& list0,
 NeighborList::~NeighborList()=default;
 
 void NeighborList::initialize() {
+  // With a skin the list is always rebuilt before it is used, so the O(N^2) list of all pairs is not needed
+  neighbor_starts_.assign(nlist0_+1,0);
+  if(skin_<=0.0) setAllPairs();
+}
+
+void NeighborList::setAllPairs() {
 #ifdef __APPLE__
   //this mac-only error is here because on my experience the mac tries to page
   //the memory on the hdd instead of throwing a memory error
@@ -104,7 +115,7 @@ void NeighborList::initialize() {
     //blocking memory allocation on slightly more than 10 GB of memory
     //that is about 1296000000 pairs (36000 atoms)
     //36000 * 36000= 1296000000
-    //each pairIDs occupies 64 bit (where unsigned are 32bit integers)
+    //each pair occupies 64 bit (where unsigned are 32bit integers)
     //4294967296 is max(uint32)+1 and is more than 34 GB (correspond to a system of 65536 atoms)
     if(nallpairs_ > 1296000000 )
       plumed_merror("An error happened while allocating the neighbor "
@@ -112,39 +123,35 @@ void NeighborList::initialize() {
   }
 #endif // __APPLE__
   try {
-    neighbors_.resize(nallpairs_);
+    neighbor_list_.resize(nallpairs_);
+    neighbor_rows_.resize(nallpairs_);
   } catch (...) {
     plumed_error_nested() << "An error happened while allocating the neighbor "
                           "list, please decrease the number of atoms used";
   }
-  //TODO: test if this is feasible for accelerating the loop
-  //#pragma omp parallel for default(shared)
-  for(unsigned int i=0; i<nallpairs_; ++i)
-    neighbors_[i]=getIndexPair(i);
+  // All the possible pairs are stored row by row
+  neighbor_starts_.resize(nlist0_+1); neighbor_starts_[0]=0;
+  unsigned k=0;
+  for(unsigned i=0; i<nlist0_; ++i) {
+    if(twolists_ && do_pair_) {
+      neighbor_rows_[k]=i; neighbor_list_[k]=i+nlist0_; k++;
+    } else if(twolists_) {
+      for(unsigned j=0; j<nlist1_; ++j) { neighbor_rows_[k]=i; neighbor_list_[k]=nlist0_+j; k++; }
+    } else {
+      for(unsigned j=i+1; j<nlist0_; ++j) { neighbor_rows_[k]=i; neighbor_list_[k]=j; k++; }
+    }
+    neighbor_starts_[i+1]=k;
+  }
+  plumed_assert(k==nallpairs_);
 }
 
 std::vector<AtomNumber>& NeighborList::getFullAtomList() {
   return fullatomlist_;
 }
 
-NeighborList::pairIDs NeighborList::getIndexPair(const unsigned ipair) {
-  pairIDs index;
-  if(twolists_ && do_pair_)
-    index=pairIDs(ipair,ipair+nlist0_);
-  else if (twolists_ && !do_pair_)
-    index=pairIDs(ipair/nlist1_,ipair%nlist1_+nlist0_);
-  else if (!twolists_) {
-    unsigned ii = nallpairs_-1-ipair;
-    unsigned  K = unsigned(std::floor((std::sqrt(double(8*ii+1))+1)/2));
-    unsigned jj = ii-K*(K-1)/2;
-    index=pairIDs(nlist0_-1-K,nlist0_-1-jj);
-  }
-  return index;
-}
-
 void NeighborList::update(const std::vector<Vector>& positions) {
-  neighbors_.clear();
-  const double d2=distance_*distance_;
+  const double dlist=distance_+skin_;
+  const double d2=dlist*dlist;
   // check if positions array has the correct length
   plumed_assert(positions.size()==fullatomlist_.size());
 
@@ -156,32 +163,99 @@ void NeighborList::update(const std::vector<Vector>& positions) {
     rank=0;
     nt=1;
   }
+
+  // Link cells are used to find the candidate neighbors whenever there is a cutoff.
+  // The atoms that can appear as neighbors are the ones in the second list (or all atoms if there is one list)
+  const unsigned cstart=twolists_ ? nlist0_ : 0;
+  const bool uselinkcells=!do_pair_ && distance_<1.0e+30 && fullatomlist_.size()>cstart;
+  const bool cellpbc=do_pbc_ && pbc_->isSet();
+  if(uselinkcells) {
+    if(!linkcells_) linkcells_=Tools::make_unique<LinkCells>(comm);
+    linkcells_->setCutoff(dlist);
+    std::vector<Vector> cell_positions(positions.begin()+cstart,positions.end());
+    std::vector<unsigned> cell_indices(cell_positions.size());
+    std::iota(cell_indices.begin(),cell_indices.end(),cstart);
+    if(cellpbc) linkcells_->buildCellLists(cell_positions,cell_indices,*pbc_);
+    else {
+      Pbc box;
+      setBoundingBox(positions,box);
+      linkcells_->buildCellLists(cell_positions,cell_indices,box);
+    }
+  }
+
   std::vector<unsigned> local_flat_nl;
 
-  #pragma omp parallel num_threads(nt)
-  {
-    std::vector<unsigned> private_flat_nl;
-    #pragma omp for nowait
-    for(unsigned int i=rank; i<nallpairs_; i+=stride) {
-      pairIDs index=getIndexPair(i);
-      unsigned index0=index.first;
-      unsigned index1=index.second;
-      Vector distance;
-      if(do_pbc_) {
-        distance=pbc_->distance(positions[index0],positions[index1]);
-      } else {
-        distance=delta(positions[index0],positions[index1]);
+  // With a single list each pair is only needed once so only half the surrounding cells have to be searched
+  if(uselinkcells && !twolists_ && linkcells_->canUseHalfShell()) {
+    #pragma omp parallel num_threads(nt)
+    {
+      std::vector<unsigned> private_flat_nl;
+      std::vector<unsigned> cells_required, candidates(nlist0_);
+      #pragma omp for nowait
+      for(unsigned int k=rank; k<nlist0_; k+=stride) {
+        const unsigned i=linkcells_->getSortedAtom(k);
+        const Vector& ipos(linkcells_->getSortedPosition(k));
+        unsigned ncandidates=0;
+        linkcells_->retrieveHalfShellAtoms(k,cells_required,ncandidates,candidates);
+        for(unsigned jj=0; jj<ncandidates; ++jj) {
+          const unsigned j=candidates[jj];
+          const Vector distance=cellpbc ? pbc_->distance(ipos,positions[j]) : delta(ipos,positions[j]);
+          if(modulo2(distance)<=d2) {
+            private_flat_nl.push_back(i);
+            private_flat_nl.push_back(j);
+          }
+        }
       }
-      double value=modulo2(distance);
-      if(value<=d2) {
-        private_flat_nl.push_back(index0);
-        private_flat_nl.push_back(index1);
+      #pragma omp critical
+      local_flat_nl.insert(local_flat_nl.end(),
+                           private_flat_nl.begin(),
+                           private_flat_nl.end());
+    }
+  } else {
+    #pragma omp parallel num_threads(nt)
+    {
+      std::vector<unsigned> private_flat_nl;
+      std::vector<unsigned> cells_required, candidates;
+      if(uselinkcells) candidates.resize(fullatomlist_.size()-cstart+1);
+      #pragma omp for nowait
+      for(unsigned int i=rank; i<nlist0_; i+=stride) {
+        unsigned ncandidates=0;
+        if(do_pair_) {
+          ncandidates=1;
+        } else if(uselinkcells) {
+          // The first element is ignored when the atoms in the cells are retrieved
+          candidates[0]=i; ncandidates=1;
+          linkcells_->retrieveNeighboringAtoms(positions[i],cells_required,ncandidates,candidates);
+        }
+        const unsigned jstart=(do_pair_ || uselinkcells) ? 0 : (twolists_ ? nlist0_ : i+1);
+        const unsigned jend=(do_pair_ || uselinkcells) ? ncandidates : fullatomlist_.size();
+        for(unsigned jj=jstart; jj<jend; ++jj) {
+          unsigned j=jj;
+          if(do_pair_) j=i+nlist0_;
+          else if(uselinkcells) {
+            if(jj==0) continue;
+            j=candidates[jj];
+            // When there is a single list each pair is only stored once
+            if(!twolists_ && j<=i) continue;
+          }
+          Vector distance;
+          if(do_pbc_) {
+            distance=pbc_->distance(positions[i],positions[j]);
+          } else {
+            distance=delta(positions[i],positions[j]);
+          }
+          double value=modulo2(distance);
+          if(value<=d2) {
+            private_flat_nl.push_back(i);
+            private_flat_nl.push_back(j);
+          }
+        }
       }
+      #pragma omp critical
+      local_flat_nl.insert(local_flat_nl.end(),
+                           private_flat_nl.begin(),
+                           private_flat_nl.end());
     }
-    #pragma omp critical
-    local_flat_nl.insert(local_flat_nl.end(),
-                         private_flat_nl.begin(),
-                         private_flat_nl.end());
   }
 
   // find total dimension of neighborlist
@@ -190,10 +264,6 @@ void NeighborList::update(const std::vector<Vector>& positions) {
   if(!serial_)
     comm.Sum(&local_nl_size[0], stride);
   int tot_size = std::accumulate(local_nl_size.begin(), local_nl_size.end(), 0);
-  if(tot_size==0) {
-    setRequestList();
-    return;
-  }
   // merge
   std::vector<unsigned> merge_nl(tot_size, 0);
   // calculate vector of displacement
@@ -205,7 +275,7 @@ void NeighborList::update(const std::vector<Vector>& positions) {
     disp[i+1] = rank_size;
   }
   // Allgather neighbor list
-  if(comm.initialized()&&!serial_) {
+  if(tot_size>0 && comm.initialized()&&!serial_) {
     comm.Allgatherv((!local_flat_nl.empty()?&local_flat_nl[0]:NULL),
                     local_nl_size[rank],
                     &merge_nl[0],
@@ -213,21 +283,81 @@ void NeighborList::update(const std::vector<Vector>& positions) {
                     &disp[0]);
   } else
     merge_nl = local_flat_nl;
-  // resize neighbor stuff
-  neighbors_.resize(tot_size/2);
-  for(unsigned i=0; i<tot_size/2; i++) {
-    unsigned j=2*i;
-    neighbors_[i] = std::make_pair(merge_nl[j],merge_nl[j+1]);
-  }
+  setPairs(merge_nl);
 
+  // Store the configuration that was used to build the list so we can check the displacements later
+  if(skin_>0.0) {
+    positions_at_update_=positions;
+    if(pbc_->isSet()) box_at_update_=pbc_->getBox();
+  }
   setRequestList();
 }
 
+void NeighborList::setPairs(const std::vector<unsigned>& flat_nl) {
+  // Count the neighbors of each atom
+  neighbor_starts_.assign(nlist0_+1,0);
+  const unsigned npairs=flat_nl.size()/2;
+  for(unsigned i=0; i<npairs; ++i) neighbor_starts_[flat_nl[2*i]+1]++;
+  for(unsigned i=0; i<nlist0_; ++i) neighbor_starts_[i+1]+=neighbor_starts_[i];
+  // And put the neighbors in place (the order of the neighbors of each atom is preserved)
+  neighbor_list_.resize(npairs); neighbor_rows_.resize(npairs);
+  std::vector<unsigned> filled(neighbor_starts_.begin(),neighbor_starts_.end()-1);
+  for(unsigned i=0; i<npairs; ++i) {
+    neighbor_rows_[filled[flat_nl[2*i]]]=flat_nl[2*i];
+    neighbor_list_[filled[flat_nl[2*i]]]=flat_nl[2*i+1];
+    filled[flat_nl[2*i]]++;
+  }
+}
+
+void NeighborList::setBoundingBox(const std::vector<Vector>& positions, Pbc& box) const {
+  // The box is larger than the region that contains the atoms by twice the cutoff, so
+  // no periodic image of an atom is found within the cutoff of another atom
+  Vector pmin(positions[0]), pmax(positions[0]);
+  for(const auto & p : positions) {
+    for(unsigned k=0; k<3; ++k) {
+      pmin[k]=std::min(pmin[k],p[k]);
+      pmax[k]=std::max(pmax[k],p[k]);
+    }
+  }
+  const double dlist=distance_+skin_;
+  Tensor cell;
+  for(unsigned k=0; k<3; ++k) cell[k][k]=pmax[k]-pmin[k]+2.0*dlist;
+  box.setBox(cell);
+}
+
+bool NeighborList::needsUpdate(const std::vector<Vector>& positions) const {
+  if(skin_<=0.0 || positions_at_update_.size()!=positions.size()) return true;
+  // When the box changes the distance between an atom and the periodic image of another atom
+  // changes by at most the sum of the changes of the box vectors (the cutoff is smaller than half the box)
+  double boxchange=0.0;
+  if(do_pbc_ && pbc_->isSet()) {
+    const Tensor& box(pbc_->getBox());
+    for(unsigned i=0; i<3; ++i) boxchange+=delta(box_at_update_.getRow(i),box.getRow(i)).modulo();
+    if(boxchange>=skin_) return true;
+  }
+  // The rest of the skin is shared between the displacements of the two atoms in a pair
+  const double maxdisp=0.5*(skin_-boxchange);
+  const double maxdisp2=maxdisp*maxdisp;
+  unsigned nt=OpenMP::getNumThreads();
+  if(serial_ || nt*10>positions.size()) nt=1;
+  bool moved=false;
+  #pragma omp parallel for num_threads(nt) reduction(||:moved)
+  for(unsigned i=0; i<positions.size(); ++i) {
+    Vector disp;
+    if(do_pbc_) disp=pbc_->distance(positions_at_update_[i],positions[i]);
+    else disp=delta(positions_at_update_[i],positions[i]);
+    if(modulo2(disp)>maxdisp2) moved=true;
+  }
+  return moved;
+}
+
 void NeighborList::setRequestList() {
   requestlist_.clear();
-  for(unsigned int i=0; i<size(); ++i) {
-    requestlist_.push_back(fullatomlist_[neighbors_[i].first]);
-    requestlist_.push_back(fullatomlist_[neighbors_[i].second]);
+  for(unsigned i=0; i<nlist0_; ++i) {
+    if(neighbor_starts_[i+1]==neighbor_starts_[i]) continue;
+    requestlist_.push_back(fullatomlist_[i]);
+    for(unsigned k=neighbor_starts_[i]; k<neighbor_starts_[i+1]; ++k)
+      requestlist_.push_back(fullatomlist_[neighbor_list_[k]]);
   }
   Tools::removeDuplicates(requestlist_);
   reduced=false;
@@ -235,17 +365,12 @@ void NeighborList::setRequestList() {
 
 std::vector<AtomNumber>& NeighborList::getReducedAtomList() {
   if(!reduced) {
-    for(unsigned int i=0; i<size(); ++i) {
-      AtomNumber index0=fullatomlist_[neighbors_[i].first];
-      AtomNumber index1=fullatomlist_[neighbors_[i].second];
 // I exploit the fact that requestlist_ is an ordered vector
-      auto p = std::find(requestlist_.begin(), requestlist_.end(), index0);
-      plumed_dbg_assert(p!=requestlist_.end());
-      unsigned newindex0=p-requestlist_.begin();
-      p = std::find(requestlist_.begin(), requestlist_.end(), index1);
-      plumed_dbg_assert(p!=requestlist_.end());
-      unsigned newindex1=p-requestlist_.begin();
-      neighbors_[i]=pairIDs(newindex0,newindex1);
+// The compressed list keeps the indices in the full list so only the map to the new indices is needed
+    reduced_index_.resize(fullatomlist_.size());
+    for(unsigned i=0; i<fullatomlist_.size(); ++i) {
+      auto p = std::lower_bound(requestlist_.begin(), requestlist_.end(), fullatomlist_[i]);
+      reduced_index_[i]=p-requestlist_.begin();
     }
   }
   reduced=true;
@@ -264,29 +389,33 @@ void NeighborList::setLastUpdate(const unsigned step) {
   lastupdate_=step;
 }
 
-unsigned NeighborList::size() const {
-  return neighbors_.size();
+double NeighborList::distance() const {
+  return distance_;
 }
 
-NeighborList::pairIDs NeighborList::getClosePair(const unsigned i) const {
-  return neighbors_[i];
+double NeighborList::getSkin() const {
+  return skin_;
 }
 
 NeighborList::pairAtomNumbers
 NeighborList::getClosePairAtomNumber(const unsigned i) const {
   pairAtomNumbers Aneigh=pairAtomNumbers(
-                           fullatomlist_[neighbors_[i].first],
-                           fullatomlist_[neighbors_[i].second]);
+                           fullatomlist_[neighbor_rows_[i]],
+                           fullatomlist_[neighbor_list_[i]]);
   return Aneigh;
 }
 
 std::vector<unsigned> NeighborList::getNeighbors(const unsigned index) {
   std::vector<unsigned> neighbors;
-  for(unsigned int i=0; i<size(); ++i) {
-    if(neighbors_[i].first==index)
-      neighbors.push_back(neighbors_[i].second);
-    if(neighbors_[i].second==index)
-      neighbors.push_back(neighbors_[i].first);
+  for(unsigned i=0; i<getNumberOfRows(); ++i) {
+    const unsigned i0=getRowAtom(i);
+    for(unsigned k=neighbor_starts_[i]; k<neighbor_starts_[i+1]; ++k) {
+      const unsigned i1=getColumnAtom(k);
+      if(i0==index)
+        neighbors.push_back(i1);
+      if(i1==index)
+        neighbors.push_back(i0);
+    }
   }
   return neighbors;
 }
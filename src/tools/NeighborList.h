@@ -23,17 +23,32 @@
 #define __PLUMED_tools_NeighborList_h
 
 #include "Vector.h"
+#include "Tensor.h"
 #include "AtomNumber.h"
 
 #include <vector>
+#include <memory>
 
 namespace PLMD {
 
 class Pbc;
 class Communicator;
+class LinkCells;
 
 /// \ingroup TOOLBOX
 /// A class that implements neighbor lists from two lists or a single list of atoms
+///
+/// The close pairs are stored in compressed sparse row format.  The rows are the atoms
+/// in the first list and the columns are the neighbors of each of these atoms.
+/// The row of each pair is also stored so that getClosePair(i) costs O(1).
+/// The constructor stores all the possible pairs, unless a skin is set: in that case the list
+/// is empty until the first call to update().
+/// When a cutoff is set the list is built with link cells so the cost of an update grows
+/// linearly with the number of atoms.  Without periodic boundary conditions the cells
+/// are set up in a box that contains all the atoms.
+/// If a skin is set the list is built using the cutoff plus the skin and needsUpdate()
+/// can be used to rebuild the list only when the atoms have moved, or the box has changed,
+/// by more than the skin allows.
 class NeighborList {
 public:
   using pairIDs=std::pair<unsigned,unsigned>;
@@ -41,27 +56,45 @@ public:
 private:
   bool reduced=false;
   bool serial_;
-  bool do_pair_;
+  bool do_pair_=false;
   bool do_pbc_;
   bool twolists_;
   const PLMD::Pbc* pbc_;
   Communicator& comm;
   std::vector<PLMD::AtomNumber> fullatomlist_{};
   std::vector<PLMD::AtomNumber> requestlist_{};
-  std::vector<pairIDs > neighbors_{};
+/// The start of the block of neighbors of each row (size is number of rows plus one)
+  std::vector<unsigned> neighbor_starts_{};
+/// The indices of the neighbors in the full list of atoms
+  std::vector<unsigned> neighbor_list_{};
+/// The row of each pair in neighbor_list_
+  std::vector<unsigned> neighbor_rows_{};
+/// The index of each atom in the reduced list of atoms
+  std::vector<unsigned> reduced_index_{};
   double distance_;
+  double skin_=0.0;
   size_t nlist0_=0;
   size_t nlist1_=0;
   size_t nallpairs_;
   unsigned stride_=0;
   unsigned lastupdate_=0;
+/// The link cells that are used to build the list
+  std::unique_ptr<LinkCells> linkcells_;
+/// The positions and the box at the time of the last update
+  std::vector<PLMD::Vector> positions_at_update_{};
+  Tensor box_at_update_;
 /// Initialize the neighbor list with all possible pairs
   void initialize();
-/// Return the pair of indexes in the positions array
-/// of the two atoms forming the i-th pair among all possible pairs
-  pairIDs getIndexPair(unsigned i);
+/// Fill the list with all the possible pairs
+  void setAllPairs();
+/// Set up a box that contains all the atoms, so that link cells can be used without periodic boundary conditions
+  void setBoundingBox(const std::vector<PLMD::Vector>& positions, Pbc& box) const;
+/// Build the compressed storage from a flat list of pairs
+  void setPairs(const std::vector<unsigned>& flat_nl);
 /// Extract the list of atoms from the current list of close pairs
   void setRequestList();
+/// Convert an index in the full list of atoms into an index in the positions array
+  unsigned getPositionIndex(unsigned i) const;
 public:
   NeighborList(const std::vector<PLMD::AtomNumber>& list0,
                const std::vector<PLMD::AtomNumber>& list1,
@@ -71,14 +104,16 @@ public:
                const PLMD::Pbc& pbc,
                Communicator &cm,
                const double& distance=1.0e+30,
-               const unsigned& stride=0);
+               const unsigned& stride=0,
+               const double& skin=0.0);
   NeighborList(const std::vector<PLMD::AtomNumber>& list0,
                const bool& serial,
                const bool& do_pbc,
                const PLMD::Pbc& pbc,
                Communicator &cm,
                const double& distance=1.0e+30,
-               const unsigned& stride=0);
+               const unsigned& stride=0,
+               const double& skin=0.0);
   ~NeighborList();
 /// Return the list of all atoms. These are needed to rebuild the neighbor list.
   std::vector<PLMD::AtomNumber>& getFullAtomList();
@@ -89,6 +124,9 @@ public:
 /// Update the neighbor list and prepare the new
 /// list of atoms that will be requested to the main code
   void update(const std::vector<PLMD::Vector>& positions);
+/// Check if the list has to be rebuilt because the atoms have moved, or the box has changed,
+/// by more than the skin allows since the last update (positions should contain the full list of atoms)
+  bool needsUpdate(const std::vector<PLMD::Vector>& positions) const;
 /// Get the update stride of the neighbor list
   unsigned getStride() const;
 /// Get the last step in which the neighbor list was updated
@@ -99,14 +137,59 @@ public:
   unsigned size() const;
 /// Get the distance used to create the neighbor list
   double distance() const;
+/// Get the skin that is added to the distance when the list is built
+  double getSkin() const;
 /// Get the i-th pair of the neighbor list
   pairIDs getClosePair(unsigned i) const;
+/// Get the number of rows in the compressed list
+  unsigned getNumberOfRows() const;
+/// Get the index of the first pair in row i (getRowStart(getNumberOfRows()) is the number of pairs)
+  unsigned getRowStart(unsigned i) const;
+/// Get the index in the positions array of the atom for row i
+  unsigned getRowAtom(unsigned i) const;
+/// Get the index in the positions array of the second atom in the i-th pair
+  unsigned getColumnAtom(unsigned i) const;
 /// Get the list of neighbors of the i-th atom
   std::vector<unsigned> getNeighbors(unsigned i);
 /// Get the i-th pair of AtomNumbers from the neighbor list
   pairAtomNumbers getClosePairAtomNumber(unsigned i) const;
 };
 
+inline
+unsigned NeighborList::getPositionIndex(const unsigned i) const {
+  return reduced ? reduced_index_[i] : i;
+}
+
+inline
+unsigned NeighborList::getNumberOfRows() const {
+  return neighbor_starts_.size()-1;
+}
+
+inline
+unsigned NeighborList::size() const {
+  return neighbor_list_.size();
+}
+
+inline
+NeighborList::pairIDs NeighborList::getClosePair(const unsigned i) const {
+  return pairIDs(getRowAtom(neighbor_rows_[i]),getColumnAtom(i));
+}
+
+inline
+unsigned NeighborList::getRowStart(const unsigned i) const {
+  return neighbor_starts_[i];
+}
+
+inline
+unsigned NeighborList::getRowAtom(const unsigned i) const {
+  return getPositionIndex(i);
+}
+
+inline
+unsigned NeighborList::getColumnAtom(const unsigned i) const {
+  return getPositionIndex(neighbor_list_[i]);
+}
+
 } // namespace PLMD
 
 #endif //__PLUMED_tools_NeighborList_h }
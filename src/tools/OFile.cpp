@@ -33,6 +33,8 @@
 #include <string>
 #include <cstdlib>
 #include <cerrno>
+#include <cctype>
+#include <cstdint>
 
 #include <memory>
 #include <utility>
@@ -74,6 +76,8 @@ size_t OFile::llwrite(const char*ptr,size_t s) {
 
 OFile::OFile():
   linked(NULL),
+  binaryAllowed(false),
+  binary(false),
   fieldChanged(false),
   backstring("bck"),
   enforceRestart_(false),
@@ -128,8 +132,14 @@ int OFile::printf(const char*fmt,...) {
   char*psearch=p1+actual_buffer_length;
   actual_buffer_length+=r;
   while((p2=std::strchr(psearch,'\n'))) {
-    if(linePrefix.length()>0) llwrite(linePrefix.c_str(),linePrefix.length());
-    llwrite(p1,p2-p1+1);
+    if(binary) {
+// binary files only contain fields, empty lines (e.g. separating rows of grids) are dropped
+      for(char* p=p1; p<p2; p++) if(!std::isspace(static_cast<unsigned char>(*p)))
+          plumed_merror("file " + getPath() + ": only fields can be written in binary files, cannot write line:\n" + std::string(p1,p2-p1));
+    } else {
+      if(linePrefix.length()>0) llwrite(linePrefix.c_str(),linePrefix.length());
+      llwrite(p1,p2-p1+1);
+    }
     actual_buffer_length-=(p2-p1)+1;
     p1=p2+1;
     psearch=p1;
@@ -168,42 +178,49 @@ OFile& OFile::printField(const std::string&name,double v) {
 // The distinction between +nan and -nan is not well defined
 // Always printing nan simplifies some regtest (special functions computed our of range).
   if(std::isnan(v)) v=std::numeric_limits<double>::quiet_NaN();
+  if(binary) return printBinaryField(name,v,0,'d');
   std::snprintf(buffer_string.data(),buffer_string.size(),fieldFmt.c_str(),v);
   printField(name,buffer_string.data());
   return *this;
 }
 
 OFile& OFile::printField(const std::string&name,int v) {
+  if(binary) return printBinaryField(name,0.0,static_cast<long long int>(v),'i');
   std::snprintf(buffer_string.data(),buffer_string.size()," %d",v);
   printField(name,buffer_string.data());
   return *this;
 }
 
 OFile& OFile::printField(const std::string&name,long int v) {
+  if(binary) return printBinaryField(name,0.0,static_cast<long long int>(v),'i');
   std::snprintf(buffer_string.data(),buffer_string.size()," %ld",v);
   printField(name,buffer_string.data());
   return *this;
 }
 
 OFile& OFile::printField(const std::string&name,long long int v) {
+  if(binary) return printBinaryField(name,0.0,static_cast<long long int>(v),'i');
   std::snprintf(buffer_string.data(),buffer_string.size()," %lld",v);
   printField(name,buffer_string.data());
   return *this;
 }
 
 OFile& OFile::printField(const std::string&name,unsigned v) {
+  if(binary) return printBinaryField(name,0.0,static_cast<long long int>(v),'i');
   std::snprintf(buffer_string.data(),buffer_string.size()," %u",v);
   printField(name,buffer_string.data());
   return *this;
 }
 
 OFile& OFile::printField(const std::string&name,long unsigned v) {
+  if(binary) return printBinaryField(name,0.0,static_cast<long long int>(v),'i');
   std::snprintf(buffer_string.data(),buffer_string.size()," %lu",v);
   printField(name,buffer_string.data());
   return *this;
 }
 
 OFile& OFile::printField(const std::string&name,long long unsigned v) {
+  if(binary) return printBinaryField(name,0.0,static_cast<long long int>(v),'i');
   std::snprintf(buffer_string.data(),buffer_string.size()," %llu",v);
   printField(name,buffer_string.data());
   return *this;
@@ -212,6 +229,12 @@ OFile& OFile::printField(const std::string&name,long long unsigned v) {
 OFile& OFile::printField(const std::string&name,const std::string & v) {
   unsigned i;
   for(i=0; i<const_fields.size(); i++) if(const_fields[i].name==name) break;
+  if(i>=const_fields.size() && binary) {
+// variable fields of binary files are numbers
+    double d;
+    if(!Tools::convertNoexcept(v,d)) plumed_merror("file " + getPath() + ": field " + name + " cannot be written in a binary file since its value " + v + " is not a number");
+    return printBinaryField(name,d,0,'d');
+  }
   if(i>=const_fields.size()) {
     Field field;
     field.name=name;
@@ -224,6 +247,58 @@ OFile& OFile::printField(const std::string&name,const std::string & v) {
   return *this;
 }
 
+OFile& OFile::printBinaryField(const std::string&name,double d,long long int n,char type) {
+  for(const auto & f : const_fields) if(f.name==name) {
+// constant fields are stored as text in the headers
+      if(type=='i') {
+        std::snprintf(buffer_string.data(),buffer_string.size()," %lld",n);
+      } else {
+        std::snprintf(buffer_string.data(),buffer_string.size(),fieldFmt.c_str(),d);
+      }
+      return printField(name,std::string(buffer_string.data()));
+    }
+  Field field;
+  field.name=name;
+  field.type=type;
+  field.number=d;
+  field.integer=n;
+  fields.push_back(field);
+  return *this;
+}
+
+namespace {
+void appendBinary(std::vector<char>&buffer,std::uint32_t n) {
+  char c[4];
+  std::memcpy(c,&n,4);
+  FileBase::toLittleEndian(c,4);
+  buffer.insert(buffer.end(),c,c+4);
+}
+
+void appendBinary(std::vector<char>&buffer,const std::string&str) {
+  appendBinary(buffer,static_cast<std::uint32_t>(str.length()));
+  buffer.insert(buffer.end(),str.begin(),str.end());
+}
+}
+
+void OFile::writeBinaryHeader() {
+  std::vector<char> header(1,'H');
+  appendBinary(header,static_cast<std::uint32_t>(fields.size()));
+  for(const auto & f : fields) {
+    appendBinary(header,f.name);
+    header.push_back(f.type);
+  }
+  appendBinary(header,static_cast<std::uint32_t>(const_fields.size()));
+  for(const auto & f : const_fields) {
+    appendBinary(header,f.name);
+    appendBinary(header,f.value);
+  }
+  llwrite(header.data(),header.size());
+}
+
+void OFile::writeBinaryMagic() {
+  llwrite(binaryMagic,sizeof(binaryMagic));
+}
+
 OFile& OFile::setupPrintValue( Value *val ) {
   if( val->isPeriodic() ) {
     addConstantField("min_" + val->getName() );
@@ -247,12 +322,28 @@ OFile& OFile::printField() {
   if(fieldChanged || fields.size()!=previous_fields.size()) {
     reprint=true;
   } else for(unsigned i=0; i<fields.size(); i++) {
-      if( previous_fields[i].name!=fields[i].name ||
+      if( previous_fields[i].name!=fields[i].name || (binary && previous_fields[i].type!=fields[i].type) ||
           (fields[i].constant && fields[i].value!=previous_fields[i].value) ) {
         reprint=true;
         break;
       }
     }
+  if(binary) {
+    if(reprint) writeBinaryHeader();
+    binaryRecord.resize(1+8*fields.size());
+    binaryRecord[0]='R';
+    for(unsigned i=0; i<fields.size(); i++) {
+      char* p=&binaryRecord[1+8*i];
+      if(fields[i].type=='i') std::memcpy(p,&fields[i].integer,8);
+      else std::memcpy(p,&fields[i].number,8);
+      toLittleEndian(p,8);
+    }
+    llwrite(binaryRecord.data(),binaryRecord.size());
+    previous_fields=fields;
+    fields.clear();
+    fieldChanged=false;
+    return *this;
+  }
   if(reprint) {
     printf("#! FIELDS");
     for(unsigned i=0; i<fields.size(); i++) printf(" %s",fields[i].name.c_str());
@@ -327,6 +418,7 @@ OFile& OFile::open(const std::string&path) {
   gzfp=NULL;
   this->path=path;
   this->path=appendSuffix(path,getSuffix());
+  binary=binaryAllowed && Tools::extension(this->path)=="bin";
   if(checkRestart()) {
     fp=std::fopen(const_cast<char*>(this->path.c_str()),"a");
     mode="a";
@@ -337,6 +429,8 @@ OFile& OFile::open(const std::string&path) {
       plumed_merror("file " + getPath() + ": trying to use a gz file without zlib being linked");
 #endif
     }
+// appending to an empty binary file
+    if(binary && fp && std::fseek(fp,0,SEEK_END)==0 && std::ftell(fp)==0) writeBinaryMagic();
   } else {
     backupFile( backstring, this->path );
     if(comm)comm->Barrier();
@@ -349,6 +443,7 @@ OFile& OFile::open(const std::string&path) {
       plumed_merror("file " + getPath() + ": trying to use a gz file without zlib being linked");
 #endif
     }
+    if(binary) writeBinaryMagic();
   }
   if(plumed) plumed->insertFile(*this);
   return *this;
@@ -384,6 +479,7 @@ OFile& OFile::rewind() {
     // no exception here
     fp=std::fopen(const_cast<char*>(path.c_str()),"w");
   }
+  if(binary) writeBinaryMagic();
   return *this;
 }
 
@@ -432,5 +528,10 @@ OFile& OFile::enforceBackup() {
   return *this;
 }
 
+OFile& OFile::allowBinary() {
+  binaryAllowed=true;
+  return *this;
+}
+
 
 }
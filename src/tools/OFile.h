@@ -80,6 +80,25 @@ keyword. Thus, everytime it is modified, all the headers are repeated in the out
 - most methods return a reference to the OFile itself, to allow chaining many calls on the same line
 (this is similar to << operator in std::ostream)
 
+\section binary-ofile Binary files
+
+When the name of the file has extension `bin` and allowBinary() was called before opening it,
+fields are written in a binary format instead of text. Other files with extension `bin` are written as text,
+and IFile reads them correctly since it recognizes binary files from their content.
+The file starts with the 8 characters `PLMDBIN1` and is followed by a sequence of blocks, each one
+starting with a single character:
+- `H` is a header, written every time the list of fields or the value of a constant field changes.
+It contains the number of fields as a 4 bytes unsigned integer and, for each field, its name
+(4 bytes length followed by the characters) and its type (`d` for double, `i` for 64 bits integer),
+then the number of constant fields followed by their names and values (both stored as strings).
+- `R` is a record, containing the values of all the fields in the order of the header, 8 bytes each.
+
+All numbers are little-endian. Since all records following a header have the same width,
+these files can be read by IFile (or by other tools) without any parsing.
+Only fielded output can be written in binary files: printf() is only allowed to write empty lines, that are ignored.
+For this reason allowBinary() should only be called by writers that do not use printf() otherwise.
+Currently these are \ref PRINT and \ref convert-colvar.
+
 \section using-correctly-ofile Using correctly OFile in PLUMED
 
 When a OFile object is used in PLUMED it can be convenient to link() it
@@ -164,7 +183,24 @@ class OFile:
 /// Class identifying a single field for fielded output
   class Field:
     public FieldBase {
+  public:
+/// Type in binary files, 'd' for double and 'i' for integer
+    char type='d';
+    double number=0.0;
+    long long int integer=0;
   };
+/// True if the file can be written in binary format, see allowBinary()
+  bool binaryAllowed;
+/// True if the file is written in binary format
+  bool binary;
+/// Buffer for records of binary files
+  std::vector<char> binaryRecord;
+/// Set the value of a numeric field of a binary file
+  OFile& printBinaryField(const std::string&,double,long long int,char type);
+/// Write the header of a binary file
+  void writeBinaryHeader();
+/// Write the magic number at the beginning of a binary file
+  void writeBinaryMagic();
 /// Low-level write
   std::size_t llwrite(const char*,std::size_t);
 /// True if fields has changed.
@@ -269,6 +305,9 @@ public:
   OFile&enforceRestart();
 /// Enforce backup, even if the attached plumed object is restarting.
   OFile&enforceBackup();
+/// Write the file in binary format if its name has extension bin.
+/// Must be called before open(), only by writers that write fields and empty lines.
+  OFile&allowBinary();
 };
 
 /// Write using << syntax
@@ -0,0 +1,220 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2012-2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "Profiler.h"
+#include "Exception.h"
+#include "OFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <utility>
+
+#if defined(__linux__) && __has_include(<linux/perf_event.h>)
+#define __PLUMED_PROFILER_PERF
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace PLMD {
+
+#ifdef __PLUMED_PROFILER_PERF
+namespace {
+/// Open a counter for the calling thread, returns -1 on failure.
+/// The counter is not inherited by the OpenMP threads, since their pool can be created before
+/// the counter is opened, and inherited counters cannot be read as a group on older kernels
+int openPerfCounter(unsigned long long config,int group) {
+  perf_event_attr attr;
+  std::memset(&attr,0,sizeof(attr));
+  attr.type=PERF_TYPE_HARDWARE;
+  attr.size=sizeof(attr);
+  attr.config=config;
+  attr.disabled=(group<0?1:0);
+  attr.exclude_kernel=1;
+  attr.exclude_hv=1;
+  attr.read_format=PERF_FORMAT_GROUP;
+  return static_cast<int>(syscall(__NR_perf_event_open,&attr,0,-1,group,0));
+}
+}
+#endif
+
+Profiler::Scope::Scope(Profiler* profiler,long long int step,Phase phase,const std::string* label):
+  profiler(profiler)
+{
+  event.step=step;
+  event.phase=phase;
+  event.label=label;
+  profiler->readCounters(event.cycles,event.instructions);
+  event.start=profiler->now();
+}
+
+Profiler::Scope::Scope(Scope&& other) noexcept:
+  profiler(other.profiler),
+  event(other.event)
+{
+  other.profiler=nullptr;
+}
+
+Profiler::Scope& Profiler::Scope::operator=(Scope&& other) noexcept {
+  if(this!=&other) {
+    profiler=other.profiler;
+    event=other.event;
+    other.profiler=nullptr;
+  }
+  return *this;
+}
+
+Profiler::Scope::~Scope() {
+  if(!profiler) return;
+  event.end=profiler->now();
+  long long int cycles=0,instructions=0;
+  profiler->readCounters(cycles,instructions);
+  event.cycles=cycles-event.cycles;
+  event.instructions=instructions-event.instructions;
+  profiler->record(event);
+}
+
+Profiler::Profiler(std::size_t capacity):
+  buffer(capacity),
+  origin(std::chrono::steady_clock::now())
+{
+  plumed_massert(capacity>0,"the profiler needs space for at least one event");
+#ifdef __PLUMED_PROFILER_PERF
+// counters are not available e.g. when /proc/sys/kernel/perf_event_paranoid forbids them,
+// in this case only times are recorded
+  perfFd=openPerfCounter(PERF_COUNT_HW_CPU_CYCLES,-1);
+  if(perfFd>=0) {
+    perfFdInstructions=openPerfCounter(PERF_COUNT_HW_INSTRUCTIONS,perfFd);
+    if(perfFdInstructions<0) {
+      close(perfFd);
+      perfFd=-1;
+    } else {
+      ioctl(perfFd,PERF_EVENT_IOC_RESET,PERF_IOC_FLAG_GROUP);
+      ioctl(perfFd,PERF_EVENT_IOC_ENABLE,PERF_IOC_FLAG_GROUP);
+    }
+  }
+#endif
+}
+
+Profiler::~Profiler() {
+#ifdef __PLUMED_PROFILER_PERF
+  if(perfFdInstructions>=0) close(perfFdInstructions);
+  if(perfFd>=0) close(perfFd);
+#endif
+}
+
+long long int Profiler::now() const {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-origin).count();
+}
+
+void Profiler::readCounters(long long int & cycles,long long int & instructions) const {
+  cycles=0;
+  instructions=0;
+#ifdef __PLUMED_PROFILER_PERF
+  if(perfFd<0) return;
+  unsigned long long values[3]; // number of counters, then their values
+  if(read(perfFd,values,sizeof(values))==static_cast<ssize_t>(sizeof(values))) {
+    cycles=values[1];
+    instructions=values[2];
+  }
+#endif
+}
+
+void Profiler::record(const Event& event) {
+// single producer: the slot is written before the new head is published
+  const std::size_t n=head.load(std::memory_order_relaxed);
+  buffer[n%buffer.size()]=event;
+  head.store(n+1,std::memory_order_release);
+}
+
+std::size_t Profiler::size() const {
+  return std::min(head.load(std::memory_order_acquire),buffer.size());
+}
+
+std::size_t Profiler::dropped() const {
+  const std::size_t n=head.load(std::memory_order_acquire);
+  return n>buffer.size()?n-buffer.size():0;
+}
+
+std::vector<Profiler::Event> Profiler::getEvents() const {
+  const std::size_t n=head.load(std::memory_order_acquire);
+  const std::size_t first=(n>buffer.size()?n-buffer.size():0);
+  std::vector<Event> events;
+  events.reserve(n-first);
+  for(std::size_t i=first; i<n; i++) events.push_back(buffer[i%buffer.size()]);
+  return events;
+}
+
+const char* Profiler::getPhaseName(Phase phase) {
+  switch(phase) {
+  case Phase::prepare: return "prepare";
+  case Phase::share: return "share";
+  case Phase::wait: return "wait";
+  case Phase::retrieveAtoms: return "retrieveAtoms";
+  case Phase::calculate: return "calculate";
+  case Phase::apply: return "apply";
+  case Phase::update: return "update";
+  }
+  return "unknown";
+}
+
+namespace {
+std::string jsonEscape(const std::string & s) {
+  std::string r;
+  for(const auto c : s) {
+    if(c=='"' || c=='\\') r+='\\';
+    r+=c;
+  }
+  return r;
+}
+}
+
+void Profiler::writeChromeTrace(OFile& ofile,int pid) const {
+  const auto events=getEvents();
+  ofile.printf("{\"traceEvents\":[\n");
+  for(std::size_t i=0; i<events.size(); i++) {
+    const auto & e(events[i]);
+    const std::string phase(getPhaseName(e.phase));
+    const std::string name(e.label?jsonEscape(*e.label):phase);
+    ofile.printf("{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"step\":%lld",
+                 name.c_str(),phase.c_str(),pid,e.start*1e-3,(e.end-e.start)*1e-3,e.step);
+    if(hasCounters()) ofile.printf(",\"cycles\":%lld,\"instructions\":%lld",e.cycles,e.instructions);
+    ofile.printf("}}%s\n",(i+1<events.size()?",":""));
+  }
+  ofile.printf("],\"displayTimeUnit\":\"ns\"");
+  if(hasCounters()) ofile.printf(",\"otherData\":{\"counters\":\"cycles and instructions of the thread that calls PLUMED only\"}");
+  ofile.printf("}\n");
+}
+
+void Profiler::writeFoldedStacks(OFile& ofile) const {
+  std::map<std::string,long long int> total;
+  for(const auto & e : getEvents()) {
+    std::string stack=std::string("plumed;")+getPhaseName(e.phase);
+    if(e.label) stack+=";"+*e.label;
+    total[stack]+=e.end-e.start;
+  }
+// folded stacks expect integer counts, microseconds are used
+  for(const auto & t : total) ofile.printf("%s %lld\n",t.first.c_str(),(t.second+500)/1000);
+}
+
+}
@@ -0,0 +1,129 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2012-2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#ifndef __PLUMED_tools_Profiler_h
+#define __PLUMED_tools_Profiler_h
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace PLMD {
+
+class OFile;
+
+/**
+\ingroup TOOLBOX
+Records timed events of the phases of each step.
+
+Each event stores the step, the phase, the label of the action (if any), its start and end time
+and, where Linux perf events are available, the number of cycles and instructions spent in it
+by the thread that created the profiler (the work of other threads is not counted).
+Events are stored in a ring buffer of fixed size, so that only the most recent ones are kept
+and recording never allocates memory. Events are meant to be recorded by a single thread,
+and the buffer can be read at any time without locks.
+
+Recorded events can be written as a Chrome trace (to be opened with chrome://tracing or https://ui.perfetto.dev)
+or as folded stacks (to be processed with flamegraph.pl).
+
+\verbatim
+Profiler profiler(100000);
+{
+  auto s=profiler.scope(step,Profiler::Phase::calculate,&label);
+  // do work
+}
+\endverbatim
+*/
+class Profiler {
+public:
+/// Phases of a step
+  enum class Phase : unsigned char { prepare, share, wait, retrieveAtoms, calculate, apply, update };
+/// A recorded event
+  struct Event {
+    long long int step=0;
+    long long int start=0;
+    long long int end=0;
+    long long int cycles=0;
+    long long int instructions=0;
+    const std::string* label=nullptr;
+    Phase phase=Phase::prepare;
+  };
+/// Records an event when it goes out of scope.
+/// A default constructed Scope records nothing.
+  class Scope {
+    friend class Profiler;
+    Profiler* profiler=nullptr;
+    Event event;
+    Scope(Profiler* profiler,long long int step,Phase phase,const std::string* label);
+  public:
+    Scope() = default;
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+    Scope(Scope&&) noexcept;
+    Scope& operator=(Scope&&) noexcept;
+    ~Scope();
+  };
+private:
+  std::vector<Event> buffer;
+/// Total number of recorded events, the last buffer.size() are stored
+  std::atomic<std::size_t> head{0};
+  std::chrono::time_point<std::chrono::steady_clock> origin;
+/// File descriptor of the perf events group, -1 if not available
+  int perfFd=-1;
+  int perfFdInstructions=-1;
+/// Read hardware counters
+  void readCounters(long long int & cycles,long long int & instructions) const;
+  long long int now() const;
+  void record(const Event&);
+public:
+/// Create a profiler keeping the last capacity events
+  explicit Profiler(std::size_t capacity);
+  ~Profiler();
+  Profiler(const Profiler&) = delete;
+  Profiler& operator=(const Profiler&) = delete;
+/// Start timing an event, it is recorded when the returned object goes out of scope.
+/// label should stay valid until the events are written
+  Scope scope(long long int step,Phase phase,const std::string* label=nullptr) {
+    return Scope(this,step,phase,label);
+  }
+/// True if hardware counters are recorded
+  bool hasCounters() const {
+    return perfFd>=0;
+  }
+/// Number of stored events
+  std::size_t size() const;
+/// Number of events that were dropped because the buffer was full
+  std::size_t dropped() const;
+/// Get the stored events, oldest first
+  std::vector<Event> getEvents() const;
+/// Name of a phase
+  static const char* getPhaseName(Phase);
+/// Write stored events in Chrome trace format, pid is used to distinguish processes
+  void writeChromeTrace(OFile&,int pid=0) const;
+/// Write the total time (in microseconds) spent in each phase and action as folded stacks
+  void writeFoldedStacks(OFile&) const;
+};
+
+}
+
+#endif
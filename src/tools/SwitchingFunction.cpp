@@ -221,6 +221,11 @@ double baseSwitch::calculateSqr(double distance2,double&dfunc) const {
   double res= calculate(std::sqrt(distance2),dfunc);//RVO!
   return res;
 }
+
+void baseSwitch::calculateSqrBatch(const double* distance2, double* res, double* dfunc, unsigned n) const {
+  for(unsigned i=0; i<n; ++i) res[i]=calculateSqr(distance2[i],dfunc[i]);
+}
+
 double baseSwitch::get_d0() const {return d0;}
 double baseSwitch::get_r0() const {return 1.0/invr0;}
 double baseSwitch::get_dmax() const {return dmax;}
@@ -290,6 +295,17 @@ public:
     return result;
 
   }
+
+  void calculateSqrBatch(const double* distance2, double* res, double* dfunc, unsigned n) const override {
+    #pragma omp simd
+    for(unsigned i=0; i<n; ++i) {
+      double df=0.0;
+      const double r=doRational<N/2>(distance2[i]*invr0_2,df);
+      const bool inside=distance2[i] <= dmax_2;
+      res[i]=inside ? r*stretch+shift : 0.0;
+      dfunc[i]=inside ? df*2*invr0_2*stretch : 0.0;
+    }
+  }
 };
 
 //these enums are useful for clarifying the settings in the factory
@@ -386,6 +402,23 @@ public:
       return res;
     }
   }
+
+  void calculateSqrBatch(const double* distance2, double* res, double* dfunc, unsigned n) const override {
+    if constexpr (isFast==rationalPow::fast) {
+      #pragma omp simd
+      for(unsigned i=0; i<n; ++i) {
+        double df=preDfuncF;
+        const double r=doRational(distance2[i]*invr0_2,df,preSecDevF,nnf,mmf,preRes);
+        const bool inside=distance2[i] <= dmax_2;
+        res[i]=inside ? r*stretch+shift : 0.0;
+        dfunc[i]=inside ? df*2*invr0_2*stretch : 0.0;
+      }
+    } else {
+      calculateBatchFromSqrt(distance2,res,dfunc,n,[this](double rdist,double&df) {
+        return this->rational::function(rdist,df);
+      });
+    }
+  }
 };
 
 
@@ -446,6 +479,11 @@ protected:
     dfunc=-result;
     return result;
   }
+  void calculateSqrBatch(const double* distance2, double* res, double* dfunc, unsigned n) const override {
+    calculateBatchFromSqrt(distance2,res,dfunc,n,[this](double rdist,double&df) {
+      return this->exponentialSwitch::function(rdist,df);
+    });
+  }
 };
 
 class gaussianSwitch: public baseSwitch {
@@ -458,6 +496,11 @@ protected:
     dfunc=-rdist*result;
     return result;
   }
+  void calculateSqrBatch(const double* distance2, double* res, double* dfunc, unsigned n) const override {
+    calculateBatchFromSqrt(distance2,res,dfunc,n,[this](double rdist,double&df) {
+      return this->gaussianSwitch::function(rdist,df);
+    });
+  }
 };
 
 class fastGaussianSwitch: public baseSwitch {
@@ -483,6 +526,15 @@ protected:
     }
     return result;
   }
+  void calculateSqrBatch(const double* distance2, double* res, double* dfunc, unsigned n) const override {
+    #pragma omp simd
+    for(unsigned i=0; i<n; ++i) {
+      const double r=std::exp(-0.5*distance2[i]);
+      const bool inside=distance2[i] <= dmax_2;
+      res[i]=inside ? r*stretch+shift : 0.0;
+      dfunc[i]=inside ? -r*stretch : 0.0;
+    }
+  }
 };
 
 class smapSwitch: public baseSwitch {
@@ -511,6 +563,11 @@ protected:
     dfunc=-b*sx/rdist*result/(1.0+sx);
     return result;
   }
+  void calculateSqrBatch(const double* distance2, double* res, double* dfunc, unsigned n) const override {
+    calculateBatchFromSqrt(distance2,res,dfunc,n,[this](double rdist,double&df) {
+      return this->smapSwitch::function(rdist,df);
+    });
+  }
 };
 
 class cubicSwitch: public baseSwitch {
@@ -537,6 +594,11 @@ protected:
     dfunc = 2*tmp1*tmp2 + 2*tmp1*tmp1;
     return tmp1*tmp1*tmp2;
   }
+  void calculateSqrBatch(const double* distance2, double* res, double* dfunc, unsigned n) const override {
+    calculateBatchFromSqrt(distance2,res,dfunc,n,[this](double rdist,double&df) {
+      return this->cubicSwitch::function(rdist,df);
+    });
+  }
 };
 
 class tanhSwitch: public baseSwitch {
@@ -551,6 +613,11 @@ protected:
     //return result;
     return 1.0 - tmp1;
   }
+  void calculateSqrBatch(const double* distance2, double* res, double* dfunc, unsigned n) const override {
+    calculateBatchFromSqrt(distance2,res,dfunc,n,[this](double rdist,double&df) {
+      return this->tanhSwitch::function(rdist,df);
+    });
+  }
 };
 
 class cosinusSwitch: public baseSwitch {
@@ -928,6 +995,10 @@ double SwitchingFunction::calculateSqr(double distance2,double&dfunc)const {
   return function -> calculateSqr(distance2, dfunc);
 }
 
+void SwitchingFunction::calculateSqrBatch(const double* distance2, double* res, double* dfunc, unsigned n)const {
+  function -> calculateSqrBatch(distance2, res, dfunc, n);
+}
+
 double SwitchingFunction::calculate(double distance,double&dfunc)const {
   plumed_massert(init,"you are trying to use an unset SwitchingFunction");
   double result=function->calculate(distance,dfunc);
@@ -25,6 +25,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <cmath>
 #include "lepton/Lepton.h"
 
 namespace PLMD {
@@ -52,12 +53,18 @@ protected:
   virtual std::string specificDescription() const;
   //
   virtual double function(double rdist, double& dfunc) const=0;
+  /// Evaluate calculate(sqrt(distance2)) for a batch of distances using the function passed as func.
+  /// func should call function() of the derived class without virtual dispatch so that the loop can be vectorized
+  template<typename F>
+  void calculateBatchFromSqrt(const double* distance2, double* res, double* dfunc, unsigned n, F func) const;
 public:
   baseSwitch(double D0,double DMAX, double R0, std::string_view name);
   virtual ~baseSwitch();
   ///the driver for the function (prepares rdist or returns 1 or 0 automatically)
   virtual double calculate(double distance, double& dfunc) const;
   virtual double calculateSqr(double distance2, double& dfunc) const;
+  ///the driver for a batch of squared distances, by default calls calculateSqr() for each of them
+  virtual void calculateSqrBatch(const double* distance2, double* res, double* dfunc, unsigned n) const;
   void setupStretch();
   void removeStretch();
   std::string description() const;
@@ -66,6 +73,26 @@ public:
   double get_dmax() const;
   double get_dmax2() const;
 };
+
+template<typename F>
+void baseSwitch::calculateBatchFromSqrt(const double* distance2, double* res, double* dfunc, unsigned n, F func) const {
+  #pragma omp simd
+  for(unsigned i=0; i<n; ++i) {
+    // This is the same as calculate() with the branches written so they can be converted to masks
+    const double distance=std::sqrt(distance2[i]);
+    const double rdist=(distance-d0)*invr0;
+    double df=0.0;
+    double r=1.0;
+    if(rdist > 0.0) {
+      r=func(rdist,df);
+      df*=invr0;
+      df/=distance;
+    }
+    const bool inside=distance <= dmax;
+    res[i]=inside ? r*stretch+shift : 0.0;
+    dfunc[i]=inside ? df*stretch : 0.0;
+  }
+}
 } // namespace switchContainers
 
 /// \ingroup TOOLBOX
@@ -103,6 +130,11 @@ public:
 /// The advantage is that in some case the expensive square root can be avoided
 /// (namely for rational functions, if nn and mm are even and d0 is zero)
   double calculateSqr(double distance2,double&dfunc)const;
+/// Compute the switching function for n squared distances at once.
+/// The result is the same as calling calculateSqr() for each element, but the type of switching
+/// function is resolved once for the whole batch and the loop over the distances is vectorized
+/// for the RATIONAL, EXP, GAUSSIAN, SMAP, CUBIC and TANH functions
+  void calculateSqrBatch(const double* distance2, double* res, double* dfunc, unsigned n)const;
 /// Returns d0
   double get_d0() const;
 /// Returns r0
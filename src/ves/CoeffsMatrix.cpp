@@ -37,6 +37,7 @@
 #include <sstream>
 #include <cstdio>
 #include <cfloat>
+#include <algorithm>
 
 
 namespace PLMD {
@@ -55,6 +56,7 @@ CoeffsMatrix::CoeffsMatrix(
   nrows_(0),
   ncolumns_(0),
   diagonal_(diagonal),
+  block_size_(0),
   averaging_counter(0),
   averaging_exp_decay_(0),
   mycomm(cc)
@@ -76,6 +78,7 @@ CoeffsMatrix::CoeffsMatrix(
   nrows_(0),
   ncolumns_(0),
   diagonal_(diagonal),
+  block_size_(0),
   averaging_counter(0),
   averaging_exp_decay_(0),
   mycomm(cc)
@@ -98,6 +101,7 @@ CoeffsMatrix::CoeffsMatrix(
   nrows_(0),
   ncolumns_(0),
   diagonal_(diagonal),
+  block_size_(0),
   averaging_counter(0),
   averaging_exp_decay_(0),
   mycomm(cc)
@@ -110,13 +114,15 @@ CoeffsMatrix::CoeffsMatrix(
   const std::string& label,
   CoeffsVector* coeffsVec,
   Communicator& cc,
-  const bool diagonal):
+  const bool diagonal,
+  const size_t block_size):
   CoeffsBase( *(static_cast<CoeffsBase*>(coeffsVec)) ),
   data(0),
   size_(0),
   nrows_(0),
   ncolumns_(0),
   diagonal_(diagonal),
+  block_size_(block_size),
   averaging_counter(0),
   averaging_exp_decay_(0),
   mycomm(cc)
@@ -132,9 +138,17 @@ CoeffsMatrix::~CoeffsMatrix() {}
 void CoeffsMatrix::setupMatrix() {
   nrows_=numberOfCoeffs();
   ncolumns_=nrows_;
+  if(block_size_>=nrows_ || diagonal_) {
+    block_size_=0;
+  }
   if(diagonal_) {
     size_=nrows_;
   }
+  else if(block_size_>0) {
+    // the upper triangular part of each diagonal block, the last block can be smaller
+    size_t nlast=nrows_%block_size_;
+    size_=(nrows_/block_size_)*(block_size_*(block_size_+1)/2)+nlast*(nlast+1)/2;
+  }
   else {
     size_=(nrows_*nrows_-nrows_)/2+nrows_;
   }
@@ -152,6 +166,13 @@ bool CoeffsMatrix::isDiagonal() const {
 }
 
 
+bool CoeffsMatrix::isStored(const size_t index1, const size_t index2) const {
+  if(diagonal_) {return index1==index2;}
+  if(block_size_>0) {return index1/block_size_==index2/block_size_;}
+  return true;
+}
+
+
 bool CoeffsMatrix::sameShape(CoeffsVector& coeffsvector_in) const {
   return CoeffsBase::sameShape( *(static_cast<CoeffsBase*>(&coeffsvector_in)) );
 }
@@ -205,6 +226,15 @@ size_t CoeffsMatrix::getMatrixIndex(const size_t index1, const size_t index2) co
     // plumed_massert(index1==index2,"CoeffsMatrix: you trying to access a off-diagonal element of a diagonal coeffs matrix");
     matrix_idx=index1;
   }
+  else if(block_size_>0) {
+    plumed_dbg_massert(isStored(index1,index2),"CoeffsMatrix: you trying to access an element outside of the diagonal blocks");
+    size_t block=index1/block_size_;
+    size_t start=block*block_size_;
+    size_t nblock=std::min(block_size_,nrows_-start);
+    size_t i1=std::min(index1,index2)-start;
+    size_t i2=std::max(index1,index2)-start;
+    matrix_idx=block*(block_size_*(block_size_+1)/2)+i2+i1*(nblock-1)-i1*(i1-1)/2;
+  }
   else if (index1<=index2) {
     matrix_idx=index2+index1*(nrows_-1)-index1*(index1-1)/2;
   }
@@ -231,6 +261,7 @@ void CoeffsMatrix::setAllValuesToZero() {
 
 
 double CoeffsMatrix::getValue(const size_t index1, const size_t index2) const {
+  if(block_size_>0 && !isStored(index1,index2)) {return 0.0;}
   return data[getMatrixIndex(index1,index2)];
 }
 
@@ -280,6 +311,16 @@ CoeffsVector operator*(const CoeffsMatrix& coeffs_matrix, const CoeffsVector& co
       new_coeffs_vector(i) = coeffs_matrix(i,i)*coeffs_vector(i);
     }
   }
+  else if(coeffs_matrix.getBlockSize()>0) {
+    size_t block_size = coeffs_matrix.getBlockSize();
+    for(size_t i=0; i<numcoeffs; i++) {
+      size_t start = (i/block_size)*block_size;
+      size_t end = std::min(start+block_size,numcoeffs);
+      for(size_t j=start; j<end; j++) {
+        new_coeffs_vector(i) += coeffs_matrix(i,j)*coeffs_vector(j);
+      }
+    }
+  }
   else {
     for(size_t i=0; i<numcoeffs; i++) {
       for(size_t j=0; j<numcoeffs; j++) {
@@ -55,6 +55,8 @@ private:
   size_t ncolumns_;
   //
   bool diagonal_;
+  // only the diagonal blocks of this size are stored if larger than zero
+  size_t block_size_;
   //
   unsigned int averaging_counter;
   unsigned int averaging_exp_decay_;
@@ -94,7 +96,8 @@ public:
     const std::string&,
     CoeffsVector*,
     Communicator& cc,
-    const bool diagonal=true);
+    const bool diagonal=true,
+    const size_t block_size=0);
   //
   ~CoeffsMatrix();
   //
@@ -102,6 +105,10 @@ public:
   //
   bool isSymmetric() const;
   bool isDiagonal() const;
+  // size of the diagonal blocks that are stored, zero if all the elements are stored
+  size_t getBlockSize() const {return block_size_;}
+  // check if an element is stored, the elements that are not stored are zero
+  bool isStored(const size_t, const size_t) const;
   //
   bool sameShape(CoeffsVector&) const;
   bool sameShape(CoeffsMatrix&) const;
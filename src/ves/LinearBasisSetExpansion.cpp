@@ -35,6 +35,7 @@
 
 #include "GridProjWeights.h"
 
+#include <algorithm>
 #include <limits>
 
 namespace PLMD {
@@ -177,24 +178,7 @@ void LinearBasisSetExpansion::updateBiasGrid() {
   if(action_pntr_!=NULL &&  getStepOfLastBiasGridUpdate()==action_pntr_->getStep()) {
     return;
   }
-  for(Grid::index_t l=0; l<bias_grid_pntr_->getSize(); l++) {
-    std::vector<double> forces(nargs_);
-    std::vector<double> args = bias_grid_pntr_->getPoint(l);
-    bool all_inside=true;
-    double bias=getBiasAndForces(args,all_inside,forces);
-    //
-    if(biasCutoffActive()) {
-      vesbias_pntr_->applyBiasCutoff(bias,forces);
-    }
-    //
-    if(bias_grid_pntr_->hasDerivatives()) {
-      bias_grid_pntr_->setValueAndDerivatives(l,bias,forces);
-    }
-    else {
-      bias_grid_pntr_->setValue(l,bias);
-    }
-    //
-  }
+  calculateBiasOnGrid(*bias_grid_pntr_,biasCutoffActive());
   if(vesbias_pntr_!=NULL) {
     vesbias_pntr_->setCurrentBiasMaxValue(bias_grid_pntr_->getMaxValue());
   }
@@ -212,18 +196,7 @@ void LinearBasisSetExpansion::updateBiasWithoutCutoffGrid() {
     return;
   }
   //
-  for(Grid::index_t l=0; l<bias_withoutcutoff_grid_pntr_->getSize(); l++) {
-    std::vector<double> forces(nargs_);
-    std::vector<double> args = bias_withoutcutoff_grid_pntr_->getPoint(l);
-    bool all_inside=true;
-    double bias=getBiasAndForces(args,all_inside,forces);
-    if(bias_withoutcutoff_grid_pntr_->hasDerivatives()) {
-      bias_withoutcutoff_grid_pntr_->setValueAndDerivatives(l,bias,forces);
-    }
-    else {
-      bias_withoutcutoff_grid_pntr_->setValue(l,bias);
-    }
-  }
+  calculateBiasOnGrid(*bias_withoutcutoff_grid_pntr_,false);
   //
   double bias_max = bias_withoutcutoff_grid_pntr_->getMaxValue();
   double bias_min = bias_withoutcutoff_grid_pntr_->getMinValue();
@@ -376,6 +349,15 @@ double LinearBasisSetExpansion::getBiasAndForces(const std::vector<double>& args
     forces[k]=0.0;
   }
   //
+  getBasisSetValuesFromValues(bf_values,coeffsderivs_values);
+  return getBiasAndForcesFromValues(bf_values,bf_derivs,forces,coeffsderivs_values,coeffs_pntr_in,comm_in);
+}
+
+
+double LinearBasisSetExpansion::getBiasAndForcesFromValues(const std::vector< std::vector<double> >& bf_values, const std::vector< std::vector<double> >& bf_derivs, std::vector<double>& forces, std::vector<double>& coeffsderivs_values, const CoeffsVector* coeffs_pntr_in, Communicator* comm_in) {
+  unsigned int nargs = bf_values.size();
+  const CoeffsVector& coeffs = *coeffs_pntr_in;
+  //
   size_t stride=1;
   size_t rank=0;
   if(comm_in!=NULL)
@@ -383,26 +365,53 @@ double LinearBasisSetExpansion::getBiasAndForces(const std::vector<double>& args
     stride=comm_in->Get_size();
     rank=comm_in->Get_rank();
   }
-  // loop over coeffs
+  for(unsigned int k=0; k<nargs; k++) {
+    forces[k]=0.0;
+  }
+  // The coefficients are stored in column-major order, so for each index of the
+  // last argument (a slab) the coefficients are contiguous. Slabs are divided among
+  // the ranks and each one is contracted with the basis functions of one argument at the
+  // time, i.e. with successive matrix-vector products. contracted[0] holds the contraction
+  // with the values, contracted[k+1] the one with the derivatives of argument k.
+  size_t nslabs = bf_values[nargs-1].size();
+  size_t slab_size = coeffs.numberOfCoeffs()/nslabs;
+  std::vector< std::vector<double> > contracted(nargs);
+  std::vector< std::vector<double> > next(nargs);
   double bias=0.0;
-  for(size_t i=rank; i<coeffs_pntr_in->numberOfCoeffs(); i+=stride) {
-    std::vector<unsigned int> indices=coeffs_pntr_in->getIndices(i);
-    double coeff = coeffs_pntr_in->getValue(i);
-    double bf_curr=1.0;
-    for(unsigned int k=0; k<nargs; k++) {
-      bf_curr*=bf_values[k][indices[k]];
-    }
-    bias+=coeff*bf_curr;
-    coeffsderivs_values[i] = bf_curr;
-    for(unsigned int k=0; k<nargs; k++) {
-      double der = 1.0;
-      for(unsigned int l=0; l<nargs; l++) {
-        if(l!=k) {der*=bf_values[l][indices[l]];}
-        else {der*=bf_derivs[l][indices[l]];}
+  for(size_t s=rank; s<nslabs; s+=stride) {
+    size_t len=slab_size;
+    for(unsigned int j=0; j+1<nargs; j++) {
+      const std::vector<double>& values = bf_values[j];
+      const std::vector<double>& derivs = bf_derivs[j];
+      size_t n=values.size();
+      size_t next_len=len/n;
+      for(unsigned int k=0; k<=j+1; k++) {next[k].resize(next_len);}
+      const double* tv = (j==0) ? &coeffs[s*slab_size] : contracted[0].data();
+      for(size_t r=0; r<next_len; r++) {
+        double v=0.0;
+        double d=0.0;
+        for(size_t i=0; i<n; i++) {
+          v+=tv[r*n+i]*values[i];
+          d+=tv[r*n+i]*derivs[i];
+        }
+        next[0][r]=v;
+        next[j+1][r]=d;
+        for(unsigned int k=1; k<=j; k++) {
+          const double* td = contracted[k].data();
+          double dk=0.0;
+          for(size_t i=0; i<n; i++) {dk+=td[r*n+i]*values[i];}
+          next[k][r]=dk;
+        }
       }
-      forces[k]-=coeff*der;
-      // maybe faster but dangerous
-      // forces[k]-=coeff*bf_curr*(bf_derivs[k][indices[k]]/bf_values[k][indices[k]]);
+      for(unsigned int k=0; k<=j+1; k++) {contracted[k].swap(next[k]);}
+      len=next_len;
+    }
+    // contraction with the last argument
+    double value = (nargs>1) ? contracted[0][0] : coeffs[s];
+    bias+=bf_values[nargs-1][s]*value;
+    forces[nargs-1]-=bf_derivs[nargs-1][s]*value;
+    for(unsigned int k=0; k+1<nargs; k++) {
+      forces[k]-=bf_values[nargs-1][s]*contracted[k+1][0];
     }
   }
   //
@@ -415,6 +424,26 @@ double LinearBasisSetExpansion::getBiasAndForces(const std::vector<double>& args
 }
 
 
+void LinearBasisSetExpansion::getBasisSetValuesFromValues(const std::vector< std::vector<double> >& bf_values, std::vector<double>& basisset_values) {
+  if(basisset_values.size()==0) {return;}
+  unsigned int nargs = bf_values.size();
+  // start from the last argument, the slowest index in column-major order, and
+  // expand in place from the end so that each value is used before being overwritten
+  size_t len=bf_values[nargs-1].size();
+  std::copy(bf_values[nargs-1].begin(),bf_values[nargs-1].end(),basisset_values.begin());
+  for(unsigned int j=nargs-1; j>0; j--) {
+    const std::vector<double>& values = bf_values[j-1];
+    size_t n=values.size();
+    for(size_t r=len; r-->0;) {
+      double v=basisset_values[r];
+      for(size_t i=n; i-->0;) {basisset_values[r*n+i]=v*values[i];}
+    }
+    len*=n;
+  }
+  plumed_dbg_assert(len==basisset_values.size());
+}
+
+
 void LinearBasisSetExpansion::getBasisSetValues(const std::vector<double>& args_values, std::vector<double>& basisset_values, std::vector<BasisFunctions*>& basisf_pntrs_in, CoeffsVector* coeffs_pntr_in, Communicator* comm_in) {
   unsigned int nargs = args_values.size();
   plumed_assert(coeffs_pntr_in->numberOfDimensions()==nargs);
@@ -430,27 +459,9 @@ void LinearBasisSetExpansion::getBasisSetValues(const std::vector<double>& args_
     basisf_pntrs_in[k]->getAllValues(args_values[k],args_values_trsfrm[k],inside,tmp_val,tmp_der);
     bf_values.push_back(tmp_val);
   }
-  //
-  size_t stride=1;
-  size_t rank=0;
-  if(comm_in!=NULL)
-  {
-    stride=comm_in->Get_size();
-    rank=comm_in->Get_rank();
-  }
-  // loop over basis set
-  for(size_t i=rank; i<coeffs_pntr_in->numberOfCoeffs(); i+=stride) {
-    std::vector<unsigned int> indices=coeffs_pntr_in->getIndices(i);
-    double bf_curr=1.0;
-    for(unsigned int k=0; k<nargs; k++) {
-      bf_curr*=bf_values[k][indices[k]];
-    }
-    basisset_values[i] = bf_curr;
-  }
-  //
-  if(comm_in!=NULL) {
-    comm_in->Sum(basisset_values);
-  }
+  // the outer product costs one multiplication per coefficient, less than
+  // summing its result over the ranks, so it is not divided among them
+  getBasisSetValuesFromValues(bf_values,basisset_values);
 }
 
 
@@ -557,13 +568,21 @@ void LinearBasisSetExpansion::calculateTargetDistAveragesFromGrid(const Grid* ta
   plumed_assert(targetdist_grid_pntr!=NULL);
   std::vector<double> targetdist_averages(ncoeffs_,0.0);
   std::vector<double> integration_weights = GridIntegrationWeights::getIntegrationWeights(targetdist_grid_pntr);
+  std::vector< std::vector< std::vector<double> > > grid_bf_values;
+  std::vector< std::vector< std::vector<double> > > grid_bf_derivs;
+  getBasisFunctionValuesOnGrid(*targetdist_grid_pntr,grid_bf_values,grid_bf_derivs);
+  std::vector< std::vector<double> > bf_values(nargs_);
+  std::vector<unsigned> indices(nargs_);
+  std::vector<double> basisset_values(ncoeffs_);
   Grid::index_t stride=mycomm_.Get_size();
   Grid::index_t rank=mycomm_.Get_rank();
   for(Grid::index_t l=rank; l<targetdist_grid_pntr->getSize(); l+=stride) {
-    std::vector<double> args_values = targetdist_grid_pntr->getPoint(l);
-    std::vector<double> basisset_values(ncoeffs_);
-    // parallelization done over the grid -> should NOT use parallel in getBasisSetValues!!
-    getBasisSetValues(args_values,basisset_values,false);
+    targetdist_grid_pntr->getIndices(l,indices);
+    for(unsigned int k=0; k<nargs_; k++) {
+      bf_values[k]=grid_bf_values[k][indices[k]];
+    }
+    // parallelization done over the grid -> should NOT use parallel here!!
+    getBasisSetValuesFromValues(bf_values,basisset_values);
     double weight = integration_weights[l]*targetdist_grid_pntr->getValue(l);
     for(unsigned int i=0; i<ncoeffs_; i++) {
       targetdist_averages[i] += weight*basisset_values[i];
@@ -576,6 +595,57 @@ void LinearBasisSetExpansion::calculateTargetDistAveragesFromGrid(const Grid* ta
 }
 
 
+void LinearBasisSetExpansion::getBasisFunctionValuesOnGrid(const Grid& grid, std::vector< std::vector< std::vector<double> > >& grid_bf_values, std::vector< std::vector< std::vector<double> > >& grid_bf_derivs) const {
+  plumed_assert(grid.getDimension()==nargs_);
+  std::vector<unsigned> nbin = grid.getNbin();
+  grid_bf_values.assign(nargs_,std::vector< std::vector<double> >());
+  grid_bf_derivs.assign(nargs_,std::vector< std::vector<double> >());
+  for(unsigned int k=0; k<nargs_; k++) {
+    grid_bf_values[k].assign(nbin[k],std::vector<double>(nbasisf_[k]));
+    grid_bf_derivs[k].assign(nbin[k],std::vector<double>(nbasisf_[k]));
+    std::vector<unsigned> indices(nargs_,0);
+    for(unsigned int i=0; i<nbin[k]; i++) {
+      indices[k]=i;
+      double arg = grid.getPoint(grid.getIndex(indices))[k];
+      double arg_trsfrm;
+      bool inside=true;
+      basisf_pntrs_[k]->getAllValues(arg,arg_trsfrm,inside,grid_bf_values[k][i],grid_bf_derivs[k][i]);
+    }
+  }
+}
+
+
+void LinearBasisSetExpansion::calculateBiasOnGrid(Grid& grid, const bool apply_cutoff) {
+  std::vector< std::vector< std::vector<double> > > grid_bf_values;
+  std::vector< std::vector< std::vector<double> > > grid_bf_derivs;
+  getBasisFunctionValuesOnGrid(grid,grid_bf_values,grid_bf_derivs);
+  std::vector< std::vector<double> > bf_values(nargs_);
+  std::vector< std::vector<double> > bf_derivs(nargs_);
+  std::vector<unsigned> indices(nargs_);
+  std::vector<double> forces(nargs_);
+  std::vector<double> coeffsderivs_values_dummy;
+  for(Grid::index_t l=0; l<grid.getSize(); l++) {
+    grid.getIndices(l,indices);
+    for(unsigned int k=0; k<nargs_; k++) {
+      bf_values[k]=grid_bf_values[k][indices[k]];
+      bf_derivs[k]=grid_bf_derivs[k][indices[k]];
+    }
+    double bias=getBiasAndForcesFromValues(bf_values,bf_derivs,forces,coeffsderivs_values_dummy,bias_coeffs_pntr_,&mycomm_);
+    //
+    if(apply_cutoff) {
+      vesbias_pntr_->applyBiasCutoff(bias,forces);
+    }
+    //
+    if(grid.hasDerivatives()) {
+      grid.setValueAndDerivatives(l,bias,forces);
+    }
+    else {
+      grid.setValue(l,bias);
+    }
+  }
+}
+
+
 void LinearBasisSetExpansion::setBiasMinimumToZero() {
   plumed_massert(bias_grid_pntr_,"setBiasMinimumToZero can only be used if the bias grid is defined");
   updateBiasGrid();
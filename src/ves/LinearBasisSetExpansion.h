@@ -190,6 +190,15 @@ private:
   void calculateTargetDistAveragesFromGrid(const Grid*);
   //
   bool isStaticTargetDistFileOutputActive() const;
+  // bias and forces from the values and derivatives of the basis functions of each argument,
+  // contracting the coefficients one dimension at the time instead of looping over the full tensor product
+  static double getBiasAndForcesFromValues(const std::vector< std::vector<double> >&, const std::vector< std::vector<double> >&, std::vector<double>&, std::vector<double>&, const CoeffsVector*, Communicator* comm_in=NULL);
+  // values of the whole basis set as the outer product of the values of the basis functions of each argument
+  static void getBasisSetValuesFromValues(const std::vector< std::vector<double> >&, std::vector<double>&);
+  // values and derivatives of the basis functions of each argument along each axis of a grid, so that they are computed once per grid line
+  void getBasisFunctionValuesOnGrid(const Grid&, std::vector< std::vector< std::vector<double> > >&, std::vector< std::vector< std::vector<double> > >&) const;
+  // fill a grid with the bias and its derivatives
+  void calculateBiasOnGrid(Grid&, const bool apply_cutoff);
 };
 
 
@@ -53,7 +53,7 @@ where \f$\mu\f$ is a fixed step size and the gradient \f$ \nabla\Omega(\bar{\bol
 \f]
 This means that the bias acting on the system depends on the averaged coefficients \f$\bar{\boldsymbol{\alpha}}^{(n)}\f$ which leads to a smooth convergence of the bias and the estimated free energy surface. Furthermore, this allows for a rather short sampling time for each iteration, for classical MD simulations typical sampling times are on the order of few ps (around 1000-4000 MD steps).
 
-Currently it is only supported to employ the diagonal part of the Hessian which is generally sufficient. Support for employing the full Hessian will be added later on.
+By default only the diagonal part of the Hessian is employed, which is generally sufficient. The full Hessian can be employed by using the FULL_HESSIAN flag, note however that the cost of sampling it grows with the square of the number of coefficients. This cost can be reduced by only sampling its diagonal blocks, whose size is given by the HESSIAN_BLOCK_SIZE keyword. The \ref OPT_PRECONDITIONED_SGD optimizer uses the Hessian also to precondition the updates of the coefficients.
 
 The VES bias that is to be optimized should be specified using the
 BIAS keyword.
@@ -0,0 +1,233 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2016-2021 The VES code team
+   (see the PEOPLE-VES file at the root of this folder for a list of names)
+
+   See http://www.ves-code.org for more information.
+
+   This file is part of VES code module.
+
+   The VES code module is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   The VES code module is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with the VES code module.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+#include "Optimizer.h"
+#include "CoeffsVector.h"
+#include "CoeffsMatrix.h"
+
+#include "core/ActionRegister.h"
+#include "tools/Matrix.h"
+
+#include <algorithm>
+
+
+namespace PLMD {
+namespace ves {
+
+//+PLUMEDOC VES_OPTIMIZER OPT_PRECONDITIONED_SGD
+/*
+Averaged stochastic gradient decent preconditioned with the Hessian.
+
+\par Algorithm
+
+This optimizer is a variant of the averaged stochastic gradient decent of \ref OPT_AVERAGED_SGD
+where the combined gradient is preconditioned with the inverse of the Hessian, such that the instantaneous
+coefficients are updated according to
+\f[
+\boldsymbol{\alpha}^{(n+1)} = \boldsymbol{\alpha}^{(n)} -
+\mu \left[ \mathbf{H}(\bar{\boldsymbol{\alpha}}^{(n)}) + \lambda h \mathbf{I} \right]^{-1}
+\left[
+\nabla \Omega(\bar{\boldsymbol{\alpha}}^{(n)}) +
+\mathbf{H}(\bar{\boldsymbol{\alpha}}^{(n)})
+[\boldsymbol{\alpha}^{(n)}-\bar{\boldsymbol{\alpha}}^{(n)}]
+\right],
+\f]
+while the averaged coefficients \f$\bar{\boldsymbol{\alpha}}^{(n)}\f$ that define the bias are obtained as in \ref OPT_AVERAGED_SGD.
+Here \f$h\f$ is the average of the diagonal elements of the Hessian and \f$\lambda\f$ is a dimensionless
+regularization given by the REGULARIZATION keyword, which keeps the update finite for the coefficients that are
+not sampled. For \f$\mu=1\f$ and \f$\lambda=0\f$ the instantaneous coefficients are given by a Newton step
+from the averaged ones.
+
+Since the Hessian is the covariance of the basis functions, the preconditioning adapts the
+step to the scale of each coefficient, so that a single step size works for basis sets of different
+orders and for coefficients sampled with very different statistics. This generally
+reduces the number of iterations needed to converge, in particular for two and three dimensional biases.
+
+By default only the diagonal part of the Hessian is used, which amounts to using a different step size for
+each coefficient. With the FULL_HESSIAN flag the full Hessian is used, and the linear system
+is solved by a Cholesky decomposition at each iteration. As the cost of sampling the full Hessian grows with
+the square of the number of coefficients, it is possible to only sample, store and invert its diagonal blocks
+by giving their size with the HESSIAN_BLOCK_SIZE keyword. The memory needed for the Hessian and the cost of each step then
+grow linearly with the number of coefficients, and the elements outside the blocks are written as zero in the HESSIAN_FILE. The coefficients are ordered with the index of the first argument
+running fastest, so that using the number of basis functions of the first argument as block size couples all the
+coefficients that share the indices of the other arguments.
+
+When using multiple walkers (MULTIPLE_WALKERS flag) the averages needed for the gradient and the Hessian,
+the weights of the walkers and their number of samples are combined with a single reduction at each iteration.
+
+The VES bias that is to be optimized should be specified using the BIAS keyword, and
+the other keywords have the same meaning as in \ref OPT_AVERAGED_SGD.
+
+\par Examples
+
+In the following example the coefficients of a two dimensional bias are
+optimized using diagonal blocks of the Hessian of size 6, the number of basis functions of
+the first argument.
+\plumedfile
+p: POSITION ATOM=1
+
+bf1: BF_LEGENDRE ORDER=5 MINIMUM=-3.0 MAXIMUM=3.0
+bf2: BF_LEGENDRE ORDER=5 MINIMUM=-3.0 MAXIMUM=3.0
+
+VES_LINEAR_EXPANSION ...
+ ARG=p.x,p.y
+ BASIS_FUNCTIONS=bf1,bf2
+ LABEL=ves1
+ TEMP=1.0
+ GRID_BINS=100,100
+... VES_LINEAR_EXPANSION
+
+OPT_PRECONDITIONED_SGD ...
+  BIAS=ves1
+  STRIDE=500
+  LABEL=o1
+  STEPSIZE=0.5
+  FULL_HESSIAN
+  HESSIAN_BLOCK_SIZE=6
+  REGULARIZATION=0.1
+  COEFFS_FILE=coefficients.data
+  COEFFS_OUTPUT=10
+  FES_OUTPUT=100
+... OPT_PRECONDITIONED_SGD
+\endplumedfile
+
+This input can be used to compare the convergence with the one of \ref OPT_AVERAGED_SGD
+by running dynamics on the Wolfe-Quapp potential with \ref ves_md_linearexpansion, as
+described in the manual of that tool, and monitoring the free energy surfaces written by the two optimizers.
+
+*/
+//+ENDPLUMEDOC
+
+class Opt_PreconditionedAveragedSGD : public Optimizer {
+private:
+  double regularization_;
+  // solve the preconditioning system for the diagonal blocks of the Hessian
+  void solveBlocks(const CoeffsMatrix&, const std::vector<double>&, std::vector<double>&) const;
+public:
+  static void registerKeywords(Keywords&);
+  explicit Opt_PreconditionedAveragedSGD(const ActionOptions&);
+  void coeffsUpdate(const unsigned int c_id = 0) override;
+};
+
+
+PLUMED_REGISTER_ACTION(Opt_PreconditionedAveragedSGD,"OPT_PRECONDITIONED_SGD")
+
+
+void Opt_PreconditionedAveragedSGD::registerKeywords(Keywords& keys) {
+  Optimizer::registerKeywords(keys);
+  Optimizer::useFixedStepSizeKeywords(keys);
+  Optimizer::useMultipleWalkersKeywords(keys);
+  Optimizer::useHessianKeywords(keys);
+  Optimizer::useMaskKeywords(keys);
+  Optimizer::useRestartKeywords(keys);
+  Optimizer::useMonitorAverageGradientKeywords(keys);
+  Optimizer::useDynamicTargetDistributionKeywords(keys);
+  keys.add("compulsory","REGULARIZATION","0.1","the regularization added to the diagonal of the Hessian, relative to the average of its diagonal elements");
+}
+
+
+Opt_PreconditionedAveragedSGD::Opt_PreconditionedAveragedSGD(const ActionOptions&ao):
+  PLUMED_VES_OPTIMIZER_INIT(ao),
+  regularization_(0.1)
+{
+  parse("REGULARIZATION",regularization_);
+  if(regularization_<0.0) {
+    plumed_merror("the value given in REGULARIZATION cannot be negative");
+  }
+  log.printf("  Averaged stochastic gradient decent preconditioned with the Hessian, using a regularization of %f\n",regularization_);
+  //
+  turnOnHessian();
+  checkRead();
+}
+
+
+void Opt_PreconditionedAveragedSGD::solveBlocks(const CoeffsMatrix& hessian, const std::vector<double>& rhs, std::vector<double>& solution) const {
+  size_t ncoeffs = rhs.size();
+  solution.assign(ncoeffs,0.0);
+  //
+  double diag_aver = 0.0;
+  size_t ndiag = 0;
+  for(size_t i=0; i<ncoeffs; i++) {
+    if(hessian(i,i)>0.0) {
+      diag_aver += hessian(i,i);
+      ndiag++;
+    }
+  }
+  // nothing has been sampled
+  if(ndiag==0) {return;}
+  double shift = regularization_*diag_aver/static_cast<double>(ndiag);
+  //
+  size_t block_size = ncoeffs;
+  if(diagonalHessian()) {block_size = 1;}
+  else if(getHessianBlockSize()>0) {block_size = getHessianBlockSize();}
+  //
+  Matrix<double> block;
+  Matrix<double> chol;
+  std::vector<double> y;
+  for(size_t start=0; start<ncoeffs; start+=block_size) {
+    size_t n = std::min(block_size,ncoeffs-start);
+    if(n==1) {
+      double d = hessian(start,start) + shift;
+      if(d>0.0) {solution[start] = rhs[start]/d;}
+      continue;
+    }
+    block.resize(n,n);
+    for(size_t i=0; i<n; i++) {
+      for(size_t j=0; j<n; j++) {
+        block(i,j) = hessian(start+i,start+j);
+      }
+      block(i,i) += shift;
+    }
+    // block = L L^T, solved by forward and backward substitution
+    cholesky(block,chol);
+    y.assign(n,0.0);
+    for(size_t i=0; i<n; i++) {
+      if(chol(i,i)<=0.0) {continue;}
+      double sum = rhs[start+i];
+      for(size_t j=0; j<i; j++) {sum -= chol(i,j)*y[j];}
+      y[i] = sum/chol(i,i);
+    }
+    for(size_t i=n; i-->0;) {
+      if(chol(i,i)<=0.0) {continue;}
+      double sum = y[i];
+      for(size_t j=i+1; j<n; j++) {sum -= chol(j,i)*solution[start+j];}
+      solution[start+i] = sum/chol(i,i);
+    }
+  }
+}
+
+
+void Opt_PreconditionedAveragedSGD::coeffsUpdate(const unsigned int c_id) {
+  //
+  CoeffsVector step = Gradient(c_id) + Hessian(c_id)*(AuxCoeffs(c_id)-Coeffs(c_id));
+  std::vector<double> preconditioned_step;
+  solveBlocks(Hessian(c_id),step.getDataAsVector(),preconditioned_step);
+  step.setValues(preconditioned_step);
+  //
+  double aver_decay = 1.0 / ( getIterationCounterDbl() + 1.0 );
+  AuxCoeffs(c_id) += - StepSize(c_id)*CoeffsMask(c_id) * step;
+  Coeffs(c_id) += aver_decay * ( AuxCoeffs(c_id)-Coeffs(c_id) );
+}
+
+
+}
+}
@@ -66,6 +66,7 @@ private:
   //
   bool use_hessian_;
   bool diagonal_hessian_;
+  unsigned int hessian_block_size_;
   bool hessian_covariance_from_averages_;
   //
   bool monitor_instantaneous_gradient_;
@@ -131,7 +132,7 @@ private:
 protected:
   void turnOnHessian();
   void turnOffHessian();
-  std::vector<CoeffsMatrix*> enableHessian(VesBias*, const bool diagonal_hessian=false);
+  std::vector<CoeffsMatrix*> enableHessian(VesBias*, const bool diagonal_hessian=false, const unsigned int hessian_block_size=0);
   // CoeffsMatrix* switchToDiagonalHessian(VesBias*);
   // CoeffsMatrix* switchToFullHessian(VesBias*);
   //
@@ -199,6 +200,7 @@ public:
   //
   bool useHessian() const {return use_hessian_;}
   bool diagonalHessian() const {return diagonal_hessian_;}
+  unsigned int getHessianBlockSize() const {return hessian_block_size_;}
   //
   bool useMultipleWalkers() const {return use_mwalkers_mpi_;}
   //
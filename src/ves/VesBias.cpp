@@ -34,6 +34,8 @@
 #include "core/PlumedMain.h"
 #include "tools/File.h"
 
+#include <algorithm>
+
 
 namespace PLMD {
 namespace ves {
@@ -51,6 +53,7 @@ VesBias::VesBias(const ActionOptions&ao):
   optimize_coeffs_(false),
   compute_hessian_(false),
   diagonal_hessian_(true),
+  hessian_block_size_(0),
   aver_counters(0),
   kbt_(0.0),
   targetdist_pntrs_(0),
@@ -407,13 +410,32 @@ bool VesBias::readCoeffsFromFiles() {
 void VesBias::updateGradientAndHessian(const bool use_mwalkers_mpi) {
   for(unsigned int k=0; k<ncoeffssets_; k++) {
     //
-    comm.Sum(sampled_averages[k]);
-    comm.Sum(sampled_cross_averages[k]);
+    std::vector<double> buffer;
+    packSampledAverages(k,buffer);
+    comm.Sum(buffer);
+    // Check the total number of samples (from all walkers) and deactivate the Gradient and Hessian if it
+    // is zero
+    unsigned int total_samples = aver_counters[k];
     if(use_mwalkers_mpi) {
+      // walkers without samples do not contribute to the averages
       double walker_weight=1.0;
       if(aver_counters[k]==0) {walker_weight=0.0;}
-      multiSimSumAverages(k,walker_weight);
+      if(walker_weight!=1.0) {
+        for(size_t i=0; i<buffer.size(); i++) {buffer[i] *= walker_weight;}
+      }
+      // the averages, the weights and the number of samples of all the walkers are summed with a single reduction
+      buffer.push_back(walker_weight);
+      buffer.push_back(static_cast<double>(aver_counters[k]));
+      if(comm.Get_rank()==0) {multi_sim_comm.Sum(buffer);}
+      comm.Bcast(buffer,0);
+      total_samples = static_cast<unsigned int>(buffer.back());
+      buffer.pop_back();
+      double norm_weights = buffer.back();
+      buffer.pop_back();
+      if(norm_weights>0.0) {norm_weights=1.0/norm_weights;}
+      for(size_t i=0; i<buffer.size(); i++) {buffer[i] *= norm_weights;}
     }
+    unpackSampledAverages(k,buffer);
     // NOTE: this assumes that all walkers have the same TargetDist, might change later on!!
     Gradient(k).setValues( TargetDistAverages(k) - sampled_averages[k] );
     Hessian(k) = computeCovarianceFromAverages(k);
@@ -431,13 +453,6 @@ void VesBias::updateGradientAndHessian(const bool use_mwalkers_mpi) {
     Gradient(k).activate();
     Hessian(k).activate();
     //
-    // Check the total number of samples (from all walkers) and deactivate the Gradient and Hessian if it
-    // is zero
-    unsigned int total_samples = aver_counters[k];
-    if(use_mwalkers_mpi) {
-      if(comm.Get_rank()==0) {multi_sim_comm.Sum(total_samples);}
-      comm.Bcast(total_samples,0);
-    }
     if(total_samples==0) {
       Gradient(k).deactivate();
       Gradient(k).clear();
@@ -452,32 +467,17 @@ void VesBias::updateGradientAndHessian(const bool use_mwalkers_mpi) {
 }
 
 
-void VesBias::multiSimSumAverages(const unsigned int c_id, const double walker_weight) {
-  plumed_massert(walker_weight>=0.0,"the weight of the walker cannot be negative!");
-  if(walker_weight!=1.0) {
-    for(size_t i=0; i<sampled_averages[c_id].size(); i++) {
-      sampled_averages[c_id][i] *= walker_weight;
-    }
-    for(size_t i=0; i<sampled_cross_averages[c_id].size(); i++) {
-      sampled_cross_averages[c_id][i] *= walker_weight;
-    }
-  }
-  //
-  if(comm.Get_rank()==0) {
-    multi_sim_comm.Sum(sampled_averages[c_id]);
-    multi_sim_comm.Sum(sampled_cross_averages[c_id]);
-    double norm_weights = walker_weight;
-    multi_sim_comm.Sum(norm_weights);
-    if(norm_weights>0.0) {norm_weights=1.0/norm_weights;}
-    for(size_t i=0; i<sampled_averages[c_id].size(); i++) {
-      sampled_averages[c_id][i] *= norm_weights;
-    }
-    for(size_t i=0; i<sampled_cross_averages[c_id].size(); i++) {
-      sampled_cross_averages[c_id][i] *= norm_weights;
-    }
-  }
-  comm.Bcast(sampled_averages[c_id],0);
-  comm.Bcast(sampled_cross_averages[c_id],0);
+void VesBias::packSampledAverages(const unsigned int c_id, std::vector<double>& buffer) const {
+  // only the elements inside the diagonal blocks are stored so all of them are needed
+  buffer = sampled_averages[c_id];
+  buffer.insert(buffer.end(),sampled_cross_averages[c_id].begin(),sampled_cross_averages[c_id].end());
+}
+
+
+void VesBias::unpackSampledAverages(const unsigned int c_id, const std::vector<double>& buffer) {
+  size_t ncoeffs = numberOfCoeffs(c_id);
+  std::copy(buffer.begin(),buffer.begin()+ncoeffs,sampled_averages[c_id].begin());
+  std::copy(buffer.begin()+ncoeffs,buffer.end(),sampled_cross_averages[c_id].begin());
 }
 
 
@@ -503,7 +503,7 @@ void VesBias::addToSampledAverages(const std::vector<double>& values, const unsi
   // update off-diagonal part of the Hessian
   if(!diagonal_hessian_) {
     for(size_t i=rank; i<ncoeffs; i+=stride) {
-      for(size_t j=(i+1); j<ncoeffs; j++) {
+      for(size_t j=(i+1); j<getHessianBlockEnd(i,c_id); j++) {
         size_t midx = getHessianIndex(i,j,c_id);
         sampled_cross_averages[c_id][midx] += (values[i]*values[j]-sampled_cross_averages[c_id][midx])/(counter_dbl+1);
       }
@@ -567,13 +567,15 @@ void VesBias::linkOptimizer(Optimizer* optimizer_pntr_in) {
 }
 
 
-void VesBias::enableHessian(const bool diagonal_hessian) {
+void VesBias::enableHessian(const bool diagonal_hessian, const unsigned int hessian_block_size) {
   compute_hessian_=true;
   diagonal_hessian_=diagonal_hessian;
+  hessian_block_size_=hessian_block_size;
   sampled_cross_averages.clear();
   for (unsigned int i=0; i<ncoeffssets_; i++) {
     std::string label = getCoeffsSetLabelString("hessian",i);
-    hessian_pntrs_[i] = Tools::make_unique<CoeffsMatrix>(label,coeffs_pntrs_[i].get(),comm,diagonal_hessian_);
+    // only the diagonal blocks of the Hessian are stored
+    hessian_pntrs_[i] = Tools::make_unique<CoeffsMatrix>(label,coeffs_pntrs_[i].get(),comm,diagonal_hessian_,hessian_block_size_);
     //
     std::vector<double> cross_aver_sampled_tmp;
     cross_aver_sampled_tmp.assign(hessian_pntrs_[i]->getSize(),0.0);
@@ -585,6 +587,7 @@ void VesBias::enableHessian(const bool diagonal_hessian) {
 void VesBias::disableHessian() {
   compute_hessian_=false;
   diagonal_hessian_=true;
+  hessian_block_size_=0;
   sampled_cross_averages.clear();
   for (unsigned int i=0; i<ncoeffssets_; i++) {
     std::string label = getCoeffsSetLabelString("hessian",i);
@@ -79,6 +79,8 @@ private:
   //
   bool compute_hessian_;
   bool diagonal_hessian_;
+  // size of the diagonal blocks of a full Hessian, 0 to use the whole matrix
+  unsigned int hessian_block_size_;
   //
   std::vector<unsigned int> aver_counters;
   //
@@ -124,7 +126,11 @@ private:
 private:
   void initializeCoeffs(std::unique_ptr<CoeffsVector>);
   std::vector<double> computeCovarianceFromAverages(const unsigned int) const;
-  void multiSimSumAverages(const unsigned int, const double walker_weight=1.0);
+  // end of the Hessian block of a coefficient, i.e. the off-diagonal elements (index,j) with j<end are computed
+  size_t getHessianBlockEnd(const size_t index, const unsigned int coeffs_id = 0) const;
+  // copy the sampled averages and the computed cross averages in a single buffer for the MPI reductions
+  void packSampledAverages(const unsigned int, std::vector<double>&) const;
+  void unpackSampledAverages(const unsigned int, const std::vector<double>&);
 protected:
   //
   void checkThatTemperatureIsGiven();
@@ -191,6 +197,7 @@ public:
   //
   bool computeHessian() const {return compute_hessian_;}
   bool diagonalHessian() const {return diagonal_hessian_;}
+  unsigned int getHessianBlockSize() const {return hessian_block_size_;}
   //
   bool optimizeCoeffs() const {return optimize_coeffs_;}
   Optimizer* getOptimizerPntr() const {return optimizer_pntr_;}
@@ -205,7 +212,7 @@ public:
   virtual void restartTargetDistributions() {};
   //
   void linkOptimizer(Optimizer*);
-  void enableHessian(const bool diagonal_hessian=true);
+  void enableHessian(const bool diagonal_hessian=true, const unsigned int hessian_block_size=0);
   void disableHessian();
   //
   void enableMultipleCoeffsSets() {use_multiple_coeffssets_=true;}
@@ -359,6 +366,16 @@ void VesBias::applyBiasCutoff(double& bias, std::vector<double>& forces, std::ve
 }
 
 
+inline
+size_t VesBias::getHessianBlockEnd(const size_t index, const unsigned int coeffs_id) const {
+  size_t ncoeffs = numberOfCoeffs(coeffs_id);
+  if(diagonal_hessian_) {return index+1;}
+  if(hessian_block_size_==0) {return ncoeffs;}
+  size_t end = (index/hessian_block_size_+1)*hessian_block_size_;
+  return end<ncoeffs ? end : ncoeffs;
+}
+
+
 inline
 std::vector<double> VesBias::computeCovarianceFromAverages(const unsigned int c_id) const {
   size_t ncoeffs = numberOfCoeffs(c_id);
@@ -370,7 +387,7 @@ std::vector<double> VesBias::computeCovarianceFromAverages(const unsigned int c_
   }
   if(!diagonal_hessian_) {
     for(size_t i=0; i<ncoeffs; i++) {
-      for(size_t j=(i+1); j<ncoeffs; j++) {
+      for(size_t j=(i+1); j<getHessianBlockEnd(i,c_id); j++) {
         size_t midx = getHessianIndex(i,j,c_id);
         covariance[midx] = sampled_cross_averages[c_id][midx] - sampled_averages[c_id][i]*sampled_averages[c_id][j];
       }
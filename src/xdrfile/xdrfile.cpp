@@ -287,6 +287,26 @@ xdrfile_close(XDRFILE *xfp)
 }
 
 
+long long
+xdrfile_tell(XDRFILE *xfp)
+{
+	if(!xfp)
+		return -1;
+	/* the XDR stream reads through the FILE handle, so the two positions coincide */
+	return (long long) ftello(xfp->fp);
+}
+
+int
+xdrfile_seek(XDRFILE *xfp, long long offset, int whence)
+{
+	if(!xfp)
+		return -1;
+	if(xfp->mode!='r' && xfp->mode!='R')
+		fflush(xfp->fp);
+	return fseeko(xfp->fp,(off_t) offset,whence);
+}
+
+
 
 int 
 xdrfile_read_int(int *ptr, int ndata, XDRFILE* xfp) 
@@ -2310,7 +2330,7 @@ static int
 xdr_opaque (XDR *xdrs, char *cp, unsigned int cnt)
 {
 	unsigned int rndup;
-	static char crud[BYTES_PER_XDR_UNIT];
+	char crud[BYTES_PER_XDR_UNIT]; /* not static, so that different files can be read by different threads */
 
 	/*
 	 * if no data we are done
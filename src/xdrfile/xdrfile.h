@@ -168,6 +168,30 @@ namespace xdrfile
 	xdrfile_close   (XDRFILE *       xfp);
 
 
+	/*! \brief Get the current position in a portable binary file, just like ftell()
+	 *
+	 *  \param xfp  Pointer to an abstract XDRFILE datatype
+	 *
+	 *  \return     Offset in bytes from the beginning of the file, -1 on error.
+	 */
+	long long
+	xdrfile_tell    (XDRFILE *       xfp);
+
+
+	/*! \brief Move to a position in a portable binary file, just like fseek()
+	 *
+	 *  \param xfp     Pointer to an abstract XDRFILE datatype
+	 *  \param offset  Offset in bytes
+	 *  \param whence  SEEK_SET, SEEK_CUR or SEEK_END, as in fseek()
+	 *
+	 *  \return        0 on success, non-zero on error.
+	 */
+	int
+	xdrfile_seek    (XDRFILE *       xfp,
+					 long long       offset,
+					 int             whence);
+
+
 
 
 	/*! \brief Read one or more \a char type variable(s) 
@@ -56,6 +56,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -524,6 +525,27 @@ int read_trr(XDRFILE *xd,int natoms,int *step,float *t,float *lambda,
 	return do_trn(xd,1,step,t,lambda,box,&natoms,x,v,f);
 }
 
+int read_trr_skip(XDRFILE *xd,int natoms,int *step,float *t)
+{
+	t_trnheader sh;
+	int result;
+	long long nbytes;
+	
+	if ((result = do_trnheader(xd,1,&sh)) != exdrOK)
+		return result;
+	if (sh.natoms != natoms)
+		return exdrHEADER;
+	*step = sh.step;
+	*t    = sh.tf;
+	/* the body only contains the blocks listed in the header */
+	nbytes = (long long)sh.box_size + sh.vir_size + sh.pres_size +
+		sh.x_size + sh.v_size + sh.f_size;
+	if (xdrfile_seek(xd,nbytes,SEEK_CUR) != 0)
+		return exdr3DX;
+	
+	return exdrOK;
+}
+
 }
 }
 
@@ -78,6 +78,10 @@ namespace xdrfile {
   extern int read_trr(XDRFILE *xd,int natoms,int *step,float *t,float *lambda,
 		      matrix box,rvec *x,rvec *v,rvec *f);
 
+  /* Skip one frame of an open trr file without reading its arrays,
+   * the header is returned so that an index of the frames can be built */
+  extern int read_trr_skip(XDRFILE *xd,int natoms,int *step,float *t);
+
   /* Write a frame to xtc file */
   extern int write_trr(XDRFILE *xd,int natoms,int step,float t,float lambda,
 		       matrix box,rvec *x,rvec *v,rvec *f);
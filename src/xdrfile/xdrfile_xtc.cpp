@@ -52,6 +52,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
  
+#include <stdio.h>
 #include <stdlib.h>
 #include "xdrfile.h"
 #include "xdrfile_xtc.h"
@@ -146,6 +147,36 @@ int read_xtc(XDRFILE *xd,
 	return exdrOK;
 }
 
+int read_xtc_skip(XDRFILE *xd,
+				  int natoms,int *step,float *time)
+/* Skip subsequent frames */
+{
+	int result,lsize,nbytes;
+  
+	if ((result = xtc_header(xd,&natoms,step,time,TRUE)) != exdrOK)
+		return result;
+	/* box, then number of coordinates */
+	if (xdrfile_seek(xd,DIM*DIM*4,SEEK_CUR) != 0)
+		return exdrFLOAT;
+	if (xdrfile_read_int(&lsize,1,xd) != 1)
+		return exdrINT;
+	if (lsize != natoms)
+		return exdr3DX;
+	/* small systems are stored uncompressed */
+	if (lsize <= 9)
+		return xdrfile_seek(xd,DIM*4*(long long)lsize,SEEK_CUR) == 0 ? exdrOK : exdr3DX;
+	/* precision, minint, maxint and smallidx, then the compressed bytes */
+	if (xdrfile_seek(xd,8*4,SEEK_CUR) != 0)
+		return exdr3DX;
+	if (xdrfile_read_int(&nbytes,1,xd) != 1)
+		return exdrINT;
+	/* opaque data are padded to multiples of four bytes */
+	if (xdrfile_seek(xd,((long long)nbytes+3)/4*4,SEEK_CUR) != 0)
+		return exdr3DX;
+  
+	return exdrOK;
+}
+
 int write_xtc(XDRFILE *xd,
 			  int natoms,int step,float time,
 			  matrix box,rvec *x,float prec)
@@ -78,6 +78,10 @@ namespace xdrfile {
   extern int read_xtc(XDRFILE *xd,int natoms,int *step,float *time,
 		      matrix box,rvec *x,float *prec);
   
+  /* Skip one frame of an open xtc file without decompressing it,
+   * the header is returned so that an index of the frames can be built */
+  extern int read_xtc_skip(XDRFILE *xd,int natoms,int *step,float *time);
+  
   /* Write a frame to xtc file */
   extern int write_xtc(XDRFILE *xd,
 		       int natoms,int step,float time,